@@ -0,0 +1,1069 @@
+// Small benchmark program for turbo-buf
+// g++ --std=c++14 -O2 -pthread bench.cpp -o bench.out
+
+#include<algorithm>
+#include<atomic>
+#include<chrono>
+#include<cstdio>
+#include<cstdlib>
+#include<cstring>
+#include<functional>
+#include<new>
+#include<string>
+#include<vector>
+
+#include"tbuf.h"
+#include"tbuf_parallel.h"
+#include"tbuf_writer.h"
+#include"tbuf_binary.h"
+#include"tbuf_incremental.h"
+#include"tbuf_events.h"
+#include"tbuf_reader.h"
+#include"tbuf_tbnf.h"
+#include"sensors_gen.h"
+#include"fio.h"
+
+void benchScanKernels();
+void benchParse();
+void benchParallelParse();
+void benchIncrementalParse();
+void benchEventParser();
+void benchReader();
+void benchProjection();
+void benchTreeReuse();
+void benchLazyFetch();
+void benchTreeBuildAndTraversal();
+void benchWideDescend();
+void benchCompiledQuery();
+void benchHexDecoding();
+void benchHexArrays();
+void benchWriter();
+void benchBinaryCodec();
+void benchTbnf();
+void benchGeneratedParser();
+void benchCorpora();
+
+/** The number of heap allocations so far - the corpus harness reports them per operation */
+std::atomic<unsigned long long> allocationCount{0};
+
+void* operator new(size_t size) {
+	allocationCount.fetch_add(1, std::memory_order_relaxed);
+	void *p = malloc((size > 0) ? size : 1);
+	if(p == nullptr) throw std::bad_alloc();
+	return p;
+}
+
+void operator delete(void *p) noexcept {
+	free(p);
+}
+
+void operator delete(void *p, size_t size) noexcept {
+	free(p);
+}
+
+int main(int argc, char **argv){
+	// Only the synthetic corpora (for tracking regressions): ./bench.out corpus > results.tsv
+	if((argc > 1) && (strcmp(argv[1], "corpus") == 0)) {
+		benchCorpora();
+		return 0;
+	}
+
+	// Various benchmarks
+	benchScanKernels();
+	benchParse();
+	benchParallelParse();
+	benchIncrementalParse();
+	benchEventParser();
+	benchReader();
+	benchProjection();
+	benchTreeReuse();
+	benchLazyFetch();
+	benchTreeBuildAndTraversal();
+	benchWideDescend();
+	benchCompiledQuery();
+	benchHexDecoding();
+	benchHexArrays();
+	benchWriter();
+	benchBinaryCodec();
+	benchTbnf();
+	benchGeneratedParser();
+	benchCorpora();
+
+	// Exit
+	return 0;
+}
+
+/** Returns the seconds elapsed since the given start */
+double secondsSince(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+const char* levelName(int level) {
+	const char *names[] = {"scalar", "sse2", "avx2"};
+	return names[level];
+}
+
+/** Runs the kernel over the whole buffer as the parser would do: continuing after every stop */
+double kernelGBs(unsigned int (*kernel)(const char*, unsigned int), const std::vector<char> &buf) {
+	const int rounds = 20;
+	unsigned int stops = 0;
+	auto start = std::chrono::steady_clock::now();
+	for(int r = 0; r < rounds; ++r) {
+		unsigned int i = 0;
+		while(i < buf.size()) {
+			i += kernel(&buf[i], buf.size() - i) + 1;
+			++stops;
+		}
+	}
+	double s = secondsSince(start);
+	// Use the result so that nothing gets optimized out
+	if(stops == 0) printf("?");
+	return (double)buf.size() * rounds / s / 1e9;
+}
+
+void benchScanKernels(){
+	printf("Scanner kernel throughput (GB/s) on 16MB buffers:\n");
+	// Long hex runs separated by node names (like our sensor frames)
+	std::vector<char> hexes;
+	std::vector<char> texts;
+	std::vector<char> spaces;
+	const char *hexDigits = "0123456789ABCDEF";
+	unsigned int seed = 42;
+	while(hexes.size() < (16 << 20)) {
+		for(int i = 0; i < 4000; ++i) {
+			seed = seed * 1103515245 + 12345;
+			hexes.push_back(hexDigits[(seed >> 16) & 15]);
+			texts.push_back('a' + ((seed >> 16) % 26));
+			spaces.push_back(((seed >> 16) & 1) ? ' ' : '\t');
+		}
+		hexes.push_back('}');
+		texts.push_back('}');
+		spaces.push_back('x');
+	}
+	for(int level = 0; level <= (int)tbuf::Scan::bestLevel(); ++level) {
+		tbuf::ScanKernels k = tbuf::Scan::kernelsFor((tbuf::ScanLevel)level);
+		printf("  %-6s hexRun: %6.2f  textSpecial: %6.2f  structural: %6.2f  whiteSpaceRun: %6.2f\n",
+				levelName(level),
+				kernelGBs(k.hexRun, hexes),
+				kernelGBs(k.textSpecial, texts),
+				kernelGBs(k.structural, texts),
+				kernelGBs(k.whiteSpaceRun, spaces));
+	}
+}
+
+void benchParse(){
+	// Hex-heavy message: many nodes with long payloads and some text
+	std::string msg;
+	const char *hexDigits = "0123456789ABCDEF";
+	unsigned int seed = 7;
+	while(msg.length() < (32 << 20)) {
+		msg += "frame{";
+		for(int i = 0; i < 1024; ++i) {
+			seed = seed * 1103515245 + 12345;
+			msg += hexDigits[(seed >> 16) & 15];
+		}
+		msg += " sample_name{0A0B} $_note{Some text to be scanned \\} with escapes} word\n}\n";
+	}
+	printf("Tree parsing of a %u MB hex-heavy FastInput buffer (MB/s):\n", (unsigned int)(msg.length() >> 20));
+	std::vector<char> buf(msg.length() + 1);
+	for(int level = 0; level <= (int)tbuf::Scan::bestLevel(); ++level) {
+		tbuf::Scan::useLevel((tbuf::ScanLevel)level);
+		const int rounds = 3;
+		double best = 0;
+		for(int r = 0; r < rounds; ++r) {
+			// Destructive parsing changes the buffer so we need a fresh copy every time
+			std::copy(msg.begin(), msg.end(), buf.begin());
+			buf[msg.length()] = EOF;
+			fio::FastInput fin(msg.length(), &buf[0], false);
+			auto start = std::chrono::steady_clock::now();
+			tbuf::Tree tree(fin, true);
+			double mbs = msg.length() / secondsSince(start) / 1e6;
+			if(mbs > best) best = mbs;
+		}
+		printf("  %-6s %8.1f\n", levelName(level), best);
+	}
+	tbuf::Scan::useLevel(tbuf::Scan::bestLevel());
+
+	// The same with the two-stage parsing: structural index first, then the tree from the index
+	printf("Two-stage parsing of the same buffer (MB/s) - index / tree / both:\n");
+	for(int level = 0; level <= (int)tbuf::Scan::bestLevel(); ++level) {
+		tbuf::Scan::useLevel((tbuf::ScanLevel)level);
+		const int rounds = 3;
+		double bestIndex = 0, bestTree = 0, bestBoth = 0;
+		for(int r = 0; r < rounds; ++r) {
+			std::copy(msg.begin(), msg.end(), buf.begin());
+			buf[msg.length()] = EOF;
+			fio::FastInput fin(msg.length(), &buf[0], false);
+			auto start = std::chrono::steady_clock::now();
+			tbuf::StructuralIndex index(fin);
+			double indexSecs = secondsSince(start);
+			auto treeStart = std::chrono::steady_clock::now();
+			tbuf::Tree tree(index, true);
+			double treeSecs = secondsSince(treeStart);
+			bestIndex = std::max(bestIndex, msg.length() / indexSecs / 1e6);
+			bestTree = std::max(bestTree, msg.length() / treeSecs / 1e6);
+			bestBoth = std::max(bestBoth, msg.length() / (indexSecs + treeSecs) / 1e6);
+		}
+		printf("  %-6s %8.1f %8.1f %8.1f\n", levelName(level), bestIndex, bestTree, bestBoth);
+	}
+	tbuf::Scan::useLevel(tbuf::Scan::bestLevel());
+}
+
+/** Many big sibling subtrees below the root - with nested nodes, words, texts and comments */
+std::string structureHeavyMessage(unsigned int megaBytes) {
+	std::string msg;
+	const char *hexDigits = "0123456789ABCDEF";
+	unsigned int seed = 11;
+	while(msg.length() < (megaBytes << 20)) {
+		msg += "subtree{\n";
+		for(int i = 0; i < 200; ++i) {
+			msg += "\tsensor{";
+			for(int j = 0; j < 32; ++j) {
+				seed = seed * 1103515245 + 12345;
+				msg += hexDigits[(seed >> 16) & 15];
+			}
+			msg += " unit{0A} $_label{A label \\} of the sensor} enabled # comment\n\t}\n";
+		}
+		msg += "}\n";
+	}
+	return msg;
+}
+
+void benchParallelParse(){
+	std::string msg = structureHeavyMessage(64);
+	unsigned int maxThreads = std::max(4u, std::thread::hardware_concurrency());
+	printf("Parallel parsing of a %u MB structure-heavy buffer (MB/s) on %u hardware threads:\n",
+			(unsigned int)(msg.length() >> 20), std::thread::hardware_concurrency());
+	std::vector<char> buf(msg.length() + 1);
+	// The serial parse is the baseline
+	double serial = 0;
+	for(int r = 0; r < 3; ++r) {
+		std::copy(msg.begin(), msg.end(), buf.begin());
+		buf[msg.length()] = EOF;
+		fio::FastInput fin(msg.length(), &buf[0], false);
+		auto start = std::chrono::steady_clock::now();
+		tbuf::Tree tree(fin, true);
+		serial = std::max(serial, msg.length() / secondsSince(start) / 1e6);
+	}
+	printf("  serial    %8.1f\n", serial);
+	for(unsigned int threads = 1; threads <= maxThreads; threads *= 2) {
+		double best = 0;
+		for(int r = 0; r < 3; ++r) {
+			std::copy(msg.begin(), msg.end(), buf.begin());
+			buf[msg.length()] = EOF;
+			fio::FastInput fin(msg.length(), &buf[0], false);
+			auto start = std::chrono::steady_clock::now();
+			std::unique_ptr<tbuf::Tree> tree = tbuf::parallelParse(fin, threads);
+			best = std::max(best, msg.length() / secondsSince(start) / 1e6);
+		}
+		printf("  %2u threads %8.1f (%.2fx)\n", threads, best, best / serial);
+	}
+}
+
+void benchIncrementalParse(){
+	std::string msg = structureHeavyMessage(16);
+	std::vector<char> buf(msg.begin(), msg.end());
+	buf.push_back(EOF);
+	const int rounds = 3;
+	double wholeBest = 0;
+	for(int r = 0; r < rounds; ++r) {
+		fio::FastInput fin(msg.length(), &buf[0], false);
+		auto start = std::chrono::steady_clock::now();
+		tbuf::Tree tree(fin);
+		wholeBest = std::max(wholeBest, msg.length() / secondsSince(start) / 1e6);
+	}
+	// Every subtree is a message arriving in network packet sized fragments
+	double fragmentBest = 0;
+	unsigned int messages = 0;
+	for(int r = 0; r < rounds; ++r) {
+		tbuf::IncrementalParser parser;
+		auto start = std::chrono::steady_clock::now();
+		for(size_t at = 0; at < msg.length(); at += 1448) {
+			const char *data = msg.data() + at;
+			size_t length = std::min<size_t>(1448, msg.length() - at);
+			while(length > 0) {
+				size_t used = parser.feed(data, length);
+				data += used;
+				length -= used;
+				if(parser.hasMessage()) {
+					messages += (parser.take()->root.children.size() == 1);
+				}
+			}
+		}
+		fragmentBest = std::max(fragmentBest, msg.length() / secondsSince(start) / 1e6);
+	}
+	printf("Parsing the %u MB structure-heavy buffer with copying (MB/s) - whole: %.1f, incremental in 1448 byte fragments: %.1f\n",
+			(unsigned int)(msg.length() >> 20), wholeBest, fragmentBest);
+	if(messages == 0) printf("?");
+}
+
+/** Counts the events of the benchmark - optionally skipping every sensor */
+struct BenchHandler {
+	bool skipSensors;
+	unsigned int opens = 0;
+	unsigned int texts = 0;
+
+	tbuf::VisitResult onOpen(fio::LenString name) {
+		++opens;
+		return (skipSensors && (name.length == 6) && (name.startPtr[0] == 's')) ? tbuf::VisitResult::SKIP_CHILDREN : tbuf::VisitResult::CONTINUE;
+	}
+	void onHexes(fio::LenString digits) {}
+	void onText(fio::LenString name, fio::LenString text) { ++texts; }
+	void onClose() {}
+};
+
+void benchEventParser(){
+	std::string msg = structureHeavyMessage(16);
+	std::vector<char> buf(msg.begin(), msg.end());
+	buf.push_back(EOF);
+	const int rounds = 3;
+	double treeBest = 0;
+	for(int r = 0; r < rounds; ++r) {
+		fio::FastInput fin(msg.length(), &buf[0], false);
+		auto start = std::chrono::steady_clock::now();
+		tbuf::Tree tree(fin);
+		treeBest = std::max(treeBest, msg.length() / secondsSince(start) / 1e6);
+	}
+	double eventBest[2] = {0, 0};
+	unsigned long long allocations = 0;
+	for(int skip = 0; skip < 2; ++skip) {
+		for(int r = 0; r < rounds; ++r) {
+			fio::FastInput fin(msg.length(), &buf[0], false);
+			BenchHandler handler{skip == 1};
+			unsigned long long allocated = allocationCount;
+			auto start = std::chrono::steady_clock::now();
+			tbuf::parseEvents(fin, handler);
+			eventBest[skip] = std::max(eventBest[skip], msg.length() / secondsSince(start) / 1e6);
+			allocations += allocationCount - allocated;
+			if(handler.opens == 0) printf("?");
+		}
+	}
+	printf("Parsing the %u MB structure-heavy buffer (MB/s) - tree with copying: %.1f, events: %.1f, events skipping the sensors: %.1f (allocations: %llu)\n",
+			(unsigned int)(msg.length() >> 20), treeBest, eventBest[0], eventBest[1], allocations);
+}
+
+void benchReader(){
+	// Reading the unit of the 100th sensor in every subtree - only a few fields of a big message
+	std::string msg = structureHeavyMessage(16);
+	std::vector<char> buf(msg.begin(), msg.end());
+	buf.push_back(EOF);
+	const int rounds = 3;
+	double ms[3] = {1e9, 1e9, 1e9};
+	unsigned int found[3] = {0, 0, 0};
+	for(int r = 0; r < rounds; ++r) {
+		fio::FastInput fin(msg.length(), &buf[0], false);
+		auto start = std::chrono::steady_clock::now();
+		tbuf::Tree tree(fin);
+		found[0] = 0;
+		for(tbuf::Node &subtree : tree.root.children) {
+			tbuf::Node *unit = subtree.children[100].descend(tbuf::LevelDescender("unit"));
+			found[0] += (unit != nullptr) ? unit->core.data.asUint() : 0;
+		}
+		ms[0] = std::min(ms[0], secondsSince(start) * 1e3);
+	}
+	for(int skip = 0; skip < 2; ++skip) {
+		for(int r = 0; r < rounds; ++r) {
+			fio::FastInput fin(msg.length(), &buf[0], false);
+			auto start = std::chrono::steady_clock::now();
+			tbuf::Reader<fio::FastInput> reader(fin);
+			unsigned int sensor = 0;
+			found[1 + skip] = 0;
+			while(reader.next()) {
+				if(reader.kind() != tbuf::ReaderKind::NORM) continue;
+				if(reader.depth() == 1) {
+					sensor = 0;
+				} else if(reader.depth() == 2) {
+					if((sensor++ != 100) && skip) reader.skipChildren();
+				} else if((reader.depth() == 3) && (sensor == 101) && (reader.name().length == 4)) {
+					found[1 + skip] += reader.hexes().asUint();
+				}
+			}
+			ms[1 + skip] = std::min(ms[1 + skip], secondsSince(start) * 1e3);
+		}
+	}
+	printf("Reading one field per subtree of the %u MB structure-heavy buffer (ms) - tree: %.1f, reader: %.1f, reader with skipChildren: %.1f\n",
+			(unsigned int)(msg.length() >> 20), ms[0], ms[1], ms[2]);
+	if((found[0] != found[1]) || (found[0] != found[2])) printf("?");
+}
+
+void benchProjection(){
+	// Three fields out of a big message - the sensors are 10 nodes each
+	std::string msg = structureHeavyMessage(16);
+	std::vector<char> buf(msg.begin(), msg.end());
+	buf.push_back(EOF);
+	unsigned int subtrees = msg.length() / (msg.find("}\n}\n") + 4);
+	std::string middle = "subtree@" + std::to_string(subtrees / 2);
+	std::vector<tbuf::CompiledQuery> queries{
+		tbuf::CompiledQuery("subtree@0/sensor@3/unit"),
+		tbuf::CompiledQuery((middle + "/sensor@100/$_label").c_str()),
+		tbuf::CompiledQuery((middle + "/sensor@150").c_str()),
+	};
+	const int rounds = 3;
+	double ms[2] = {1e9, 1e9};
+	unsigned int nodes[2] = {0, 0};
+	for(int project = 0; project < 2; ++project) {
+		for(int r = 0; r < rounds; ++r) {
+			fio::FastInput fin(msg.length(), &buf[0], false);
+			auto start = std::chrono::steady_clock::now();
+			std::unique_ptr<tbuf::Tree> tree(project ? new tbuf::Tree(fin, queries) : new tbuf::Tree(fin));
+			unsigned int found = 0;
+			for(size_t i = 0; i < queries.size(); ++i) {
+				found += ((project ? tree->projected(i) : queries[i].find(tree->root)) != nullptr);
+			}
+			ms[project] = std::min(ms[project], secondsSince(start) * 1e3);
+			nodes[project] = 0;
+			tree->root.dfs_preorder([&] (tbuf::NodeCore &nc, unsigned int depth, bool leaf) { ++nodes[project]; });
+			if(found != queries.size()) printf("?");
+		}
+	}
+	printf("Three queries on the %u MB structure-heavy buffer (ms) - whole tree: %.1f (%u nodes), projection: %.1f (%u nodes)\n",
+			(unsigned int)(msg.length() >> 20), ms[0], nodes[0], ms[1], nodes[1]);
+}
+
+void benchTreeReuse(){
+	// Every subtree is a message on its own
+	std::string msg = structureHeavyMessage(16);
+	std::vector<std::vector<char>> bufs;
+	for(size_t at = msg.find("subtree{"); at != std::string::npos; ) {
+		size_t end = msg.find("subtree{", at + 1);
+		end = (end == std::string::npos) ? msg.length() : end;
+		bufs.push_back(std::vector<char>(msg.begin() + at, msg.begin() + end));
+		// The FastInput needs an EOF after the message
+		bufs.back().push_back(EOF);
+		at = (end < msg.length()) ? end : std::string::npos;
+	}
+	const int rounds = 3;
+	double best[2] = {0, 0};
+	unsigned long long allocations[2] = {0, 0};
+	for(int reuse = 0; reuse < 2; ++reuse) {
+		tbuf::Tree reused;
+		for(int r = 0; r < rounds; ++r) {
+			unsigned long long allocated = allocationCount;
+			auto start = std::chrono::steady_clock::now();
+			for(std::vector<char> &buf : bufs) {
+				fio::FastInput fin(buf.size() - 1, &buf[0], false);
+				if(reuse == 1) {
+					reused.reparse(fin);
+					if(reused.root.children.empty()) printf("?");
+				} else {
+					tbuf::Tree tree(fin);
+					if(tree.root.children.empty()) printf("?");
+				}
+			}
+			best[reuse] = std::max(best[reuse], msg.length() / secondsSince(start) / 1e6);
+			// The first round grows the reused tree
+			allocations[reuse] = allocationCount - allocated;
+		}
+	}
+	double messages = (double)bufs.size();
+	printf("Parsing %u messages of %u KB with copying (MB/s) - new trees: %.1f (%.1f allocations per message), reparsed tree: %.1f (%.1f allocations per message)\n",
+			(unsigned int)messages, (unsigned int)(bufs[0].size() >> 10), best[0], allocations[0] / messages, best[1], allocations[1] / messages);
+}
+
+void benchLazyFetch(){
+	printf("Parse + fetch of one path in the middle (ms) - eager / lazy:\n");
+	for(unsigned int megaBytes = 4; megaBytes <= 64; megaBytes *= 4) {
+		std::string msg = structureHeavyMessage(megaBytes);
+		unsigned int subtrees = msg.length() / (msg.find("}\n}\n") + 4);
+		std::vector<tbuf::LevelDescender> path{
+			tbuf::LevelDescender("subtree", subtrees / 2),
+			tbuf::LevelDescender("sensor", 100),
+			tbuf::LevelDescender("unit"),
+		};
+		double ms[2];
+		for(int lazy = 0; lazy < 2; ++lazy) {
+			std::vector<char> buf(msg.begin(), msg.end());
+			buf.push_back(EOF);
+			fio::FastInput fin(msg.length(), &buf[0], false);
+			auto start = std::chrono::steady_clock::now();
+			tbuf::Tree tree(fin, true, true, lazy == 1);
+			unsigned int found = 0;
+			tbuf::TreeQuery::fetch(tree.root, path, [&found] (tbuf::NodeCore &nc) {
+				found = nc.data.asUint();
+			});
+			ms[lazy] = secondsSince(start) * 1e3;
+			if(found != 0x0A) printf("?");
+		}
+		printf("  %2u MB %9.2f %9.2f\n", megaBytes, ms[0], ms[1]);
+	}
+}
+
+/** The recursive walk with a std::function passed by value - how dfs_preorder used to work (for comparison) */
+void recursiveStdFunctionPreorder(tbuf::Node &node, std::function<void (tbuf::NodeCore&, unsigned int, bool)> visitor, unsigned int depth) {
+	visitor(node.core, depth, node.children.size() == 0);
+	for(tbuf::Node &child : node.children) {
+		recursiveStdFunctionPreorder(child, visitor, depth + 1);
+	}
+}
+
+void benchTreeBuildAndTraversal(){
+	std::string msg = structureHeavyMessage(64);
+	std::vector<char> buf(msg.begin(), msg.end());
+	buf.push_back(EOF);
+	fio::FastInput fin(msg.length(), &buf[0], false);
+	auto start = std::chrono::steady_clock::now();
+	tbuf::Tree tree(fin, true);
+	double parseMs = secondsSince(start) * 1e3;
+	printf("Serial parse of the %u MB structure-heavy buffer: %.1f ms\n", (unsigned int)(msg.length() >> 20), parseMs);
+	// Visit every node a few times
+	const int rounds = 5;
+	unsigned long long visited = 0;
+	auto counter = [&visited] (tbuf::NodeCore &nc, unsigned int depth, bool leaf) {
+		visited += nc.nameLength;
+	};
+	start = std::chrono::steady_clock::now();
+	for(int r = 0; r < rounds; ++r) {
+		recursiveStdFunctionPreorder(tree.root, counter, 0);
+	}
+	double recursiveMs = secondsSince(start) * 1e3 / rounds;
+	std::function<void (tbuf::NodeCore&, unsigned int, bool)> wrapped = counter;
+	start = std::chrono::steady_clock::now();
+	for(int r = 0; r < rounds; ++r) {
+		tree.root.dfs_preorder(wrapped);
+	}
+	double wrappedMs = secondsSince(start) * 1e3 / rounds;
+	start = std::chrono::steady_clock::now();
+	for(int r = 0; r < rounds; ++r) {
+		tree.root.dfs_preorder(counter);
+	}
+	double inlinedMs = secondsSince(start) * 1e3 / rounds;
+	// Only the top two levels: the sensors are skipped
+	start = std::chrono::steady_clock::now();
+	for(int r = 0; r < rounds; ++r) {
+		tree.root.dfs_preorder([&visited] (tbuf::NodeCore &nc, unsigned int depth, bool leaf) {
+			visited += nc.nameLength;
+			return (depth == 1) ? tbuf::VisitResult::SKIP_CHILDREN : tbuf::VisitResult::CONTINUE;
+		});
+	}
+	double skippingMs = secondsSince(start) * 1e3 / rounds;
+	printf("Preorder walks over the tree (ms) - recursive std::function: %.1f, iterative std::function: %.1f, "
+			"iterative inlined: %.1f, skipping the sensors: %.2f\n", recursiveMs, wrappedMs, inlinedMs, skippingMs);
+	if(visited == 0) printf("?");
+}
+
+void benchWideDescend(){
+	// One wide node with children of similar long names - the target is the last one
+	std::string msg = "wide{\n";
+	const int width = 50000;
+	for(int i = 0; i < width; ++i) {
+		msg += "measurement_channel_" + std::to_string(i % 100) + "{0A}\n";
+	}
+	msg += "measurement_channel_target{0B}\n}\n";
+	std::vector<char> buf(msg.begin(), msg.end());
+	buf.push_back(EOF);
+	fio::FastInput fin(msg.length(), &buf[0], false);
+	tbuf::Tree tree(fin, true);
+	tbuf::Node &wide = tree.root.children[0];
+	tbuf::LevelDescender byName("measurement_channel_target");
+	tbuf::LevelDescender byPrefix("measurement_channel_t", 0, true);
+	const int rounds = 200;
+	unsigned int found = 0;
+	// The first lookup builds the child index of the wide node
+	auto start = std::chrono::steady_clock::now();
+	found += wide.descend(byName)->core.data.asUint();
+	double firstUs = secondsSince(start) * 1e6;
+	start = std::chrono::steady_clock::now();
+	for(int r = 0; r < rounds; ++r) {
+		found += wide.descend(byName)->core.data.asUint();
+	}
+	double nameUs = secondsSince(start) * 1e6 / rounds;
+	start = std::chrono::steady_clock::now();
+	for(int r = 0; r < rounds; ++r) {
+		found += wide.descend(byPrefix)->core.data.asUint();
+	}
+	double prefixUs = secondsSince(start) * 1e6 / rounds;
+	printf("Descend to the last of %d children (us) - first (builds the index): %.1f, by name: %.3f, by prefix: %.3f\n",
+			width + 1, firstUs, nameUs, prefixUs);
+	if(found != (2 * rounds + 1) * 0x0B) printf("?");
+}
+
+void benchCompiledQuery(){
+	std::string msg = structureHeavyMessage(4);
+	std::vector<char> buf(msg.begin(), msg.end());
+	buf.push_back(EOF);
+	fio::FastInput fin(msg.length(), &buf[0], false);
+	tbuf::Tree tree(fin, true);
+	const int rounds = 100000;
+	unsigned int found = 0;
+	// Building the descenders on every call
+	auto start = std::chrono::steady_clock::now();
+	for(int r = 0; r < rounds; ++r) {
+		tbuf::TreeQuery::fetch(tree.root, {"subtree@7", "sensor@150", "unit"}, [&found] (tbuf::NodeCore &nc) {
+			found += nc.data.asUint();
+		});
+	}
+	double perCallNs = secondsSince(start) * 1e9 / rounds;
+	// Compiling once
+	tbuf::CompiledQuery query = tbuf::TreeQuery::compile("subtree@7/sensor@150/unit");
+	start = std::chrono::steady_clock::now();
+	for(int r = 0; r < rounds; ++r) {
+		query.fetch(tree.root, [&found] (tbuf::Node &node) {
+			found += node.core.data.asUint();
+		});
+	}
+	double compiledNs = secondsSince(start) * 1e9 / rounds;
+	// Parsed and hashed at compile time
+	start = std::chrono::steady_clock::now();
+	for(int r = 0; r < rounds; ++r) {
+		TBUF_PATH("subtree@7/sensor@150/unit").fetch(tree.root, [&found] (tbuf::Node &node) {
+			found += node.core.data.asUint();
+		});
+	}
+	double literalNs = secondsSince(start) * 1e9 / rounds;
+	printf("Query subtree@7/sensor@150/unit (ns) - descenders per call: %.1f, compiled once: %.1f, path literal: %.1f\n",
+			perCallNs, compiledNs, literalNs);
+	if(found != 3 * rounds * 0x0A) printf("?");
+}
+
+void benchHexDecoding(){
+	// Many 4 KB payloads
+	std::string hex;
+	const char *hexDigits = "0123456789ABCDEF";
+	unsigned int seed = 5;
+	while(hex.length() < (16 << 20)) {
+		seed = seed * 1103515245 + 12345;
+		hex += hexDigits[(seed >> 16) & 15];
+	}
+	const unsigned int payload = 4096;
+	std::vector<uint8_t> out(payload / 2);
+	const int rounds = 5;
+	unsigned int check = 0;
+	// One nibble at a time with a branchy conversion (how the payloads had to be decoded before)
+	auto start = std::chrono::steady_clock::now();
+	for(int r = 0; r < rounds; ++r) {
+		for(size_t at = 0; at + payload <= hex.length(); at += payload) {
+			for(unsigned int i = 0; i < payload; i += 2) {
+				out[i / 2] = (tbuf::Hexes::hexValueOf(hex[at + i]) << 4) | tbuf::Hexes::hexValueOf(hex[at + i + 1]);
+			}
+			check += out[7];
+		}
+	}
+	double nibbleGBs = (double)hex.length() * rounds / secondsSince(start) / 1e9;
+	start = std::chrono::steady_clock::now();
+	for(int r = 0; r < rounds; ++r) {
+		for(size_t at = 0; at + payload <= hex.length(); at += payload) {
+			tbuf::Hexes h{fio::LenString{payload, &hex[at]}};
+			if(h.decodeBytes(&out[0], out.size()) != out.size()) printf("?");
+			check += out[7];
+		}
+	}
+	double decodeGBs = (double)hex.length() * rounds / secondsSince(start) / 1e9;
+	// 16 digit integers
+	start = std::chrono::steady_clock::now();
+	uint64_t sum = 0;
+	for(size_t at = 0; at + 16 <= hex.length(); at += 16) {
+		tbuf::Hexes h{fio::LenString{16, &hex[at]}};
+		uint64_t value;
+		if(h.asUint64(value)) sum += value;
+	}
+	double uint64Ns = secondsSince(start) * 1e9 / (hex.length() / 16);
+	printf("Hex decoding (GB/s of hexes) - nibble loop: %.2f, decodeBytes: %.2f, asUint64 of 16 digits: %.1f ns\n",
+			nibbleGBs, decodeGBs, uint64Ns);
+	if((check == 0) || (sum == 0)) printf("?");
+}
+
+void benchHexArrays(){
+	// Sensor frames: 64 samples of 4 hexes each
+	std::string hex;
+	const char *hexDigits = "0123456789ABCDEF";
+	unsigned int seed = 13;
+	while(hex.length() < (16 << 20)) {
+		seed = seed * 1103515245 + 12345;
+		hex += hexDigits[(seed >> 16) & 15];
+	}
+	const unsigned int frame = 64 * 4;
+	uint16_t samples[64];
+	unsigned int check = 0;
+	auto start = std::chrono::steady_clock::now();
+	for(size_t at = 0; at + frame <= hex.length(); at += frame) {
+		// Hand-rolled: one small Hexes per sample
+		for(int i = 0; i < 64; ++i) {
+			samples[i] = tbuf::Hexes{fio::LenString{4, &hex[at + i * 4]}}.asUint();
+		}
+		check += samples[63];
+	}
+	double perSampleGBs = (double)hex.length() / secondsSince(start) / 1e9;
+	start = std::chrono::steady_clock::now();
+	for(size_t at = 0; at + frame <= hex.length(); at += frame) {
+		tbuf::Hexes h{fio::LenString{frame, &hex[at]}};
+		if(h.asArray<uint16_t>().decodeInto(samples, 64) != 64) printf("?");
+		check += samples[63];
+	}
+	double arrayGBs = (double)hex.length() / secondsSince(start) / 1e9;
+	printf("Sensor frames of 64 x 4 hexes (GB/s of hexes) - per sample: %.2f, asArray<uint16_t>: %.2f\n", perSampleGBs, arrayGBs);
+	if(check == 0) printf("?");
+}
+
+void benchWriter(){
+	std::string msg = structureHeavyMessage(16);
+	std::vector<char> buf(msg.begin(), msg.end());
+	buf.push_back(EOF);
+	fio::FastInput fin(msg.length(), &buf[0], false);
+	tbuf::Tree tree(fin);
+	FILE *devNull = fopen("/dev/null", "w");
+	const int rounds = 3;
+	printf("Serializing the %u MB structure-heavy tree (MB/s of input) - pretty / dense:\n", (unsigned int)(msg.length() >> 20));
+	double writeOutMBs[2], fileMBs[2], fdMBs[2], memoryMBs[2];
+	fio::MemoryOutput memory;
+	for(int pretty = 1; pretty >= 0; --pretty) {
+		double best[4] = {0, 0, 0, 0};
+		for(int r = 0; r < rounds; ++r) {
+			auto start = std::chrono::steady_clock::now();
+			tree.root.writeOut(devNull, pretty == 1);
+			fflush(devNull);
+			best[0] = std::max(best[0], msg.length() / secondsSince(start) / 1e6);
+			start = std::chrono::steady_clock::now();
+			{
+				fio::StreamOutput out(devNull);
+				tbuf::Writer<fio::StreamOutput>(out, pretty == 1).write(tree.root);
+				out.flush();
+			}
+			best[1] = std::max(best[1], msg.length() / secondsSince(start) / 1e6);
+			start = std::chrono::steady_clock::now();
+			{
+				fio::StreamOutput out(fileno(devNull));
+				tbuf::Writer<fio::StreamOutput>(out, pretty == 1).write(tree.root);
+			}
+			best[2] = std::max(best[2], msg.length() / secondsSince(start) / 1e6);
+			memory.clear();
+			start = std::chrono::steady_clock::now();
+			tbuf::Writer<fio::MemoryOutput>(memory, pretty == 1).write(tree.root);
+			best[3] = std::max(best[3], msg.length() / secondsSince(start) / 1e6);
+		}
+		writeOutMBs[pretty] = best[0];
+		fileMBs[pretty] = best[1];
+		fdMBs[pretty] = best[2];
+		memoryMBs[pretty] = best[3];
+	}
+	printf("  writeOut(FILE*)      %8.1f %8.1f\n", writeOutMBs[1], writeOutMBs[0]);
+	printf("  Writer + FILE*       %8.1f %8.1f\n", fileMBs[1], fileMBs[0]);
+	printf("  Writer + fd (writev) %8.1f %8.1f\n", fdMBs[1], fdMBs[0]);
+	printf("  Writer + memory      %8.1f %8.1f\n", memoryMBs[1], memoryMBs[0]);
+	fclose(devNull);
+	if(memory.size() == 0) printf("?");
+}
+
+void benchBinaryCodec(){
+	std::string msg = structureHeavyMessage(16);
+	std::vector<char> buf(msg.begin(), msg.end());
+	buf.push_back(EOF);
+	fio::FastInput fin(msg.length(), &buf[0], false);
+	tbuf::Tree tree(fin);
+	const int rounds = 3;
+	double encodeMs = 1e9, textMs = 1e9, decodeMs = 1e9, referMs = 1e9, walkMs = 1e9;
+	std::string encoded;
+	for(int r = 0; r < rounds; ++r) {
+		auto start = std::chrono::steady_clock::now();
+		encoded = tbuf::BinaryCodec::encode(tree.root);
+		encodeMs = std::min(encodeMs, secondsSince(start) * 1e3);
+		fio::LenString message{(unsigned int)encoded.length(), &encoded[0]};
+		// The copying text parse is the baseline for the copying decode
+		fio::FastInput textIn(msg.length(), &buf[0], false);
+		start = std::chrono::steady_clock::now();
+		{
+			tbuf::Tree parsed(textIn);
+		}
+		textMs = std::min(textMs, secondsSince(start) * 1e3);
+		start = std::chrono::steady_clock::now();
+		std::unique_ptr<tbuf::Tree> decoded = tbuf::BinaryCodec::decode(message);
+		decodeMs = std::min(decodeMs, secondsSince(start) * 1e3);
+		decoded.reset();
+		start = std::chrono::steady_clock::now();
+		decoded = tbuf::BinaryCodec::decode(message, true);
+		referMs = std::min(referMs, secondsSince(start) * 1e3);
+		unsigned long long visited = 0;
+		start = std::chrono::steady_clock::now();
+		tbuf::BinaryCodec::walk(message, [&visited] (tbuf::NodeCore &nc, unsigned int depth, bool leaf) {
+			visited += nc.nameLength;
+		});
+		walkMs = std::min(walkMs, secondsSince(start) * 1e3);
+		if(visited == 0) printf("?");
+	}
+	printf("Binary encoding of the %u MB structure-heavy tree: %.1f MB (%.0f%%), encode: %.1f ms\n",
+			(unsigned int)(msg.length() >> 20), encoded.length() / 1048576.0, 100.0 * encoded.length() / msg.length(), encodeMs);
+	printf("  text parse: %.1f ms, binary decode: %.1f ms, decode referring the message: %.1f ms, walk without a tree: %.1f ms\n",
+			textMs, decodeMs, referMs, walkMs);
+}
+
+void benchTbnf(){
+	std::string msg = structureHeavyMessage(16);
+	std::vector<char> buf(msg.begin(), msg.end());
+	buf.push_back(EOF);
+	fio::FastInput fin(msg.length(), &buf[0], false);
+	tbuf::Tree tree(fin);
+	// The exact schema of the message and the general grammar of any message
+	const char *schema =
+		"@include<tbuf.tbnf>\n"
+		"frame::=<subtree>*\n"
+		"subtree::=subtree{<sensor>*}\n"
+		"sensor::=sensor{<hex>*32 <unit> <label> enabled{}}\n"
+		"unit::=unit{<hex>+}\n"
+		"label::=$_label{<ESCAPED_UTF8>*}\n";
+	tbuf::TbnfGrammar grammar;
+	if(!grammar.load(schema, strlen(schema)) || !grammar.compile("frame") || !grammar.compile("lang")) {
+		printf("? %s\n", grammar.error().c_str());
+		return;
+	}
+	std::string encoded = tbuf::BinaryCodec::encode(tree.root);
+	fio::LenString message{(unsigned int)encoded.length(), &encoded[0]};
+	tbuf::TbnfValidator frameValidator(grammar, "frame");
+	tbuf::TbnfValidator langValidator(grammar, "lang");
+	const int rounds = 3;
+	double walkMs = 1e9, frameMs = 1e9, langMs = 1e9, binaryMs = 1e9;
+	bool fits = true;
+	for(int r = 0; r < rounds; ++r) {
+		// Just walking the tree is the baseline
+		unsigned long long visited = 0;
+		auto start = std::chrono::steady_clock::now();
+		tree.root.dfs_preorder([&visited] (tbuf::NodeCore &nc, unsigned int depth, bool leaf) {
+			visited += nc.nameLength;
+		});
+		walkMs = std::min(walkMs, secondsSince(start) * 1e3);
+		if(visited == 0) printf("?");
+		start = std::chrono::steady_clock::now();
+		frameValidator.reset();
+		tree.root.dfs_preorder(frameValidator);
+		fits = frameValidator.finish() && fits;
+		frameMs = std::min(frameMs, secondsSince(start) * 1e3);
+		start = std::chrono::steady_clock::now();
+		langValidator.reset();
+		tree.root.dfs_preorder(langValidator);
+		fits = langValidator.finish() && fits;
+		langMs = std::min(langMs, secondsSince(start) * 1e3);
+		// Validating while decoding the binary message - without any tree
+		start = std::chrono::steady_clock::now();
+		frameValidator.reset();
+		tbuf::BinaryCodec::walk(message, frameValidator);
+		fits = frameValidator.finish() && fits;
+		binaryMs = std::min(binaryMs, secondsSince(start) * 1e3);
+	}
+	if(!fits) printf("? %s %s\n", frameValidator.error().c_str(), langValidator.error().c_str());
+	printf("Validating the %u MB structure-heavy tree against turbo-bnf (ms) - walk only: %.1f, schema: %.1f, tbuf.tbnf: %.1f, schema while walking the binary message: %.1f\n",
+			(unsigned int)(msg.length() >> 20), walkMs, frameMs, langMs, binaryMs);
+}
+
+void benchGeneratedParser(){
+	std::string msg = structureHeavyMessage(16);
+	std::vector<char> buf(msg.begin(), msg.end());
+	buf.push_back(EOF);
+	const int rounds = 3;
+	double treeMs = 1e9, generatedMs = 1e9, againMs = 1e9;
+	bool fits = true;
+	sensors::Frame frame;
+	for(int r = 0; r < rounds; ++r) {
+		// Building the generic tree is the baseline
+		fio::FastInput treeIn(msg.length(), &buf[0], false);
+		auto start = std::chrono::steady_clock::now();
+		{
+			tbuf::Tree tree(treeIn);
+		}
+		treeMs = std::min(treeMs, secondsSince(start) * 1e3);
+		// Into fresh structs and then into the same ones again
+		fio::FastInput freshIn(msg.length(), &buf[0], false);
+		start = std::chrono::steady_clock::now();
+		{
+			sensors::Frame fresh;
+			fits = sensors::parse(freshIn, fresh) && fits;
+		}
+		generatedMs = std::min(generatedMs, secondsSince(start) * 1e3);
+		fio::FastInput againIn(msg.length(), &buf[0], false);
+		start = std::chrono::steady_clock::now();
+		fits = sensors::parse(againIn, frame) && fits;
+		againMs = std::min(againMs, secondsSince(start) * 1e3);
+	}
+	if(!fits) printf("?");
+	printf("Parsing the %u MB structure-heavy message (ms) - Tree: %.1f, generated structs: %.1f, into the same structs again: %.1f\n",
+			(unsigned int)(msg.length() >> 20), treeMs, generatedMs, againMs);
+}
+
+/** Appends pseudo-random hex digits */
+void appendHexes(std::string &msg, unsigned int count, unsigned int &seed) {
+	const char *hexDigits = "0123456789ABCDEF";
+	for(unsigned int i = 0; i < count; ++i) {
+		seed = seed * 1103515245 + 12345;
+		msg += hexDigits[(seed >> 16) & 15];
+	}
+}
+
+/** Chains of 4096 nested nodes one after the other */
+std::string deepCorpus(unsigned int megaBytes) {
+	std::string msg;
+	while(msg.length() < (megaBytes << 20)) {
+		for(int i = 0; i < 4096; ++i) {
+			msg += "chain{";
+		}
+		msg += "0A";
+		msg.append(4096, '}');
+		msg += '\n';
+	}
+	return msg;
+}
+
+/** Nodes with 100k children each */
+std::string wideCorpus(unsigned int megaBytes) {
+	std::string msg;
+	unsigned int seed = 13;
+	while(msg.length() < (megaBytes << 20)) {
+		msg += "wide{\n";
+		for(int i = 0; i < 100000; ++i) {
+			msg += "item{";
+			appendHexes(msg, 4, seed);
+			msg += "} ";
+		}
+		msg += "}\n";
+	}
+	return msg;
+}
+
+/** Few nodes with 4 KB payloads */
+std::string hexCorpus(unsigned int megaBytes) {
+	std::string msg;
+	unsigned int seed = 17;
+	while(msg.length() < (megaBytes << 20)) {
+		msg += "frame{";
+		appendHexes(msg, 4096, seed);
+		msg += "}\n";
+	}
+	return msg;
+}
+
+/** Long texts with many escapes */
+std::string textCorpus(unsigned int megaBytes) {
+	std::string msg;
+	while(msg.length() < (megaBytes << 20)) {
+		msg += "doc{\n";
+		for(int i = 0; i < 64; ++i) {
+			msg += "\t$_line{Some \\{escaped\\} text with a backslash \\\\ and more words to scan in every line of it}\n";
+		}
+		msg += "}\n";
+	}
+	return msg;
+}
+
+/** Small nodes between long comment lines */
+std::string commentCorpus(unsigned int megaBytes) {
+	std::string msg;
+	unsigned int seed = 19;
+	while(msg.length() < (megaBytes << 20)) {
+		msg += "# A long comment line {with braces} and $_things{} that should all be skipped by the parser\n";
+		msg += "# Another one right after it\n";
+		msg += "value{";
+		appendHexes(msg, 8, seed);
+		msg += "}\n";
+	}
+	return msg;
+}
+
+/** Many empty leaves (words) in small nodes */
+std::string wordCorpus(unsigned int megaBytes) {
+	std::string msg;
+	while(msg.length() < (megaBytes << 20)) {
+		msg += "tags{ red green yellow purple orange white black grey pink silver }\n";
+	}
+	return msg;
+}
+
+/** Prints one machine readable result: corpus<TAB>shape<TAB>metric<TAB>value<TAB>unit */
+void corpusResult(const char *shape, const char *metric, double value, const char *unit) {
+	printf("corpus\t%s\t%s\t%.2f\t%s\n", shape, metric, value, unit);
+}
+
+/**
+ * The harness over synthetic corpora of different shapes. Every result is one tab separated line (see corpusResult)
+ * so the output of different versions can be compared line by line. Times are the best of a few rounds.
+ */
+void benchCorpora(){
+	struct Shape {
+		const char *name;
+		std::string (*generate)(unsigned int megaBytes);
+		/** A query for the fetch latency: deep enough into the corpus to make it count */
+		const char *query;
+	};
+	const Shape shapes[] = {
+		{"deep", deepCorpus, "chain@3/chain/chain/chain/chain/chain/chain/chain/chain/chain/chain/chain"},
+		{"wide", wideCorpus, "wide@2/item@99999"},
+		{"hex", hexCorpus, "frame@1000"},
+		{"text", textCorpus, "doc@500/$_line@63"},
+		{"comment", commentCorpus, "value@50000"},
+		{"words", wordCorpus, "tags@10000/silver"},
+	};
+	const unsigned int megaBytes = 16;
+	const int rounds = 3;
+	printf("corpus\tshape\tmetric\tvalue\tunit\n");
+	FILE *devNull = fopen("/dev/null", "w");
+	for(const Shape &shape : shapes) {
+		std::string msg = shape.generate(megaBytes);
+		std::vector<char> buf(msg.length() + 1);
+		corpusResult(shape.name, "size", msg.length() / 1e6, "MB");
+		// Tree construction in both modes
+		double nodes = 0;
+		for(int refer = 1; refer >= 0; --refer) {
+			double best = 1e9;
+			unsigned long long allocations = 0;
+			for(int r = 0; r < rounds; ++r) {
+				// Referring the input changes the buffer so we need a fresh copy every time
+				std::copy(msg.begin(), msg.end(), buf.begin());
+				buf[msg.length()] = EOF;
+				fio::FastInput fin(msg.length(), &buf[0], false);
+				unsigned long long before = allocationCount;
+				auto start = std::chrono::steady_clock::now();
+				tbuf::Tree tree(fin, refer == 1);
+				best = std::min(best, secondsSince(start));
+				allocations = allocationCount - before;
+				if(nodes == 0) {
+					tree.root.dfs_preorder([&nodes] (tbuf::NodeCore &nc, unsigned int depth, bool leaf) {
+						++nodes;
+					});
+				}
+			}
+			const char *mode = refer ? "refer" : "copy";
+			corpusResult(shape.name, (std::string("tree_") + mode + "_speed").c_str(), msg.length() / best / 1e6, "MB/s");
+			corpusResult(shape.name, (std::string("tree_") + mode + "_per_node").c_str(), best * 1e9 / nodes, "ns");
+			corpusResult(shape.name, (std::string("tree_") + mode + "_allocations").c_str(), (double)allocations, "count");
+		}
+		corpusResult(shape.name, "nodes", nodes, "count");
+		// The operations on a tree that does not refer the input
+		std::copy(msg.begin(), msg.end(), buf.begin());
+		buf[msg.length()] = EOF;
+		fio::FastInput fin(msg.length(), &buf[0], false);
+		tbuf::Tree tree(fin);
+		// Fetch latency with the query string (the first one can build child indices - that is not measured)
+		unsigned int found = 0;
+		auto fetcher = [&found] (tbuf::NodeCore &nc) {
+			found += nc.nameLength;
+		};
+		tbuf::TreeQuery::fetch(tree.root, shape.query, fetcher);
+		const int fetches = 10000;
+		unsigned long long before = allocationCount;
+		auto start = std::chrono::steady_clock::now();
+		for(int i = 0; i < fetches; ++i) {
+			tbuf::TreeQuery::fetch(tree.root, shape.query, fetcher);
+		}
+		corpusResult(shape.name, "fetch_latency", secondsSince(start) * 1e9 / fetches, "ns");
+		corpusResult(shape.name, "fetch_allocations", (double)(allocationCount - before) / fetches, "count");
+		if(found == 0) printf("?");
+		// Preorder walk
+		double best = 1e9;
+		unsigned long long visited = 0;
+		for(int r = 0; r < rounds; ++r) {
+			start = std::chrono::steady_clock::now();
+			tree.root.dfs_preorder([&visited] (tbuf::NodeCore &nc, unsigned int depth, bool leaf) {
+				visited += nc.nameLength;
+			});
+			best = std::min(best, secondsSince(start));
+		}
+		corpusResult(shape.name, "dfs_preorder_per_node", best * 1e9 / nodes, "ns");
+		if(visited == 0) printf("?");
+		// Dense writeOut (pretty printing of the deep chains would be quadratic because of the indentation)
+		best = 1e9;
+		for(int r = 0; r < rounds; ++r) {
+			start = std::chrono::steady_clock::now();
+			tree.root.writeOut(devNull, false);
+			fflush(devNull);
+			best = std::min(best, secondsSince(start));
+		}
+		corpusResult(shape.name, "writeout_speed", msg.length() / best / 1e6, "MB/s");
+		corpusResult(shape.name, "writeout_per_node", best * 1e9 / nodes, "ns");
+	}
+	fclose(devNull);
+}
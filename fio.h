@@ -5,10 +5,24 @@
 
 #include<fstream>
 #include<cstdio>
+#include<cstring>
+#include<cstdint>
+#include<cerrno>
+#include<string>
 #include<vector>
 #include<algorithm>
 #include"fio_data.h"
 
+// Memory mapped and file descriptor based inputs (and outputs) are only available on posix systems
+#if defined(__unix__) || defined(__APPLE__)
+#define FIO_HAS_POSIX 1
+#include<fcntl.h>
+#include<unistd.h>
+#include<sys/mman.h>
+#include<sys/stat.h>
+#include<sys/uio.h>
+#endif
+
 // The I/O part of fio
 namespace fio {
 
@@ -53,6 +67,17 @@ public:
 	/** Advance the reading position. You should not advance behind grabCurr() returning EOF as that is undefined! */
 	void advance() { }
 
+	/** Advance the reading position by n characters. Never advance more than what grabAhead() returned! */
+	void advance(unsigned int n) { }
+
+	/**
+	 * Returns the characters that are already available in the memory starting from the head (the first is grabCurr)
+	 * without advancing. This lets the users scan more characters at once (for example with vectorized code) and
+	 * then advance(n) over them. When the returned length is zero, we have reached the end of the stream.
+	 * The returned LenString is only valid until the next advance - and it never contains the EOF.
+	 */
+	LenString grabAhead() { }
+
 	/**
 	 * Grab all characters of the input from the point defined by the given seam handle until the current head.
 	 * The resulting length+char* includes the characted right below the head - the one you can get with grabCurr!
@@ -77,6 +102,13 @@ public:
 	 * Some implementation might allow users to do these tricks, but others (like maybe a memory mapped file) cannot let them do this!
 	 */
 	bool isSupportingDangerousDestructiveOperations() { }
+
+	/**
+	 * Tells the user if the LenStrings returned by the grab operations stay valid (and unchanged by the input itself)
+	 * for the whole life-cycle of the input object or not. When this returns false, the grabbed data is only valid
+	 * until the next advance() so users must copy what they want to keep! (for example a stream that refills a buffer)
+	 */
+	bool isSupportingPersistentGrabs() { }
 };
 
 // This is designed to be as fast as it can be by using a lot of inlining and tricks
@@ -103,14 +135,14 @@ public:
 
 	/**
 	 * Create a fast-input handler using the data already in the memory.
-	 * (!) The last character of the provided buffer need to be EOF for this to work (except length=0 cases)
+	 * (!) The character after the last one (buffer[buf_len]) need to be EOF for this to work (except length=0 cases)
 	 * (!) Beware that the returned LenString's might modify the underlying buffers when you ask for c_strs in the fast way.
 	 * (!) This might result in having a really different scan after a reset when changing memory with those unsafe operators!!!
 	 */
 	FastInput(const int buf_len, char* buffer, bool ownsProvidedBufferMemory = true) {
 		// We just copy pointers and provided data!
 		length = buf_len;
-		buffer = buffer;
+		this->buffer = buffer;
 		head = buffer;
 		// They tell us if we own the provided buffer memory or not
 		// so that we delete it in destructor or not!
@@ -157,6 +189,17 @@ public:
 		++head;
 	}
 
+	inline void advance(unsigned int n) {
+		head += n;
+	}
+
+	inline LenString grabAhead() {
+		return LenString {
+			(length > 0) ? (unsigned int)((buffer + length) - head) : 0,
+			head
+		};
+	}
+
 	inline LenString grabFromSeamToCurr(void* seamHandle) {
 		return LenString {
 			(head >= (char*)seamHandle) && length > 0 ? (unsigned int)(head - (char*)seamHandle) + 1 : 0,
@@ -183,6 +226,9 @@ public:
 	/** Indeed we are supporting these dangerous operations when needed! */
 	inline bool isSupportingDangerousDestructiveOperations() { return true; }
 
+	/** The whole data is in the memory all the time */
+	inline bool isSupportingPersistentGrabs() { return true; }
+
 	~FastInput() {
 		if(buffer != nullptr && ownsBuffer) {
 			delete[] buffer;
@@ -190,6 +236,553 @@ public:
 	}
 };
 
+#ifdef FIO_HAS_POSIX
+/**
+ * Input handler that memory-maps the given file read-only instead of reading it into the memory as a whole.
+ * Only the pages that are actually touched get loaded by the operating system so there is no extra copy of
+ * the file in the memory and loading is proportional to what we read (not to the size of the file).
+ *
+ * Because the mapping is read-only, this input handler does NOT support the dangerous destructive operations!
+ * The returned LenStrings point into the mapped memory and stay valid for the whole life-cycle of this object.
+ */
+class MmapInput : public Input {
+private:
+	int64_t length;	// -1 on errors, otherwise the length
+	size_t mappedSize;	// the size of the mapping (for unmapping it)
+	char* buffer;	// the mapped data of the file - or nullptr when nothing is mapped
+	char* end;	// points right after the last mapped character
+	char* head;	// reading head pointer
+public:
+	MmapInput() {
+		length = 0;		// This might help others not use us
+		mappedSize = 0;
+		buffer = nullptr;	// This might help others not use us
+		end = nullptr;		// This might help others not use us
+		head = nullptr;		// This might help others not use us
+	}
+
+	/** Create an input handler that maps the given file into the memory */
+	MmapInput(const char* inFileName) : MmapInput() {
+		int fd = open(inFileName, O_RDONLY);
+		if(fd < 0) {
+			length = -1;
+			return;
+		}
+		struct stat st;
+		if(fstat(fd, &st) < 0) {
+			length = -1;
+		} else if((uint64_t)st.st_size > UINT32_MAX) {
+			// The LenStrings cannot be longer than this
+			length = -1;
+		} else if(st.st_size > 0) {
+			void* mapped = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if(mapped == MAP_FAILED) {
+				length = -1;
+			} else {
+				length = st.st_size;
+				mappedSize = (size_t)st.st_size;
+				buffer = (char*)mapped;
+				end = buffer + mappedSize;
+			}
+		}
+		// The mapping stays valid without the file descriptor
+		close(fd);
+		// Reset reading head
+		head = buffer;
+	}
+
+	/** There is no EOF character at the end of the mapping so this needs to be bounds-checked */
+	inline char grabCurr() {
+		return (head < end) ? *head : EOF;
+	}
+
+	inline char grabLast() {
+		// This might crash when we grab before the buffer!
+		return *(head - 1);
+	}
+
+	inline void* markSeam() {
+		return (void*)head;
+	}
+
+	inline void advance() {
+		++head;
+	}
+
+	inline void advance(unsigned int n) {
+		head += n;
+	}
+
+	inline LenString grabAhead() {
+		return LenString {
+			(unsigned int)(end - head),
+			head
+		};
+	}
+
+	inline LenString grabFromSeamToCurr(void* seamHandle) {
+		// We cannot include the "EOF" after the end as it is not in the memory
+		char* last = (head < end) ? head + 1 : end;
+		return LenString {
+			(last > (char*)seamHandle) ? (unsigned int)(last - (char*)seamHandle) : 0,
+			(char*)seamHandle
+		};
+	}
+
+	inline LenString grabFromSeamToLast(void* seamHandle) {
+		return LenString {
+			((seamHandle != nullptr) && (head > (char*)seamHandle)) ? (unsigned int)(head - (char*)seamHandle) : 0,
+			(char*)seamHandle
+		};
+	}
+
+	/** Go to the start - this is always safe as nobody can change the mapped memory */
+	inline void reset() {
+		head = buffer;
+	}
+
+	/** The mapping is read-only so we cannot support these operations! */
+	inline bool isSupportingDangerousDestructiveOperations() { return false; }
+
+	/** The whole file is mapped all the time */
+	inline bool isSupportingPersistentGrabs() { return true; }
+
+	~MmapInput() {
+		if(buffer != nullptr) {
+			munmap(buffer, mappedSize);
+		}
+	}
+};
+#endif // FIO_HAS_POSIX
+
+/**
+ * Input handler that is reading from a FILE* or a file descriptor (like a pipe) into a refillable buffer.
+ * Memory usage is bounded by the biggest token (the longest data between a seam and the head) and not by the
+ * size of the whole stream so this is good for really big files or never-ending pipes and such.
+ *
+ * When the buffer gets depleted, we refill it by moving the data behind the oldest outstanding seam to the start
+ * of the buffer (or we grow the buffer when that data would fill it) so the grabbed tokens are always contiguous.
+ * (!) Seams are released by the grab operations, so every markSeam() should be paired with a grab!
+ * (!) Grabbed LenStrings are only valid until the next advance() as a refill can move or overwrite them!
+ */
+class StreamInput : public Input {
+private:
+	FILE* file;		// the stream we read when not using a file descriptor
+	int fd;			// the file descriptor we read when file is nullptr (-1 if none)
+	bool ownsStream;	// tells if we close the stream/descriptor in the destructor
+	bool depleted;		// true when there is no more to read from the stream
+	char* buffer;		// the refillable buffer (with one extra character for the EOF)
+	unsigned int capacity;	// the size of the buffer without the EOF character
+	char* end;		// points right after the last valid character - the EOF is written here
+	char* head;		// reading head pointer
+	uint64_t bufferPos;	// the position of the buffer start in the whole stream
+	/** Stream positions of the outstanding seams in the order of marking (that is: increasing positions) */
+	std::vector<uint64_t> seams;
+
+	/** Reads more data from the underlying stream after the end of the buffer. Returns the number of read bytes. */
+	inline unsigned int readMore() {
+		unsigned int space = capacity - (unsigned int)(end - buffer);
+		if(file != nullptr) {
+			return fread(end, 1, space, file);
+		}
+#ifdef FIO_HAS_POSIX
+		if(fd >= 0) {
+			ssize_t got;
+			do {
+				got = read(fd, end, space);
+			} while(got < 0 && errno == EINTR);
+			return (got > 0) ? (unsigned int)got : 0;
+		}
+#endif
+		return 0;
+	}
+
+	/**
+	 * Refills the buffer when the head reaches its end. Keeps the data from the oldest outstanding seam
+	 * (or at least the last character for grabLast) and moves it to the front of the buffer - or grows
+	 * the buffer when the kept data is filling the bigger part of it.
+	 */
+	inline void refill() {
+		if(depleted) {
+			return;
+		}
+		// Find what we need to keep
+		char* keepFrom = (head > buffer) ? head - 1 : head;
+		if(!seams.empty()) {
+			char* seamPtr = buffer + (seams.front() - bufferPos);
+			if(seamPtr < keepFrom) {
+				keepFrom = seamPtr;
+			}
+		}
+		unsigned int keep = (unsigned int)(end - keepFrom);
+		// Compact: move the kept data to the front of the buffer
+		if(keepFrom > buffer) {
+			memmove(buffer, keepFrom, keep);
+			bufferPos += (keepFrom - buffer);
+			head -= (keepFrom - buffer);
+			end = buffer + keep;
+		}
+		// Grow when the token we keep fills most of the buffer so that refills read a reasonable amount
+		if(keep > capacity / 2) {
+			unsigned int newCapacity = capacity * 2;
+			char* newBuffer = new char[newCapacity + 1];
+			memcpy(newBuffer, buffer, keep);
+			head = newBuffer + (head - buffer);
+			end = newBuffer + keep;
+			delete[] buffer;
+			buffer = newBuffer;
+			capacity = newCapacity;
+		}
+		// Read new data - there is always space after the above so zero means the end of the stream
+		unsigned int got = readMore();
+		if(got == 0) {
+			depleted = true;
+		}
+		end += got;
+		*end = EOF;
+	}
+
+	/** Common initialization for the constructors */
+	inline void init(unsigned int initialCapacity) {
+		depleted = false;
+		capacity = (initialCapacity > 1) ? initialCapacity : 2;
+		buffer = new char[capacity + 1];
+		end = buffer;
+		head = buffer;
+		bufferPos = 0;
+		// Fill the buffer for the first time
+		refill();
+	}
+public:
+	StreamInput() {
+		file = nullptr;		// This might help others not use us
+		fd = -1;		// This might help others not use us
+		ownsStream = false;	// This ensures no closing happens
+		depleted = true;
+		capacity = 0;
+		buffer = new char[1];	// only the EOF
+		end = buffer;
+		head = buffer;
+		*end = EOF;
+		bufferPos = 0;
+	}
+
+	/** Create a stream-input handler that reads the given FILE* - the initial buffer grows as big tokens need */
+	StreamInput(FILE* stream, bool ownsProvidedStream = false, unsigned int initialCapacity = 64 * 1024) {
+		file = stream;
+		fd = -1;
+		ownsStream = ownsProvidedStream;
+		init(initialCapacity);
+	}
+
+#ifdef FIO_HAS_POSIX
+	/** Create a stream-input handler that reads the given file descriptor - the initial buffer grows as big tokens need */
+	StreamInput(int fileDescriptor, bool ownsProvidedDescriptor = false, unsigned int initialCapacity = 64 * 1024) {
+		file = nullptr;
+		fd = fileDescriptor;
+		ownsStream = ownsProvidedDescriptor;
+		init(initialCapacity);
+	}
+#endif // FIO_HAS_POSIX
+
+	inline char grabCurr() {
+		// There is always an EOF after the valid data
+		return *head;
+	}
+
+	inline char grabLast() {
+		// This might crash when we grab before the buffer!
+		return *(head - 1);
+	}
+
+	/** The returned handle is the position in the stream (not a pointer) as our buffer might move */
+	inline void* markSeam() {
+		uint64_t pos = bufferPos + (head - buffer);
+		seams.push_back(pos);
+		return (void*)(uintptr_t)pos;
+	}
+
+	inline void advance() {
+		++head;
+		if(head >= end) {
+			refill();
+		}
+	}
+
+	/** Advancing to the end of what grabAhead() returned refills the buffer */
+	inline void advance(unsigned int n) {
+		head += n;
+		if(head >= end) {
+			refill();
+		}
+	}
+
+	inline LenString grabAhead() {
+		return LenString {
+			(unsigned int)(end - head),
+			head
+		};
+	}
+
+	inline LenString grabFromSeamToCurr(void* seamHandle) {
+		char* seamPtr = releaseSeam(seamHandle);
+		// We cannot include the EOF after the end as that is not data
+		char* last = (head < end) ? head + 1 : end;
+		return LenString {
+			(last > seamPtr) ? (unsigned int)(last - seamPtr) : 0,
+			seamPtr
+		};
+	}
+
+	inline LenString grabFromSeamToLast(void* seamHandle) {
+		char* seamPtr = releaseSeam(seamHandle);
+		return LenString {
+			(head > seamPtr) ? (unsigned int)(head - seamPtr) : 0,
+			seamPtr
+		};
+	}
+
+	/** Streams are not persistent, but the buffer is ours so nobody else sees the changes until the next advance */
+	inline bool isSupportingDangerousDestructiveOperations() { return false; }
+
+	/** Refills invalidate the grabbed data */
+	inline bool isSupportingPersistentGrabs() { return false; }
+
+	~StreamInput() {
+		delete[] buffer;
+		if(ownsStream) {
+			if(file != nullptr) {
+				fclose(file);
+			}
+#ifdef FIO_HAS_POSIX
+			if(fd >= 0) {
+				close(fd);
+			}
+#endif
+		}
+	}
+private:
+	/** Forgets about the given seam so that refills can drop the data before it - returns where the seam is in the buffer */
+	inline char* releaseSeam(void* seamHandle) {
+		uint64_t pos = (uint64_t)(uintptr_t)seamHandle;
+		// Seams are usually released in reverse marking order, so search from the back
+		for(auto it = seams.end(); it != seams.begin();) {
+			--it;
+			if(*it == pos) {
+				seams.erase(it);
+				break;
+			}
+		}
+		return buffer + (pos - bufferPos);
+	}
+};
+
+/**
+ * Base-class for all generic output handlers (sinks)
+ * and the sample implementations below.
+ *
+ * Just like for the inputs, we use templates instead of virtual
+ * functions so the writers can choose the output method for free.
+ * Writers are expected to do their own buffering and hand over
+ * big parts at once - many times as a gather list of parts that
+ * the sink can write out with a single system call.
+ */
+class Output {
+public:
+	/** Empty parameterless constructor - you need to implement this too! */
+	Output() { }
+
+	/** Write out the given characters. The memory is only valid during the call so copy what you keep! */
+	void write(const char *data, size_t length) { }
+
+	/**
+	 * Write out the given parts in order. The memory of the parts is only valid during the call.
+	 * Implementations should write these out at once when they can (for example with a writev).
+	 */
+	void writeParts(const LenString *parts, unsigned int count) { }
+
+	/** Push everything that is buffered in the sink itself to the underlying stream / device */
+	void flush() { }
+
+	/** Returns false when there was any error while writing - the output is incomplete then */
+	bool isGood() { }
+};
+
+/**
+ * Output handler that collects everything in a growing memory buffer.
+ * The buffer is kept on clear() so the same sink can be reused without allocations.
+ */
+class MemoryOutput : public Output {
+private:
+	std::vector<char> buffer;
+public:
+	MemoryOutput() { }
+
+	/** Create a memory output that preallocates the given capacity */
+	MemoryOutput(size_t initialCapacity) {
+		buffer.reserve(initialCapacity);
+	}
+
+	inline void write(const char *data, size_t length) {
+		buffer.insert(buffer.end(), data, data + length);
+	}
+
+	inline void writeParts(const LenString *parts, unsigned int count) {
+		size_t total = buffer.size();
+		for(unsigned int i = 0; i < count; ++i) {
+			total += parts[i].length;
+		}
+		// Grow at most once for the whole batch
+		if(total > buffer.capacity()) {
+			buffer.reserve(std::max(total, buffer.capacity() * 2));
+		}
+		for(unsigned int i = 0; i < count; ++i) {
+			write(parts[i].startPtr, parts[i].length);
+		}
+	}
+
+	inline void flush() { }
+
+	inline bool isGood() { return true; }
+
+	/** The collected characters (not zero terminated) */
+	inline const char* data() const { return buffer.empty() ? "" : &buffer[0]; }
+
+	/** The number of collected characters */
+	inline size_t size() const { return buffer.size(); }
+
+	/** Returns a copy of the collected characters as a string */
+	inline std::string str() const { return std::string(data(), size()); }
+
+	/** Forgets the collected characters, but keeps the memory */
+	inline void clear() { buffer.clear(); }
+};
+
+/**
+ * Output handler that writes to a FILE* or to a file descriptor (like a pipe or socket).
+ * In case of a FILE* every part is handed to fwrite (the FILE* does its own buffering), while in case
+ * of a file descriptor there is no buffering at all here: a batch of parts is written with one writev call
+ * (retrying on partial writes and interrupts) so writers should hand over big batches.
+ */
+class StreamOutput : public Output {
+private:
+	FILE* file;		// the stream we write when not using a file descriptor
+	int fd;			// the file descriptor we write when file is nullptr (-1 if none)
+	bool ownsStream;	// tells if we close the stream/descriptor in the destructor
+	bool good;		// false after the first error
+#ifdef FIO_HAS_POSIX
+	/** The most parts we give to one writev call (IOV_MAX is at least this much everywhere) */
+	static const unsigned int MAX_IOV = 64;
+
+	/** Writes the parts with as few writev calls as we can */
+	inline void writeFd(const LenString *parts, unsigned int count) {
+		struct iovec iov[MAX_IOV];
+		unsigned int i = 0;
+		while(good && (i < count)) {
+			unsigned int n = (count - i < MAX_IOV) ? count - i : MAX_IOV;
+			for(unsigned int j = 0; j < n; ++j) {
+				iov[j].iov_base = parts[i + j].startPtr;
+				iov[j].iov_len = parts[i + j].length;
+			}
+			struct iovec *first = iov;
+			unsigned int left = n;
+			while(left > 0) {
+				ssize_t done = writev(fd, first, left);
+				if(done < 0) {
+					if(errno == EINTR) continue;
+					good = false;
+					break;
+				}
+				// Skip the parts that are completely written and continue in the middle of the partial one
+				while((left > 0) && ((size_t)done >= first->iov_len)) {
+					done -= first->iov_len;
+					++first;
+					--left;
+				}
+				if(left > 0) {
+					first->iov_base = (char*)first->iov_base + done;
+					first->iov_len -= done;
+				}
+			}
+			i += n;
+		}
+	}
+#endif // FIO_HAS_POSIX
+public:
+	StreamOutput() {
+		file = nullptr;		// This might help others not use us
+		fd = -1;		// This might help others not use us
+		ownsStream = false;	// This ensures no closing happens
+		good = false;
+	}
+
+	/** Create a stream-output handler that writes the given FILE* */
+	StreamOutput(FILE* stream, bool ownsProvidedStream = false) {
+		file = stream;
+		fd = -1;
+		ownsStream = ownsProvidedStream;
+		good = (stream != nullptr);
+	}
+
+#ifdef FIO_HAS_POSIX
+	/** Create a stream-output handler that writes the given file descriptor */
+	StreamOutput(int fileDescriptor, bool ownsProvidedDescriptor = false) {
+		file = nullptr;
+		fd = fileDescriptor;
+		ownsStream = ownsProvidedDescriptor;
+		good = (fileDescriptor >= 0);
+	}
+#endif // FIO_HAS_POSIX
+
+	// We might own the stream so copies would close it twice
+	StreamOutput(const StreamOutput&) = delete;
+	StreamOutput& operator=(const StreamOutput&) = delete;
+
+	inline void write(const char *data, size_t length) {
+		LenString part{(unsigned int)length, (char*)data};
+		writeParts(&part, 1);
+	}
+
+	inline void writeParts(const LenString *parts, unsigned int count) {
+		if(file != nullptr) {
+			for(unsigned int i = 0; good && (i < count); ++i) {
+				if(fwrite(parts[i].startPtr, 1, parts[i].length, file) != parts[i].length) {
+					good = false;
+				}
+			}
+			return;
+		}
+#ifdef FIO_HAS_POSIX
+		if(fd >= 0) {
+			writeFd(parts, count);
+		}
+#endif
+	}
+
+	inline void flush() {
+		if((file != nullptr) && (fflush(file) != 0)) {
+			good = false;
+		}
+	}
+
+	inline bool isGood() { return good; }
+
+	~StreamOutput() {
+		if(file != nullptr) {
+			if(ownsStream) {
+				fclose(file);
+			} else {
+				fflush(file);
+			}
+		}
+#ifdef FIO_HAS_POSIX
+		if(ownsStream && (fd >= 0)) {
+			close(fd);
+		}
+#endif
+	}
+};
+
 // An example class that shows how to use the input interface properly: no overhead of virtual methods, but code can choose implementation!
 /*
 template<class InputSubClass>
@@ -45,8 +45,10 @@ struct LenString {
 	 * escapeChar need to be taken literally. If you are parsing in that way
 	 * that you ignore escaped closing characters while accumulating characters
 	 * this could be really handy!
+	 *
+	 * Returns the length of the unescaped string (the position of the new zero terminator).
 	 */
-	inline void dangerous_destructive_unsafe_unescape_in_place(char escapeChar) {
+	inline unsigned int dangerous_destructive_unsafe_unescape_in_place(char escapeChar) {
 		bool escaped = false;	// true right after an escape char
 		int i; // i - Read head; j<=i. Always step incrementally and move through the array of chars
 		int j; // j - Write head: just go over the array. Step like i, but in case of escapes step back too
@@ -68,6 +70,7 @@ struct LenString {
 		}
 		// Add the new zero terminator!
 		startPtr[j] = 0;
+		return j;
 	}
 
 	/**
@@ -0,0 +1,28 @@
+// Generates C++ structs and parsers from a tbnf schema (see tbuf_tbnfgen.h)
+// g++ --std=c++14 tbnfgen.cpp -o tbnfgen.out
+// Usage: ./tbnfgen.out schema.tbnf startRule namespace > schema_gen.h
+
+#include<cstdio>
+#include<iostream>
+#include<sstream>
+#include"tbuf_tbnfgen.h"
+
+int main(int argc, char **argv) {
+	if(argc != 4) {
+		fprintf(stderr, "Usage: %s schema.tbnf startRule namespace > header.h\n", argv[0]);
+		return 1;
+	}
+	tbuf::TbnfGrammar grammar;
+	if(!grammar.loadFile(argv[1])) {
+		fprintf(stderr, "%s\n", grammar.error().c_str());
+		return 1;
+	}
+	tbuf::TbnfGenerator generator(grammar);
+	std::ostringstream header;
+	if(!generator.generate(argv[2], argv[3], header)) {
+		fprintf(stderr, "%s: %s\n", argv[1], generator.error().c_str());
+		return 1;
+	}
+	std::cout << header.str();
+	return 0;
+}
@@ -2,6 +2,7 @@
 #define TURBO_BUF_H
 
 #include<cassert> /* For assertions #define TBUF_ASSERT */
+#include<algorithm>
 #include<memory>
 #include<vector>
 #include<cstdio>
@@ -9,9 +10,15 @@
 #include<cctype>
 #include<functional>
 #include<initializer_list>
+#include<unordered_map>
 #include<unordered_set>
+#include<type_traits>
 #include"fio.h"
 #include"tbuf_data.h"
+#include"tbuf_scan.h"
+#include"tbuf_index.h"
+#include"tbuf_symbols.h"
+#include"tbuf_stats.h"
 
 // Uncomment this if we want to see the debug logging
 // Or even better: define this before including us...
@@ -51,6 +58,24 @@ struct LevelDescender {
 	/** Defines if we have ad-hoc (prefix) polymorphism - basically saying if we search for prefix or full fit */
 	bool adHocPolymorph;
 
+	/**
+	 * Returns the ID of the targetName in the given symbol table (NO_SYMBOL if no node has that name there).
+	 * The found ID is cached so a descender that is used again on the same tree never looks up the name again.
+	 * Rem.: Because of the caching, do not share one descender among threads!
+	 */
+	inline uint32_t resolveIn(const SymbolTable &symbols) const {
+		if(resolvedSerial != symbols.serial()) {
+			uint32_t id = symbols.find(targetName.c_str(), targetName.length());
+			if(id == NO_SYMBOL) {
+				// The name might be added later so nothing is cached
+				return NO_SYMBOL;
+			}
+			resolvedSerial = symbols.serial();
+			resolvedId = id;
+		}
+		return resolvedId;
+	}
+
 	/** Create empty level descender */
 	LevelDescender() : targetName{""}, targetIndex{0}, adHocPolymorph{false} {}
 
@@ -67,12 +92,266 @@ struct LevelDescender {
 	LevelDescender(std::string _targetName, int _targetIndex, bool _adHocPolymorph) : 
 		targetName{_targetName}, targetIndex{_targetIndex}, adHocPolymorph{_adHocPolymorph} {}
 
-	/** Create a level descender with the given data */
+	/**
+	 * Create a level descender from one level of a query like "item@3" or "price_" (see TreeQuery::compile).
+	 * Invalid descriptors give a descender that never finds anything.
+	 */
 	// Should be explicit to avoid surprises when conversions apply
 	explicit LevelDescender(const char* descriptor_cstr) : targetIndex{0}, adHocPolymorph{false} {
-		// FIXME: fix this so that we do not only handle the simple cases!
-		targetName = descriptor_cstr; // uses string copy construction from cstr
+		if(!parse(descriptor_cstr, descriptor_cstr + strlen(descriptor_cstr), *this)) {
+			*this = LevelDescender();
+		}
+	}
+
+	/**
+	 * Parses one level of a query from the [begin, end) characters: the name, then an optional '@' with the
+	 * decimal index and an optional '_' (before or after the index) for the ad-hoc (prefix) polymorphism.
+	 * Returns false when the level is not valid.
+	 */
+	inline static bool parse(const char *begin, const char *end, LevelDescender &ld) {
+		const char *at = (const char*)memchr(begin, '@', end - begin);
+		const char *nameEnd = (at != nullptr) ? at : end;
+		ld.adHocPolymorph = false;
+		ld.targetIndex = 0;
+		if(at != nullptr) {
+			const char *p = at + 1;
+			if((p == end) || !isdigit((unsigned char)*p)) {
+				return false;
+			}
+			long index = 0;
+			while((p < end) && isdigit((unsigned char)*p)) {
+				index = index * 10 + (*p - '0');
+				if(index > 0x7FFFFFFF) {
+					return false;
+				}
+				++p;
+			}
+			if((p < end) && (*p == '_')) {
+				ld.adHocPolymorph = true;
+				++p;
+			}
+			if(p != end) {
+				return false;
+			}
+			ld.targetIndex = (int)index;
+		}
+		if((nameEnd > begin) && (nameEnd[-1] == '_') && !ld.adHocPolymorph) {
+			ld.adHocPolymorph = true;
+			--nameEnd;
+		}
+		if(nameEnd == begin) {
+			return false;
+		}
+		ld.targetName.assign(begin, nameEnd);
+		return true;
+	}
+
+private:
+	/** The serial number of the symbol table the resolvedId is for (zero when nothing is cached) */
+	mutable uint64_t resolvedSerial = 0;
+	/** The cached ID of the targetName */
+	mutable uint32_t resolvedId = NO_SYMBOL;
+};
+
+/**
+ * One level of a path literal (see TBUF_PATH): the same as a LevelDescender but everything - the name, its hash,
+ * the index and the prefix flag - is computed at compile time so using it needs no strings and no allocations
+ * (prefix levels on wide nodes too - only the first lookup in a wide node builds its child index).
+ */
+struct PathLevel {
+	/** The name (or prefix) of the level - points into the path literal so it is not zero terminated */
+	const char *name = nullptr;
+	unsigned int length = 0;
+	/** The SymbolTable::hashOf the name */
+	uint32_t hash = 0;
+	/** The index of the target among the children with the name */
+	int index = 0;
+	/** Tells if the name is only a prefix (ad-hoc polymorphism) */
+	bool prefix = false;
+
+	/** Parses one level of a path in [begin, end) with the same syntax as LevelDescender::parse - false if invalid */
+	constexpr static bool parse(const char *begin, const char *end, PathLevel &level) {
+		const char *nameEnd = begin;
+		while((nameEnd < end) && (*nameEnd != '@')) {
+			++nameEnd;
+		}
+		level.prefix = false;
+		level.index = 0;
+		if(nameEnd < end) {
+			const char *p = nameEnd + 1;
+			if((p == end) || (*p < '0') || (*p > '9')) {
+				return false;
+			}
+			long index = 0;
+			while((p < end) && (*p >= '0') && (*p <= '9')) {
+				index = index * 10 + (*p - '0');
+				if(index > 0x7FFFFFFF) {
+					return false;
+				}
+				++p;
+			}
+			if((p < end) && (*p == '_')) {
+				level.prefix = true;
+				++p;
+			}
+			if(p != end) {
+				return false;
+			}
+			level.index = (int)index;
+		}
+		if((nameEnd > begin) && (nameEnd[-1] == '_') && !level.prefix) {
+			level.prefix = true;
+			--nameEnd;
+		}
+		if(nameEnd == begin) {
+			return false;
+		}
+		level.name = begin;
+		level.length = (unsigned int)(nameEnd - begin);
+		level.hash = SymbolTable::hashOf(begin, level.length);
+		return true;
+	}
+
+	/** Returns the end of the level of a path that starts at p (the next '/' or the end) */
+	constexpr static const char* levelEnd(const char *p, const char *end) {
+		while((p < end) && (*p != '/')) {
+			++p;
+		}
+		return p;
+	}
+
+	/** Returns the end of a zero terminated path */
+	constexpr static const char* pathEnd(const char *path) {
+		while(*path != '\0') {
+			++path;
+		}
+		return path;
+	}
+};
+
+/** Returns the number of levels in the path (like "egy/ketto@1/harom") or zero when the path is not valid */
+constexpr unsigned int pathLevelCount(const char *path) {
+	const char *end = PathLevel::pathEnd(path);
+	const char *p = path;
+	if((p < end) && (*p == '/')) {
+		// The root itself
+		++p;
+	}
+	unsigned int count = 0;
+	while(p < end) {
+		const char *levelEnd = PathLevel::levelEnd(p, end);
+		PathLevel level;
+		if(!PathLevel::parse(p, levelEnd, level) || (levelEnd + 1 == end)) {
+			// Invalid level or a trailing '/' without a level
+			return 0;
+		}
+		++count;
+		p = (levelEnd < end) ? levelEnd + 1 : end;
+	}
+	return count;
+}
+
+struct Node;
+class Tree;
+class NodePool;
+class BinaryCodec;
+
+#ifdef TBUF_STATS
+/** Returns the stats of the tree the node is in (nullptr for nodes that are not in a tree) */
+inline TreeStats* statsOf(Node &node);
+#endif
+
+/** The index of a missing node in the node pools */
+const uint32_t NO_NODE = 0xFFFFFFFF;
+
+/**
+ * The list of child nodes of a node. The nodes themselves live in the node pool of the tree and they are linked
+ * together by 32 bit indices (the first child, the next sibling and so on) so nodes never move around in memory.
+ * The list behaves like a container: size(), iteration and indexing all work (sequential indexing is fast too).
+ *
+ * Children of lazy trees are only parsed the first time this list is touched in any way (see Tree constructor),
+ * so fetching a few paths from a huge message does not build every node of it.
+ */
+class ChildList {
+public:
+	/** Iterates over the children by following the next sibling indices */
+	class iterator {
+	public:
+		iterator(NodePool *_pool, uint32_t _index) : pool{_pool}, index{_index} {}
+		inline Node& operator*() const;
+		inline Node* operator->() const;
+		inline iterator& operator++();
+		inline bool operator==(const iterator &other) const { return index == other.index; }
+		inline bool operator!=(const iterator &other) const { return index != other.index; }
+	private:
+		NodePool *pool;
+		uint32_t index;
+	};
+
+	/** Create an empty list */
+	ChildList() : pool{nullptr}, first{NO_NODE}, last{NO_NODE}, count{0}, cachedPos{0}, cachedIndex{NO_NODE} {}
+	/** Create an empty list for nodes of the given pool */
+	explicit ChildList(NodePool *_pool) : pool{_pool}, first{NO_NODE}, last{NO_NODE}, count{0}, cachedPos{0}, cachedIndex{NO_NODE} {}
+
+	inline size_t size() const { ensure(); return count; }
+	inline bool empty() const { ensure(); return count == 0; }
+	inline Node& operator[](size_t i) const;
+	inline Node& back() const;
+	inline Node& front() const;
+	inline iterator begin() const { ensure(); return iterator(pool, first); }
+	inline iterator end() const { return iterator(pool, NO_NODE); }
+	/** Adds a copy of the node as the last child (into the node pool of the tree) */
+	inline void push_back(const Node &node);
+	/** Nothing to do here: the node pool handles the memory for every node */
+	inline void reserve(size_t n) {}
+	/** Moves every node of the other list (of the same pool) to the end of this list */
+	inline void splice(ChildList &other);
+
+	/** Tells if the children are not parsed yet (the only operation that does not parse them) */
+	inline bool isLazy() const { return count == LAZY_COUNT; }
+
+private:
+	friend class Tree;
+	friend struct Node;
+	friend class BinaryCodec;
+#ifdef TBUF_STATS
+	friend TreeStats* statsOf(Node &node);
+#endif
+	/** The node pool of the tree where our nodes are */
+	NodePool *pool;
+	/**
+	 * The indices of our first and last node in the pool and the number of nodes.
+	 * Rem.: For lazy lists the count is LAZY_COUNT and first and last are the range of the children in the input.
+	 *       The cachedIndex is the pool index of the owner node then (NO_NODE for the root) - see materialize().
+	 */
+	uint32_t first;
+	uint32_t last;
+	uint32_t count;
+	static const uint32_t LAZY_COUNT = 0xFFFFFFFF;
+	/** The last indexed position and its node index - so that indexing in a loop is not quadratic */
+	mutable uint32_t cachedPos;
+	mutable uint32_t cachedIndex;
+
+	/** Parses the children if they are not parsed yet */
+	inline void ensure() const {
+		if(count == LAZY_COUNT) {
+			materialize();
+		}
 	}
+	/** Parses the children (defined after the tree) */
+	inline void materialize() const;
+	/** Appends the node at the given pool index to the end of the list (the node must not be in any list) */
+	inline void link(uint32_t index);
+};
+
+/** What the tree walking should do after visiting a node (see Node::dfs_preorder) */
+enum class VisitResult {
+	/** Go on with the walk */
+	CONTINUE,
+	/** Do not visit the children of this node (only for preorder walks) */
+	SKIP_CHILDREN,
+	/** Stop the whole walk */
+	STOP,
 };
 
 /**
@@ -85,65 +364,44 @@ struct Node {
 
 	/**
 	 * Points to our parent - can be nullptr for implicit root nodes
-	 * - MEMORY IS OWNED BY THE TREE! Do not cache this!
+	 * - MEMORY IS OWNED BY THE TREE! Nodes never move while the tree is alive so this is stable.
 	 */
 	Node* parent;
 
 	/** The child nodes (if any). Handled by the tree */
-	std::vector<Node> children;
+	ChildList children;
 
-	// TODO: Implement per-node hashing for going down the next level based of the name and simple lookup...
-	// TODO: Maybe implement some kind of caching or handle prefix-queries efficiently etc...
-	
-	/** Descend into one of our children designated by the given level descender (or return nullptr if not available) */
-	inline Node* descend(LevelDescender ld) {
-		int foundIndex = -1;
-		for(Node &child : children) {
-#ifdef DEBUG_LOG
-printf(" -- Trying child with name:%s against target name: %s\n", child.core.name, ld.targetName.c_str());
-#endif
-			if(!ld.adHocPolymorph) {
-				// Simple lookup
-				if(!strcmp(child.core.name, ld.targetName.c_str())) {
-					// if child node name is not different from descriptor's name
-					// then they are the same and we have found a possible children
-					// we can return. Only possible because of at-indexing though...
-					++foundIndex;	// update at-indexing
-					if(foundIndex == ld.targetIndex) {
-						// If we have found that child of this name/type
-						// we can return pointer to it
-						return &child;
-					}
-				}
-			} else {
-				// Prefix-lookup
-				if(!strncmp(child.core.name, ld.targetName.c_str(), ld.targetName.length())) {
-					// if child node name is not different from descriptor's name
-					// then they are the same and we have found a possible children
-					// we can return. Only possible because of at-indexing though...
-					++foundIndex;	// update at-indexing
-					if(foundIndex == ld.targetIndex) {
-						// If we have found that child of this name/type
-						// we can return pointer to it
-						return &child;
-					}
-				}
-			}
-		}
+	/** The index of our next sibling in the node pool of the tree (NO_NODE for the last child) */
+	uint32_t nextSibling = NO_NODE;
 
-		// Didn't found any child for this descriptor...
-		return nullptr;
-	}
+	/**
+	 * Descend into one of our children designated by the given level descender (or return nullptr if not available).
+	 * Full name matches only compare the symbol IDs of the names - prefix matches need to compare the names.
+	 * Wide nodes get a child index on the first lookup so that later ones do not scan the children at all.
+	 * Rem.: Lookups might change the tree (parse lazy children or build the index) so they are not thread-safe!
+	 */
+	inline Node* descend(const LevelDescender &ld);
 
-	/** A depth-first searching on the sub-tree from this node by visiging all nodes with the given visitor. Ordering is preorder. */
-	inline void dfs_preorder(std::function<void (NodeCore &node, unsigned int depth, bool leaf)> visitor) {
-		dfs_preorder_impl(visitor, 0);
-	}
+	/** The same as the other descend but for one level of a path literal (see TBUF_PATH) - it never allocates */
+	inline Node* descend(const PathLevel &level);
 
-	/** A depth-first searching on the sub-tree from this node by visiging all nodes with the given visitor. Ordering is postorder. */
-	inline void dfs_postorder(std::function<void (NodeCore &node, unsigned int depth, bool leaf)> visitor) {
-		dfs_postorder_impl(visitor, 0);
-	}
+	/**
+	 * A depth-first searching on the sub-tree from this node by visiging all nodes with the given visitor. Ordering is preorder.
+	 * The visitor is called as visitor(NodeCore &node, unsigned int depth, bool leaf) and it might return a VisitResult
+	 * to skip the children of the node or stop the whole walk. Returns false when the walk was stopped.
+	 *
+	 * The visitor is inlined (no std::function) and the walk is iterative using the parent and sibling links of the
+	 * nodes - so it needs no stack at all and works for trees of any depth.
+	 */
+	template<class Visitor>
+	inline bool dfs_preorder(Visitor &&visitor);
+
+	/**
+	 * A depth-first searching on the sub-tree from this node by visiging all nodes with the given visitor. Ordering is postorder.
+	 * The same as dfs_preorder except that skipping the children is not possible (they are already visited).
+	 */
+	template<class Visitor>
+	inline bool dfs_postorder(Visitor &&visitor);
 
 	/** Useful when writing out a subtree below root into a file. Default file is stdout. */
 	inline void writeOut(FILE *destFile = stdout, bool prettyPrint = true) {
@@ -205,7 +463,7 @@ printf(" -- Trying child with name:%s against target name: %s\n", child.core.nam
 			// Tree data
 			// name is only needed if the depth is non-zero
 			if(depth > 0) {
-				fprintf(destFile, "%s", nc.name);
+				fprintf(destFile, "%.*s", nc.nameLength, nc.name);
 				// Omit the opening { for empty-data leaf nodes - they better just written as the name and nothing else
 				// - because that is the shortest representation and also makes sense on prettyPrint==true!
 				// Rem.: Many times these empty-data leaves act semantically as "words" so it makes semantic sense too!
@@ -222,8 +480,10 @@ printf(" -- Trying child with name:%s against target name: %s\n", child.core.nam
 					fprintf(destFile, "%X", nc.data.asUint());
 				}
 			} else {
-				// Text-node - show text
-				fprintf(destFile, "%s", nc.text);
+				// Text-node - show text (if there is any text)
+				if(nc.text != nullptr) {
+					fprintf(destFile, "%.*s", nc.textLength, nc.text);
+				}
 			}
 			lastWoDepth = depth;
 
@@ -261,39 +521,424 @@ printf(" -- Trying child with name:%s against target name: %s\n", child.core.nam
 	}
 
 private:
-	// Recursive dfs for preorder
-	inline void dfs_preorder_impl(std::function<void (NodeCore &node, unsigned int depth, bool leaf)> visitor, unsigned int depth) {
-		// Visit
-		visitor(this->core, depth, this->children.size() == 0);
-		// recurse
-		for(int i = 0; i < this->children.size(); ++i) {
-			children[i].dfs_preorder_impl(visitor, depth + 1);
+	// Walks the nodes the same way as the dfs
+	friend class BinaryCodec;
+
+	/** Returns our first child (there should be one) */
+	inline Node* firstChild();
+	/** Returns our next sibling (there should be one) */
+	inline Node* nextSiblingNode();
+
+	/** Calls a visitor that returns a VisitResult */
+	template<class Visitor>
+	inline static VisitResult visit(Visitor &visitor, NodeCore &nc, unsigned int depth, bool leaf, std::false_type returnsVoid) {
+		return visitor(nc, depth, leaf);
+	}
+	/** Calls a visitor that returns nothing - that means we always continue */
+	template<class Visitor>
+	inline static VisitResult visit(Visitor &visitor, NodeCore &nc, unsigned int depth, bool leaf, std::true_type returnsVoid) {
+		visitor(nc, depth, leaf);
+		return VisitResult::CONTINUE;
+	}
+	template<class Visitor>
+	inline static VisitResult visit(Visitor &visitor, NodeCore &nc, unsigned int depth, bool leaf) {
+		return visit(visitor, nc, depth, leaf, typename std::is_void<decltype(visitor(nc, depth, leaf))>::type());
+	}
+};
+
+/**
+ * The memory of the nodes of a tree. Nodes are put into geometrically growing blocks, so a parse needs only a few
+ * allocations and the nodes never move - their addresses and indices stay valid as long as the tree is alive.
+ */
+class NodePool {
+	// Nodes are never destructed one by one (the memory is just freed) so that should be a no-op
+	static_assert(std::is_trivially_destructible<Node>::value, "Nodes should be trivially destructible!");
+public:
+	/** The tree these nodes belong to (for parsing the lazy children) */
+	Tree *tree;
+
+	/** Create an empty pool */
+	NodePool() : tree{nullptr}, count{0} {}
+
+	/** Returns the number of used nodes */
+	inline uint32_t size() const {
+		return count;
+	}
+
+	/** Returns the node at the given index (in O(1) time) */
+	inline Node& operator[](uint32_t index) {
+		uint32_t block = blockOf(index);
+		return reinterpret_cast<Node*>(blocks[block].get())[index - blockStart(block)];
+	}
+
+	/** Adds a copy of the given node and returns its index */
+	inline uint32_t add(const Node &node) {
+		uint32_t index = grow(1);
+		new (&(*this)[index]) Node(node);
+		return index;
+	}
+
+	/**
+	 * Makes room for n more nodes and returns the index of the first one - the caller should construct them
+	 * with placement new. Useful when more threads are filling the nodes as the pool is not changed meanwhile.
+	 */
+	inline uint32_t grow(uint32_t n) {
+		uint32_t index = count;
+		count += n;
+		while(blockStart(blocks.size()) < count) {
+			// Rem.: Nodes are not constructed here so that their memory is only written once
+			blocks.push_back(std::unique_ptr<Storage[]>(new Storage[FIRST_BLOCK_SIZE << blocks.size()]));
+		}
+		return index;
+	}
+
+	/** Forgets every node but keeps the memory for reuse */
+	inline void clear() {
+		count = 0;
+	}
+
+	/** Returns the number of blocks allocated so far */
+	inline size_t blockCount() const {
+		return blocks.size();
+	}
+
+private:
+	/** The size of the first block (every other block is double the size of the earlier) */
+	static const uint32_t FIRST_BLOCK_SIZE = 64;
+	static const uint32_t FIRST_BLOCK_BITS = 6;
+
+	/** Uninitialized memory for one node */
+	typedef typename std::aligned_storage<sizeof(Node), alignof(Node)>::type Storage;
+	/** The blocks of nodes */
+	std::vector<std::unique_ptr<Storage[]>> blocks;
+	/** The number of used nodes */
+	uint32_t count;
+
+	/** Returns the block of the node index: the i-th block starts at FIRST_BLOCK_SIZE * (2^i - 1) */
+	inline static uint32_t blockOf(uint32_t index) {
+		return 31 - __builtin_clz((index >> FIRST_BLOCK_BITS) + 1);
+	}
+
+	/** Returns the first node index of the given block */
+	inline static uint32_t blockStart(uint32_t block) {
+		return ((1u << block) - 1) << FIRST_BLOCK_BITS;
+	}
+};
+
+/**
+ * The lookup index of the children of one (wide) node: the positions of the children grouped by their names and
+ * the distinct names in sorted order. Makes descending O(1) for full names and O(log n) for name prefixes.
+ * The tree builds these on the first lookup in nodes with at least CHILD_INDEX_MIN_FANOUT children and keeps
+ * them current when children are added.
+ */
+struct ChildIndex {
+	/** Where a child is: its position among the children and its index in the node pool */
+	struct Position {
+		uint32_t ordinal;
+		uint32_t node;
+	};
+	/** The positions of the children in their order for every name ID */
+	std::unordered_map<uint32_t, std::vector<Position>> byName;
+	/** The distinct name IDs of the children - sorted by the names themselves (for prefix lookups) */
+	std::vector<uint32_t> sortedNames;
+
+	/** Adds the child with the given name that is after every child added so far */
+	inline void add(uint32_t nameId, uint32_t ordinal, uint32_t node, const SymbolTable &symbols) {
+		std::vector<Position> &positions = byName[nameId];
+		if(positions.empty()) {
+			// A new name: keep the names sorted
+			auto at = std::lower_bound(sortedNames.begin(), sortedNames.end(), nameId, [&symbols] (uint32_t a, uint32_t b) {
+				return compare(symbols.nameOf(a), symbols.lengthOf(a), symbols.nameOf(b), symbols.lengthOf(b)) < 0;
+			});
+			sortedNames.insert(at, nameId);
+		}
+		positions.push_back(Position{ordinal, node});
+	}
+
+	/** Returns the pool index of the targetIndex-th child with the given name ID (or NO_NODE) */
+	inline uint32_t find(uint32_t nameId, int targetIndex) const {
+		auto it = byName.find(nameId);
+		if((it == byName.end()) || (targetIndex < 0) || ((size_t)targetIndex >= it->second.size())) {
+			return NO_NODE;
+		}
+		return it->second[targetIndex].node;
+	}
+
+	/**
+	 * Returns the pool index of the targetIndex-th child having a name with the given prefix (or NO_NODE).
+	 * Nothing is allocated and nothing is changed (so lookups can still run concurrently).
+	 */
+	inline uint32_t findPrefixed(const char *prefix, unsigned int prefixLength, int targetIndex, const SymbolTable &symbols) const {
+		if(targetIndex < 0) {
+			return NO_NODE;
+		}
+		// The names with the prefix are next to each other in the sorted names
+		auto from = std::lower_bound(sortedNames.begin(), sortedNames.end(), prefix,
+				[&symbols, prefixLength] (uint32_t a, const char *b) {
+			return compare(symbols.nameOf(a), symbols.lengthOf(a), b, prefixLength) < 0;
+		});
+		auto to = from;
+		while((to != sortedNames.end()) && (symbols.lengthOf(*to) >= prefixLength) && !memcmp(symbols.nameOf(*to), prefix, prefixLength)) {
+			++to;
+		}
+		if(to - from == 1) {
+			// The usual case: only one name has the prefix
+			const std::vector<Position> &positions = byName.find(*from)->second;
+			return ((size_t)targetIndex < positions.size()) ? positions[targetIndex].node : NO_NODE;
+		}
+		// More names: the smallest ordinal with targetIndex + 1 children of these names up to it is found by
+		// binary search - every step counts the positions of each name up to the middle (binary searches again)
+		size_t total = 0;
+		uint32_t low = 0;
+		uint32_t high = 0;
+		for(auto it = from; it != to; ++it) {
+			const std::vector<Position> &positions = byName.find(*it)->second;
+			total += positions.size();
+			high = std::max(high, positions.back().ordinal);
+		}
+		if((size_t)targetIndex >= total) {
+			return NO_NODE;
+		}
+		while(low < high) {
+			uint32_t middle = low + (high - low) / 2;
+			size_t upToMiddle = 0;
+			for(auto it = from; it != to; ++it) {
+				const std::vector<Position> &positions = byName.find(*it)->second;
+				upToMiddle += std::upper_bound(positions.begin(), positions.end(), middle, [] (uint32_t ordinal, const Position &p) {
+					return ordinal < p.ordinal;
+				}) - positions.begin();
+			}
+			if(upToMiddle > (size_t)targetIndex) {
+				high = middle;
+			} else {
+				low = middle + 1;
+			}
+		}
+		// The child at that ordinal has one of the names
+		for(auto it = from; it != to; ++it) {
+			const std::vector<Position> &positions = byName.find(*it)->second;
+			auto at = std::lower_bound(positions.begin(), positions.end(), low, [] (const Position &p, uint32_t ordinal) {
+				return p.ordinal < ordinal;
+			});
+			if((at != positions.end()) && (at->ordinal == low)) {
+				return at->node;
+			}
+		}
+		return NO_NODE;
+	}
+
+	/** Compares two (not necessarily zero terminated) names like strcmp */
+	inline static int compare(const char *a, unsigned int aLength, const char *b, unsigned int bLength) {
+		int c = memcmp(a, b, std::min(aLength, bLength));
+		return (c != 0) ? c : ((aLength < bLength) ? -1 : (aLength > bLength) ? 1 : 0);
+	}
+};
+
+/** Nodes with at least this many children get a child index (see ChildIndex) on their first lookup */
+const size_t CHILD_INDEX_MIN_FANOUT = 32;
+
+/** Reused trees forget their names when they have more than this many (see Tree::clear and Tree::limitKeptNames) */
+const size_t KEPT_NAMES_DEFAULT_LIMIT = 4096;
+
+/**
+ * A query compiled from a query string (see TreeQuery::compile). It can be run any number of times against any
+ * tree without allocating memory (prefix levels too - only the first lookup in a wide node builds its child index):
+ * the names are resolved to symbol IDs once per tree.
+ * Rem.: Like the LevelDescender, a compiled query caches the IDs so do not share one among threads (copy it)!
+ */
+class CompiledQuery {
+public:
+	/** Create an invalid query */
+	CompiledQuery() : valid{false} {}
+
+	/** Compile the given query string */
+	explicit CompiledQuery(const char *query) : valid{true} {
+		const char *p = query;
+		const char *end = query + strlen(query);
+		if((p < end) && (*p == '/')) {
+			// The root itself
+			++p;
+		}
+		while(valid && (p < end)) {
+			const char *levelEnd = (const char*)memchr(p, '/', end - p);
+			if(levelEnd == nullptr) {
+				levelEnd = end;
+			}
+			levels.push_back(LevelDescender());
+			valid = LevelDescender::parse(p, levelEnd, levels.back());
+			p = (levelEnd < end) ? levelEnd + 1 : end;
+			if(valid && (levelEnd + 1 == end)) {
+				// Trailing '/' without a level
+				valid = false;
+			}
+		}
+		if(!valid) {
+			levels.clear();
+		}
+	}
+
+	/** Tells if the query string was valid. Invalid queries never find anything. */
+	inline bool isValid() const { return valid; }
+
+	/** Returns the levels of the query */
+	inline const std::vector<LevelDescender>& getLevels() const { return levels; }
+
+	/** Returns the node found by the query from the given node or nullptr */
+	inline Node* find(Node &from) const {
+		if(!valid) {
+			return nullptr;
+		}
+		TBUF_STAT(TreeStats *stats = statsOf(from); if(stats != nullptr) ++stats->queries);
+		TBUF_PHASE(statsOf(from), StatsPhase::QUERY);
+		Node *current = &from;
+		for(const LevelDescender &ld : levels) {
+			current = current->descend(ld);
+			if(current == nullptr) {
+				return nullptr;
+			}
+		}
+		return current;
+	}
+
+	/** Runs the visitor (anything callable with a Node&) on the found node and returns true - or false if not found */
+	template<class Visitor>
+	inline bool fetch(Node &from, Visitor visitor) const {
+		Node *found = find(from);
+		if(found == nullptr) {
+			return false;
+		}
+		visitor(*found);
+		return true;
+	}
+
+private:
+	std::vector<LevelDescender> levels;
+	bool valid;
+};
+
+/**
+ * A query path that is split, parsed and hashed at compile time - use the TBUF_PATH macro to make one. Running it
+ * costs one hash table probe per level and then an integer compare per child (or a child index lookup for wide
+ * nodes): no strings, no allocations and no caching so it can be shared among threads (as long as the tree is not
+ * changed by the lookups - see Node::descend).
+ */
+template<unsigned int N>
+class PathLiteral {
+	static_assert(N > 0, "Invalid path literal");
+public:
+	PathLevel levels[N];
+
+	/** Parses the path: N must be pathLevelCount(path) */
+	constexpr explicit PathLiteral(const char *path) : levels{} {
+		const char *end = PathLevel::pathEnd(path);
+		const char *p = ((path < end) && (*path == '/')) ? path + 1 : path;
+		for(unsigned int i = 0; (i < N) && (p < end); ++i) {
+			const char *levelEnd = PathLevel::levelEnd(p, end);
+			PathLevel::parse(p, levelEnd, levels[i]);
+			p = (levelEnd < end) ? levelEnd + 1 : end;
 		}
 	}
-	// Recursive dfs for postorder
-	inline void dfs_postorder_impl(std::function<void (NodeCore &node, unsigned int depth, bool leaf)> visitor, unsigned int depth) {
-		// recurse
-		for(int i = 0; i < this->children.size(); ++i) {
-			children[i].dfs_preorder_impl(visitor, depth + 1);
+
+	/** Returns the number of levels */
+	constexpr static unsigned int size() { return N; }
+
+	/** Returns the node found by the path from the given node or nullptr */
+	inline Node* find(Node &from) const {
+		TBUF_STAT(TreeStats *stats = statsOf(from); if(stats != nullptr) ++stats->queries);
+		TBUF_PHASE(statsOf(from), StatsPhase::QUERY);
+		Node *current = &from;
+		for(const PathLevel &level : levels) {
+			current = current->descend(level);
+			if(current == nullptr) {
+				return nullptr;
+			}
+		}
+		return current;
+	}
+
+	/** Runs the visitor (anything callable with a Node&) on the found node and returns true - or false if not found */
+	template<class Visitor>
+	inline bool fetch(Node &from, Visitor visitor) const {
+		Node *found = find(from);
+		if(found == nullptr) {
+			return false;
 		}
-		// Visit
-		visitor(this->core, depth, this->children.size() == 0);
+		visitor(*found);
+		return true;
 	}
 };
 
+/**
+ * Makes a PathLiteral from a string literal with the query syntax (see TreeQuery::compile), for example
+ * TBUF_PATH("egy/ketto@1/harom"). The levels are split and hashed at compile time and an invalid path does not
+ * compile. The result is a reference to a static constant so it can be used (and kept) anywhere.
+ */
+#define TBUF_PATH(path) \
+	([]() -> const ::tbuf::PathLiteral<::tbuf::pathLevelCount(path)>& { \
+		static_assert(::tbuf::pathLevelCount(path) > 0, "Invalid TBUF_PATH: " path); \
+		static constexpr ::tbuf::PathLiteral<::tbuf::pathLevelCount(path)> literal{path}; \
+		return literal; \
+	}())
+
 /**
  * Contains static convenience methods to do queries over nodes of trees
  */
 class TreeQuery {
 public:
 	/** Separates levels of the tree in queries */
-	const char LEVEL_SEPARATOR = '/';
+	static const char LEVEL_SEPARATOR = '/';
 	/** Describes 'at' relationships - basically describes what fitting result we should get among the many using indexing */
-	const char AT_DESCRIPTOR = '@';
+	static const char AT_DESCRIPTOR = '@';
 	/** The symbol of ad-hoc polymorphism based on prefix matching */
-	const char AD_HOC_POLIMORFER= '_';
+	static const char AD_HOC_POLIMORFER= '_';
+
+	/**
+	 * Compiles a query string like "orders/item@3/price_" into a reusable query: levels are separated by '/',
+	 * "name@k" means the k-th child with that name (zero based) and a '_' after the name (or the index) means
+	 * that the name is only a prefix - so "price_" finds "price", "price_usd" and so on (ad-hoc polymorphism).
+	 * A leading '/' (the root) is allowed. Check isValid() on the result for syntax errors.
+	 */
+	inline static CompiledQuery compile(const char *query) {
+		return CompiledQuery(query);
+	}
+
+	/**
+	 * Tree-query: Run the given operation on the node found by the query string (see compile). If node is not
+	 * found, this will be a NO-OP. Compile the query once instead when it is used many times!
+	 */
+	inline static void fetch(Node &root, const char *query, std::function<void (NodeCore &found)> visitor) {
+		compile(query).fetch(root, [&visitor] (Node &found) {
+			visitor(found.core);
+		});
+	}
+
+	/**
+	 * If you do not want to further move along the result in the tree, use the fetches that ask
+	 * for a NodeCore instead in your functor that you are providing! Only use this if you need it!
+	 *
+	 * Tree-query: Run the given operation on the node found by the query string (see compile).
+	 */
+	inline static void fetch(Node &root, const char *query, std::function<void (Node &found)> visitor) {
+		compile(query).fetch(root, visitor);
+	}
 
-	// TODO: implement tQuery calls for const char* query strings with '/' as level separator
+	/**
+	 * Tree-query: Run the given operation on the node found by the path literal (see TBUF_PATH). If node is not
+	 * found, this will be a NO-OP. Nothing is parsed, hashed or allocated here.
+	 */
+	template<unsigned int N>
+	inline static void fetch(Node &root, const PathLiteral<N> &path, std::function<void (NodeCore &found)> visitor) {
+		Node *found = path.find(root);
+		if(found != nullptr) {
+			visitor(found->core);
+		}
+	}
+
+	/** Tree-query: Run the given operation on the node found by the path literal (see TBUF_PATH). */
+	template<unsigned int N>
+	inline static void fetch(Node &root, const PathLiteral<N> &path, std::function<void (Node &found)> visitor) {
+		path.fetch(root, visitor);
+	}
 
 	/**
 	 * Tree-query: Run the given operation on the found node. If node is not found, this will be a NO-OP.
@@ -330,7 +975,7 @@ printf("fetch(...) cstr->descender conversion pathElem: %s\n", pathElem);
 			descenders.push_back(std::move(LevelDescender(pathElem)));
 		}
 		// Use the fetch already defined for descenders
-		fetch(root, std::move(descenders), visitor);
+		fetch(root, descenders, visitor);
 	}
 
 	/**
@@ -339,7 +984,7 @@ printf("fetch(...) cstr->descender conversion pathElem: %s\n", pathElem);
 	 * is handled by one element in the second (initializer list of const char*) parameter. Basically this is the
 	 * function that is called by the other - more user friendly cases too.
 	 */
-	inline static void fetch(Node &root, std::vector<LevelDescender> tPath, std::function<void (NodeCore &found)> visitor) {
+	inline static void fetch(Node &root, const std::vector<LevelDescender> &tPath, std::function<void (NodeCore &found)> visitor) {
 		// Just do the usual call and grab the core from it
 		// simple lambda also shows usage as an example.
 		fetch(root, tPath, [&visitor] (Node &visited) {
@@ -356,7 +1001,9 @@ printf("fetch(...) cstr->descender conversion pathElem: %s\n", pathElem);
 	 * is handled by one element in the second (initializer list of const char*) parameter. Basically this is the
 	 * function that is called by the other - more user friendly cases too.
 	 */
-	inline static void fetch(Node &root, std::vector<LevelDescender> tPath, std::function<void (Node &found)> visitor) {
+	inline static void fetch(Node &root, const std::vector<LevelDescender> &tPath, std::function<void (Node &found)> visitor) {
+		TBUF_STAT(TreeStats *stats = statsOf(root); if(stats != nullptr) ++stats->queries);
+		TBUF_PHASE(statsOf(root), StatsPhase::QUERY);
 		Node *currentHead = &root;
 		for(int i = 0; i < tPath.size(); ++i) {
 			// Try descending and update current head with that
@@ -373,7 +1020,104 @@ printf("fetch(...) cstr->descender conversion pathElem: %s\n", pathElem);
 	}
 };
 
+/**
+ * Fast-forwards over the rest of a node body - the same way the parser would read it, but without building or
+ * copying anything. Text nodes are skipped with their escapes ("$t{ \} }" does not close anything) and so are
+ * the comments, so braces inside them never count.
+ */
+class SubtreeSkipper {
+public:
+	/**
+	 * Skips from right after the '{' of a normal node (its hexes included) until right after its closing '}'.
+	 * Returns false when the input ends before the node is closed (then we are on the EOF).
+	 */
+	template<class InputSubClass>
+	inline static bool skip(InputSubClass &input) {
+		const ScanKernels &k = Scan::active();
+		unsigned int depth = 1;
+		Scan::advanceOver(input, k.hexRun);
+		while(true) {
+			char c = input.grabCurr();
+			if(c == EOF) {
+				return false;
+			} else if(Scan::isWhiteSpace(c)) {
+				Scan::advanceOver(input, k.whiteSpaceRun);
+			} else if(c == SYM_COMMENT) {
+				Scan::advanceOver(input, k.lineEnd);
+			} else if(c == SYM_STRING_NODE) {
+				if(!skipText(input)) {
+					return false;
+				}
+			} else if(c == SYM_CLOSE_NODE) {
+				input.advance();
+				if(--depth == 0) {
+					return true;
+				}
+			} else {
+				// The first character is always part of the name
+				input.advance();
+				Scan::advanceOver(input, k.nameEnd);
+				if(input.grabCurr() == SYM_OPEN_NODE) {
+					// The hexes must be skipped here as "a{ff{" is the node "a" with hexes and a child named "{"
+					input.advance();
+					Scan::advanceOver(input, k.hexRun);
+					++depth;
+				}
+				// Otherwise a word (the whitespace after it is the next token) or the EOF
+			}
+		}
+	}
+
+	/** Skips a whole text node from its '$' until right after its closing '}' - returns false when cut off */
+	template<class InputSubClass>
+	inline static bool skipText(InputSubClass &input) {
+		Scan::advanceOver(input, openBrace);
+		if(input.grabCurr() == EOF) {
+			return false;
+		}
+		input.advance();
+		if(!advanceToTextEnd(input)) {
+			return false;
+		}
+		input.advance();
+		return true;
+	}
+
+	/** Advances from the inside of a text node onto its closing '}' - returns false when the input ends first */
+	template<class InputSubClass>
+	inline static bool advanceToTextEnd(InputSubClass &input) {
+		// Every character after an escape is taken literally (even the escape char itself)
+		bool escaped = false;
+		while(true) {
+			fio::LenString ahead = input.grabAhead();
+			if(ahead.length == 0) {
+				return false;
+			}
+			unsigned int n = Scan::textEnd(ahead.startPtr, ahead.length, escaped);
+			input.advance(n);
+			if(n < ahead.length) {
+				return true;
+			}
+		}
+	}
+
+	/** A scan kernel to the '{' after the name of a text node */
+	inline static unsigned int openBrace(const char *p, unsigned int len) {
+		const char *found = (const char*)memchr(p, SYM_OPEN_NODE, len);
+		return (found != nullptr) ? (unsigned int)(found - p) : len;
+	}
+};
+
+// Defined in tbuf_parallel.h
+inline std::unique_ptr<Tree> parallelParse(fio::FastInput &input, unsigned int threads);
+
 class Tree {
+	// Builds the indices of the top-level subtrees concurrently right into our root
+	friend std::unique_ptr<Tree> parallelParse(fio::FastInput &input, unsigned int threads);
+	// Builds the nodes right into our pool when decoding binary messages
+	friend class BinaryCodec;
+	// Adds the nodes as their fragments arrive
+	friend class IncrementalParser;
 public:
 	/** Name for implicit root nodes */
 	const char *rootNodeName = "/";	// This name is special as it can be '/' only for the root - see tbnf description!
@@ -382,12 +1126,16 @@ public:
 	/** The root node for this tree */
 	Node root;
 
+	// Nodes are referring to the tree and to each other by their addresses so trees cannot be copied or moved
+	Tree(const Tree&) = delete;
+	Tree& operator=(const Tree&) = delete;
+
 	/**
 	 * Creates and empty tree with a root node that has no children and no data.
 	 */
 	Tree() {
 		// Empty input file, return empty root
-		root = Node{NodeKind::ROOT, Hexes{fio::LenString{0,nullptr}}, rootNodeName, nullptr, nullptr, std::vector<Node>()};
+		initRoot(Hexes{fio::LenString{0,nullptr}});
 	}
 	
 	/**
@@ -397,32 +1145,156 @@ public:
 	 * of input should be longer than the life-cycle of this object otherwise corrupted strings might get to
 	 * be returned from this tree later! If you set that parameter to be true, everything is a little bit
 	 * faster as we are not using that much dynamic memory...
+	 *
+	 * When the input does not support dangerous destructive operations (like fio::MmapInput) but we can refer
+	 * its memory, a zero-copy parse happens instead: names and texts are pointing right into the input memory
+	 * and they are NOT zero terminated (use nameLength and textLength)! Only texts with escapes get copied.
+	 *
+	 * Inputs that do not support persistent grabs (like fio::StreamInput) are always copied into the tree.
+	 *
+	 * When lazy is true, only the root hexes are parsed here and the children of every node are parsed the first
+	 * time its children list is touched (by descend, the dfs or any direct access). Until that time a node only
+	 * knows where its children are in the input, so fetching a few paths out of a huge message only builds the
+	 * nodes along those paths (and their siblings). The input must be kept alive as long as the tree is used in
+	 * this case - even when canReferMemoryFromInput is false! Lazy parsing always ignores whitespace and it is
+	 * only possible for inputs that support persistent grabs (others are just parsed the usual way).
 	 */
 	// TODO: This is not so clean, why not own input when canReferMemoryFromInput is true? Should refactor!?
 	template<class InputSubClass>
-	Tree(InputSubClass &input, bool canReferMemoryFromInput = false, bool ignoreWhiteSpace = true) {
+	Tree(InputSubClass &input, bool canReferMemoryFromInput = false, bool ignoreWhiteSpace = true, bool lazy = false) {
 		// These are only here to ensure type safety
-		// in our case of template usage...
-		fio::Input *testSubClassing = new InputSubClass();
-		delete testSubClassing;	// Should be fast!
+		// in our case of template usage... (compile time only - no need to construct inputs)
+		static_assert(std::is_base_of<fio::Input, InputSubClass>::value, "Tree needs a subclass of fio::Input!");
+		TBUF_PHASE(&stats, StatsPhase::PARSE);
 
 		// Parse
 		
 		// Check if we have any input to parse
-		if(input.grabCurr() == EOF) {
+		if(lazy && input.isSupportingPersistentGrabs()) {
+			// Only look at the root hexes and remember where the rest is
+			lazyChars = input.grabAhead();
+			lazyRefer = canReferMemoryFromInput;
+			lazyDestructive = canReferMemoryFromInput && input.isSupportingDangerousDestructiveOperations();
+			uint32_t rootHexEnd = Scan::hexRun(lazyChars.startPtr, lazyChars.length);
+			Hexes rootHexes = (rootHexEnd > 0) ? Hexes{fio::LenString{rootHexEnd, lazyChars.startPtr}} : Hexes::EMPTY_HEXES();
+			initRoot(ownedHexes(rootHexes, canReferMemoryFromInput));
+			makeLazy(root.children, NO_NODE, rootHexEnd, lazyChars.length);
+			input.advance(lazyChars.length);
+		} else if(input.grabCurr() == EOF) {
 			// Empty input file, return empty root
-			root = Node{NodeKind::ROOT, Hexes{fio::LenString{0,nullptr}}, rootNodeName, nullptr, nullptr, std::vector<Node>()};
+			initRoot(Hexes{fio::LenString{0,nullptr}});
 		} else {
 			// Properly parse the whole input as a tree
 			// Parse hexes for the root node
-			Hexes rootHexes = parseHexes(input);
+			Hexes rootHexes = ownedHexes(parseHexes(input), canReferMemoryFromInput && input.isSupportingPersistentGrabs());
 			// Create the root node with empty child lists
-			root = Node {NodeKind::ROOT, rootHexes, rootNodeName, nullptr, nullptr, std::vector<Node>()};
+			initRoot(rootHexes);
 			// Fill-in the children while parsing nodes with tree-walking
 			parseNodes(input, root, canReferMemoryFromInput, ignoreWhiteSpace);
 		}
 	}
 
+	/**
+	 * Create tree from a structural index: the second stage of the two-stage parsing (see tbuf::StructuralIndex).
+	 * The strings are handled the same way as in the parsing constructor so canReferMemoryFromInput has the
+	 * same dangers: the input that the index was built from should outlive this tree in that case.
+	 *
+	 * Because the number of nodes is known, the node pool grows only once. An invalid index gives an empty tree.
+	 */
+	Tree(StructuralIndex &index, bool canReferMemoryFromInput = false) {
+		if(!index.isValid()) {
+			initRoot(Hexes::EMPTY_HEXES());
+			return;
+		}
+		// Create the root node with the root hexes and the exact space for the children
+		char *p = index.chars.startPtr;
+		Hexes rootHexes = (index.rootHexEnd > 0) ? Hexes{fio::LenString{index.rootHexEnd, p}} : Hexes::EMPTY_HEXES();
+		initRoot(ownedHexes(rootHexes, canReferMemoryFromInput));
+		TBUF_PHASE(&stats, StatsPhase::PARSE);
+		buildFromIndex(index, root.children, pool.grow(index.nodeCount), canReferMemoryFromInput, symbols);
+		TBUF_STAT(statsIndexed(index); stats.bytesScanned += index.chars.length - index.rootHexEnd);
+	}
+
+	/**
+	 * Create a projection of the input: only the nodes found by the given queries (with their whole subtrees) and
+	 * their ancestors are built. Everything else is skipped at scanning speed without creating nodes or copying
+	 * strings and the parsing stops as soon as every query has found its node (or cannot find it anymore), so the
+	 * time and the memory track the projected size and not the size of the input.
+	 *
+	 * Use projected(i) to get the node found by the i-th query. Queries with '@' indices should not be run on the
+	 * projected tree again: the skipped siblings are not there so the indices would count differently!
+	 * Strings are handled the same way as in the parsing constructor (whitespace is always ignored).
+	 */
+	template<class InputSubClass>
+	Tree(InputSubClass &input, const std::vector<CompiledQuery> &queries, bool canReferMemoryFromInput = false) {
+		// These are only here to ensure type safety in our case of template usage...
+		static_assert(std::is_base_of<fio::Input, InputSubClass>::value, "Tree needs a subclass of fio::Input!");
+		TBUF_PHASE(&stats, StatsPhase::PARSE);
+		Hexes rootHexes = ownedHexes(parseHexes(input), canReferMemoryFromInput && input.isSupportingPersistentGrabs());
+		initRoot(rootHexes);
+		parseProjected(input, queries, canReferMemoryFromInput);
+	}
+
+	/** Returns the node found by the i-th query of the projecting constructor (nullptr when it was not found) */
+	inline Node* projected(size_t i) const {
+		return (i < projection.size()) ? projection[i] : nullptr;
+	}
+
+	/**
+	 * Forgets every node but keeps the memory for the next message: the node pool, the arenas of the copied
+	 * strings and the names. The names keep their IDs too (so cached query IDs stay valid) unless some were
+	 * referred in the input that might be gone now or there are more names than the limit (see limitKeptNames).
+	 * Then the IDs are handed out again: the queries notice that by the serial() of the symbol table and look
+	 * their names up again. The counters are kept as well (see resetStatistics()).
+	 * Rem.: Every node and string of the tree becomes invalid!
+	 */
+	inline void clear() {
+		forgetNodes();
+		initRoot(Hexes::EMPTY_HEXES());
+	}
+
+	/**
+	 * Parses the next message into this tree - the same as building a new tree from the input (without lazy
+	 * parsing) but the memory of the earlier messages is reused (see clear()). For messages of the same shape
+	 * this allocates nothing once the tree has grown for them (the child indices of wide nodes are rebuilt).
+	 */
+	template<class InputSubClass>
+	inline void reparse(InputSubClass &input, bool canReferMemoryFromInput = false, bool ignoreWhiteSpace = true) {
+		static_assert(std::is_base_of<fio::Input, InputSubClass>::value, "Tree needs a subclass of fio::Input!");
+		forgetNodes();
+		TBUF_PHASE(&stats, StatsPhase::PARSE);
+		Hexes rootHexes = ownedHexes(parseHexes(input), canReferMemoryFromInput && input.isSupportingPersistentGrabs());
+		initRoot(rootHexes);
+		parseNodes(input, root, canReferMemoryFromInput, ignoreWhiteSpace);
+	}
+
+	/**
+	 * Sets how many names clear() and reparse(..) keep (KEPT_NAMES_DEFAULT_LIMIT by default). Over that, every name
+	 * is forgotten so that messages with ever changing names (like IDs in names) cannot grow the tree forever.
+	 */
+	inline void limitKeptNames(size_t limit) {
+		keptNamesLimit = limit;
+	}
+
+	/** Returns the table of the distinct node names of this tree (see NodeCore::nameId) */
+	inline const SymbolTable& symbolTable() const {
+		return symbols;
+	}
+
+#ifdef TBUF_STATS
+	/** Returns the counters of the parser and the queries of this tree (only with TBUF_STATS - see tbuf_stats.h) */
+	inline const TreeStats& statistics() {
+		stats.poolBlocks = pool.blockCount();
+		stats.symbolRehashes = symbols.rehashCount();
+		return stats;
+	}
+
+	/** Zeroes the counters (the parse counters only change again when lazy children get parsed) */
+	inline void resetStatistics() {
+		stats.reset();
+	}
+#endif
+
 	/**
 	 * Adds a duplicate of the given source node below the specified parent. The src should come from the same tree!
 	 *
@@ -443,7 +1315,7 @@ public:
 #endif
 		// Add by setting parent and empty children
 		// and of course the very same shared NodeContent data from src
-		parent.children.push_back(std::move(Node{src.core, &parent, std::vector<Node>()}));
+		parent.children.push_back(std::move(Node{src.core, &parent, ChildList()}));
 
 		return parent.children[parent.children.size() - 1];
 	}
@@ -458,25 +1330,24 @@ public:
 		NodeCore nc;
 		nc.nodeKind = NodeKind::TEXT;
 		// The name of the node is "$" by default.
-		const char *fullName = SYM_STRING_NODE_STR;
-		if(name.length() > 0) {
-			// Otherwise it is of the form: "$_aUserDefinedName"
-			// So we need to add to or lookup string from the treeStrings set
-			auto iName = treeStrings.insert(SYM_STRING_NODE_CLASS_STR+name);
-			// Refer to this data then (which has tree-bound lifetime)
-			fullName = (*(iName.first)).c_str();
-		}
-		nc.name = fullName;
+		// Otherwise it is of the form: "$_aUserDefinedName"
+		std::string fullName = (name.length() > 0) ? (SYM_STRING_NODE_CLASS_STR + name) : SYM_STRING_NODE_STR;
+		// So we need to add to or lookup the name in the symbol table (which has tree-bound lifetime)
+		nc.nameId = symbols.intern(fio::LenString{(unsigned int)fullName.length(), &fullName[0]}, true);
+		nc.name = symbols.nameOf(nc.nameId);
+		nc.nameLength = fullName.length();
 		// Try adding the text for the node - this also looks up earlier data!
 		// Rem.: This ensures there are duplicate data stored except when there are data from first parse c_strs!
 		//       That is the latter are not in the treeStrings set because they are still in the morphed input!
 		//       (It would take too long to look with linear search in the memory or the tree for char* strings)
 		auto iText = treeStrings.insert(text); // iterator for the "text" std::string
+		TBUF_STAT(++stats.treeStringInserts; stats.treeStringHits += !iText.second);
 		nc.text = (*(iText.first)).c_str();
+		nc.textLength = text.length();
 
 		// Add a new node below the parent - with the given NodeCore data and pointer to the given parent and no initial children.
 		// Rem.: takint address of parent migth be nothing if it is already a reference - if its not things are faster anyways...
-		parent.children.push_back(std::move(Node{nc, &parent, std::vector<Node>()}));
+		parent.children.push_back(std::move(Node{nc, &parent, ChildList()}));
 
 		return parent.children[parent.children.size() - 1];
 	}
@@ -505,6 +1376,7 @@ public:
 		if(data.length() > 0) {
 			// See if we can look up or insert the data as a string
 			auto iData = treeStrings.insert(data);
+			TBUF_STAT(++stats.treeStringInserts; stats.treeStringHits += !iData.second);
 			// Get the length and a pointer properly from the stored string
 			// Rem.: Bad conversion is a must here sadly - but it is the only way...
 			char* digitStr = (char*)(iData.first->c_str());
@@ -512,30 +1384,446 @@ public:
 			nc.data = Hexes{digits};
 		}
 		// Set NAME
-		const char *fullName = "missing_node_name"; // This should never show up...
-		if(name.length() > 0) {
-			// Otherwise it is of the form: "$_aUserDefinedName"
-			// So we need to add to or lookup string from the treeStrings set
-			auto iName = treeStrings.insert(name);
-			// Refer to this data then (which has tree-bound lifetime)
-			fullName = (*(iName.first)).c_str();
-		}
-		nc.name = fullName;
+		std::string fullName = (name.length() > 0) ? name : "missing_node_name"; // This should never show up...
+		// So we need to add to or lookup the name in the symbol table (which has tree-bound lifetime)
+		nc.nameId = symbols.intern(fio::LenString{(unsigned int)fullName.length(), &fullName[0]}, true);
+		nc.name = symbols.nameOf(nc.nameId);
+		nc.nameLength = fullName.length();
+		// Not a text node
+		nc.text = nullptr;
+		nc.textLength = 0;
 
 		// Add a new node below the parent - with the given NodeCore data and pointer to the given parent and no initial children.
 		// Rem.: takint address of parent migth be nothing if it is already a reference - if its not things are faster anyways...
-		parent.children.push_back(std::move(Node{nc, &parent, std::vector<Node>()}));
+		parent.children.push_back(std::move(Node{nc, &parent, ChildList()}));
 
 		return parent.children[parent.children.size() - 1];
 	}
 private:
+	/** The memory of every node except the root */
+	NodePool pool;
+
+#ifdef TBUF_STATS
+	/** The counters of the parser and the queries */
+	TreeStats stats;
+	/** The depth of the node the parser is in */
+	uint32_t statsDepth = 0;
+
+	friend TreeStats* statsOf(Node &node);
+
+	/** Counts entering a node while parsing */
+	inline void statsEnter() {
+		stats.maxDepth = std::max(stats.maxDepth, ++statsDepth);
+	}
+
+	/** Counts the nodes of an index built into the tree (not in buildFromIndex as those can run concurrently) */
+	inline void statsIndexed(const StructuralIndex &index) {
+		statsDepth = 0;
+		for(const IndexEntry &e : index.entries) {
+			if(e.kind == IndexEntryKind::CLOSE) {
+				--statsDepth;
+			} else {
+				++stats.nodesByKind[(int)((e.kind == IndexEntryKind::TEXT) ? NodeKind::TEXT : NodeKind::NORM)];
+				if(e.kind == IndexEntryKind::OPEN) {
+					statsEnter();
+				}
+			}
+		}
+	}
+#endif
+
+	/** The distinct node names of the tree */
+	SymbolTable symbols;
+
+	/** (Re)initializes the root with the given hexes and no children */
+	inline void initRoot(Hexes rootHexes) {
+		pool.tree = this;
+		// Rem.: Copied so that only the names from the inputs count as referred ones (see clear)
+		uint32_t rootNameId = symbols.intern(fio::LenString{1, (char*)rootNodeName}, true);
+		TBUF_STAT(++stats.nodesByKind[(int)NodeKind::ROOT]; stats.bytesScanned += rootHexes.digits.length);
+		root = Node{NodeKind::ROOT, rootHexes, rootNodeName, 1, rootNameId, nullptr, 0, nullptr, ChildList(&pool)};
+	}
+
 	/**
-	 * Those strings go here that we are not able to fetch in an optimized way out of the input handler's memory.
-	 * Also dynamically added elements strings are going here and user can ask the tree to copy everything instead of
-	 * doing the hacky ways of referring to memory we have in the input... Latter is faster, but more error prone.
+	 * The strings of the dynamically added elements go here (the parsed ones that we are not able to refer in the
+	 * input handler's memory are copied into the strings table below instead).
 	 */
 	std::unordered_set<std::string> treeStrings;
 
+	/** Big tree-owned blocks of strings (like the unpacked hexes of binary messages) - these are never deduplicated */
+	std::vector<std::unique_ptr<char[]>> treeBlocks;
+
+	/**
+	 * The copies of the parsed hexes and texts (when the input cannot be referred). These are deduplicated the same
+	 * way as the names, in arenas that are kept for reuse when the tree is cleared - so copying allocates nothing
+	 * once the arenas are big enough for the messages.
+	 */
+	SymbolTable strings;
+
+	/** Scratch memory for unescaping the texts before they are copied (its capacity is kept) */
+	std::string unescapeBuffer;
+
+	/** Returns the tree-owned zero terminated copy of the given characters (deduplicated) */
+	inline const char* copyToTreeStrings(fio::LenString str) {
+#ifdef TBUF_STATS
+		size_t known = strings.size();
+#endif
+		const char *copy = strings.nameOf(strings.intern(str, true));
+		TBUF_STAT(++stats.treeStringInserts; stats.treeStringHits += (strings.size() == known));
+		return copy;
+	}
+
+	/** Hexes need to be copied into the tree strings when we cannot refer the memory of the input later */
+	inline Hexes ownedHexes(Hexes hexes, bool referInput) {
+		if(!referInput && !hexes.isEmpty()) {
+			// Rem.: Bad conversion is a must here sadly - but the tree never changes these
+			hexes.digits.startPtr = (char*)copyToTreeStrings(hexes.digits);
+		}
+		return hexes;
+	}
+
+	/** The nodes found by the queries of the projecting constructor */
+	std::vector<Node*> projection;
+
+	/** The most names that clear() keeps (see limitKeptNames) */
+	size_t keptNamesLimit = KEPT_NAMES_DEFAULT_LIMIT;
+
+	/** Forgets every node and string of the tree but keeps the memory (the root is not initialized) */
+	inline void forgetNodes() {
+		pool.clear();
+		strings.clear();
+		if(symbols.hasReferredNames() || (symbols.size() > keptNamesLimit)) {
+			// The referred names might be gone with the earlier input (and the others should not pile up forever)
+			symbols.clear();
+		}
+		treeStrings.clear();
+		treeBlocks.clear();
+		childIndices.clear();
+		projection.clear();
+		lazyChars = fio::LenString{0, nullptr};
+		lazyRefer = false;
+		lazyDestructive = false;
+		TBUF_STAT(statsDepth = 0);
+	}
+
+	/** The characters of the input in case of lazy trees */
+	fio::LenString lazyChars = fio::LenString{0, nullptr};
+	/** Tells if the lazy parsing can refer the memory of the input */
+	bool lazyRefer = false;
+	/** Tells if the lazy parsing can do the dangerous destructive operations on the input */
+	bool lazyDestructive = false;
+
+	friend class ChildList;
+
+	/**
+	 * Lets the list parse its children from the [begin, end) range of the lazy input on the first access.
+	 * The owner is the pool index of the node of the list (NO_NODE for the root).
+	 */
+	inline void makeLazy(ChildList &list, uint32_t owner, uint32_t begin, uint32_t end) {
+		if(begin < end) {
+			list.first = begin;
+			list.last = end;
+			list.count = ChildList::LAZY_COUNT;
+			list.cachedIndex = owner;
+		}
+	}
+
+	/** Adds a copy of the node into the pool as the last child of the list and returns the added node */
+	inline Node& addToList(ChildList &list, const Node &node) {
+		uint32_t index = pool.add(node);
+		Node &added = pool[index];
+		// Rem.: The children are never copied - the added node starts with an empty list
+		added.children = ChildList(&pool);
+		list.link(index);
+		// Keep the child index of the list current (if there is one)
+		if(!childIndices.empty()) {
+			auto it = childIndices.find(&list);
+			if(it != childIndices.end()) {
+				it->second->add(added.core.nameId, list.count - 1, index, symbols);
+			}
+		}
+		return added;
+	}
+
+	/** The child indices of the wide nodes (by their child lists) - see ChildIndex */
+	std::unordered_map<const ChildList*, std::unique_ptr<ChildIndex>> childIndices;
+
+	friend struct Node;
+
+	/** Returns the child index of the list - builds it first if the list does not have one yet */
+	inline const ChildIndex& childIndexOf(ChildList &list) {
+		TBUF_STAT(++stats.descendComparisons);
+		std::unique_ptr<ChildIndex> &index = childIndices[&list];
+		if(!index) {
+			index.reset(new ChildIndex());
+			uint32_t ordinal = 0;
+			for(uint32_t i = list.first; i != NO_NODE; i = pool[i].nextSibling) {
+				index->add(pool[i].core.nameId, ordinal++, i, symbols);
+			}
+		}
+		return *index;
+	}
+
+	/** Descends into the list using its child index */
+	inline Node* descendIndexed(ChildList &list, const LevelDescender &ld) {
+		const ChildIndex &index = childIndexOf(list);
+		uint32_t found;
+		if(ld.adHocPolymorph) {
+			found = index.findPrefixed(ld.targetName.c_str(), ld.targetName.length(), ld.targetIndex, symbols);
+		} else {
+			uint32_t targetId = ld.resolveIn(symbols);
+			found = (targetId == NO_SYMBOL) ? NO_NODE : index.find(targetId, ld.targetIndex);
+		}
+		return (found == NO_NODE) ? nullptr : &pool[found];
+	}
+
+	/** Descends into the list using its child index - the name is looked up with its precomputed hash */
+	inline Node* descendIndexed(ChildList &list, const PathLevel &level) {
+		const ChildIndex &index = childIndexOf(list);
+		uint32_t found;
+		if(level.prefix) {
+			found = index.findPrefixed(level.name, level.length, level.index, symbols);
+		} else {
+			uint32_t targetId = symbols.find(level.name, level.length, level.hash);
+			found = (targetId == NO_SYMBOL) ? NO_NODE : index.find(targetId, level.index);
+		}
+		return (found == NO_NODE) ? nullptr : &pool[found];
+	}
+
+	/** Forgets the child index of the list (it gets rebuilt on the next lookup) */
+	inline void dropChildIndex(const ChildList &list) {
+		childIndices.erase(&list);
+	}
+
+	/**
+	 * Handler for the StructuralWalker that only collects the direct children of the walked range.
+	 * For normal nodes the "end" is the end of their hexes and "match" is the position of their closing '}'.
+	 */
+	struct LazyChildFinder {
+		std::vector<IndexEntry> found;
+		uint32_t depth = 0;
+		inline void open(uint32_t start, uint32_t brace) {
+			if(depth == 0) {
+				found.push_back(IndexEntry{IndexEntryKind::OPEN, start, brace, brace + 1, 0, 0});
+			}
+			++depth;
+		}
+		inline void hexEnd(uint32_t pos) {
+			if(depth == 1) {
+				found.back().end = pos;
+			}
+		}
+		inline void word(uint32_t start, uint32_t end) {
+			if(depth == 0) {
+				found.push_back(IndexEntry{IndexEntryKind::WORD, start, end, end, 0, 0});
+			}
+		}
+		inline void text(uint32_t start, uint32_t brace, uint32_t close) {
+			if(depth == 0) {
+				found.push_back(IndexEntry{IndexEntryKind::TEXT, start, brace, close, 0, 0});
+			}
+		}
+		inline void close(uint32_t pos) {
+			// Rem.: At the top level a '}' is just ignored (there are no such in the bodies of the nodes)
+			if(depth > 0) {
+				--depth;
+				if(depth == 0) {
+					found.back().match = pos;
+				}
+			}
+		}
+	};
+
+	/** Parses the direct children of the owner from the [begin, end) range of the lazy input */
+	inline void materializeChildren(Node &owner, uint32_t begin, uint32_t end) {
+#ifdef DEBUG_LOG
+printf("(~) Lazy parsing of the children of %.*s(%p)\n", owner.core.nameLength, owner.core.name, (void*)&owner);
+#endif
+		TBUF_PHASE(&stats, StatsPhase::LAZY_PARSE);
+		// Collect the children first so that the destructive operations do not happen while walking
+		LazyChildFinder finder;
+		WalkPosition wp{WalkState::TOKEN, begin, begin, begin};
+		StructuralWalker::walk(lazyChars, end, wp, finder);
+		// Handle what is left open at the end of the input the same way the tree parser does
+		if(finder.depth > 0) {
+			IndexEntry &last = finder.found.back();
+			if((wp.state == WalkState::HEXES) && (finder.depth == 1)) {
+				last.end = end;
+			}
+			if((last.end == last.open + 1) && (last.end == lazyChars.length)) {
+				// A '{' at the very end is a syntax error: the node is dropped
+				finder.found.pop_back();
+			} else if(last.kind == IndexEntryKind::OPEN) {
+				// Never closed: the body goes until the end
+				last.match = end;
+			}
+		}
+
+		// Build the nodes - the ones with bodies are lazy again
+		bool zeroCopy = lazyRefer && !lazyDestructive;
+		char *p = lazyChars.startPtr;
+		TBUF_STAT(stats.bytesScanned += end - begin);
+		for(const IndexEntry &e : finder.found) {
+			TBUF_STAT(++stats.nodesByKind[(int)((e.kind == IndexEntryKind::TEXT) ? NodeKind::TEXT : NodeKind::NORM)]);
+			fio::LenString name{e.open - e.start, p + e.start};
+			uint32_t nameId;
+			if(e.kind == IndexEntryKind::TEXT) {
+				fio::LenString content{e.end - e.open - 1, p + e.open + 1};
+				unsigned int textLength = 0;
+				const char *text = keepText(content, lazyDestructive, zeroCopy, textLength);
+				const char *kept = keepName(name, lazyDestructive, zeroCopy, nameId);
+				addToList(owner.children, Node{NodeKind::TEXT, Hexes {}, kept, name.length, nameId, text, textLength, &owner, ChildList()});
+			} else {
+				Hexes hexes = (e.end > e.open + 1) ? Hexes{fio::LenString{e.end - e.open - 1, p + e.open + 1}} : Hexes::EMPTY_HEXES();
+				// Rem.: The whitespace after an empty leaf can be overridden as nothing walks it again
+				const char *kept = keepName(name, lazyDestructive, zeroCopy, nameId);
+				Node &added = addToList(owner.children, Node{NodeKind::NORM, ownedHexes(hexes, lazyRefer), kept, name.length, nameId, nullptr, 0, &owner, ChildList()});
+				if(e.kind == IndexEntryKind::OPEN) {
+					// Rem.: The added node is the last one in the list of the owner
+					makeLazy(added.children, owner.children.last, e.end, e.match);
+				}
+			}
+		}
+	}
+
+	/** Returns a name with tree-lifetime for the given name in the input memory and interns it into our symbols */
+	inline const char* keepName(fio::LenString name, bool destructive, bool zeroCopy, uint32_t &nameId) {
+		return keepName(name, destructive, zeroCopy, nameId, symbols);
+	}
+
+	/**
+	 * Returns a name with tree-lifetime for the given name in the input memory:
+	 * - destructive: put a zero terminator right after the name (overriding the '{' there) and refer to it
+	 * - zeroCopy: refer to the input memory without changing it (the name is not zero terminated)
+	 * - otherwise: copy it into the symbol table (always needed for non-persistent inputs like streams)
+	 * The ID of the name in the given symbol table is put into nameId. Copies happen once per distinct name.
+	 */
+	inline const char* keepName(fio::LenString name, bool destructive, bool zeroCopy, uint32_t &nameId, SymbolTable &table) {
+		if(destructive) {
+			// Create null terminated c_str from the LenString
+			const char *kept = name.dangerous_destructive_unsafe_get_zeroterminator_added_cstr();
+			nameId = table.intern(name, false);
+			return kept;
+		} else if(zeroCopy) {
+			// Just refer to the input memory (no zero terminator!)
+			nameId = table.intern(name, false);
+			return name.startPtr;
+		} else {
+			// The table owns the (zero terminated) copy - we refer to that
+			nameId = table.intern(name, true);
+			return table.nameOf(nameId);
+		}
+	}
+
+	/**
+	 * Returns the unescaped text with tree-lifetime for the given text node contents in the input memory.
+	 * The modes are the same as for keepName(..) and textLength is set to the length of the unescaped text.
+	 */
+	inline const char* keepText(fio::LenString content, bool destructive, bool zeroCopy, unsigned int &textLength) {
+		textLength = content.length;
+		if(destructive) {
+			// Create null terminated c_str from the LenString (overriding the closing '}')
+			const char* text = content.dangerous_destructive_unsafe_get_zeroterminator_added_cstr();
+			// Support escaping - at least for the '}' character. We need unescaping here...
+			textLength = content.dangerous_destructive_unsafe_unescape_in_place(SYM_ESCAPE);
+			// Empty texts are nullptr (see NodeCore::text)
+			return (textLength > 0) ? text : nullptr;
+		} else if(zeroCopy && (memchr(content.startPtr, SYM_ESCAPE, content.length) == nullptr)) {
+			// Just refer to the input memory (no zero terminator!) - when empty, we use nullptr
+			// This can be only done when there is nothing to unescape as we cannot change the memory...
+			return (content.length > 0) ? content.startPtr : nullptr;
+		} else {
+			// Unescape into the scratch buffer and copy that into the tree strings
+			// This way the tree owns these copies as it should be.
+			// Every character after an escape is taken literally (even the escape char itself)
+			unescapeBuffer.clear();
+			for(unsigned int i = 0; i < content.length; ++i) {
+				if((content.startPtr[i] == SYM_ESCAPE) && (i + 1 < content.length)) {
+					++i;
+				}
+				unescapeBuffer.push_back(content.startPtr[i]);
+			}
+			textLength = unescapeBuffer.length();
+			return (textLength > 0) ? copyToTreeStrings(fio::LenString{textLength, &unescapeBuffer[0]}) : nullptr;
+		}
+	}
+
+	/**
+	 * Builds the nodes of the index below the root. The nodes are put into the already grown part of the node pool
+	 * starting from firstIndex, the top level nodes are added to the topLevel list and the names are interned into
+	 * the given symbol table. When the input supports the dangerous destructive operations and we can refer it,
+	 * nothing is added to the treeStrings and the pool is not changed either, so various indices can be built into
+	 * the same tree concurrently (with separate lists and symbol tables that are merged later).
+	 */
+	inline void buildFromIndex(const StructuralIndex &index, ChildList &topLevel, uint32_t firstIndex, bool canReferMemoryFromInput, SymbolTable &symbols) {
+		bool destructive = canReferMemoryFromInput && index.destructiveAllowed;
+		bool zeroCopy = canReferMemoryFromInput && !destructive;
+		char *p = index.chars.startPtr;
+
+		// Walk the entries - this is the same non-recursive depth first tree-walking as when parsing
+		Node *parent = &root;
+		uint32_t nodeIndex = firstIndex;
+		for(const IndexEntry &e : index.entries) {
+			if(e.kind == IndexEntryKind::CLOSE) {
+				// CLOSE entries always have a matching OPEN so we are never at the root here
+				parent = parent->parent;
+				continue;
+			}
+			Node &node = *new (&pool[nodeIndex]) Node();
+			fio::LenString name{e.open - e.start, p + e.start};
+			uint32_t nameId;
+			if(e.kind == IndexEntryKind::OPEN) {
+				Hexes hexes = (e.end > e.open + 1) ? Hexes{fio::LenString{e.end - e.open - 1, p + e.open + 1}} : Hexes::EMPTY_HEXES();
+				node = Node{
+						NodeKind::NORM,
+						ownedHexes(hexes, canReferMemoryFromInput),
+						keepName(name, destructive, zeroCopy, nameId, symbols),
+						name.length,
+						nameId,
+						nullptr,
+						0,
+						parent,
+						ChildList(&pool)
+				};
+			} else if(e.kind == IndexEntryKind::WORD) {
+				// Rem.: Unlike in the parser, the whitespace after the name can be overridden by the '\0' here
+				//       as the indexing has already happened and nothing looks at that character anymore!
+				node = Node{
+						NodeKind::NORM,
+						Hexes::EMPTY_HEXES(),
+						keepName(name, destructive, zeroCopy, nameId, symbols),
+						name.length,
+						nameId,
+						nullptr,
+						0,
+						parent,
+						ChildList(&pool)
+				};
+			} else {
+				fio::LenString content{e.end - e.open - 1, p + e.open + 1};
+				unsigned int textLength = 0;
+				const char *text = keepText(content, destructive, zeroCopy, textLength);
+				node = Node{
+						NodeKind::TEXT,
+						Hexes {},
+						keepName(name, destructive, zeroCopy, nameId, symbols),
+						name.length,
+						nameId,
+						text,
+						textLength,
+						parent,
+						ChildList(&pool)
+				};
+			}
+			// Top level nodes go to their own list
+			((parent == &root) ? topLevel : parent->children).link(nodeIndex);
+			if(e.kind == IndexEntryKind::OPEN) {
+				parent = &node;
+			}
+			++nodeIndex;
+		}
+	}
+
 	/**
 	 * Advances input until it is a hex character and parse.
 	 * The current of input will point after the first non-hex character after this operation...
@@ -546,16 +1834,285 @@ private:
 			// No hexes at current position
 			return Hexes {{0, nullptr}};
 		} else {
-			// Hexes at current position
+			// Hexes at current position - scan them with the vectorized kernels
 			void* hexSeam = input.markSeam();
-			while(Hexes::isHexCharacter(input.grabCurr())) {
-				input.advance();
-			}
+			Scan::advanceOver(input, Scan::active().hexRun);
 			fio::LenString digits = input.grabFromSeamToLast(hexSeam);
 			return Hexes { digits };
 		}
 	}
 
+	/** Counts a whitespace run the parser skipped (only with TBUF_STATS) */
+	inline void countWhiteSpace(size_t length) {
+		TBUF_STAT(++stats.whiteSpaceRuns; stats.whiteSpaceBytes += length; stats.bytesScanned += length);
+	}
+
+	/** Counts a comment the parser skipped (only with TBUF_STATS) */
+	inline void countComment(size_t length) {
+		TBUF_STAT(++stats.comments; stats.commentBytes += length; stats.bytesScanned += length);
+	}
+
+	/**
+	 * Parses the contents of a text node from its '{' (its name is already grabbed as lsName) and adds the node
+	 * below the parent. Returns false when the text is never closed: the node is dropped then.
+	 * Rem.: The name is kept before the contents are read as non-persistent inputs might invalidate it!
+	 */
+	template<class InputSubClass>
+	inline bool parseTextNode(InputSubClass &input, Node *parent, fio::LenString lsName, bool destructive, bool zeroCopy) {
+		uint32_t textNodeNameId;
+		const char* textNodeName = keepName(lsName, destructive, zeroCopy, textNodeNameId);
+#ifdef DEBUG_LOG
+printf("(..) Found text-node with name: %.*s below %.*s(%p)\n", lsName.length, textNodeName, parent->core.nameLength, parent->core.name, (void*)parent);
+#endif
+
+		// Let us try to find the contents then...
+		fio::LenString content;
+		// Go after the '{' - we are now in the inside of the node
+		input.advance();
+		// We mark a seam so that we can accumulate input
+		// this should work even if we are at the EOF immediately!
+		void* seamHandle = input.markSeam();
+		// No escaping was possible until yet so '}' surely closes at first
+		bool escaped = false;
+		// Loop and parse the text contents of this node
+		// Every character after an escape is taken literally (even the escape char itself)
+		while(true) {
+			fio::LenString ahead = input.grabAhead();
+			if(ahead.length == 0) {
+				// Syntax error - the text node is never closed
+				// Rem.: We grab from seam here only to ensure mark/grab pairing!
+				input.grabFromSeamToLast(seamHandle);
+				return false;
+			}
+			unsigned int n = Scan::textEnd(ahead.startPtr, ahead.length, escaped);
+			input.advance(n);
+			if(n < ahead.length) {
+				// We are on the closing '}'
+				break;
+			}
+		}
+		// Found the end of the inside of the node
+		content = input.grabFromSeamToLast(seamHandle);
+
+		// Get the text of this node
+		unsigned int textLength = 0;
+		const char* text = keepText(content, destructive, zeroCopy, textLength);
+#ifdef DEBUG_LOG
+printf("(!) text-node content is: %.*s below %.*s(%p)\n", textLength, text, parent->core.nameLength, parent->core.name, (void*)parent);
+#endif
+
+		// The name, the braces and the content
+		TBUF_STAT(++stats.nodesByKind[(int)NodeKind::TEXT]; stats.bytesScanned += lsName.length + content.length + 2);
+
+		// Add this new node as our children to the parent
+		parent->children.push_back(Node{
+				NodeKind::TEXT,
+				Hexes {},
+				textNodeName,
+				lsName.length,
+				textNodeNameId,
+				text,
+				textLength,
+				parent,
+				ChildList()
+		});
+
+		// Advance over the '}' closing char
+		// (in dangerous operations it became a null terminator anyways)
+		input.advance();
+		return true;
+	}
+
+	/** Where a query of the projecting constructor is */
+	struct ProjectedQuery {
+		/** The number of its levels found so far: the query goes on below the node of this depth on the current path */
+		unsigned int found;
+		/** The matching siblings seen so far on the next level (for the '@' indexing) */
+		int matches;
+		/** Tells if the node is found or cannot be found anymore */
+		bool done;
+	};
+
+	/** Tells if the name fits the level of a query (the same way as Node::descend compares the names) */
+	inline static bool fitsLevel(fio::LenString name, const LevelDescender &ld) {
+		return ld.adHocPolymorph ?
+				((name.length >= ld.targetName.length()) && !memcmp(name.startPtr, ld.targetName.c_str(), ld.targetName.length())) :
+				((name.length == ld.targetName.length()) && !memcmp(name.startPtr, ld.targetName.c_str(), name.length));
+	}
+
+	/**
+	 * Parses the children of the root for the projecting constructor. Only the nodes taking the queries on are built:
+	 * the path nodes are entered, the found nodes are parsed as a whole by parseNode and the rest is skipped.
+	 */
+	template<class InputSubClass>
+	inline void parseProjected(InputSubClass &input, const std::vector<CompiledQuery> &queries, bool canReferMemoryFromInput) {
+		bool referInput = canReferMemoryFromInput && input.isSupportingPersistentGrabs();
+		bool destructive = referInput && input.isSupportingDangerousDestructiveOperations();
+		bool zeroCopy = referInput && !destructive;
+		const ScanKernels &k = Scan::active();
+
+		projection.assign(queries.size(), nullptr);
+		std::vector<ProjectedQuery> state(queries.size(), ProjectedQuery{0, 0, false});
+		size_t pending = 0;
+		bool wholeTree = false;
+		for(size_t i = 0; i < queries.size(); ++i) {
+			state[i].done = !queries[i].isValid();
+			pending += !state[i].done;
+			wholeTree = wholeTree || (queries[i].isValid() && queries[i].getLevels().empty());
+		}
+		if(wholeTree) {
+			// The root itself is asked for so everything is projected
+			parseNodes(input, root, canReferMemoryFromInput, true);
+			for(size_t i = 0; i < queries.size(); ++i) {
+				projection[i] = queries[i].find(root);
+			}
+			return;
+		}
+
+		// The queries that took a node on finish below it (the subtree is whole there so the indices are right)
+		auto resolveBelow = [&] (Node &node, unsigned int nodeDepth) {
+			for(size_t i = 0; i < queries.size(); ++i) {
+				if(!state[i].done && (state[i].found == nodeDepth)) {
+					const std::vector<LevelDescender> &levels = queries[i].getLevels();
+					Node *current = &node;
+					for(size_t l = nodeDepth; (current != nullptr) && (l < levels.size()); ++l) {
+						current = current->descend(levels[l]);
+					}
+					projection[i] = current;
+					state[i].done = true;
+					--pending;
+				}
+			}
+		};
+
+		// The same non-recursive depth first tree-walking as when parsing - but only on the path of the queries
+		Node *parent = &root;
+		unsigned int depth = 0;
+		while(pending > 0) {
+			char c = input.grabCurr();
+			if(c == EOF) {
+				return;
+			} else if(Scan::isWhiteSpace(c)) {
+				countWhiteSpace(Scan::advanceOver(input, k.whiteSpaceRun));
+			} else if(c == SYM_COMMENT) {
+				countComment(Scan::advanceOver(input, k.lineEnd));
+			} else if(c == SYM_CLOSE_NODE) {
+				input.advance();
+				if(depth > 0) {
+					// The queries going on below the closed node cannot find their nodes anymore
+					for(ProjectedQuery &q : state) {
+						if(!q.done && (q.found == depth)) {
+							q.done = true;
+							--pending;
+						}
+					}
+					parent = parent->parent;
+					--depth;
+					TBUF_STAT(--statsDepth);
+				}
+			} else {
+				// Read the name first so that we know which queries take this node on
+				bool isText = (c == SYM_STRING_NODE);
+				void* seamHandle = input.markSeam();
+				if(isText) {
+					Scan::advanceOver(input, SubtreeSkipper::openBrace);
+				} else {
+					// The first character is always part of the name
+					input.advance();
+					Scan::advanceOver(input, k.nameEnd);
+				}
+				c = input.grabCurr();
+				if(c == EOF) {
+					// Syntax error - the name is cut off (we grab from seam only to ensure mark/grab pairing!)
+					input.grabFromSeamToLast(seamHandle);
+					return;
+				}
+				fio::LenString lsName = input.grabFromSeamToLast(seamHandle);
+				bool hasBody = !isText && (c == SYM_OPEN_NODE);
+				bool found = false;
+				bool wanted = false;
+				for(size_t i = 0; i < queries.size(); ++i) {
+					ProjectedQuery &q = state[i];
+					const std::vector<LevelDescender> &levels = queries[i].getLevels();
+					if(q.done || (q.found != depth) || !fitsLevel(lsName, levels[depth]) || (q.matches++ != levels[depth].targetIndex)) {
+						continue;
+					}
+					if(depth + 1 == levels.size()) {
+						found = true;
+					} else if(!hasBody) {
+						// Words and text nodes have no children to go on with
+						q.done = true;
+						--pending;
+						continue;
+					}
+					q.found = depth + 1;
+					q.matches = 0;
+					wanted = true;
+				}
+
+				if(!wanted) {
+					// Skip the whole node without building anything
+					if(isText) {
+						input.advance();
+						if(!SubtreeSkipper::advanceToTextEnd(input)) {
+							return;
+						}
+						input.advance();
+					} else if(hasBody) {
+						input.advance();
+						if(!SubtreeSkipper::skip(input)) {
+							return;
+						}
+					}
+					continue;
+				}
+
+				// Build the node the same way as parseNode does
+				Node *node;
+				if(isText) {
+					if(!parseTextNode(input, parent, lsName, destructive, zeroCopy)) {
+						return;
+					}
+					node = &parent->children.back();
+				} else {
+					uint32_t nodeNameId;
+					// Rem.: This must happen before advancing as non-persistent inputs might invalidate the LenString!
+					const char* nodeName = keepName(lsName, hasBody && destructive, zeroCopy, nodeNameId);
+					Hexes hexes = Hexes::EMPTY_HEXES();
+					if(hasBody) {
+						input.advance();
+						if(input.grabCurr() == EOF) {
+							// A '{' at the very end is dropped
+							return;
+						}
+						hexes = ownedHexes(parseHexes(input), referInput);
+					}
+					parent->children.push_back(Node{NodeKind::NORM, hexes, nodeName, lsName.length, nodeNameId, nullptr, 0, parent, ChildList()});
+					node = &parent->children.back();
+					TBUF_STAT(++stats.nodesByKind[(int)NodeKind::NORM]; if(hasBody) statsEnter());
+				}
+
+				if(found && hasBody) {
+					// A found node is parsed as a whole - then the queries going through it can find their nodes in it
+					Node *current = node;
+					while((current != nullptr) && (current != parent)) {
+						current = parseNode(input, current, canReferMemoryFromInput, true);
+					}
+					resolveBelow(*node, depth + 1);
+					if(current == nullptr) {
+						return;
+					}
+				} else if(found) {
+					resolveBelow(*node, depth + 1);
+				} else {
+					// Only on the path of queries: go on with its children
+					parent = node;
+					++depth;
+				}
+			}
+		}
+	}
+
 	/** Parse all child nodes of the root after parsing hexes of root */
 	template<class InputSubClass>
 	inline void parseNodes(InputSubClass &input, Node &parent, bool canReferMemoryFromInput, bool ignoreWhiteSpace){
@@ -578,14 +2135,22 @@ private:
 			return nullptr;
 		}
 
+		// Decide how we get tree-lifetime strings out of the input:
+		// - destructive: put zero terminators into the input memory and refer to it
+		// - zeroCopy: refer to the input memory without changing it (strings are not zero terminated)
+		// - otherwise: copy everything into the treeStrings (always needed for non-persistent inputs like streams)
+		bool referInput = useOptimizedButHackyStringReferences && input.isSupportingPersistentGrabs();
+		bool destructive = referInput && input.isSupportingDangerousDestructiveOperations();
+		bool zeroCopy = referInput && !destructive;
+
 		// Try to parse a node which will be saved into the parent
 		if(input.grabCurr() == EOF) {
 			// Finished parsing
 			return nullptr;
-		} else if(ignoreWhiteSpace && isspace(input.grabCurr())) {
+		} else if(ignoreWhiteSpace && Scan::isWhiteSpace(input.grabCurr())) {
 			// Just advance over whitespaces in most cases 
 			// this does not apply when we are in the middle of a text-node however
-			input.advance();
+			countWhiteSpace(Scan::advanceOver(input, Scan::active().whiteSpaceRun));
 			// Return the unchanged parent node as the same
 			return parent;
 		} else if(input.grabCurr() == SYM_COMMENT) {
@@ -594,10 +2159,7 @@ private:
 			// or whatever, the '#' in the string nodes do not start a comment and such!
 			// Rem.: We need to take care about what if we run out of input so EOF
 			//       check is necessary here too!
-			while(!isALineEndChar(input.grabCurr()) && (input.grabCurr() != EOF)) {
-				// Advance input
-				input.advance();
-			}
+			countComment(Scan::advanceOver(input, Scan::active().lineEnd));
 			// Return the unchanged parent node as the same
 			return parent;
 		} else if(input.grabCurr() == SYM_STRING_NODE) {
@@ -606,110 +2168,29 @@ private:
 			// way we can have various 'types' or 'variations' of string nodes
 			// by adding a type name after the '$' in the protocol!
 			void* nameSeamHandle = input.markSeam();	// Mark seam for node name!
-			while(input.grabCurr() != SYM_OPEN_NODE) {
-				// Input sanity check
-				if(input.grabCurr() == EOF) {
-					// Completely depleted input: finish parsing
-					// happens on badly formatted input...
-					// Rem.: We grab from seam here only to ensure mark/grab pairing!
-					input.grabFromSeamToLast(nameSeamHandle);
-					return nullptr;
-				} else {
-					// advance to find the node opening
-					input.advance();
-				}
+			// advance to find the node opening
+			Scan::advanceOver(input, [] (const char *p, unsigned int len) {
+				const char *found = (const char*)memchr(p, SYM_OPEN_NODE, len);
+				return (found != nullptr) ? (unsigned int)(found - p) : len;
+			});
+			// Input sanity check
+			if(input.grabCurr() == EOF) {
+				// Completely depleted input: finish parsing
+				// happens on badly formatted input...
+				// Rem.: We grab from seam here only to ensure mark/grab pairing!
+				input.grabFromSeamToLast(nameSeamHandle);
+				return nullptr;
 			}
 			// Grab name of the text node
 			fio::LenString lsName = input.grabFromSeamToLast(nameSeamHandle);
-			char* textNodeName = nullptr;
-			if(useOptimizedButHackyStringReferences && input.isSupportingDangerousDestructiveOperations()) {
-				// Create null terminated c_str from the LenString
-				textNodeName = lsName.dangerous_destructive_unsafe_get_zeroterminator_added_cstr();
-			} else {
-				// Create std::string from the LenString and
-				// store it in the local set of strings we have in the tree.
-				// This way the tree owns these copies as it should be.
-				treeStrings.insert(lsName.get_str());
-				// (!) We need finding this string and setting the pointer to it
-				// if I would just set the pointer to an other get_str that
-				// would be invalid. We store the std::strings only so that
-				// memory release happens properly later!!!
-				textNodeName = (char*)(*treeStrings.find(lsName.get_str())).c_str();
-			}
-#ifdef DEBUG_LOG
-printf("(..) Found text-node with name: %s below %s(%u)\n", textNodeName, parent->core.name, (unsigned int)parent);
-#endif
-
-			// Let us try to find the contents then...
-			fio::LenString content;
-			// Go after the '{' - we are now in the inside of the node
-			input.advance();
-			// This will hold the current character
-			char current = input.grabCurr();
-			// We mark a seam so that we can accumulate input
-			// this should work even if current became EOF immediately!
-			void* seamHandle = input.markSeam();
-			// Initialize closes flag. EOF surely closes (should not happen though)
-			// and also '}' surely closes as no escaping was possible until yet...
-			bool nodeClosed = ((current == EOF) || (current == SYM_CLOSE_NODE));
-			// Loop and parse the text contents of this node
-			while(!nodeClosed) {
-				// See if this node is already closed or not
-				// here "current" still refers to the last character...
-				bool escaped = (current == SYM_ESCAPE);
-				input.advance();
-				current = input.grabCurr();
-				if((current == SYM_CLOSE_NODE) && (!escaped)) {
-					// Found the end of the inside of the node
-					content = input.grabFromSeamToLast(seamHandle);
-					nodeClosed = true;
-				}
-			}
-
-			// Get the text of this node
-			char* text = nullptr;
-			if(useOptimizedButHackyStringReferences && input.isSupportingDangerousDestructiveOperations()) {
-				// Create null terminated c_str from the LenString
-				text = content.dangerous_destructive_unsafe_get_zeroterminator_added_cstr();
-				// Support escaping - at least for the '}' character. We need unescaping here...
-				content.dangerous_destructive_unsafe_unescape_in_place(SYM_ESCAPE);
-			} else {
-				// Create std::string from the LenString and
-				// store it in the local set of strings we have in the tree.
-				// This way the tree owns these copies as it should be.
-				// Rem.: unescaping is necssary here too!
-				treeStrings.insert(fio::LenString::safe_unescape(SYM_ESCAPE, content.get_str()));
-				// (!) We need finding this string and setting the pointer to it
-				// if I would just set the pointer to an other get_str that
-				// would be invalid. We store the std::strings only so that
-				// memory release happens properly later!!!
-				text = (char*)(*treeStrings.find(content.get_str())).c_str();
-			}
-#ifdef DEBUG_LOG
-printf("(!) text-node content is: %s below %s(%u)\n", text, parent->core.name, (unsigned int)parent);
-#endif
-
-			// Add this new node as our children to the parent
-			parent->children.push_back(Node{
-					NodeKind::TEXT,
-					Hexes {},
-					textNodeName,
-					text,
-					parent,
-					std::vector<Node> {}
-			});
-
-			// Advance over the '}' closing char
-			// (in dangerous operations it became a null terminator anyways)
-			input.advance();
-			
 			// Because the text-only nodes are always leaves
 			// the parents stays as it was
-			return parent;
+			return parseTextNode(input, parent, lsName, destructive, zeroCopy) ? parent : nullptr;
 		} else if(input.grabCurr() == SYM_CLOSE_NODE) {
 			// Parsed the '}' closing symbol
 			// Always advance the input when it is not the EOF already!
 			input.advance();
+			TBUF_STAT(++stats.bytesScanned; statsDepth -= (parent->parent != nullptr));
 			// We should go up one level in the tree walking loop!
 			// The only thing we need to do is thus to go upwards
 			// if the current parent still had any parent
@@ -740,14 +2221,16 @@ printf("(!) text-node content is: %s below %s(%u)\n", text, parent->core.name, (
 			bool isEmptyLeaf = ((current == EOF));	// This just becomes 'false' in any case the code is not broken!
 			// Loop and parse the text contents of this node
 			while(!nodeNameParsed) {
-				// Advance the input read head
+				// Advance the input read head (the first character is always part of the name)
+				// and then over the rest of the name using the vectorized kernels
 				input.advance();
+				Scan::advanceOver(input, Scan::active().nameEnd);
 				// Read the next character
 				current = input.grabCurr();
 				// When the current char becomes a whitespace that means that this node does not have
 				// the '{...}' part and is an empty leaf node. Useful for compactness and when the parser
 				// is used for various unusual reasons like parsing forth-like words and such.
-				isEmptyLeaf = isspace(current);
+				isEmptyLeaf = Scan::isWhiteSpace(current);
 				// If we have found the open node '{' char, empty leaf or EOF we reach end of the name
 				// when EOF is found that is basically an error that we silently try to handle somehow.
 				if((current == SYM_OPEN_NODE) || (current == EOF) || isEmptyLeaf) {
@@ -762,6 +2245,13 @@ printf("(!) text-node content is: %s below %s(%u)\n", text, parent->core.name, (
 				}
 			}
 
+			// Get the text of this node name
+			// Rem.: This must happen before advancing as non-persistent inputs might invalidate the LenString!
+			// In case of empty leaves we cannot use the optimization as there is no "useless" character
+			// for overriding with the '\0' char! If we are not an empty leaf, we can override the '{' safely...
+			uint32_t nodeNameId;
+			const char* nodeName = keepName(lsNodeName, !isEmptyLeaf && destructive, zeroCopy, nodeNameId);
+
 			// Empty leaves does not have the '{' opener, 
 			// so do not even try to advance over that in that case!
 			if(!isEmptyLeaf) {
@@ -777,30 +2267,10 @@ printf("(!) text-node content is: %s below %s(%u)\n", text, parent->core.name, (
 				}
 			}
 
-			// Get the text of this node name
-			char* nodeName = nullptr;
-			// In case of empty leaves we cannot use the optimization as there is no "useless" character
-			// for overriding with the '\0' char! If we are not an empty leaf, we can override the '{' safely...
-			if(!isEmptyLeaf && useOptimizedButHackyStringReferences && input.isSupportingDangerousDestructiveOperations()) {
-				// Create null terminated c_str from the LenString
-				// this works as the '{' character will be overridden
-				nodeName = lsNodeName.dangerous_destructive_unsafe_get_zeroterminator_added_cstr();
-			} else {
-				// Create std::string from the LenString and
-				// store it in the local set of strings we have in the tree.
-				// This way the tree owns these copies as it should be.
-				treeStrings.insert(lsNodeName.get_str());
-				// (!) We need finding this string and setting the pointer to it
-				// if I would just set the pointer to an other get_str that
-				// would be invalid. We store the std::strings only so that
-				// memory release happens properly later!!!
-				nodeName = (char*)(*treeStrings.find(lsNodeName.get_str())).c_str();
-			}
-
 			// Empty leafs do not have all the data other cases have
 			if(!isEmptyLeaf) {
 #ifdef DEBUG_LOG
-printf("(!) Found non-empty sub-node with name: %s below %s(%u)\n", nodeName, parent->core.name, (unsigned int)parent);
+printf("(!) Found non-empty sub-node with name: %.*s below %.*s(%p)\n", lsNodeName.length, nodeName, parent->core.nameLength, parent->core.name, (void*)parent);
 #endif
 				// Now we have all the data to build this subnode
 				// and set it as a parent. This must be added as a
@@ -809,12 +2279,18 @@ printf("(!) Found non-empty sub-node with name: %s below %s(%u)\n", nodeName, pa
 				// empty (like: node{}) this still works the same way!
 				parent->children.push_back(Node{
 						NodeKind::NORM, // normal node type
-						std::move(parseHexes(input)), // inline hexes...
+						ownedHexes(parseHexes(input), referInput), // inline hexes...
 						nodeName, // set the parsed node name
+						lsNodeName.length, // and its length
+						nodeNameId, // and its symbol
 						nullptr, // not a text node
+						0, // so no text length either
 						parent,	// set parent node
-						std::vector<Node> {}	// start with empty children - will collect them later!
+						ChildList()	// start with empty children - will collect them later!
 				});
+				// The name, the '{' and the hexes
+				TBUF_STAT(++stats.nodesByKind[(int)NodeKind::NORM]; statsEnter();
+						stats.bytesScanned += lsNodeName.length + 1 + parent->children.back().core.data.digits.length);
 
 				// Return the node we just added
 				// "vector.back" just returns the last element
@@ -824,7 +2300,7 @@ printf("(!) Found non-empty sub-node with name: %s below %s(%u)\n", nodeName, pa
 				return &parent->children.back();
 			} else {
 #ifdef DEBUG_LOG
-printf("(!) Found an empty-leaf sub-node with name: %s below %s(%u)\n", nodeName, parent->core.name, (unsigned int)parent);
+printf("(!) Found an empty-leaf sub-node with name: %.*s below %.*s(%p)\n", lsNodeName.length, nodeName, parent->core.nameLength, parent->core.name, (void*)parent);
 #endif
 				// Now we have all the data to build this subnode
 				// and set it as a parent. This must be added as a
@@ -835,10 +2311,14 @@ printf("(!) Found an empty-leaf sub-node with name: %s below %s(%u)\n", nodeName
 						NodeKind::NORM, // normal node type (just no body and child!)
 						Hexes::EMPTY_HEXES(), // empty hexes
 						nodeName, // set the parsed node name
+						lsNodeName.length, // and its length
+						nodeNameId, // and its symbol
 						nullptr, // not a text node
+						0, // so no text length either
 						parent,	// set parent node
-						std::vector<Node> {}	// surely no children - never will be any!
+						ChildList()	// surely no children - never will be any!
 				});
+				TBUF_STAT(++stats.nodesByKind[(int)NodeKind::NORM]; stats.bytesScanned += lsNodeName.length);
 				// We can keep the earlier parent as this node was an empty leaf
 				// Further nodes cannot be below an emtpy one of course...
 				return parent;
@@ -847,5 +2327,258 @@ printf("(!) Found an empty-leaf sub-node with name: %s below %s(%u)\n", nodeName
 	}
 };
 
+#ifdef TBUF_STATS
+inline TreeStats* statsOf(Node &node) {
+	return (node.children.pool != nullptr) ? &node.children.pool->tree->stats : nullptr;
+}
+#endif
+
+inline Node* Node::descend(const LevelDescender &ld) {
+	TBUF_STAT(if(TreeStats *stats = statsOf(*this)) ++stats->descends);
+	if((children.pool != nullptr) && (children.size() >= CHILD_INDEX_MIN_FANOUT)) {
+		return children.pool->tree->descendIndexed(children, ld);
+	}
+	int foundIndex = -1;
+	if(!ld.adHocPolymorph && (children.pool != nullptr)) {
+		// Simple lookup: the name is resolved once and only the IDs are compared
+		// Rem.: Lazy children must be parsed first as their names might not be in the table yet!
+		children.ensure();
+		uint32_t targetId = ld.resolveIn(children.pool->tree->symbolTable());
+		if(targetId == NO_SYMBOL) {
+			// No node has that name in the whole tree
+			return nullptr;
+		}
+		for(Node &child : children) {
+			TBUF_STAT(++statsOf(*this)->descendComparisons);
+			if(child.core.nameId == targetId) {
+				++foundIndex;	// update at-indexing
+				if(foundIndex == ld.targetIndex) {
+					return &child;
+				}
+			}
+		}
+		return nullptr;
+	}
+	for(Node &child : children) {
+		TBUF_STAT(if(TreeStats *stats = statsOf(*this)) ++stats->descendComparisons);
+#ifdef DEBUG_LOG
+printf(" -- Trying child with name:%.*s against target name: %s\n", child.core.nameLength, child.core.name, ld.targetName.c_str());
+#endif
+		// Rem.: names are not always zero terminated so we compare using the lengths
+		if(ld.adHocPolymorph ?
+				((child.core.nameLength >= ld.targetName.length()) &&
+				 !memcmp(child.core.name, ld.targetName.c_str(), ld.targetName.length())) :
+				((child.core.nameLength == ld.targetName.length()) &&
+				 !memcmp(child.core.name, ld.targetName.c_str(), child.core.nameLength))) {
+			// Found a possible child - only possible because of at-indexing though...
+			++foundIndex;	// update at-indexing
+			if(foundIndex == ld.targetIndex) {
+				return &child;
+			}
+		}
+	}
+
+	// Didn't found any child for this descriptor...
+	return nullptr;
+}
+
+inline Node* Node::descend(const PathLevel &level) {
+	TBUF_STAT(if(TreeStats *stats = statsOf(*this)) ++stats->descends);
+	if((children.pool != nullptr) && (children.size() >= CHILD_INDEX_MIN_FANOUT)) {
+		return children.pool->tree->descendIndexed(children, level);
+	}
+	int foundIndex = -1;
+	if(!level.prefix && (children.pool != nullptr)) {
+		// The hash is from compile time so the lookup is one probe and then an integer compare per child
+		children.ensure();
+		uint32_t targetId = children.pool->tree->symbolTable().find(level.name, level.length, level.hash);
+		if(targetId == NO_SYMBOL) {
+			return nullptr;
+		}
+		for(Node &child : children) {
+			TBUF_STAT(++statsOf(*this)->descendComparisons);
+			if((child.core.nameId == targetId) && (++foundIndex == level.index)) {
+				return &child;
+			}
+		}
+		return nullptr;
+	}
+	for(Node &child : children) {
+		TBUF_STAT(if(TreeStats *stats = statsOf(*this)) ++stats->descendComparisons);
+		if((child.core.nameLength >= level.length) && !memcmp(child.core.name, level.name, level.length) &&
+				(level.prefix || (child.core.nameLength == level.length)) && (++foundIndex == level.index)) {
+			return &child;
+		}
+	}
+	return nullptr;
+}
+
+inline Node* Node::firstChild() {
+	return &(*children.pool)[children.first];
+}
+
+inline Node* Node::nextSiblingNode() {
+	// Rem.: The pool of our children is the pool of the tree we are in
+	return &(*children.pool)[nextSibling];
+}
+
+template<class Visitor>
+inline bool Node::dfs_preorder(Visitor &&visitor) {
+	Node *node = this;
+	unsigned int depth = 0;
+	while(true) {
+		// Rem.: Checking for the children parses them in case of lazy trees
+		bool leaf = node->children.empty();
+		VisitResult result = visit(visitor, node->core, depth, leaf);
+		if(result == VisitResult::STOP) {
+			return false;
+		}
+		if(!leaf && (result != VisitResult::SKIP_CHILDREN)) {
+			node = node->firstChild();
+			++depth;
+			continue;
+		}
+		// Go to the next sibling - or up until there is one without leaving our subtree
+		while(true) {
+			if(node == this) {
+				return true;
+			}
+			if(node->nextSibling != NO_NODE) {
+				node = node->nextSiblingNode();
+				break;
+			}
+			node = node->parent;
+			--depth;
+		}
+	}
+}
+
+template<class Visitor>
+inline bool Node::dfs_postorder(Visitor &&visitor) {
+	Node *node = this;
+	unsigned int depth = 0;
+	while(true) {
+		// Go down to the first leaf
+		while(!node->children.empty()) {
+			node = node->firstChild();
+			++depth;
+		}
+		// Visit the leaf, then every parent that has no more children to visit
+		while(true) {
+			if(visit(visitor, node->core, depth, node->children.empty()) == VisitResult::STOP) {
+				return false;
+			}
+			if(node == this) {
+				return true;
+			}
+			if(node->nextSibling != NO_NODE) {
+				node = node->nextSiblingNode();
+				break;
+			}
+			node = node->parent;
+			--depth;
+		}
+	}
+}
+
+inline Node& ChildList::iterator::operator*() const {
+	return (*pool)[index];
+}
+
+inline Node* ChildList::iterator::operator->() const {
+	return &(*pool)[index];
+}
+
+inline ChildList::iterator& ChildList::iterator::operator++() {
+	index = (*pool)[index].nextSibling;
+	return *this;
+}
+
+inline Node& ChildList::operator[](size_t i) const {
+	ensure();
+	if(i + 1 == count) {
+		return (*pool)[last];
+	}
+	// Continue from the last indexed position when we can
+	if((cachedIndex == NO_NODE) || (i < cachedPos)) {
+		cachedPos = 0;
+		cachedIndex = first;
+	}
+	while(cachedPos < i) {
+		cachedIndex = (*pool)[cachedIndex].nextSibling;
+		++cachedPos;
+	}
+	return (*pool)[cachedIndex];
+}
+
+inline Node& ChildList::back() const {
+	ensure();
+	return (*pool)[last];
+}
+
+inline Node& ChildList::front() const {
+	ensure();
+	return (*pool)[first];
+}
+
+inline void ChildList::push_back(const Node &node) {
+	ensure();
+	pool->tree->addToList(*this, node);
+}
+
+inline void ChildList::link(uint32_t index) {
+	(*pool)[index].nextSibling = NO_NODE;
+	if(count == 0) {
+		first = index;
+	} else {
+		(*pool)[last].nextSibling = index;
+	}
+	last = index;
+	++count;
+}
+
+inline void ChildList::splice(ChildList &other) {
+	ensure();
+	other.ensure();
+	if(other.count == 0) {
+		return;
+	}
+	// The positions of the children change so their indices are not valid anymore
+	pool->tree->dropChildIndex(*this);
+	pool->tree->dropChildIndex(other);
+	if(count == 0) {
+		first = other.first;
+	} else {
+		(*pool)[last].nextSibling = other.first;
+	}
+	last = other.last;
+	count += other.count;
+	other.first = NO_NODE;
+	other.last = NO_NODE;
+	other.count = 0;
+	other.cachedIndex = NO_NODE;
+}
+
+inline void ChildList::materialize() const {
+	// The lazy list knows the pool index of its node - so copies of the list find the same node too
+	Tree *tree = pool->tree;
+	Node &owner = (cachedIndex == NO_NODE) ? tree->root : (*pool)[cachedIndex];
+	ChildList &list = owner.children;
+	if(list.count == LAZY_COUNT) {
+		uint32_t begin = list.first;
+		uint32_t end = list.last;
+		list.first = NO_NODE;
+		list.last = NO_NODE;
+		list.count = 0;
+		list.cachedPos = 0;
+		list.cachedIndex = NO_NODE;
+		tree->materializeChildren(owner, begin, end);
+	}
+	// Rem.: A copy of the list just takes the parsed children of the node (those are never really const)
+	if(this != &list) {
+		*const_cast<ChildList*>(this) = list;
+	}
+}
+
 } // tbuf namespace ends here
 #endif // TURBO_BUF_H
@@ -0,0 +1,474 @@
+// tbuf_binary.h: Compact binary encoding of turbo-buf trees - for the hops where nobody reads the messages.
+
+#ifndef TURBO_BUF_BINARY_H
+#define TURBO_BUF_BINARY_H
+
+#include<cstdint>
+#include<cstring>
+#include<memory>
+#include<string>
+#include<utility>
+#include<vector>
+#include"fio.h"
+#include"tbuf.h"
+#include"tbuf_symbols.h"
+
+namespace tbuf {
+
+/** The first bytes of every binary encoded message */
+const char BINARY_MAGIC[] = "TBB1";
+const unsigned int BINARY_MAGIC_LENGTH = 4;
+
+/**
+ * Encodes trees into a compact binary form and decodes them back - exactly: the text form written from the
+ * decoded tree is the same as the one written from the original tree. The encoding is:
+ *
+ *   "TBB1"
+ *   varint nameCount, nodeCount (without the root), digitCount (of all nodes), textLength (of all text nodes)
+ *   nameCount times: varint length, the characters of the name
+ *   the root and then every node in preorder:
+ *     varint tag = (name << 2) | HAS_CHILDREN | IS_TEXT	- name is the index in the name table
+ *     text nodes:   varint length, the characters of the text (unescaped)
+ *     other nodes:  varint digits, the packed nibbles (two per byte, an odd count has a leading zero nibble)
+ *                   and if HAS_CHILDREN: varint childCount followed by the children
+ *
+ * Varints are the usual little-endian base-128 ones. Names are stored only once and the hexes take half the space
+ * so messages with repeated names and long hexes get roughly half as big. Decoding never looks for braces or
+ * escapes: the lengths and the child counts tell where everything is.
+ */
+class BinaryCodec {
+public:
+	/**
+	 * Encodes the tree (or subtree) from the given node into the output (a subclass of fio::Output).
+	 * The given node becomes the root of the decoded tree. Returns false on output errors.
+	 */
+	template<class OutputSubClass>
+	static bool encode(Node &root, OutputSubClass &out) {
+		// First pass: the name table and the totals for the header
+		SymbolTable names;
+		std::vector<uint32_t> nameOfSymbol;
+		uint64_t nodeCount = 0, digitCount = 0, textLength = 0;
+		preorder(root, [&] (Node &node) {
+			nameIndexOf(node.core, names, nameOfSymbol);
+			++nodeCount;
+			if(node.core.nodeKind != NodeKind::TEXT) {
+				digitCount += node.core.data.digits.length;
+			} else if(&node != &root) {
+				textLength += node.core.textLength;
+			}
+		});
+		Sink<OutputSubClass> sink(out);
+		sink.put(BINARY_MAGIC, BINARY_MAGIC_LENGTH);
+		sink.varint(names.size());
+		sink.varint(nodeCount - 1);
+		sink.varint(digitCount);
+		sink.varint(textLength);
+		for(uint32_t i = 0; i < names.size(); ++i) {
+			sink.varint(names.lengthOf(i));
+			sink.put(names.nameOf(i), names.lengthOf(i));
+		}
+		// Second pass: the nodes
+		preorder(root, [&] (Node &node) {
+			NodeCore &nc = node.core;
+			// Rem.: The root of the decoded tree cannot be a text node so a text node as root is written as an empty node
+			bool isText = (nc.nodeKind == NodeKind::TEXT) && (&node != &root);
+			bool hasChildren = !isText && !node.children.empty();
+			uint64_t name = nameIndexOf(nc, names, nameOfSymbol);
+			sink.varint((name << 2) | (hasChildren ? HAS_CHILDREN : 0) | (isText ? IS_TEXT : 0));
+			if(isText) {
+				sink.varint(nc.textLength);
+				// Rem.: Empty texts are nullptr
+				if(nc.textLength > 0) {
+					sink.put(nc.text, nc.textLength);
+				}
+			} else if(nc.nodeKind == NodeKind::TEXT) {
+				sink.varint(0);
+			} else {
+				sink.varint(nc.data.digits.length);
+				sink.packed(nc.data);
+				if(hasChildren) {
+					sink.varint(node.children.size());
+				}
+			}
+		});
+		sink.drain();
+		return out.isGood();
+	}
+
+	/** Encodes the tree (or subtree) from the given node into a string */
+	static std::string encode(Node &root) {
+		fio::MemoryOutput out;
+		encode(root, out);
+		return out.str();
+	}
+
+	/**
+	 * Decodes the message into a new tree - or returns nullptr when the message is not a valid encoding.
+	 * When canReferMemoryFromInput is true, the names and texts point right into the message (and they are NOT zero
+	 * terminated) so the message must outlive the tree. Otherwise everything is copied. The hexes are always owned
+	 * by the tree as they need to be unpacked.
+	 */
+	static std::unique_ptr<Tree> decode(fio::LenString message, bool canReferMemoryFromInput = false) {
+		std::unique_ptr<Tree> tree(new Tree());
+		TreeBuilder builder(*tree, canReferMemoryFromInput);
+		if(!parse(message, builder)) {
+			return nullptr;
+		}
+		return tree;
+	}
+
+	/**
+	 * Decodes the message without building a tree: calls visitor(NodeCore &node, unsigned int depth, bool leaf) for
+	 * every node in preorder - just like Node::dfs_preorder does. The node is only valid during the call and the
+	 * names and texts are not zero terminated. Returns false when the message is not a valid encoding (the visitor
+	 * might have been called for the nodes before the error) or the visitor returned VisitResult::STOP.
+	 * Rem.: The children of the node are in the message anyways so SKIP_CHILDREN is the same as CONTINUE here.
+	 */
+	template<class Visitor>
+	static bool walk(fio::LenString message, Visitor &&visitor) {
+		Walker<Visitor> walker{visitor};
+		return parse(message, walker);
+	}
+
+private:
+	static const uint64_t IS_TEXT = 1;
+	static const uint64_t HAS_CHILDREN = 2;
+
+	/** Calls f(Node&) for the node and every node below it in preorder (with the same stackless walk as the dfs) */
+	template<class F>
+	static void preorder(Node &root, F &&f) {
+		Node *node = &root;
+		while(true) {
+			f(*node);
+			if(!node->children.empty()) {
+				node = node->firstChild();
+				continue;
+			}
+			while(true) {
+				if(node == &root) {
+					return;
+				}
+				if(node->nextSibling != NO_NODE) {
+					node = node->nextSiblingNode();
+					break;
+				}
+				node = node->parent;
+			}
+		}
+	}
+
+	/** Returns the index of the name of the node in our name table - adding it when it is new */
+	static uint32_t nameIndexOf(NodeCore &nc, SymbolTable &names, std::vector<uint32_t> &nameOfSymbol) {
+		if(nc.nameId == NO_SYMBOL) {
+			return names.intern(fio::LenString{nc.nameLength, (char*)nc.name}, false);
+		}
+		// Most names are cached by the symbol IDs of the tree so we rarely hash
+		if(nc.nameId >= nameOfSymbol.size()) {
+			nameOfSymbol.resize(nc.nameId + 1, NO_SYMBOL);
+		}
+		uint32_t &cached = nameOfSymbol[nc.nameId];
+		if(cached == NO_SYMBOL) {
+			cached = names.intern(fio::LenString{nc.nameLength, (char*)nc.name}, false);
+		}
+		return cached;
+	}
+
+	/** A small buffered writer for the encoding */
+	template<class OutputSubClass>
+	struct Sink {
+		static const unsigned int BUFFER_SIZE = 64 * 1024;
+		OutputSubClass &out;
+		std::unique_ptr<char[]> buffer;
+		unsigned int used;
+
+		Sink(OutputSubClass &output) : out(output), buffer(new char[BUFFER_SIZE]), used(0) {}
+
+		inline void drain() {
+			if(used > 0) {
+				out.write(buffer.get(), used);
+				used = 0;
+			}
+		}
+
+		inline void put(const char *p, size_t length) {
+			if(used + length > BUFFER_SIZE) {
+				drain();
+				if(length > BUFFER_SIZE) {
+					out.write(p, length);
+					return;
+				}
+			}
+			memcpy(buffer.get() + used, p, length);
+			used += length;
+		}
+
+		inline void varint(uint64_t value) {
+			if(used + 10 > BUFFER_SIZE) {
+				drain();
+			}
+			char *p = buffer.get() + used;
+			while(value >= 0x80) {
+				*p++ = (char)((value & 0x7F) | 0x80);
+				value >>= 7;
+			}
+			*p++ = (char)value;
+			used = (unsigned int)(p - buffer.get());
+		}
+
+		/** Writes the hexes as packed nibbles */
+		inline void packed(const Hexes &hexes) {
+			size_t bytes = hexes.byteLength();
+			if(bytes == 0) {
+				return;
+			}
+			if(used + bytes > BUFFER_SIZE) {
+				drain();
+			}
+			if(bytes > BUFFER_SIZE) {
+				std::vector<uint8_t> big(bytes);
+				hexes.decodeBytes(&big[0], bytes);
+				out.write((const char*)&big[0], bytes);
+				return;
+			}
+			// Rem.: Hexes of trees are always valid so this cannot fail
+			hexes.decodeBytes((uint8_t*)buffer.get() + used, bytes);
+			used += bytes;
+		}
+	};
+
+	/** Reading varints and such from the message - every read fails instead of reading after the end */
+	struct Reader {
+		const uint8_t *p;
+		const uint8_t *end;
+
+		inline bool varint(uint64_t &value) {
+			value = 0;
+			for(unsigned int shift = 0; shift < 64; shift += 7) {
+				if(p == end) {
+					return false;
+				}
+				uint8_t b = *p++;
+				value |= (uint64_t)(b & 0x7F) << shift;
+				if(b < 0x80) {
+					return true;
+				}
+			}
+			return false;
+		}
+
+		/** Reads a varint that should be a length of the bytes that follow */
+		inline bool length(uint32_t &value) {
+			uint64_t v;
+			if(!varint(v) || (v > (uint64_t)(end - p))) {
+				return false;
+			}
+			value = (uint32_t)v;
+			return true;
+		}
+
+		inline const char* take(uint32_t n) {
+			const char *taken = (const char*)p;
+			p += n;
+			return taken;
+		}
+	};
+
+	/** The header and the name table of a message */
+	struct Header {
+		uint64_t nodeCount;
+		uint64_t digitCount;
+		uint64_t textLength;
+		std::vector<fio::LenString> names;
+	};
+
+	/** Unpacks the nibbles into hex digits */
+	static void unpack(const uint8_t *packed, uint32_t digits, char *out) {
+		static const char *HEX = "0123456789ABCDEF";
+		if((digits % 2) == 1) {
+			*out++ = HEX[*packed++ & 0xF];
+			--digits;
+		}
+		for(uint32_t i = 0; i < digits; i += 2) {
+			uint8_t b = *packed++;
+			*out++ = HEX[b >> 4];
+			*out++ = HEX[b & 0xF];
+		}
+	}
+
+	/**
+	 * Parses the message and calls the handler: begin(const Header&) once, then node(...) for every node in preorder.
+	 * Returns false on malformed messages or when the handler returns false.
+	 */
+	template<class Handler>
+	static bool parse(fio::LenString message, Handler &handler) {
+		Reader r{(const uint8_t*)message.startPtr, (const uint8_t*)message.startPtr + message.length};
+		if((message.length < BINARY_MAGIC_LENGTH) || memcmp(message.startPtr, BINARY_MAGIC, BINARY_MAGIC_LENGTH) != 0) {
+			return false;
+		}
+		r.p += BINARY_MAGIC_LENGTH;
+		Header h;
+		uint64_t nameCount;
+		if(!r.varint(nameCount) || !r.varint(h.nodeCount) || !r.varint(h.digitCount) || !r.varint(h.textLength)) {
+			return false;
+		}
+		// Every name and node takes at least one byte so bigger counts are surely errors (and would allocate too much)
+		if((nameCount > message.length) || (h.nodeCount > message.length) ||
+		   (h.digitCount > 2 * (uint64_t)message.length) || (h.textLength > message.length)) {
+			return false;
+		}
+		h.names.reserve(nameCount);
+		for(uint64_t i = 0; i < nameCount; ++i) {
+			uint32_t length;
+			if(!r.length(length)) {
+				return false;
+			}
+			h.names.push_back(fio::LenString{length, (char*)r.take(length)});
+		}
+		if(!handler.begin(h)) {
+			return false;
+		}
+		// The number of children left at every depth (the root is the only one at depth zero)
+		std::vector<uint64_t> left{1};
+		uint64_t nodes = 0, digitsSeen = 0, textSeen = 0;
+		while(!left.empty()) {
+			if(left.back() == 0) {
+				left.pop_back();
+				continue;
+			}
+			--left.back();
+			unsigned int depth = (unsigned int)left.size() - 1;
+			uint64_t tag;
+			if(!r.varint(tag) || ((tag >> 2) >= h.names.size()) || (++nodes > h.nodeCount + 1)) {
+				return false;
+			}
+			const fio::LenString &name = h.names[tag >> 2];
+			if(tag & IS_TEXT) {
+				uint32_t length;
+				if(!r.length(length)) {
+					return false;
+				}
+				textSeen += length;
+				if((tag & HAS_CHILDREN) || (textSeen > h.textLength)) {
+					return false;
+				}
+				// Rem.: Empty texts are nullptr - just like in the parsed trees
+				const char *text = r.take(length);
+				if(!handler.node(NodeKind::TEXT, name, nullptr, 0, (length > 0) ? text : nullptr, length, depth, true)) {
+					return false;
+				}
+				continue;
+			}
+			uint64_t length;
+			// Rem.: Checked before any arithmetic so that huge lengths cannot overflow past the checks
+			if(!r.varint(length) || (length > h.digitCount - digitsSeen) || (length > 2 * (uint64_t)(r.end - r.p)) ||
+					(length > UINT32_MAX)) {
+				return false;
+			}
+			uint32_t bytes = (uint32_t)((length + 1) / 2);
+			digitsSeen += length;
+			const uint8_t *packed = (const uint8_t*)r.take(bytes);
+			uint64_t children = 0;
+			if((tag & HAS_CHILDREN) && (!r.varint(children) || (children == 0) || (children > h.nodeCount))) {
+				return false;
+			}
+			NodeKind kind = (depth == 0) ? NodeKind::ROOT : NodeKind::NORM;
+			if(!handler.node(kind, name, packed, (uint32_t)length, nullptr, 0, depth, children == 0)) {
+				return false;
+			}
+			if(children > 0) {
+				left.push_back(children);
+			}
+		}
+		// Everything should be used up exactly
+		return (r.p == r.end) && (nodes == h.nodeCount + 1) && (digitsSeen == h.digitCount) && (textSeen == h.textLength);
+	}
+
+	/** Handler that builds a tree */
+	struct TreeBuilder {
+		Tree &tree;
+		bool refer;
+		/** The tree-owned memory of the unpacked hexes (and the copied texts) */
+		char *strings = nullptr;
+		/** The last node at every depth - the parents of the next nodes */
+		std::vector<Node*> parents;
+		uint32_t nextIndex = 0;
+
+		TreeBuilder(Tree &t, bool canReferMemoryFromInput) : tree(t), refer(canReferMemoryFromInput) {}
+
+		inline bool begin(const Header &h) {
+			size_t size = h.digitCount + (refer ? 0 : h.textLength);
+			if(size > 0) {
+				tree.treeBlocks.push_back(std::unique_ptr<char[]>(new char[size]));
+				strings = tree.treeBlocks.back().get();
+			}
+			// Rem.: The pool grows once for every node just like for the structural index
+			if(h.nodeCount > 0) {
+				nextIndex = tree.pool.grow((uint32_t)h.nodeCount);
+			}
+			return true;
+		}
+
+		inline bool node(NodeKind kind, const fio::LenString &name, const uint8_t *packed, uint32_t digits,
+				const char *text, uint32_t textLength, unsigned int depth, bool leaf) {
+			Hexes hexes = Hexes::EMPTY_HEXES();
+			if(digits > 0) {
+				unpack(packed, digits, strings);
+				hexes = Hexes{fio::LenString{digits, strings}};
+				strings += digits;
+			}
+			if((text != nullptr) && !refer) {
+				memcpy(strings, text, textLength);
+				text = strings;
+				strings += textLength;
+			}
+			uint32_t nameId = tree.symbols.intern(name, !refer);
+			const char *keptName = refer ? name.startPtr : tree.symbols.nameOf(nameId);
+			Node *node;
+			if(depth == 0) {
+				// Rem.: The root keeps its special name
+				tree.root.core.data = hexes;
+				node = &tree.root;
+			} else {
+				node = new (&tree.pool[nextIndex]) Node();
+				*node = Node{kind, hexes, keptName, name.length, nameId, text, textLength, parents[depth - 1], ChildList(&tree.pool)};
+				parents[depth - 1]->children.link(nextIndex);
+				++nextIndex;
+			}
+			if(parents.size() <= depth) {
+				parents.resize(depth + 1);
+			}
+			parents[depth] = node;
+			return true;
+		}
+	};
+
+	/** Handler that calls a dfs-like visitor */
+	template<class Visitor>
+	struct Walker {
+		Visitor &visitor;
+		/** The unpacked hexes of the current node */
+		std::vector<char> digitBuffer;
+
+		inline bool begin(const Header &h) {
+			return true;
+		}
+
+		inline bool node(NodeKind kind, const fio::LenString &name, const uint8_t *packed, uint32_t digits,
+				const char *text, uint32_t textLength, unsigned int depth, bool leaf) {
+			Hexes hexes = Hexes::EMPTY_HEXES();
+			if(digits > 0) {
+				if(digitBuffer.size() < digits) {
+					digitBuffer.resize(digits);
+				}
+				unpack(packed, digits, &digitBuffer[0]);
+				hexes = Hexes{fio::LenString{digits, &digitBuffer[0]}};
+			}
+			NodeCore nc{kind, hexes, name.startPtr, name.length, NO_SYMBOL, text, textLength};
+			return Node::visit(visitor, nc, depth, leaf) != VisitResult::STOP;
+		}
+	};
+};
+
+} // end of namespace tbuf
+
+#endif // TURBO_BUF_BINARY_H
@@ -1,6 +1,8 @@
 #ifndef TURBO_BUF_DATA_H
 #define TURBO_BUF_DATA_H
 
+#include<cstdint>
+#include<type_traits>
 #include<memory>
 #include<vector>
 #include<cstdio>
@@ -11,12 +13,19 @@
 #include<unordered_set>
 #include"fio_data.h"
 
+#ifdef __SSE2__
+#include<emmintrin.h>
+#endif
+
 // Uncomment this if we want to see the debug logging
 // Or even better: define this before including us...
 //#define DEBUG_LOG 1
 
 namespace tbuf {
 
+template<class T>
+class HexArray;
+
 /** Hex-data stream class */
 class Hexes {
 public:
@@ -25,26 +34,113 @@ public:
 	 */
 	fio::LenString digits;
 
-	/** Try to return the integral representation of this hex stream if possible */
-	inline unsigned long long asIntegral() {
-		// This could be optimized to do 4byte or 8byte processing in loop I think...
-		long long result = 0;
+	/** Try to return the integral representation of this hex stream if possible (only the lowest 64 bits) */
+	inline unsigned long long asIntegral() const {
+		uint64_t result = 0;
+		const char *p = digits.startPtr;
 		unsigned int len = digits.length;
-		for(unsigned int i = 0; i < len; ++i) {
-			result = (result << 4) + Hexes::hexValueOf(digits.startPtr[i]);
+		// The first chunk is the partial one so that every other has exactly 8 digits
+		unsigned int first = len % 8;
+		if(first > 0) {
+			result = chunkValue(paddedChunk(p, first));
+			p += first;
+			len -= first;
+		}
+		for(; len > 0; p += 8, len -= 8) {
+			result = (result << 32) | chunkValue(loadChunk(p));
 		}
 		return result;
 	}
 
-	/** Try to return the unsigned int representation of this hex stream if possible */
-	inline unsigned int asUint() {
-		// This could be optimized to do 4byte or 8byte processing in loop I think...
-		unsigned int result = 0;
+	/** Try to return the unsigned int representation of this hex stream if possible (only the lowest 32 bits) */
+	inline unsigned int asUint() const {
+		return (unsigned int)asIntegral();
+	}
+
+	/**
+	 * Decodes the hexes as an unsigned 64 bit integer into value. Returns false when a character is not a hex
+	 * digit or the value does not fit in 64 bits (leading zeros are fine). Validation happens in the same pass.
+	 */
+	inline bool asUint64(uint64_t &value) const {
+		value = 0;
+		const char *p = digits.startPtr;
 		unsigned int len = digits.length;
-		for(unsigned int i = 0; i < len; ++i) {
-			result = (result << 4) + Hexes::hexValueOf(digits.startPtr[i]);
+		// Skip the leading zeros 8 at a time (then one at a time)
+		uint64_t zeros;
+		memset(&zeros, '0', sizeof(zeros));
+		while((len > 16) && (loadChunk(p) == zeros)) {
+			p += 8;
+			len -= 8;
 		}
-		return result;
+		while((len > 16) && (*p == '0')) {
+			++p;
+			--len;
+		}
+		if(len > 16) {
+			// More than 16 significant digits: overflow
+			return false;
+		}
+		uint64_t result = 0;
+		unsigned int first = len % 8;
+		if(first > 0) {
+			uint64_t chunk = paddedChunk(p, first);
+			if(!isHexChunk(chunk)) return false;
+			result = chunkValue(chunk);
+			p += first;
+			len -= first;
+		}
+		for(; len > 0; p += 8, len -= 8) {
+			uint64_t chunk = loadChunk(p);
+			if(!isHexChunk(chunk)) return false;
+			result = (result << 32) | chunkValue(chunk);
+		}
+		value = result;
+		return true;
+	}
+
+	/** Returns the number of bytes the hexes represent (an odd number of hexes has an implicit leading zero) */
+	inline size_t byteLength() const {
+		return (digits.length + 1) / 2;
+	}
+
+	/** Returned by decodeBytes when the hexes are not valid or the output is too small */
+	static const size_t DECODE_ERROR = (size_t)-1;
+
+	/**
+	 * Decodes the hexes into bytes (most significant first, like the hexes) and returns the number of bytes written.
+	 * Returns DECODE_ERROR when a character is not a hex digit or cap is less than byteLength() - the contents of
+	 * out are undefined in that case. Validation happens in the same pass: 16 hexes at a time with SSE2.
+	 */
+	inline size_t decodeBytes(uint8_t *out, size_t cap) const {
+		size_t bytes = byteLength();
+		if(cap < bytes) {
+			return DECODE_ERROR;
+		}
+		const char *p = digits.startPtr;
+		unsigned int len = digits.length;
+		uint8_t *o = out;
+		if((len % 2) == 1) {
+			// The implicit leading zero
+			if(!isHexCharacter(*p)) return DECODE_ERROR;
+			*o++ = hexValueOf(*p++);
+			--len;
+		}
+#ifdef __SSE2__
+		for(; len >= 16; p += 16, len -= 16, o += 8) {
+			if(!decode16(p, o)) return DECODE_ERROR;
+		}
+#endif
+		for(; len >= 8; p += 8, len -= 8, o += 4) {
+			uint64_t chunk = loadChunk(p);
+			if(!isHexChunk(chunk)) return DECODE_ERROR;
+			uint32_t packed = chunkBytes(chunk);
+			memcpy(o, &packed, 4);
+		}
+		for(; len > 0; p += 2, len -= 2) {
+			if(!isHexCharacter(p[0]) || !isHexCharacter(p[1])) return DECODE_ERROR;
+			*o++ = (hexValueOf(p[0]) << 4) | hexValueOf(p[1]);
+		}
+		return bytes;
 	}
 
 	inline bool isEmpty() {
@@ -76,8 +172,199 @@ public:
 	inline static Hexes EMPTY_HEXES() {
 	       return	{{0, nullptr}};
 	}
+
+	/**
+	 * Returns a view of the hexes as an array of fixed-width unsigned integers: every digitsPerElem hexes are one
+	 * element (like the '<hex>*N' fields of tbnf). The default is the natural width: 2 hexes per byte of T.
+	 * The view is invalid (and empty) when the number of hexes is not a multiple of digitsPerElem or when that many
+	 * hexes might not fit into T. See HexArray for the element access and the bulk decoders.
+	 */
+	template<class T>
+	inline HexArray<T> asArray(unsigned int digitsPerElem = 2 * sizeof(T)) const;
+
+private:
+	template<class T>
+	friend class HexArray;
+
+	// SWAR (SIMD within a register) helpers: 8 hex characters are handled in one 64 bit integer where the byte
+	// i is the i-th character. Rem.: This needs a little-endian machine like every x86 or usual ARM ones!
+	static const uint64_t ONES = 0x0101010101010101ULL;
+	static const uint64_t HIGHS = 0x8080808080808080ULL;
+
+	/** Loads 8 characters */
+	inline static uint64_t loadChunk(const char *p) {
+		uint64_t chunk;
+		memcpy(&chunk, p, sizeof(chunk));
+		return chunk;
+	}
+
+	/** Loads the last n (less than 8) characters right-aligned and pads them with leading '0' characters */
+	inline static uint64_t paddedChunk(const char *p, unsigned int n) {
+		char padded[8];
+		memset(padded, '0', sizeof(padded));
+		memcpy(padded + 8 - n, p, n);
+		return loadChunk(padded);
+	}
+
+	/** Sets the high bit of the bytes that are in the (m, n) range - every byte should be less than 128 */
+	inline static uint64_t bytesBetween(uint64_t chunk, uint64_t m, uint64_t n) {
+		uint64_t low7 = chunk & (ONES * 127);
+		return ((ONES * (127 + n) - low7) & ~chunk & (low7 + ONES * (127 - m))) & HIGHS;
+	}
+
+	/** Tells if all 8 characters are among ['0'..'9'] or ['A'..'F'] */
+	inline static bool isHexChunk(uint64_t chunk) {
+		return ((chunk & HIGHS) == 0) &&
+		       ((bytesBetween(chunk, '0' - 1, '9' + 1) | bytesBetween(chunk, 'A' - 1, 'F' + 1)) == HIGHS);
+	}
+
+	/** Returns the 4 bytes of the 8 hexes in memory order (so the first character is in the lowest byte) */
+	inline static uint32_t chunkBytes(uint64_t chunk) {
+		// The nibble values: the low 4 bits plus 9 for the letters (which have the 0x40 bit set)
+		uint64_t nibbles = (chunk & (ONES * 0x0F)) + ((chunk >> 6) & ONES) * 9;
+		// Join the neighbouring nibbles, then the bytes, then the 16 bit parts
+		uint64_t bytes = ((nibbles << 4) | (nibbles >> 8)) & 0x00FF00FF00FF00FFULL;
+		bytes = (bytes | (bytes >> 8)) & 0x0000FFFF0000FFFFULL;
+		return (uint32_t)(bytes | (bytes >> 16));
+	}
+
+	/** Returns the value of the 8 hexes */
+	inline static uint32_t chunkValue(uint64_t chunk) {
+		return __builtin_bswap32(chunkBytes(chunk));
+	}
+
+	/** Decodes n (at most 16) hexes into value - returns false if any of them is not a hex digit */
+	inline static bool decodeShort(const char *p, unsigned int n, uint64_t &value) {
+		uint64_t high = 0;
+		if(n > 8) {
+			uint64_t chunk = paddedChunk(p, n - 8);
+			if(!isHexChunk(chunk)) return false;
+			high = chunkValue(chunk);
+			p += n - 8;
+			n = 8;
+		}
+		uint64_t chunk = (n == 8) ? loadChunk(p) : paddedChunk(p, n);
+		if(!isHexChunk(chunk)) return false;
+		value = (high << 32) | chunkValue(chunk);
+		return true;
+	}
+
+#ifdef __SSE2__
+	/** Decodes 16 hexes into 8 bytes at out - returns false if any character is not a hex digit */
+	inline static bool decode16(const char *p, uint8_t *out) {
+		__m128i v = _mm_loadu_si128((const __m128i*)p);
+		// Range checks with unsigned minimums: x is in [0, max] exactly when min(x, max) == x
+		__m128i d = _mm_sub_epi8(v, _mm_set1_epi8('0'));
+		__m128i h = _mm_sub_epi8(v, _mm_set1_epi8('A'));
+		__m128i isDigit = _mm_cmpeq_epi8(_mm_min_epu8(d, _mm_set1_epi8(9)), d);
+		__m128i isHexit = _mm_cmpeq_epi8(_mm_min_epu8(h, _mm_set1_epi8(5)), h);
+		if(_mm_movemask_epi8(_mm_or_si128(isDigit, isHexit)) != 0xFFFF) {
+			return false;
+		}
+		// The nibble values, then the pairs joined in the 16 bit lanes and packed to bytes
+		__m128i nibbles = _mm_or_si128(_mm_and_si128(isDigit, d), _mm_and_si128(isHexit, _mm_add_epi8(h, _mm_set1_epi8(10))));
+		__m128i pairs = _mm_or_si128(_mm_slli_epi16(nibbles, 4), _mm_srli_epi16(nibbles, 8));
+		pairs = _mm_and_si128(pairs, _mm_set1_epi16(0x00FF));
+		_mm_storel_epi64((__m128i*)out, _mm_packus_epi16(pairs, pairs));
+		return true;
+	}
+#endif
 };
 
+/**
+ * A view of hexes as an array of fixed-width unsigned integers (see Hexes::asArray). The view refers the memory of
+ * the hexes so it is only valid as long as those are (for tree nodes: as long as the tree is alive).
+ */
+template<class T>
+class HexArray {
+	static_assert(std::is_unsigned<T>::value && (sizeof(T) <= 8), "HexArray elements should be unsigned integers!");
+public:
+	/** Create an invalid (empty) view */
+	HexArray() : digits{nullptr}, count{0}, digitsPerElem{0} {}
+
+	/** Create a view of count elements of digitsPerElem hexes each */
+	HexArray(const char *_digits, size_t _count, unsigned int _digitsPerElem) :
+		digits{_digits}, count{_count}, digitsPerElem{_digitsPerElem} {}
+
+	/** Tells if the hexes could be viewed as an array of this kind */
+	inline bool isValid() const { return digitsPerElem != 0; }
+
+	/** Returns the number of elements */
+	inline size_t size() const { return count; }
+
+	/** Returns the i-th element without validation (invalid characters give some undefined value) */
+	inline T operator[](size_t i) const {
+		uint64_t value = 0;
+		Hexes::decodeShort(digits + i * digitsPerElem, digitsPerElem, value);
+		return (T)value;
+	}
+
+	/** Decodes the i-th element into value - returns false if it has a character that is not a hex digit */
+	inline bool at(size_t i, T &value) const {
+		uint64_t v;
+		bool valid = Hexes::decodeShort(digits + i * digitsPerElem, digitsPerElem, v);
+		value = (T)v;
+		return valid;
+	}
+
+	/**
+	 * Decodes every element into the caller-provided buffer and returns the number of elements. Returns
+	 * Hexes::DECODE_ERROR for invalid views, invalid characters or when cap (in elements) is less than size().
+	 * Natural width elements are decoded as bytes 16 hexes at a time (see Hexes::decodeBytes) then byte-swapped.
+	 */
+	inline size_t decodeInto(T *out, size_t cap) const {
+		if(!isValid() || (cap < count)) {
+			return Hexes::DECODE_ERROR;
+		}
+		if(digitsPerElem == 2 * sizeof(T)) {
+			// The hexes are big-endian so every element needs a byte swap after decoding them as bytes
+			Hexes all{fio::LenString{(unsigned int)(count * digitsPerElem), (char*)digits}};
+			if(all.decodeBytes((uint8_t*)out, count * sizeof(T)) == Hexes::DECODE_ERROR) {
+				return Hexes::DECODE_ERROR;
+			}
+			for(size_t i = 0; i < count; ++i) {
+				out[i] = fromBigEndian(out[i]);
+			}
+		} else {
+			for(size_t i = 0; i < count; ++i) {
+				if(!at(i, out[i])) {
+					return Hexes::DECODE_ERROR;
+				}
+			}
+		}
+		return count;
+	}
+
+	/** Decodes every element into the vector (resized to size()) - returns false the same way as decodeInto */
+	inline bool decodeInto(std::vector<T> &out) const {
+		out.resize(count);
+		return (count == 0) ? isValid() : (decodeInto(&out[0], count) != Hexes::DECODE_ERROR);
+	}
+
+private:
+	const char *digits;
+	size_t count;
+	unsigned int digitsPerElem;
+
+	/** Converts a big-endian element to the native (little-endian) byte order */
+	inline static T fromBigEndian(T v) {
+		switch(sizeof(T)) {
+			case 1: return v;
+			case 2: return (T)__builtin_bswap16((uint16_t)v);
+			case 4: return (T)__builtin_bswap32((uint32_t)v);
+			default: return (T)__builtin_bswap64((uint64_t)v);
+		}
+	}
+};
+
+template<class T>
+inline HexArray<T> Hexes::asArray(unsigned int digitsPerElem) const {
+	if((digitsPerElem == 0) || (digitsPerElem > 2 * sizeof(T)) || ((digits.length % digitsPerElem) != 0)) {
+		return HexArray<T>();
+	}
+	return HexArray<T>(digits.startPtr, digits.length / digitsPerElem, digitsPerElem);
+}
+
 /**
  * Defines possible node kinds
  */
@@ -110,12 +397,27 @@ public:
 	 * - MEMORY IS OWNED BY THE TREE! Do not cache this!
 	 */
 	const char *name;
+	/**
+	 * The length of the name in bytes. When the tree refers the memory of an input that does not support destructive
+	 * operations (like fio::MmapInput) the name is NOT zero-terminated so always use this length in that case!
+	 */
+	unsigned int nameLength;
+	/**
+	 * The ID of the name in the symbol table of the tree: nodes of the same tree have the same name exactly when
+	 * their name IDs are the same. IDs of different trees cannot be compared!
+	 */
+	uint32_t nameId;
 	/**
 	 * Only contains a valid pointer if the node kind is TEXT when it contains the utf8 char string. Otherwise nullptr.
 	 * Also a nullptr if the node text is empty (so instead of "", we use nullptr).
 	 * - MEMORY IS OWNED BY THE TREE! Do not cache this!
 	 */
 	const char *text;
+	/**
+	 * The length of the text in bytes (zero for non-text nodes and empty texts). Like with the name, the text is
+	 * NOT zero-terminated when the tree refers the memory of an input that does not support destructive operations!
+	 */
+	unsigned int textLength;
 };
 
 } // end of namespace tbuf
@@ -0,0 +1,218 @@
+// tbuf_events.h: Push-style (SAX-like) parsing that tells a handler about the structure without building a tree.
+
+#ifndef TURBO_BUF_EVENTS_H
+#define TURBO_BUF_EVENTS_H
+
+#include<cstring>
+#include<type_traits>
+#include"fio.h"
+#include"tbuf.h"
+#include"tbuf_scan.h"
+
+namespace tbuf {
+
+/**
+ * Unescapes the raw contents of a text node into out (that must have room for text.length characters) and
+ * returns the unescaped length. The result is the same as the text of the node in a Tree - nothing is allocated.
+ */
+inline unsigned int unescapeText(fio::LenString text, char *out) {
+	unsigned int length = 0;
+	for(unsigned int i = 0; i < text.length; ++i) {
+		if((text.startPtr[i] == SYM_ESCAPE) && (i + 1 < text.length)) {
+			++i;
+		}
+		out[length++] = text.startPtr[i];
+	}
+	return length;
+}
+
+/**
+ * Parses any fio::Input and calls the handler for the structure instead of building a Tree: nothing is allocated
+ * and no Node, vector or tree-owned string is touched. The scanning is the same as in Tree::parseNode (whitespace
+ * is always ignored) so the events describe exactly the tree that would be built. The handler has these methods:
+ *
+ * - onOpen(fio::LenString name): a normal node starts (words too - those are closed right away)
+ * - onHexes(fio::LenString digits): the hex digits of the last opened node (or of the root before anything else).
+ *   Only called when there are any digits.
+ * - onText(fio::LenString name, fio::LenString text): a text node - the name has the '$' and the text is raw:
+ *   the escapes are still there (forwarding can write it out as it is, see unescapeText(..) otherwise)
+ * - onClose(): the last opened node ends
+ *
+ * Each of them can return a VisitResult (or nothing for always continuing). VisitResult::STOP stops the parsing
+ * and VisitResult::SKIP_CHILDREN from onOpen(..) or onHexes(..) fast-forwards over the rest of the node at
+ * scanning speed (see SubtreeSkipper) - onClose() is still called for it so the events stay balanced.
+ *
+ * Rem.: The LenStrings are only valid during the call unless the input supports persistent grabs!
+ */
+template<class InputSubClass, class Handler>
+class EventParser {
+public:
+	EventParser(InputSubClass &_input, Handler &_handler) : input(_input), handler(_handler), level(0), stopped(false) {
+		// Only here to ensure type safety in our case of template usage...
+		static_assert(std::is_base_of<fio::Input, InputSubClass>::value, "EventParser needs a subclass of fio::Input!");
+	}
+
+	/**
+	 * Parses the whole input. Returns true when the input ended cleanly: between tokens with every node closed.
+	 * Returns false when the handler stopped us or when the input was cut off (like a Tree, we drop the cut off
+	 * token - the nodes that are still open are just never closed).
+	 */
+	inline bool parse() {
+		const ScanKernels &k = Scan::active();
+		// Root hexes can only come at the very start
+		if(Hexes::isHexCharacter(input.grabCurr())) {
+			void* hexSeam = input.markSeam();
+			Scan::advanceOver(input, k.hexRun);
+			if(result([&] { return handler.onHexes(input.grabFromSeamToLast(hexSeam)); }) == VisitResult::STOP) {
+				return stop();
+			}
+		}
+		while(true) {
+			char c = input.grabCurr();
+			if(c == EOF) {
+				return level == 0;
+			} else if(Scan::isWhiteSpace(c)) {
+				Scan::advanceOver(input, k.whiteSpaceRun);
+			} else if(c == SYM_COMMENT) {
+				// Comments only start at tokens so a '#' in a name or a text does not start one
+				Scan::advanceOver(input, k.lineEnd);
+			} else if(c == SYM_STRING_NODE) {
+				if(!parseText()) {
+					return false;
+				}
+			} else if(c == SYM_CLOSE_NODE) {
+				input.advance();
+				// A '}' on the top level is just ignored (like in the tree parser)
+				if(level > 0) {
+					--level;
+					if(result([&] { return handler.onClose(); }) == VisitResult::STOP) {
+						return stop();
+					}
+				}
+			} else if(!parseNormal()) {
+				return false;
+			}
+		}
+	}
+
+	/** The number of the currently open nodes (the children of the root are opened on level one) */
+	inline unsigned int depth() const {
+		return level;
+	}
+
+	/** Tells if the handler has stopped the parsing */
+	inline bool isStopped() const {
+		return stopped;
+	}
+
+private:
+	InputSubClass &input;
+	Handler &handler;
+	unsigned int level;
+	bool stopped;
+
+	inline bool stop() {
+		stopped = true;
+		return false;
+	}
+
+	/** Calls a handler method that returns a VisitResult */
+	template<class Call>
+	inline static VisitResult result(Call call, std::false_type returnsVoid) {
+		return call();
+	}
+	/** Calls a handler method that returns nothing - that means we always continue */
+	template<class Call>
+	inline static VisitResult result(Call call, std::true_type returnsVoid) {
+		call();
+		return VisitResult::CONTINUE;
+	}
+	template<class Call>
+	inline static VisitResult result(Call call) {
+		return result(call, typename std::is_void<decltype(call())>::type());
+	}
+
+	/** Parses a text node from its '$' - returns false when we should not go on */
+	inline bool parseText() {
+		// The name and the text are grabbed from one seam so that both are valid for the call even for streams
+		void* seam = input.markSeam();
+		unsigned int nameLength = (unsigned int)Scan::advanceOver(input, SubtreeSkipper::openBrace);
+		if(input.grabCurr() == EOF) {
+			// Rem.: We grab from seam here only to ensure mark/grab pairing!
+			input.grabFromSeamToLast(seam);
+			return false;
+		}
+		input.advance();
+		if(!SubtreeSkipper::advanceToTextEnd(input)) {
+			// Syntax error - the text node is never closed
+			input.grabFromSeamToLast(seam);
+			return false;
+		}
+		fio::LenString whole = input.grabFromSeamToLast(seam);
+		fio::LenString name {nameLength, whole.startPtr};
+		fio::LenString text {whole.length - nameLength - 1, whole.startPtr + nameLength + 1};
+		VisitResult r = result([&] { return handler.onText(name, text); });
+		// Advance over the '}' closing char
+		input.advance();
+		return (r != VisitResult::STOP) || stop();
+	}
+
+	/** Parses a normal node (or a word) from the first letter of its name - returns false when we should not go on */
+	inline bool parseNormal() {
+		const ScanKernels &k = Scan::active();
+		void* seam = input.markSeam();
+		// The first character is always part of the name
+		input.advance();
+		Scan::advanceOver(input, k.nameEnd);
+		char c = input.grabCurr();
+		if(c == EOF) {
+			// Syntax error - no opening tag after tag name!
+			input.grabFromSeamToLast(seam);
+			return false;
+		} else if(c != SYM_OPEN_NODE) {
+			// An empty leaf (the whitespace after it is the next token)
+			fio::LenString name = input.grabFromSeamToLast(seam);
+			if((result([&] { return handler.onOpen(name); }) == VisitResult::STOP) ||
+					(result([&] { return handler.onClose(); }) == VisitResult::STOP)) {
+				return stop();
+			}
+			return true;
+		}
+		// The seam keeps the name valid while we advance over the '{' and check that the node is not cut off
+		input.advance();
+		if(input.grabCurr() == EOF) {
+			// The tree drops a '{' at the very end too
+			input.grabFromSeamToLast(seam);
+			return false;
+		}
+		fio::LenString name = input.grabFromSeamToLast(seam);
+		--name.length;
+		VisitResult r = result([&] { return handler.onOpen(name); });
+		if((r == VisitResult::CONTINUE) && Hexes::isHexCharacter(input.grabCurr())) {
+			void* hexSeam = input.markSeam();
+			Scan::advanceOver(input, k.hexRun);
+			r = result([&] { return handler.onHexes(input.grabFromSeamToLast(hexSeam)); });
+		}
+		if(r == VisitResult::STOP) {
+			return stop();
+		} else if(r == VisitResult::SKIP_CHILDREN) {
+			if(!SubtreeSkipper::skip(input)) {
+				return false;
+			}
+			return (result([&] { return handler.onClose(); }) != VisitResult::STOP) || stop();
+		}
+		++level;
+		return true;
+	}
+};
+
+/** Parses the input with the handler - see EventParser */
+template<class InputSubClass, class Handler>
+inline bool parseEvents(InputSubClass &input, Handler &handler) {
+	EventParser<InputSubClass, Handler> parser(input, handler);
+	return parser.parse();
+}
+
+} // end of namespace tbuf
+
+#endif // TURBO_BUF_EVENTS_H
@@ -0,0 +1,334 @@
+// tbuf_incremental.h: Resumable parsing of messages that arrive in arbitrary fragments (like from non-blocking sockets).
+
+#ifndef TURBO_BUF_INCREMENTAL_H
+#define TURBO_BUF_INCREMENTAL_H
+
+#include<cstring>
+#include<memory>
+#include<string>
+#include"fio.h"
+#include"tbuf.h"
+#include"tbuf_scan.h"
+
+namespace tbuf {
+
+/**
+ * Parses messages from fragments of any size. Every byte is scanned once: the parser keeps where it is in the
+ * message (the current parent, a partial name, hex run or escaped text) across the feed(..) calls, so the work is
+ * done as the bytes arrive and nothing has to be buffered and rescanned when the rest comes.
+ *
+ * The trees are the same as what Tree would build from the whole message with copying (fragments do not outlive
+ * the calls so nothing can be referred). A message is complete when its top-level node closes - so a stream like
+ * "frame{..} frame{..}" is a series of messages - or when finish() is called at the end of the input. With
+ * splitTopLevel = false, only finish() completes the message: the whole input becomes one tree.
+ *
+ * Usage:
+ *     while(length > 0) {
+ *         size_t used = parser.feed(data, length);
+ *         data += used; length -= used;
+ *         if(parser.hasMessage()) parser.recycle(handle(parser.take()));
+ *     }
+ *
+ * (where handle gives the tree back when it is done with it - or just drop the trees without recycle(..))
+ */
+class IncrementalParser {
+public:
+	explicit IncrementalParser(bool _splitTopLevel = true) : splitTopLevel(_splitTopLevel) {
+		startMessage();
+	}
+
+	/**
+	 * Parses the fragment until its end or until a message is complete - returns the number of bytes used. The rest
+	 * of the fragment should be fed again after take(): nothing is used while a complete message is waiting.
+	 */
+	inline size_t feed(const char *data, size_t length) {
+		size_t used = 0;
+		while((used < length) && !complete) {
+			// The kernels work on unsigned int lengths so huge fragments are done in parts
+			size_t left = length - used;
+			unsigned int part = (left > 0x40000000) ? 0x40000000 : (unsigned int)left;
+			used += step(data + used, part);
+		}
+		TBUF_STAT(tree->stats.bytesScanned += used);
+		return used;
+	}
+
+	/**
+	 * Ends the input: the message in progress is completed the same way Tree handles the end of the input (a token
+	 * that is cut off is dropped and open nodes stay as they are). Returns false when something was cut off.
+	 * In splitTopLevel mode an empty message (only whitespace or comments after the last one) is not reported.
+	 */
+	inline bool finish() {
+		if(complete) {
+			return true;
+		}
+		bool clean = true;
+		switch(state) {
+		case State::ROOT_HEXES:
+			setRootHexes();
+			break;
+		case State::HEXES:
+			// The node is only kept when it has hexes (the tree drops a '{' at the very end)
+			if(pending.empty()) {
+				clean = false;
+			} else {
+				openNode();
+			}
+			break;
+		case State::NAME:
+		case State::TEXT_NAME:
+		case State::TEXT:
+		case State::TEXT_ESCAPE:
+			clean = false;
+			break;
+		default:
+			break;
+		}
+		state = State::TOKEN;
+		// Open nodes are cut off too
+		clean = clean && (depth == 0);
+		complete = !splitTopLevel || !tree->root.children.empty() || !tree->root.core.data.isEmpty();
+		return clean;
+	}
+
+	/** Tells if a message is complete (take it with take()) */
+	inline bool hasMessage() const {
+		return complete;
+	}
+
+	/** Returns the message in progress (or the complete one) - its nodes stay where they are while it is parsed */
+	inline Tree& current() {
+		return *tree;
+	}
+
+	/** Takes the complete message - the next one starts right after it */
+	inline std::unique_ptr<Tree> take() {
+		std::unique_ptr<Tree> taken = std::move(tree);
+		startMessage();
+		return taken;
+	}
+
+	/**
+	 * Gives a taken tree back so that a later message is parsed into it (see Tree::clear). When every taken tree
+	 * is given back, messages of the same shape are parsed without allocations once the trees have grown for them.
+	 */
+	inline void recycle(std::unique_ptr<Tree> used) {
+		spare = std::move(used);
+	}
+
+private:
+	/** Where the parser is in the message */
+	enum class State {
+		/** Before the first byte: root hexes can only come here */
+		MESSAGE_START,
+		/** In the hexes of the root */
+		ROOT_HEXES,
+		/** Between the tokens */
+		TOKEN,
+		/** In a comment (until the line end) */
+		COMMENT,
+		/** In the name of a normal node or a word */
+		NAME,
+		/** In the name of a text node (from the '$' until the '{') */
+		TEXT_NAME,
+		/** After the '{' of a normal node: in its hexes */
+		HEXES,
+		/** In the content of a text node */
+		TEXT,
+		/** Right after an escape in a text node */
+		TEXT_ESCAPE,
+	};
+
+	bool splitTopLevel;
+	std::unique_ptr<Tree> tree;
+	/** A given back tree for the next message */
+	std::unique_ptr<Tree> spare;
+	/** The node the next nodes go below */
+	Node *parent;
+	/** The depth of the parent (zero for the root) */
+	unsigned int depth;
+	State state;
+	bool complete;
+	/** The partial name of the current node (kept between fragments - its capacity is reused) */
+	std::string name;
+	/** The partial hexes or the partial unescaped text of the current node */
+	std::string pending;
+
+	inline void startMessage() {
+		if(spare) {
+			tree = std::move(spare);
+			tree->clear();
+		} else {
+			tree.reset(new Tree());
+		}
+		parent = &tree->root;
+		depth = 0;
+		state = State::MESSAGE_START;
+		complete = false;
+		name.clear();
+		pending.clear();
+	}
+
+	/** A top-level node is done: the message is complete in splitTopLevel mode */
+	inline void nodeDone() {
+		if(splitTopLevel && (depth == 0)) {
+			complete = true;
+		}
+	}
+
+	inline void setRootHexes() {
+		if(!pending.empty()) {
+			tree->root.core.data = tree->ownedHexes(Hexes{fio::LenString{(unsigned int)pending.length(), &pending[0]}}, false);
+		}
+	}
+
+	/** Returns the kept name (copied into the symbols of the tree) and puts its ID into nameId */
+	inline const char* keptName(uint32_t &nameId) {
+		return tree->keepName(fio::LenString{(unsigned int)name.length(), &name[0]}, false, false, nameId);
+	}
+
+	/** Adds the normal node with the name and hexes read so far and goes into it */
+	inline void openNode() {
+		uint32_t nameId;
+		const char *kept = keptName(nameId);
+		Hexes hexes = pending.empty() ? Hexes::EMPTY_HEXES() :
+				tree->ownedHexes(Hexes{fio::LenString{(unsigned int)pending.length(), &pending[0]}}, false);
+		parent->children.push_back(Node{NodeKind::NORM, hexes, kept, (unsigned int)name.length(), nameId, nullptr, 0, parent, ChildList()});
+		TBUF_STAT(++tree->stats.nodesByKind[(int)NodeKind::NORM]; tree->statsEnter());
+		parent = &parent->children.back();
+		++depth;
+	}
+
+	/** Adds an empty leaf with the name read so far */
+	inline void addWord() {
+		uint32_t nameId;
+		const char *kept = keptName(nameId);
+		parent->children.push_back(Node{NodeKind::NORM, Hexes::EMPTY_HEXES(), kept, (unsigned int)name.length(), nameId, nullptr, 0, parent, ChildList()});
+		TBUF_STAT(++tree->stats.nodesByKind[(int)NodeKind::NORM]);
+		nodeDone();
+	}
+
+	/** Adds the text node with the name and the (already unescaped) text read so far */
+	inline void addText() {
+		uint32_t nameId;
+		const char *kept = keptName(nameId);
+		// Rem.: Empty texts are nullptr (see NodeCore::text)
+		const char *text = pending.empty() ? nullptr : tree->copyToTreeStrings(fio::LenString{(unsigned int)pending.length(), &pending[0]});
+		parent->children.push_back(Node{NodeKind::TEXT, Hexes {}, kept, (unsigned int)name.length(), nameId, text, (unsigned int)pending.length(), parent, ChildList()});
+		TBUF_STAT(++tree->stats.nodesByKind[(int)NodeKind::TEXT]);
+		nodeDone();
+	}
+
+	/** Parses from the start of the data and returns the number of bytes used (zero when only the state changed) */
+	inline unsigned int step(const char *p, unsigned int len) {
+		const ScanKernels &k = Scan::active();
+		switch(state) {
+		case State::MESSAGE_START:
+			state = Hexes::isHexCharacter(*p) ? State::ROOT_HEXES : State::TOKEN;
+			return 0;
+		case State::ROOT_HEXES: {
+			unsigned int n = k.hexRun(p, len);
+			pending.append(p, n);
+			if(n < len) {
+				setRootHexes();
+				pending.clear();
+				state = State::TOKEN;
+			}
+			return n;
+		}
+		case State::TOKEN: {
+			char c = *p;
+			if(Scan::isWhiteSpace(c)) {
+				unsigned int n = k.whiteSpaceRun(p, len);
+				TBUF_STAT(++tree->stats.whiteSpaceRuns; tree->stats.whiteSpaceBytes += n);
+				return n;
+			} else if(c == SYM_COMMENT) {
+				TBUF_STAT(++tree->stats.comments);
+				state = State::COMMENT;
+				return 0;
+			} else if(c == SYM_CLOSE_NODE) {
+				// A '}' on the top level is just ignored (like in the tree parser)
+				if(depth > 0) {
+					parent = parent->parent;
+					--depth;
+					TBUF_STAT(--tree->statsDepth);
+					nodeDone();
+				}
+				return 1;
+			}
+			// The first character is always part of the name
+			name.assign(1, c);
+			pending.clear();
+			state = (c == SYM_STRING_NODE) ? State::TEXT_NAME : State::NAME;
+			return 1;
+		}
+		case State::COMMENT: {
+			unsigned int n = k.lineEnd(p, len);
+			TBUF_STAT(tree->stats.commentBytes += n);
+			if(n < len) {
+				// The line end itself is whitespace for the next token
+				state = State::TOKEN;
+			}
+			return n;
+		}
+		case State::NAME: {
+			unsigned int n = k.nameEnd(p, len);
+			name.append(p, n);
+			if(n == len) {
+				return n;
+			}
+			if(p[n] == SYM_OPEN_NODE) {
+				state = State::HEXES;
+				return n + 1;
+			}
+			// Whitespace after the name: an empty leaf (the whitespace is skipped as the next token)
+			addWord();
+			state = State::TOKEN;
+			return n;
+		}
+		case State::TEXT_NAME: {
+			const char *open = (const char*)memchr(p, SYM_OPEN_NODE, len);
+			unsigned int n = (open != nullptr) ? (unsigned int)(open - p) : len;
+			name.append(p, n);
+			if(open == nullptr) {
+				return n;
+			}
+			state = State::TEXT;
+			return n + 1;
+		}
+		case State::HEXES: {
+			unsigned int n = k.hexRun(p, len);
+			pending.append(p, n);
+			if(n < len) {
+				openNode();
+				state = State::TOKEN;
+			}
+			return n;
+		}
+		case State::TEXT: {
+			unsigned int n = k.textSpecial(p, len);
+			pending.append(p, n);
+			if(n == len) {
+				return n;
+			}
+			if(p[n] == SYM_CLOSE_NODE) {
+				addText();
+				state = State::TOKEN;
+			} else {
+				// The character after the escape is taken literally (even the escape itself)
+				state = State::TEXT_ESCAPE;
+			}
+			return n + 1;
+		}
+		case State::TEXT_ESCAPE:
+			pending.push_back(*p);
+			state = State::TEXT;
+			return 1;
+		}
+		return 0;
+	}
+};
+
+} // end of namespace tbuf
+
+#endif // TURBO_BUF_INCREMENTAL_H
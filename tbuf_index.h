@@ -0,0 +1,363 @@
+// tbuf_index.h: Structural indexing of in-memory turbo-buf messages - the first stage of the two-stage parsing.
+// The index is built from 64 character blocks of bitmaps so that we only look at the interesting characters.
+
+#ifndef TURBO_BUF_INDEX_H
+#define TURBO_BUF_INDEX_H
+
+#include<cstdint>
+#include<cstring>
+#include<vector>
+#include<type_traits>
+#include"fio.h"
+#include"tbuf_scan.h"
+
+namespace tbuf {
+
+/** The kinds of the entries in the structural index */
+enum class IndexEntryKind : uint32_t {
+	/** A normal node with a body: "name{hexes..." */
+	OPEN = 0,
+	/** An empty-data leaf node (a "word") without the '{...}' part */
+	WORD = 1,
+	/** A text node: "$name{text}" */
+	TEXT = 2,
+	/** The '}' closing an OPEN entry */
+	CLOSE = 3,
+};
+
+/** One entry of the structural index. Positions are offsets in the indexed characters. */
+struct IndexEntry {
+	/** Tells what kind of entry this is */
+	IndexEntryKind kind;
+	/** The start of the name (OPEN, WORD, TEXT) or the position of the '}' (CLOSE) */
+	uint32_t start;
+	/** The position of the '{' (OPEN, TEXT) or the end of the name (WORD) */
+	uint32_t open;
+	/** OPEN: the end of the hex run after the '{'. TEXT: the position of the closing '}' */
+	uint32_t end;
+	/** OPEN: the index of the matching CLOSE entry (or the number of entries when the node is never closed) */
+	uint32_t match;
+	/** OPEN: the number of direct children */
+	uint32_t children;
+};
+
+/** The states of the structural walking - these are telling what we are looking for next */
+enum class WalkState {
+	/** The start of the next token: skipping whitespace */
+	TOKEN,
+	/** The end of a node name: '{' or whitespace */
+	NAME,
+	/** The end of the hex run after a '{' */
+	HEXES,
+	/** The end of a comment line */
+	COMMENT,
+	/** The '{' after the name of a text node */
+	TEXT_NAME,
+	/** The closing unescaped '}' of a text node */
+	TEXT,
+};
+
+/** Tells where the structural walking is - so that the walking can be continued later from here */
+struct WalkPosition {
+	/** What we are looking for next */
+	WalkState state;
+	/** The next character to look at */
+	uint32_t pos;
+	/** Where the name of the current node starts */
+	uint32_t tokenStart;
+	/** Where the '{' of the current text node is */
+	uint32_t textOpen;
+};
+
+/**
+ * The resumable state machine of the structural indexing. It walks over the set bits of the 64 character block
+ * bitmaps and tells the handler about the structure. The handler should have these methods (positions are offsets):
+ *
+ * - open(start, brace): a normal node with the name [start, brace) and a '{' at brace
+ * - hexEnd(pos): the hex run of the last opened node ends at pos
+ * - word(start, end): an empty-data leaf node with the name [start, end)
+ * - text(start, brace, close): a text node with the name [start, brace) and the text (brace, close)
+ * - close(pos): a '}' at pos that closes a node (or is ignored when nothing is open)
+ *
+ * Walking can be stopped at any position and continued later with the returned WalkPosition. What is still open
+ * at the end of the input should be handled by the caller (see StructuralIndex).
+ */
+class StructuralWalker {
+public:
+	/** Walk the characters from wp.pos until the position "to" (exclusive) and update wp to where we are */
+	template<class Handler>
+	inline static void walk(fio::LenString chars, uint32_t to, WalkPosition &wp, Handler &handler) {
+		const char *p = chars.startPtr;
+		uint32_t len = chars.length;
+		const ScanKernels &k = Scan::active();
+		uint32_t pos = wp.pos;
+		WalkState state = wp.state;
+		BlockMasks m;
+		char tail[64];
+		for(uint32_t base = pos & ~63u; (base < to) && (pos < to); base += 64) {
+			// Long hex runs are better skipped with the run kernel than walked block by block
+			if((state == WalkState::HEXES) && (pos - base < 32)) {
+				pos += k.hexRun(p + pos, to - pos);
+				if(pos >= to) break;
+				handler.hexEnd(pos);
+				state = WalkState::TOKEN;
+				base = pos & ~63u;
+			}
+			// The bitmaps of the block (the last block of the input is padded with zeroes)
+			if(len - base >= 64) {
+				k.blockMasks(p + base, m);
+			} else {
+				memset(tail, 0, sizeof(tail));
+				memcpy(tail, p + base, len - base);
+				k.blockMasks(tail, m);
+			}
+			uint64_t valid = (to - base >= 64) ? ~0ULL : ((1ULL << (to - base)) - 1);
+			uint32_t blockEnd = (to - base >= 64) ? base + 64 : to;
+			// Walk the set bits of the masks the current state is interested in
+			while(pos < blockEnd) {
+				uint64_t from = (~0ULL << (pos - base)) & valid;
+				uint64_t hits;
+				switch(state) {
+				case WalkState::TOKEN:
+					hits = ~m.white & from;
+					if(hits == 0) {
+						pos = blockEnd;
+						break;
+					}
+					pos = base + __builtin_ctzll(hits);
+					if(p[pos] == '#') {
+						state = WalkState::COMMENT;
+					} else if(p[pos] == '$') {
+						wp.tokenStart = pos;
+						state = WalkState::TEXT_NAME;
+					} else if(p[pos] == '}') {
+						handler.close(pos);
+					} else {
+						// The first character is always part of the name
+						wp.tokenStart = pos;
+						state = WalkState::NAME;
+					}
+					++pos;
+					break;
+				case WalkState::NAME:
+					hits = (m.open | m.white) & from;
+					if(hits == 0) {
+						pos = blockEnd;
+						break;
+					}
+					pos = base + __builtin_ctzll(hits);
+					if(p[pos] == '{') {
+						handler.open(wp.tokenStart, pos);
+						state = WalkState::HEXES;
+						++pos;
+					} else {
+						// Whitespace: an empty-data leaf
+						handler.word(wp.tokenStart, pos);
+						state = WalkState::TOKEN;
+					}
+					break;
+				case WalkState::HEXES:
+					hits = ~m.hex & from;
+					if(hits == 0) {
+						pos = blockEnd;
+						break;
+					}
+					pos = base + __builtin_ctzll(hits);
+					handler.hexEnd(pos);
+					state = WalkState::TOKEN;
+					break;
+				case WalkState::COMMENT:
+					hits = m.lineEnd & from;
+					if(hits == 0) {
+						pos = blockEnd;
+						break;
+					}
+					pos = base + __builtin_ctzll(hits);
+					state = WalkState::TOKEN;
+					break;
+				case WalkState::TEXT_NAME:
+					hits = m.open & from;
+					if(hits == 0) {
+						pos = blockEnd;
+						break;
+					}
+					pos = base + __builtin_ctzll(hits);
+					wp.textOpen = pos;
+					state = WalkState::TEXT;
+					++pos;
+					break;
+				case WalkState::TEXT:
+					hits = (m.close | m.escape) & from;
+					if(hits == 0) {
+						pos = blockEnd;
+						break;
+					}
+					pos = base + __builtin_ctzll(hits);
+					if(p[pos] == '\\') {
+						// Every character after the escape is taken literally (this might jump into the next block)
+						pos += 2;
+					} else {
+						handler.text(wp.tokenStart, wp.textOpen, pos);
+						state = WalkState::TOKEN;
+						++pos;
+					}
+					break;
+				}
+			}
+		}
+		// Rem.: We might be over "to" only when an escape was the last character
+		wp.pos = pos;
+		wp.state = state;
+	}
+};
+
+/**
+ * Structural index of an in-memory message: the first stage of the two-stage parsing (modelled on simdjson).
+ * We compute bitmaps of the interesting characters for 64 character blocks with the vectorized kernels and then
+ * only walk over the set bits to find every node, text and closing brace. Comments and the insides of text nodes
+ * are resolved here, so a tbuf::Tree can be built from the entries without looking at every character again.
+ *
+ * Because the matching closing braces and child counts are known up front, subtrees can be skipped in O(1) and
+ * the child vectors can be allocated with their exact sizes when building a tree. Whitespace is always ignored.
+ */
+class StructuralIndex {
+public:
+	/** The entries in the order of the input */
+	std::vector<IndexEntry> entries;
+	/** The indexed characters - the memory is owned by the input! */
+	fio::LenString chars;
+	/** The end of the hex run of the root (the root hexes are always at the start of the characters) */
+	uint32_t rootHexEnd;
+	/** The number of direct children of the root */
+	uint32_t rootChildren;
+	/** The number of nodes (that is: the entries except the CLOSE ones) */
+	uint32_t nodeCount;
+	/** Tells if the input supported the dangerous destructive operations */
+	bool destructiveAllowed;
+
+	/** Create an empty index */
+	StructuralIndex() : chars{0, nullptr}, rootHexEnd{0}, rootChildren{0}, nodeCount{0}, destructiveAllowed{false}, valid{true} {}
+
+	/**
+	 * Index everything from the current head of the input (and advance the input to its end).
+	 * Only inputs that have all their data in the memory can be indexed (like fio::FastInput or fio::MmapInput)
+	 * as the tree building refers back to the characters. For other inputs (like fio::StreamInput) the index is
+	 * empty and not valid (see isValid()) and the input is not advanced.
+	 */
+	template<class InputSubClass>
+	StructuralIndex(InputSubClass &input) : StructuralIndex() {
+		// These are only here to ensure type safety
+		// in our case of template usage...
+		static_assert(std::is_base_of<fio::Input, InputSubClass>::value, "StructuralIndex needs a subclass of fio::Input!");
+		// Ensure we can refer the characters later - the grabAhead() of other inputs only has a part of the data
+		if(!input.isSupportingPersistentGrabs()) {
+			valid = false;
+			return;
+		}
+		chars = input.grabAhead();
+		destructiveAllowed = input.isSupportingDangerousDestructiveOperations();
+		// The root hex run is always at the start
+		rootHexEnd = (chars.length > 0) ? Scan::hexRun(chars.startPtr, chars.length) : 0;
+		build(rootHexEnd, chars.length);
+		input.advance(chars.length);
+	}
+
+	/**
+	 * Index only the [from, to) range of the characters as if they were the children of the root. There are no root
+	 * hexes in this case, so "from" should be the start of a top-level token (the same is true for "to" unless it is
+	 * the end of the characters). Useful for indexing the top-level subtrees separately - see tbuf::parallelParse.
+	 */
+	StructuralIndex(fio::LenString _chars, bool _destructiveAllowed, uint32_t from, uint32_t to) :
+		chars{_chars}, rootHexEnd{0}, rootChildren{0}, nodeCount{0}, destructiveAllowed{_destructiveAllowed}, valid{true} {
+		build(from, to);
+	}
+
+	/** Tells if the input could be indexed - trees are not built from invalid indices */
+	inline bool isValid() const {
+		return valid;
+	}
+
+	/** Returns the index of the entry right after the subtree of the i-th entry (in O(1) time) */
+	inline uint32_t skip(uint32_t i) const {
+		return (entries[i].kind == IndexEntryKind::OPEN) ? entries[i].match + 1 : i + 1;
+	}
+
+private:
+	/** False when the input did not have all of its data in the memory */
+	bool valid;
+
+	/** The handler for the StructuralWalker that adds the entries */
+	struct EntryAdder {
+		StructuralIndex &index;
+		/** The indices of the entries of the currently open nodes */
+		std::vector<uint32_t> openStack;
+
+		/** Adds a child entry below the currently open node (or the root) */
+		inline void addChild(IndexEntry entry) {
+			if(openStack.empty()) {
+				++index.rootChildren;
+			} else {
+				++index.entries[openStack.back()].children;
+			}
+			++index.nodeCount;
+			index.entries.push_back(entry);
+		}
+		inline void open(uint32_t start, uint32_t brace) {
+			addChild(IndexEntry{IndexEntryKind::OPEN, start, brace, brace + 1, 0, 0});
+			openStack.push_back(index.entries.size() - 1);
+		}
+		inline void hexEnd(uint32_t pos) {
+			index.entries[openStack.back()].end = pos;
+		}
+		inline void word(uint32_t start, uint32_t end) {
+			addChild(IndexEntry{IndexEntryKind::WORD, start, end, end, 0, 0});
+		}
+		inline void text(uint32_t start, uint32_t brace, uint32_t close) {
+			addChild(IndexEntry{IndexEntryKind::TEXT, start, brace, close, 0, 0});
+		}
+		inline void close(uint32_t pos) {
+			// Closing the current node (at the top level this is just ignored)
+			if(!openStack.empty()) {
+				index.entries[openStack.back()].match = index.entries.size();
+				index.entries.push_back(IndexEntry{IndexEntryKind::CLOSE, pos, pos, pos, 0, 0});
+				openStack.pop_back();
+			}
+		}
+	};
+
+	/** Builds the entries for the [from, to) range */
+	inline void build(uint32_t from, uint32_t to) {
+		entries.clear();
+		rootChildren = 0;
+		nodeCount = 0;
+		EntryAdder adder{*this, std::vector<uint32_t>()};
+		WalkPosition wp{WalkState::TOKEN, from, from, from};
+		StructuralWalker::walk(chars, to, wp, adder);
+
+		// Handle what is left open at the end the same way the tree parser does
+		if(wp.state == WalkState::HEXES) {
+			IndexEntry &last = entries.back();
+			if(last.open + 1 >= to) {
+				// A '{' at the very end is a syntax error: the node is dropped
+				entries.pop_back();
+				--nodeCount;
+				adder.openStack.pop_back();
+				if(adder.openStack.empty()) {
+					--rootChildren;
+				} else {
+					--entries[adder.openStack.back()].children;
+				}
+			} else {
+				last.end = to;
+			}
+		}
+		// Rem.: Unfinished names and texts are syntax errors and they are not added at all
+		for(uint32_t open : adder.openStack) {
+			entries[open].match = entries.size();
+		}
+	}
+};
+
+} // end of namespace tbuf
+
+#endif // TURBO_BUF_INDEX_H
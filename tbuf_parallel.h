@@ -0,0 +1,218 @@
+// tbuf_parallel.h: Multi-threaded parsing of big in-memory turbo-buf messages split at the top-level children.
+// Needs to be linked with -pthread.
+
+#ifndef TURBO_BUF_PARALLEL_H
+#define TURBO_BUF_PARALLEL_H
+
+#include<atomic>
+#include<algorithm>
+#include<memory>
+#include<thread>
+#include<vector>
+#include<utility>
+#include"fio.h"
+#include"tbuf.h"
+#include"tbuf_index.h"
+#include"tbuf_symbols.h"
+
+namespace tbuf {
+
+/**
+ * Handler for the StructuralWalker that finds the top-level children in a chunk without knowing the depth where
+ * the chunk starts: the brace-depth prefix pass of the parallel parsing.
+ *
+ * The depth after the chunk is always of the form max(d + a, b) where d is the (yet unknown) depth at the start of
+ * the chunk - because a '}' at the top level is ignored. A child starting in the chunk is a top-level child if its
+ * depth is zero, so we keep every child start as candidate for which that is still possible with some d.
+ */
+struct TopLevelFinder {
+	/** The depth function so far: d -> max(d + a, b) */
+	int32_t a;
+	int32_t b;
+	/** The start positions of the possible top-level children with the "a" at their start */
+	std::vector<std::pair<uint32_t, int32_t>> candidates;
+
+	TopLevelFinder() : a{0}, b{0} {}
+
+	/** Marks a possible top-level child that starts at start */
+	inline void child(uint32_t start) {
+		if((b == 0) && (a <= 0)) {
+			candidates.push_back(std::make_pair(start, a));
+		}
+	}
+	inline void open(uint32_t start, uint32_t brace) {
+		child(start);
+		++a;
+		++b;
+	}
+	inline void hexEnd(uint32_t pos) {}
+	inline void word(uint32_t start, uint32_t end) {
+		child(start);
+	}
+	inline void text(uint32_t start, uint32_t brace, uint32_t close) {
+		child(start);
+	}
+	inline void close(uint32_t pos) {
+		--a;
+		b = std::max(b - 1, 0);
+	}
+};
+
+/** Runs the job for every index in [0, count) using at most "threads" threads (the calling one is one of them) */
+template<class Job>
+inline void runConcurrently(unsigned int count, unsigned int threads, Job job) {
+	std::atomic<unsigned int> next{0};
+	auto worker = [&next, count, &job] () {
+		unsigned int i;
+		while((i = next++) < count) {
+			job(i);
+		}
+	};
+	std::vector<std::thread> helpers;
+	for(unsigned int t = 1; (t < threads) && (t < count); ++t) {
+		helpers.push_back(std::thread(worker));
+	}
+	worker();
+	for(std::thread &helper : helpers) {
+		helper.join();
+	}
+}
+
+/**
+ * Parses the whole input into a tree using the given number of threads and returns the tree.
+ * The result is the same as the one of tbuf::Tree(input, true) - so the input should outlive the tree!
+ *
+ * It works in these steps:
+ * - The characters are split into chunks at line ends and every chunk is walked concurrently with the assumption
+ *   that it does not start inside a text node. This finds the possible top-level children (see TopLevelFinder).
+ * - The assumptions are checked in order (and the chunk is walked again when wrong) so that the depth at every
+ *   chunk start is known and the real top-level children are found.
+ * - The top-level children are grouped into similar sized groups which get indexed concurrently.
+ * - The node pool of the tree grows for all the nodes and the groups are built into it concurrently - each group
+ *   with its own symbol table. These are merged into the one of the tree and the name IDs are renumbered after.
+ *
+ * Rem.: Because the tree refers to the input, no thread touches the string storage of the tree.
+ */
+inline std::unique_ptr<Tree> parallelParse(fio::FastInput &input, unsigned int threads) {
+	std::unique_ptr<Tree> tree(new Tree());
+	fio::LenString chars = input.grabAhead();
+	input.advance(chars.length);
+	if(chars.length == 0) {
+		// Empty input, return empty root
+		return tree;
+	}
+	if(threads == 0) {
+		threads = 1;
+	}
+	uint32_t len = chars.length;
+	char *p = chars.startPtr;
+
+	// The root hex run is always at the start
+	uint32_t rootHexEnd = Scan::hexRun(p, len);
+	if(rootHexEnd > 0) {
+		tree->root.core.data = Hexes{fio::LenString{rootHexEnd, p}};
+	}
+
+	// Split the rest into chunks that start right after a line end (where texts rarely continue)
+	std::vector<uint32_t> splits{rootHexEnd};
+	for(unsigned int t = 1; t < threads; ++t) {
+		uint32_t at = rootHexEnd + (uint32_t)((uint64_t)(len - rootHexEnd) * t / threads);
+		if(at <= splits.back()) continue;
+		const char *lineEnd = (const char*)memchr(p + at, '\n', len - at);
+		if(lineEnd == nullptr) break;
+		at = (lineEnd - p) + 1;
+		if(at > splits.back() && at < len) {
+			splits.push_back(at);
+		}
+	}
+	splits.push_back(len);
+	unsigned int chunkCount = splits.size() - 1;
+
+	// Find the possible top-level children in every chunk concurrently
+	std::vector<TopLevelFinder> finders(chunkCount);
+	std::vector<WalkPosition> ends(chunkCount);
+	runConcurrently(chunkCount, threads, [&] (unsigned int i) {
+		WalkPosition wp{WalkState::TOKEN, splits[i], splits[i], splits[i]};
+		StructuralWalker::walk(chars, splits[i + 1], wp, finders[i]);
+		ends[i] = wp;
+	});
+
+	// Check the assumptions and collect the real top-level children with the known depths
+	std::vector<uint32_t> topLevel;
+	int32_t depth = 0;
+	for(unsigned int i = 0; i < chunkCount; ++i) {
+		if((i > 0) && ((ends[i - 1].state != WalkState::TOKEN) || (ends[i - 1].pos != splits[i]))) {
+			// The chunk did not start at a token (like in a multi-line text): walk it again from where we are
+			finders[i] = TopLevelFinder();
+			WalkPosition wp = ends[i - 1];
+			StructuralWalker::walk(chars, splits[i + 1], wp, finders[i]);
+			ends[i] = wp;
+		}
+		for(const std::pair<uint32_t, int32_t> &candidate : finders[i].candidates) {
+			if(depth + candidate.second <= 0) {
+				topLevel.push_back(candidate.first);
+			}
+		}
+		depth = std::max(depth + finders[i].a, finders[i].b);
+	}
+	if(topLevel.empty()) {
+		return tree;
+	}
+
+	// Group the top-level children (more groups than threads for better balancing)
+	std::vector<uint32_t> groupStarts;
+	uint32_t groupBytes = std::max<uint32_t>(1, (len - rootHexEnd) / (threads * 4));
+	for(uint32_t start : topLevel) {
+		if(groupStarts.empty() || (start >= groupStarts.back() + groupBytes)) {
+			groupStarts.push_back(start);
+		}
+	}
+	unsigned int groupCount = groupStarts.size();
+	groupStarts.push_back(len);
+
+	// Index the groups concurrently
+	std::vector<StructuralIndex> indices(groupCount);
+	runConcurrently(groupCount, threads, [&] (unsigned int g) {
+		indices[g] = StructuralIndex(chars, input.isSupportingDangerousDestructiveOperations(), groupStarts[g], groupStarts[g + 1]);
+	});
+
+	// Grow the node pool for every node and build the groups into their own part of it concurrently
+	std::vector<uint32_t> firstIndices(groupCount);
+	for(unsigned int g = 0; g < groupCount; ++g) {
+		firstIndices[g] = tree->pool.grow(indices[g].nodeCount);
+	}
+	Tree *t = tree.get();
+	std::vector<ChildList> groupLists(groupCount, ChildList(&t->pool));
+	std::vector<SymbolTable> groupSymbols(groupCount);
+	runConcurrently(groupCount, threads, [&] (unsigned int g) {
+		t->buildFromIndex(indices[g], groupLists[g], firstIndices[g], true, groupSymbols[g]);
+	});
+	// Merge the names of the groups into the tree and renumber the name IDs of their nodes concurrently
+	std::vector<std::vector<uint32_t>> remaps(groupCount);
+	for(unsigned int g = 0; g < groupCount; ++g) {
+		remaps[g] = t->symbols.merge(groupSymbols[g]);
+	}
+	runConcurrently(groupCount, threads, [&] (unsigned int g) {
+		const std::vector<uint32_t> &remap = remaps[g];
+		for(uint32_t i = firstIndices[g]; i < firstIndices[g] + indices[g].nodeCount; ++i) {
+			NodeCore &core = t->pool[i].core;
+			core.nameId = remap[core.nameId];
+		}
+	});
+	// Put the top-level nodes of the groups below the root
+	for(ChildList &list : groupLists) {
+		tree->root.children.splice(list);
+	}
+	TBUF_STAT(
+		for(const StructuralIndex &index : indices) {
+			t->statsIndexed(index);
+		}
+		t->stats.bytesScanned += len;
+	);
+
+	return tree;
+}
+
+} // end of namespace tbuf
+
+#endif // TURBO_BUF_PARALLEL_H
@@ -0,0 +1,238 @@
+// tbuf_reader.h: Pull-style cursor over the structure of a message - the caller drives the parsing, no tree is built.
+
+#ifndef TURBO_BUF_READER_H
+#define TURBO_BUF_READER_H
+
+#include<type_traits>
+#include"fio.h"
+#include"tbuf.h"
+#include"tbuf_scan.h"
+#include"tbuf_events.h"
+
+namespace tbuf {
+
+/** What the Reader is on */
+enum class ReaderKind {
+	/** Before the first next() or after the end of the input */
+	NONE,
+	/** The root: always the first - hexes() are the root hexes (if any) */
+	ROOT,
+	/** A normal node: name() and hexes() - words are normal nodes too (closed right away) */
+	NORM,
+	/** A text node: name() and text() */
+	TEXT,
+	/** The end of the last normal node that is still open */
+	CLOSE,
+};
+
+/**
+ * A cursor over any fio::Input that reads one item at a time - scanning the same way as Tree::parseNode (whitespace
+ * is always ignored) but without building or copying anything. Every NORM item is followed by its children and a
+ * CLOSE item with the same depth (even for words), so consumers can keep the structure in their own state machines.
+ * Uninteresting subtrees can be jumped over with skipChildren() at scanning speed.
+ *
+ * Usage:
+ *     tbuf::Reader<fio::FastInput> reader(input);
+ *     while(reader.next()) {
+ *         if(reader.kind() == tbuf::ReaderKind::NORM && !interesting(reader.name())) reader.skipChildren();
+ *     }
+ *
+ * Rem.: The name, hexes and text are only valid until the next next() or skipChildren() call unless the input
+ *       supports persistent grabs!
+ */
+template<class InputSubClass>
+class Reader {
+public:
+	explicit Reader(InputSubClass &_input) : input(_input) {
+		// Only here to ensure type safety in our case of template usage...
+		static_assert(std::is_base_of<fio::Input, InputSubClass>::value, "Reader needs a subclass of fio::Input!");
+	}
+
+	/**
+	 * Moves to the next item - returns false at the end of the input (then kind() is NONE). Like a Tree, we drop
+	 * a token that is cut off at the end and the nodes that are still open then are never closed (see isCutOff()).
+	 */
+	inline bool next() {
+		const ScanKernels &k = Scan::active();
+		if(!started) {
+			// Root hexes can only come at the very start
+			started = true;
+			currentHexes = Hexes::EMPTY_HEXES();
+			if(Hexes::isHexCharacter(input.grabCurr())) {
+				void* hexSeam = input.markSeam();
+				Scan::advanceOver(input, k.hexRun);
+				currentHexes = Hexes{input.grabFromSeamToLast(hexSeam)};
+			}
+			return item(ReaderKind::ROOT, 0);
+		}
+		if(afterText) {
+			// We stayed on the closing '}' of the text so that it was valid until now
+			afterText = false;
+			input.advance();
+		}
+		if(pendingClose) {
+			pendingClose = false;
+			return item(ReaderKind::CLOSE, itemDepth);
+		}
+		while(true) {
+			char c = input.grabCurr();
+			if(c == EOF) {
+				cutOff = cutOff || (level > 0);
+				return item(ReaderKind::NONE, 0);
+			} else if(Scan::isWhiteSpace(c)) {
+				Scan::advanceOver(input, k.whiteSpaceRun);
+			} else if(c == SYM_COMMENT) {
+				// Comments only start at tokens so a '#' in a name or a text does not start one
+				Scan::advanceOver(input, k.lineEnd);
+			} else if(c == SYM_STRING_NODE) {
+				return readText();
+			} else if(c == SYM_CLOSE_NODE) {
+				input.advance();
+				// A '}' on the top level is just ignored (like in the tree parser)
+				if(level > 0) {
+					return item(ReaderKind::CLOSE, level--);
+				}
+			} else {
+				return readNormal();
+			}
+		}
+	}
+
+	/**
+	 * Jumps over the children of the current normal node: the next item is its CLOSE. On the root it jumps to the
+	 * end of the input and on other items it does nothing. Returns false when the input ends in the skipped part.
+	 */
+	inline bool skipChildren() {
+		if(currentKind == ReaderKind::ROOT) {
+			for(fio::LenString ahead = input.grabAhead(); ahead.length > 0; ahead = input.grabAhead()) {
+				input.advance(ahead.length);
+			}
+			return true;
+		} else if((currentKind != ReaderKind::NORM) || !hasBody) {
+			return true;
+		}
+		hasBody = false;
+		if(!SubtreeSkipper::skip(input)) {
+			cutOff = true;
+			return false;
+		}
+		--level;
+		pendingClose = true;
+		return true;
+	}
+
+	/** The kind of the current item */
+	inline ReaderKind kind() const {
+		return currentKind;
+	}
+
+	/** The name of the current NORM or TEXT item (text node names have the '$') */
+	inline fio::LenString name() const {
+		return currentName;
+	}
+
+	/** The hexes of the current NORM or ROOT item (empty when it has none) */
+	inline Hexes hexes() const {
+		return currentHexes;
+	}
+
+	/** The raw text of the current TEXT item - the escapes are still there (see unescapeText(..)) */
+	inline fio::LenString text() const {
+		return currentText;
+	}
+
+	/** The depth of the current item: zero for the root, one for its children - a CLOSE has the depth of its node */
+	inline unsigned int depth() const {
+		return itemDepth;
+	}
+
+	/** Tells if the input ended in the middle of a token or with open nodes */
+	inline bool isCutOff() const {
+		return cutOff;
+	}
+
+private:
+	InputSubClass &input;
+	ReaderKind currentKind = ReaderKind::NONE;
+	fio::LenString currentName {0, nullptr};
+	Hexes currentHexes = Hexes::EMPTY_HEXES();
+	fio::LenString currentText {0, nullptr};
+	unsigned int itemDepth = 0;
+	/** The number of the open normal nodes */
+	unsigned int level = 0;
+	bool started = false;
+	/** The current NORM item has a '{...}' body (its children come or can be skipped) */
+	bool hasBody = false;
+	/** The CLOSE of a word or a skipped node comes next */
+	bool pendingClose = false;
+	/** We are on the closing '}' of the current TEXT item */
+	bool afterText = false;
+	bool cutOff = false;
+
+	inline bool item(ReaderKind kind, unsigned int depth) {
+		currentKind = kind;
+		itemDepth = depth;
+		return kind != ReaderKind::NONE;
+	}
+
+	/** Reads a text node from its '$' */
+	inline bool readText() {
+		// The name and the text are grabbed from one seam so that both stay valid for the caller even for streams
+		void* seam = input.markSeam();
+		unsigned int nameLength = (unsigned int)Scan::advanceOver(input, SubtreeSkipper::openBrace);
+		if(input.grabCurr() != EOF) {
+			input.advance();
+			if(SubtreeSkipper::advanceToTextEnd(input)) {
+				fio::LenString whole = input.grabFromSeamToLast(seam);
+				currentName = fio::LenString{nameLength, whole.startPtr};
+				currentText = fio::LenString{whole.length - nameLength - 1, whole.startPtr + nameLength + 1};
+				afterText = true;
+				return item(ReaderKind::TEXT, level + 1);
+			}
+		}
+		// Syntax error - the text node is never closed (we grab from seam only to ensure mark/grab pairing!)
+		input.grabFromSeamToLast(seam);
+		cutOff = true;
+		return item(ReaderKind::NONE, 0);
+	}
+
+	/** Reads a normal node (or a word) from the first letter of its name */
+	inline bool readNormal() {
+		const ScanKernels &k = Scan::active();
+		// The name and the hexes are grabbed from one seam so that both stay valid for the caller even for streams
+		void* seam = input.markSeam();
+		// The first character is always part of the name
+		input.advance();
+		unsigned int nameLength = 1 + (unsigned int)Scan::advanceOver(input, k.nameEnd);
+		char c = input.grabCurr();
+		if(c == SYM_OPEN_NODE) {
+			input.advance();
+			// The tree drops a '{' at the very end
+			c = input.grabCurr();
+			if(c != EOF) {
+				unsigned int hexLength = (unsigned int)Scan::advanceOver(input, k.hexRun);
+				fio::LenString whole = input.grabFromSeamToLast(seam);
+				currentName = fio::LenString{nameLength, whole.startPtr};
+				currentHexes = (hexLength > 0) ? Hexes{fio::LenString{hexLength, whole.startPtr + nameLength + 1}} : Hexes::EMPTY_HEXES();
+				hasBody = true;
+				return item(ReaderKind::NORM, ++level);
+			}
+		}
+		if(c == EOF) {
+			// Syntax error - no opening tag after tag name!
+			input.grabFromSeamToLast(seam);
+			cutOff = true;
+			return item(ReaderKind::NONE, 0);
+		}
+		// An empty leaf (the whitespace after it is the next token)
+		currentName = input.grabFromSeamToLast(seam);
+		currentHexes = Hexes::EMPTY_HEXES();
+		hasBody = false;
+		pendingClose = true;
+		return item(ReaderKind::NORM, level + 1);
+	}
+};
+
+} // end of namespace tbuf
+
+#endif // TURBO_BUF_READER_H
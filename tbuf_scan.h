@@ -0,0 +1,431 @@
+// tbuf_scan.h: Vectorized scanner kernels for the hot loops of the turbo-buf parsers.
+// Every kernel has a scalar fallback and SSE2/AVX2 variants on x86 that are chosen at runtime.
+
+#ifndef TURBO_BUF_SCAN_H
+#define TURBO_BUF_SCAN_H
+
+#include<cstdint>
+#include<cstring>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define TBUF_SCAN_X86 1
+#include<immintrin.h>
+#endif
+
+namespace tbuf {
+
+/** The instruction set levels the scanner kernels are implemented for */
+enum class ScanLevel {
+	/** Portable byte-by-byte (table driven) code */
+	SCALAR = 0,
+	/** 16 bytes at a time */
+	SSE2 = 1,
+	/** 32 bytes at a time */
+	AVX2 = 2,
+};
+
+/** Bitmaps of the interesting character classes in a 64 byte block (bit i stands for the i-th character) */
+struct BlockMasks {
+	/** The '{' characters */
+	uint64_t open;
+	/** The '}' characters */
+	uint64_t close;
+	/** The '$' characters */
+	uint64_t dollar;
+	/** The '#' characters */
+	uint64_t comment;
+	/** The '\' characters */
+	uint64_t escape;
+	/** The whitespace characters */
+	uint64_t white;
+	/** The '\n' and '\r' characters */
+	uint64_t lineEnd;
+	/** The ['0'..'9'] and ['A'..'F'] characters */
+	uint64_t hex;
+};
+
+/**
+ * A set of scanner kernels for one instruction set level.
+ * Every kernel gets a pointer and a length and returns the index of the first character where the scanning stops
+ * or the length itself when the scanning did not stop in the given range (so the caller should continue after).
+ */
+struct ScanKernels {
+	/** Stops at the first character that is not among ['0'..'9'] or ['A'..'F'] - that is: returns the length of the hex run */
+	unsigned int (*hexRun)(const char *p, unsigned int len);
+	/** Stops at the first '{' or whitespace - that is: at the end of a node name */
+	unsigned int (*nameEnd)(const char *p, unsigned int len);
+	/** Stops at the first structural character: '{', '}', '$', '#' or '\' */
+	unsigned int (*structural)(const char *p, unsigned int len);
+	/** Stops at the first '}' or '\' - these are the only interesting characters in text-node bodies */
+	unsigned int (*textSpecial)(const char *p, unsigned int len);
+	/** Stops at the first '\n' or '\r' - the end of comments */
+	unsigned int (*lineEnd)(const char *p, unsigned int len);
+	/** Stops at the first non-whitespace character - that is: returns the length of the whitespace run */
+	unsigned int (*whiteSpaceRun)(const char *p, unsigned int len);
+	/** Fills the bitmaps of exactly 64 characters - this is the first stage of the structural indexing */
+	void (*blockMasks)(const char *p, BlockMasks &masks);
+};
+
+/**
+ * Contains the vectorized scanner kernels and their runtime dispatching.
+ * The parsers should call the static methods of this class which use the best kernels for the current CPU.
+ */
+class Scan {
+public:
+	// Character class bits for the scalar lookup table
+	static const unsigned char CC_HEX = 1;
+	static const unsigned char CC_WHITE = 2;
+	static const unsigned char CC_NAME_END = 4;
+	static const unsigned char CC_STRUCTURAL = 8;
+	static const unsigned char CC_TEXT_SPECIAL = 16;
+	static const unsigned char CC_LINE_END = 32;
+
+	/** Returns the character class bits of the given character */
+	inline static unsigned char classOf(char c) {
+		return charClasses()[(unsigned char)c];
+	}
+
+	/** Tells if the character is a whitespace - the same as isspace(c) in the "C" locale, but safe for any char */
+	inline static bool isWhiteSpace(char c) {
+		return (classOf(c) & CC_WHITE) != 0;
+	}
+
+	inline static unsigned int hexRun(const char *p, unsigned int len) {
+		return active().hexRun(p, len);
+	}
+
+	inline static unsigned int nameEnd(const char *p, unsigned int len) {
+		return active().nameEnd(p, len);
+	}
+
+	inline static unsigned int structural(const char *p, unsigned int len) {
+		return active().structural(p, len);
+	}
+
+	inline static unsigned int lineEnd(const char *p, unsigned int len) {
+		return active().lineEnd(p, len);
+	}
+
+	inline static unsigned int whiteSpaceRun(const char *p, unsigned int len) {
+		return active().whiteSpaceRun(p, len);
+	}
+
+	/**
+	 * Finds the closing unescaped '}' of a text-node body. Every character after a '\' is taken literally, so
+	 * "\\}" closes the node (escaped '\') while "\}" does not. The escaped flag carries the state between calls
+	 * so that the body can be scanned in multiple parts: set it to false at the start of the body.
+	 * Returns the index of the closing '}' or len when it is not in the given range.
+	 */
+	inline static unsigned int textEnd(const char *p, unsigned int len, bool &escaped) {
+		unsigned int i = 0;
+		if(escaped) {
+			if(len == 0) {
+				return 0;
+			}
+			// The first character is escaped
+			escaped = false;
+			i = 1;
+		}
+		const ScanKernels &k = active();
+		while(true) {
+			i += k.textSpecial(p + i, len - i);
+			if(i >= len) {
+				return len;
+			}
+			if(p[i] == '}') {
+				return i;
+			}
+			// Found a '\' so the next character is escaped
+			if(i + 1 >= len) {
+				escaped = true;
+				return len;
+			}
+			i += 2;
+		}
+	}
+
+	/**
+	 * Advances the input (a subclass of fio::Input) while the given kernel does not stop on the characters
+	 * that grabAhead() gives us. This might go over multiple buffered parts in case of streaming inputs.
+	 * Returns the number of characters advanced over.
+	 */
+	template<class InputSubClass, class Kernel>
+	inline static size_t advanceOver(InputSubClass &input, Kernel kernel) {
+		size_t advanced = 0;
+		while(true) {
+			auto ahead = input.grabAhead();
+			unsigned int n = kernel(ahead.startPtr, ahead.length);
+			input.advance(n);
+			advanced += n;
+			if((n < ahead.length) || (ahead.length == 0)) {
+				return advanced;
+			}
+		}
+	}
+
+	/** Returns the best level the current CPU supports */
+	inline static ScanLevel bestLevel() {
+#ifdef TBUF_SCAN_X86
+		if(__builtin_cpu_supports("avx2")) {
+			return ScanLevel::AVX2;
+		}
+		if(__builtin_cpu_supports("sse2")) {
+			return ScanLevel::SSE2;
+		}
+#endif
+		return ScanLevel::SCALAR;
+	}
+
+	/** Returns the kernels of the given level (or of the best lower level this build supports) */
+	inline static ScanKernels kernelsFor(ScanLevel level) {
+#ifdef TBUF_SCAN_X86
+		if(level == ScanLevel::AVX2) {
+			return ScanKernels {
+				avx2Find<HexRun>, avx2Find<NameEnd>, avx2Find<Structural>,
+				avx2Find<TextSpecial>, avx2Find<LineEnd>, avx2Find<WhiteSpaceRun>,
+				avx2BlockMasks
+			};
+		}
+		if(level == ScanLevel::SSE2) {
+			return ScanKernels {
+				sse2Find<HexRun>, sse2Find<NameEnd>, sse2Find<Structural>,
+				sse2Find<TextSpecial>, sse2Find<LineEnd>, sse2Find<WhiteSpaceRun>,
+				sse2BlockMasks
+			};
+		}
+#endif
+		return ScanKernels {
+			scalarFind<CC_HEX, true>, scalarFind<CC_NAME_END, false>, scalarFind<CC_STRUCTURAL, false>,
+			scalarFind<CC_TEXT_SPECIAL, false>, scalarFind<CC_LINE_END, false>, scalarFind<CC_WHITE, true>,
+			scalarBlockMasks
+		};
+	}
+
+	/**
+	 * Makes the scanner use the kernels of the given level from now on. Useful for benchmarking and testing.
+	 * Do not call this while other threads are parsing! Using a level the CPU does not support is undefined.
+	 */
+	inline static void useLevel(ScanLevel level) {
+		active() = kernelsFor(level);
+	}
+
+	/** Returns the kernels in use - these are the kernels of the bestLevel() unless useLevel changed them */
+	inline static ScanKernels& active() {
+		static ScanKernels kernels = kernelsFor(bestLevel());
+		return kernels;
+	}
+
+private:
+	/** The lookup table for the scalar kernels */
+	inline static const unsigned char* charClasses() {
+		static const struct Table {
+			unsigned char cc[256];
+			Table() {
+				memset(cc, 0, sizeof(cc));
+				for(int c = '0'; c <= '9'; ++c) cc[c] |= CC_HEX;
+				for(int c = 'A'; c <= 'F'; ++c) cc[c] |= CC_HEX;
+				const char *white = " \t\n\v\f\r";
+				for(const char *w = white; *w != 0; ++w) cc[(unsigned char)*w] |= CC_WHITE | CC_NAME_END;
+				cc[(unsigned char)'{'] |= CC_NAME_END | CC_STRUCTURAL;
+				cc[(unsigned char)'}'] |= CC_STRUCTURAL | CC_TEXT_SPECIAL;
+				cc[(unsigned char)'$'] |= CC_STRUCTURAL;
+				cc[(unsigned char)'#'] |= CC_STRUCTURAL;
+				cc[(unsigned char)'\\'] |= CC_STRUCTURAL | CC_TEXT_SPECIAL;
+				cc[(unsigned char)'\n'] |= CC_LINE_END;
+				cc[(unsigned char)'\r'] |= CC_LINE_END;
+			}
+		} table;
+		return table.cc;
+	}
+
+	/** Scalar kernel: stops at the first character that has (or has not when inverted) the given class */
+	template<unsigned char CLASS, bool INVERTED>
+	static unsigned int scalarFind(const char *p, unsigned int len) {
+		const unsigned char *cc = charClasses();
+		for(unsigned int i = 0; i < len; ++i) {
+			if(((cc[(unsigned char)p[i]] & CLASS) != 0) != INVERTED) {
+				return i;
+			}
+		}
+		return len;
+	}
+
+	/** Scalar kernel for the block bitmaps */
+	static void scalarBlockMasks(const char *p, BlockMasks &m) {
+		const unsigned char *cc = charClasses();
+		m = BlockMasks {0, 0, 0, 0, 0, 0, 0, 0};
+		for(unsigned int i = 0; i < 64; ++i) {
+			uint64_t bit = 1ULL << i;
+			char c = p[i];
+			unsigned char cls = cc[(unsigned char)c];
+			if(c == '{') m.open |= bit;
+			if(c == '}') m.close |= bit;
+			if(c == '$') m.dollar |= bit;
+			if(c == '#') m.comment |= bit;
+			if(c == '\\') m.escape |= bit;
+			if(cls & CC_WHITE) m.white |= bit;
+			if(cls & CC_LINE_END) m.lineEnd |= bit;
+			if(cls & CC_HEX) m.hex |= bit;
+		}
+	}
+
+#ifdef TBUF_SCAN_X86
+	// The vector predicates: they return 0xFF bytes where the scanning should stop.
+	// Rem.: SSE2 and AVX2 have no unsigned byte compares so ranges are checked with min_epu8(x, max) == x
+
+	struct HexRun {
+		static const bool INVERTED = true;
+		__attribute__((target("sse2"))) static __m128i sse2(__m128i v) {
+			__m128i d = _mm_sub_epi8(v, _mm_set1_epi8('0'));
+			__m128i h = _mm_sub_epi8(v, _mm_set1_epi8('A'));
+			__m128i isDigit = _mm_cmpeq_epi8(_mm_min_epu8(d, _mm_set1_epi8(9)), d);
+			__m128i isHexit = _mm_cmpeq_epi8(_mm_min_epu8(h, _mm_set1_epi8(5)), h);
+			return _mm_or_si128(isDigit, isHexit);
+		}
+		__attribute__((target("avx2"))) static __m256i avx2(__m256i v) {
+			__m256i d = _mm256_sub_epi8(v, _mm256_set1_epi8('0'));
+			__m256i h = _mm256_sub_epi8(v, _mm256_set1_epi8('A'));
+			__m256i isDigit = _mm256_cmpeq_epi8(_mm256_min_epu8(d, _mm256_set1_epi8(9)), d);
+			__m256i isHexit = _mm256_cmpeq_epi8(_mm256_min_epu8(h, _mm256_set1_epi8(5)), h);
+			return _mm256_or_si256(isDigit, isHexit);
+		}
+		static bool scalar(char c) { return (classOf(c) & CC_HEX) != 0; }
+	};
+
+	struct WhiteSpaceRun {
+		static const bool INVERTED = true;
+		__attribute__((target("sse2"))) static __m128i sse2(__m128i v) {
+			__m128i w = _mm_sub_epi8(v, _mm_set1_epi8('\t'));
+			__m128i isControl = _mm_cmpeq_epi8(_mm_min_epu8(w, _mm_set1_epi8('\r' - '\t')), w);
+			return _mm_or_si128(isControl, _mm_cmpeq_epi8(v, _mm_set1_epi8(' ')));
+		}
+		__attribute__((target("avx2"))) static __m256i avx2(__m256i v) {
+			__m256i w = _mm256_sub_epi8(v, _mm256_set1_epi8('\t'));
+			__m256i isControl = _mm256_cmpeq_epi8(_mm256_min_epu8(w, _mm256_set1_epi8('\r' - '\t')), w);
+			return _mm256_or_si256(isControl, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')));
+		}
+		static bool scalar(char c) { return (classOf(c) & CC_WHITE) != 0; }
+	};
+
+	struct NameEnd {
+		static const bool INVERTED = false;
+		__attribute__((target("sse2"))) static __m128i sse2(__m128i v) {
+			return _mm_or_si128(WhiteSpaceRun::sse2(v), _mm_cmpeq_epi8(v, _mm_set1_epi8('{')));
+		}
+		__attribute__((target("avx2"))) static __m256i avx2(__m256i v) {
+			return _mm256_or_si256(WhiteSpaceRun::avx2(v), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('{')));
+		}
+		static bool scalar(char c) { return (classOf(c) & CC_NAME_END) != 0; }
+	};
+
+	struct Structural {
+		static const bool INVERTED = false;
+		__attribute__((target("sse2"))) static __m128i sse2(__m128i v) {
+			__m128i braces = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('{')), _mm_cmpeq_epi8(v, _mm_set1_epi8('}')));
+			__m128i specials = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('$')), _mm_cmpeq_epi8(v, _mm_set1_epi8('#')));
+			return _mm_or_si128(_mm_or_si128(braces, specials), _mm_cmpeq_epi8(v, _mm_set1_epi8('\\')));
+		}
+		__attribute__((target("avx2"))) static __m256i avx2(__m256i v) {
+			__m256i braces = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('{')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('}')));
+			__m256i specials = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('$')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('#')));
+			return _mm256_or_si256(_mm256_or_si256(braces, specials), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\')));
+		}
+		static bool scalar(char c) { return (classOf(c) & CC_STRUCTURAL) != 0; }
+	};
+
+	struct TextSpecial {
+		static const bool INVERTED = false;
+		__attribute__((target("sse2"))) static __m128i sse2(__m128i v) {
+			return _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('}')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\\')));
+		}
+		__attribute__((target("avx2"))) static __m256i avx2(__m256i v) {
+			return _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('}')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\')));
+		}
+		static bool scalar(char c) { return (classOf(c) & CC_TEXT_SPECIAL) != 0; }
+	};
+
+	struct LineEnd {
+		static const bool INVERTED = false;
+		__attribute__((target("sse2"))) static __m128i sse2(__m128i v) {
+			return _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\r')));
+		}
+		__attribute__((target("avx2"))) static __m256i avx2(__m256i v) {
+			return _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r')));
+		}
+		static bool scalar(char c) { return (classOf(c) & CC_LINE_END) != 0; }
+	};
+
+	/** SSE2 kernel for the block bitmaps: 4 times 16 characters */
+	__attribute__((target("sse2"))) static void sse2BlockMasks(const char *p, BlockMasks &m) {
+		m = BlockMasks {0, 0, 0, 0, 0, 0, 0, 0};
+		for(unsigned int i = 0; i < 64; i += 16) {
+			__m128i v = _mm_loadu_si128((const __m128i*)(p + i));
+			m.open |= (uint64_t)(unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('{'))) << i;
+			m.close |= (uint64_t)(unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('}'))) << i;
+			m.dollar |= (uint64_t)(unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('$'))) << i;
+			m.comment |= (uint64_t)(unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('#'))) << i;
+			m.escape |= (uint64_t)(unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\\'))) << i;
+			m.white |= (uint64_t)(unsigned int)_mm_movemask_epi8(WhiteSpaceRun::sse2(v)) << i;
+			m.lineEnd |= (uint64_t)(unsigned int)_mm_movemask_epi8(LineEnd::sse2(v)) << i;
+			m.hex |= (uint64_t)(unsigned int)_mm_movemask_epi8(HexRun::sse2(v)) << i;
+		}
+	}
+
+	/** AVX2 kernel for the block bitmaps: 2 times 32 characters */
+	__attribute__((target("avx2"))) static void avx2BlockMasks(const char *p, BlockMasks &m) {
+		m = BlockMasks {0, 0, 0, 0, 0, 0, 0, 0};
+		for(unsigned int i = 0; i < 64; i += 32) {
+			__m256i v = _mm256_loadu_si256((const __m256i*)(p + i));
+			m.open |= (uint64_t)(unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('{'))) << i;
+			m.close |= (uint64_t)(unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('}'))) << i;
+			m.dollar |= (uint64_t)(unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('$'))) << i;
+			m.comment |= (uint64_t)(unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('#'))) << i;
+			m.escape |= (uint64_t)(unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\'))) << i;
+			m.white |= (uint64_t)(unsigned int)_mm256_movemask_epi8(WhiteSpaceRun::avx2(v)) << i;
+			m.lineEnd |= (uint64_t)(unsigned int)_mm256_movemask_epi8(LineEnd::avx2(v)) << i;
+			m.hex |= (uint64_t)(unsigned int)_mm256_movemask_epi8(HexRun::avx2(v)) << i;
+		}
+	}
+
+	/** SSE2 kernel: 16 bytes at a time using the predicate, the tail is done with the scalar predicate */
+	template<class PRED>
+	__attribute__((target("sse2"))) static unsigned int sse2Find(const char *p, unsigned int len) {
+		unsigned int i = 0;
+		for(; i + 16 <= len; i += 16) {
+			unsigned int mask = (unsigned int)_mm_movemask_epi8(PRED::sse2(_mm_loadu_si128((const __m128i*)(p + i))));
+			if(PRED::INVERTED) {
+				mask = ~mask & 0xFFFF;
+			}
+			if(mask != 0) {
+				return i + __builtin_ctz(mask);
+			}
+		}
+		for(; i < len; ++i) {
+			if(PRED::scalar(p[i]) != PRED::INVERTED) {
+				return i;
+			}
+		}
+		return len;
+	}
+
+	/** AVX2 kernel: 32 bytes at a time using the predicate, the tail is done with the SSE2 kernel */
+	template<class PRED>
+	__attribute__((target("avx2"))) static unsigned int avx2Find(const char *p, unsigned int len) {
+		unsigned int i = 0;
+		for(; i + 32 <= len; i += 32) {
+			unsigned int mask = (unsigned int)_mm256_movemask_epi8(PRED::avx2(_mm256_loadu_si256((const __m256i*)(p + i))));
+			if(PRED::INVERTED) {
+				mask = ~mask;
+			}
+			if(mask != 0) {
+				return i + __builtin_ctz(mask);
+			}
+		}
+		return i + sse2Find<PRED>(p + i, len - i);
+	}
+#endif // TBUF_SCAN_X86
+};
+
+} // end of namespace tbuf
+
+#endif // TURBO_BUF_SCAN_H
@@ -0,0 +1,178 @@
+// tbuf_schema.h: Runtime support for the schema-specific parsers that tbnfgen generates from tbnf files.
+
+#ifndef TURBO_BUF_SCHEMA_H
+#define TURBO_BUF_SCHEMA_H
+
+#include<cstdint>
+#include<cstring>
+#include<string>
+#include"fio.h"
+#include"tbuf.h"
+#include"tbuf_scan.h"
+
+namespace tbuf {
+
+/**
+ * A cursor over the text form of a message for the generated parsers (see tbnfgen.cpp). It scans the input the same
+ * way Tree does (with the same kernels, whitespace, comments, words and escapes) but builds nothing: the generated
+ * code asks for the children one by one, compares their names right where they are in the input and reads the
+ * hexes and texts straight into its structs. This works on any fio::Input subclass.
+ *
+ * The name of the current child and the hexes are only valid until the next read (streams refill their buffers).
+ */
+template<class InputSubClass>
+class SchemaReader {
+public:
+	/** What next() has found */
+	enum class Token {
+		/** A node with a body: name{ */
+		NODE,
+		/** An empty leaf: a name without a body */
+		WORD,
+		/** A text node: $name{ */
+		TEXT,
+		/** The end of the current node (its '}' or the end of the input for the root) */
+		END,
+		/** Syntax error: the input ended inside a node or a '}' came on the top level */
+		ERROR
+	};
+
+	SchemaReader(InputSubClass &_input) : input(_input), depth(0), pendingEnd(false), name{0, nullptr} {}
+
+	/** Reads the next child of the current node - its name is in name() after this */
+	inline Token next() {
+		if(pendingEnd) {
+			pendingEnd = false;
+			return Token::END;
+		}
+		char c;
+		while(true) {
+			c = input.grabCurr();
+			if(c == EOF) {
+				return (depth == 0) ? Token::END : Token::ERROR;
+			} else if(Scan::isWhiteSpace(c)) {
+				Scan::advanceOver(input, Scan::active().whiteSpaceRun);
+			} else if(c == SYM_COMMENT) {
+				Scan::advanceOver(input, Scan::active().lineEnd);
+			} else if(c == SYM_CLOSE_NODE) {
+				if(depth == 0) {
+					return Token::ERROR;
+				}
+				input.advance();
+				--depth;
+				return Token::END;
+			} else {
+				break;
+			}
+		}
+		void* seam = input.markSeam();
+		if(c == SYM_STRING_NODE) {
+			Scan::advanceOver(input, [] (const char *p, unsigned int len) {
+				const char *found = (const char*)memchr(p, SYM_OPEN_NODE, len);
+				return (found != nullptr) ? (unsigned int)(found - p) : len;
+			});
+			name = input.grabFromSeamToLast(seam);
+			return (input.grabCurr() == EOF) ? Token::ERROR : Token::TEXT;
+		}
+		// The first character is always part of the name
+		input.advance();
+		Scan::advanceOver(input, Scan::active().nameEnd);
+		c = input.grabCurr();
+		name = input.grabFromSeamToLast(seam);
+		if(c == EOF) {
+			return Token::ERROR;
+		}
+		return (c == SYM_OPEN_NODE) ? Token::NODE : Token::WORD;
+	}
+
+	/** The name of the child that next() has found */
+	inline fio::LenString currentName() const {
+		return name;
+	}
+
+	/** Tells if the name of the child that next() has found is the given one */
+	inline bool nameIs(const char *literal, unsigned int length) const {
+		return (name.length == length) && (memcmp(name.startPtr, literal, length) == 0);
+	}
+
+	/** Goes into the NODE or WORD that next() has found so its body can be read (a WORD has an empty body) */
+	inline void enter(Token token) {
+		if(token == Token::NODE) {
+			input.advance();
+			++depth;
+		} else {
+			pendingEnd = true;
+		}
+	}
+
+	/** Reads the hexes at the start of the current body (right after entering it or at the start of the input) */
+	inline fio::LenString hexes() {
+		if(pendingEnd || !Hexes::isHexCharacter(input.grabCurr())) {
+			return fio::LenString{0, nullptr};
+		}
+		void* seam = input.markSeam();
+		Scan::advanceOver(input, Scan::active().hexRun);
+		return input.grabFromSeamToLast(seam);
+	}
+
+	/** Goes into the NODE or WORD that next() has found and tells if its body is empty */
+	inline bool skipEmpty(Token token) {
+		enter(token);
+		return (hexes().length == 0) && (next() == Token::END);
+	}
+
+	/** Reads the (unescaped) text of the TEXT node that next() has found - returns false when it is not closed */
+	inline bool text(std::string &out) {
+		out.clear();
+		// Over the '{'
+		input.advance();
+		const ScanKernels &k = Scan::active();
+		while(true) {
+			fio::LenString ahead = input.grabAhead();
+			if(ahead.length == 0) {
+				return false;
+			}
+			unsigned int n = k.textSpecial(ahead.startPtr, ahead.length);
+			out.append(ahead.startPtr, n);
+			if(n == ahead.length) {
+				input.advance(n);
+				continue;
+			}
+			char special = ahead.startPtr[n];
+			input.advance(n + 1);
+			if(special == SYM_CLOSE_NODE) {
+				return true;
+			}
+			// The character after the escape is taken literally
+			char c = input.grabCurr();
+			if(c == EOF) {
+				return false;
+			}
+			out.push_back(c);
+			input.advance();
+		}
+	}
+
+	/** Decodes hexes into an integer (the value of the lowest 64 bits) */
+	template<class T>
+	inline static T valueOf(fio::LenString digits) {
+		return (T)Hexes{digits}.asIntegral();
+	}
+
+	/** Decodes hexes into bytes (an odd count has an implicit leading zero) */
+	inline static void bytesOf(fio::LenString digits, uint8_t *out, size_t cap) {
+		Hexes{digits}.decodeBytes(out, cap);
+	}
+
+private:
+	InputSubClass &input;
+	/** The depth of the current node (0 for the root) */
+	unsigned int depth;
+	/** A WORD was entered: its body is empty so the next read ends it */
+	bool pendingEnd;
+	fio::LenString name;
+};
+
+} // end of namespace tbuf
+
+#endif // TURBO_BUF_SCHEMA_H
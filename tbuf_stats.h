@@ -0,0 +1,149 @@
+// tbuf_stats.h: Optional counters and phase timers of the parser and the queries.
+
+#ifndef TURBO_BUF_STATS_H
+#define TURBO_BUF_STATS_H
+
+#include<chrono>
+#include<cstdint>
+#include<cstdio>
+#if defined(TBUF_STATS_TIMERS) && (defined(__x86_64__) || defined(__i386__))
+#include<x86intrin.h>
+#endif
+
+/**
+ * The counters are only compiled in when TBUF_STATS is defined before including tbuf.h (like TBUF_ASSERT). Without
+ * it the statements in TBUF_STAT(..) are not compiled at all so the instrumentation costs nothing.
+ * Rem.: Define it the same way in every translation unit as it changes the layout of Tree!
+ */
+#ifdef TBUF_STATS
+#define TBUF_STAT(...) do { __VA_ARGS__; } while(0)
+#else
+#define TBUF_STAT(...) do {} while(0)
+#endif
+
+/**
+ * Times the rest of the scope into the given phase of the given TreeStats (that can be nullptr). Only compiled in
+ * when both TBUF_STATS and TBUF_STATS_TIMERS are defined: reading the timestamp counter costs a few dozen cycles.
+ */
+#if defined(TBUF_STATS) && defined(TBUF_STATS_TIMERS)
+#define TBUF_PHASE(statsPtr, phase) ::tbuf::PhaseTimer tbufPhaseTimer((statsPtr), (phase))
+#else
+#define TBUF_PHASE(statsPtr, phase) do {} while(0)
+#endif
+
+namespace tbuf {
+
+/** The phases of the phase timers - nested phases are included in the outer ones (a lazy parse in a query) */
+enum class StatsPhase {
+	/** Building a tree (from an input or from a structural index) */
+	PARSE = 0,
+	/** Parsing the lazy children on their first access */
+	LAZY_PARSE = 1,
+	/** Running queries (fetch, compiled queries and path literals) */
+	QUERY = 2,
+};
+
+const unsigned int STATS_PHASE_COUNT = 3;
+
+/**
+ * The counters of one tree (see Tree::stats). Everything is a plain integer that is only changed by the thread
+ * using the tree - reading them while another thread parses or queries is not safe.
+ */
+struct TreeStats {
+	/** The characters the parser has scanned (lazy trees scan the bodies again when their children get parsed) */
+	uint64_t bytesScanned = 0;
+	/** The nodes built - indexed by NodeKind (EMPTY, ROOT, NORM, TEXT) */
+	uint64_t nodesByKind[4] = {0, 0, 0, 0};
+	/** Strings copied into the tree-owned set (hexes and texts when the input cannot be referred) */
+	uint64_t treeStringInserts = 0;
+	/** The inserts that found an already stored equal string */
+	uint64_t treeStringHits = 0;
+	/** The blocks of the node pool (the node memory is never reallocated - it grows by blocks) */
+	uint64_t poolBlocks = 0;
+	/** The times the symbol table of the names was doubled */
+	uint64_t symbolRehashes = 0;
+	uint64_t comments = 0;
+	uint64_t commentBytes = 0;
+	uint64_t whiteSpaceRuns = 0;
+	uint64_t whiteSpaceBytes = 0;
+	/** The deepest level the parser has reached (the children of the root are on level one) */
+	uint32_t maxDepth = 0;
+	/** The queries run on the tree */
+	uint64_t queries = 0;
+	/** The levels descended by the queries */
+	uint64_t descends = 0;
+	/** The children compared by the descends (a child index lookup counts as one) */
+	uint64_t descendComparisons = 0;
+	/** The time spent in the phases - in timestamp counter ticks (or nanoseconds where there is no such) */
+	uint64_t phaseTicks[STATS_PHASE_COUNT] = {0, 0, 0};
+
+	/** Zeroes every counter */
+	inline void reset() {
+		*this = TreeStats();
+	}
+
+	/**
+	 * Calls sink(const char *name, uint64_t value) for every counter - the names are stable snake_case names
+	 * so they can go right into a metrics pipeline.
+	 */
+	template<class Sink>
+	inline void forEach(Sink sink) const {
+		sink("bytes_scanned", bytesScanned);
+		sink("nodes_root", nodesByKind[1]);
+		sink("nodes_norm", nodesByKind[2]);
+		sink("nodes_text", nodesByKind[3]);
+		sink("tree_string_inserts", treeStringInserts);
+		sink("tree_string_hits", treeStringHits);
+		sink("pool_blocks", poolBlocks);
+		sink("symbol_rehashes", symbolRehashes);
+		sink("comments", comments);
+		sink("comment_bytes", commentBytes);
+		sink("whitespace_runs", whiteSpaceRuns);
+		sink("whitespace_bytes", whiteSpaceBytes);
+		sink("max_depth", maxDepth);
+		sink("queries", queries);
+		sink("descends", descends);
+		sink("descend_comparisons", descendComparisons);
+		sink("parse_ticks", phaseTicks[(int)StatsPhase::PARSE]);
+		sink("lazy_parse_ticks", phaseTicks[(int)StatsPhase::LAZY_PARSE]);
+		sink("query_ticks", phaseTicks[(int)StatsPhase::QUERY]);
+	}
+
+	/** Writes every counter as a "<prefix><name> <value>" line */
+	inline void print(FILE *out = stdout, const char *prefix = "tbuf.") const {
+		forEach([out, prefix] (const char *name, uint64_t value) {
+			fprintf(out, "%s%s %llu\n", prefix, name, (unsigned long long)value);
+		});
+	}
+
+	/** The current time for the phase timers */
+	inline static uint64_t ticks() {
+#if defined(TBUF_STATS_TIMERS) && (defined(__x86_64__) || defined(__i386__))
+		return __rdtsc();
+#else
+		return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+	}
+};
+
+/** Adds the ticks of its lifetime to a phase of the stats (see TBUF_PHASE) */
+class PhaseTimer {
+public:
+	PhaseTimer(TreeStats *_stats, StatsPhase _phase) : stats(_stats), phase(_phase), start(TreeStats::ticks()) {}
+
+	~PhaseTimer() {
+		if(stats != nullptr) {
+			stats->phaseTicks[(int)phase] += TreeStats::ticks() - start;
+		}
+	}
+
+private:
+	TreeStats *stats;
+	StatsPhase phase;
+	uint64_t start;
+};
+
+} // end of namespace tbuf
+
+#endif // TURBO_BUF_STATS_H
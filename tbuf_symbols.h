@@ -0,0 +1,211 @@
+// tbuf_symbols.h: Interning of turbo-buf node names so that names can be compared as small integers.
+
+#ifndef TURBO_BUF_SYMBOLS_H
+#define TURBO_BUF_SYMBOLS_H
+
+#include<algorithm>
+#include<atomic>
+#include<cstdint>
+#include<cstring>
+#include<memory>
+#include<vector>
+#include"fio.h"
+
+namespace tbuf {
+
+/** The symbol ID of names that are not in a symbol table */
+const uint32_t NO_SYMBOL = 0xFFFFFFFF;
+
+/**
+ * A table of the distinct node names of a tree. Every distinct name gets a small integer ID (in the order they
+ * were first seen, starting from zero) so nodes can be compared by their IDs instead of their names.
+ *
+ * The table stores one entry per distinct name: repeated names (like thousands of "fruit" nodes) cost nothing
+ * more. Names are either referred in place (when the memory outlives the table) or copied into the table once.
+ */
+class SymbolTable {
+public:
+	SymbolTable() : slots(INITIAL_SLOTS, NO_SYMBOL), serialNumber{nextSerial()} {}
+
+	// Nodes are referring the names in the arenas of the table so it cannot be copied or moved
+	SymbolTable(const SymbolTable&) = delete;
+	SymbolTable& operator=(const SymbolTable&) = delete;
+
+	/**
+	 * Returns the ID of the given name - adding it to the table when it is not there yet. When copy is false,
+	 * the table refers the memory of the name so that should outlive the table. Otherwise the name is copied
+	 * (zero terminated) into the table when it is new.
+	 */
+	inline uint32_t intern(fio::LenString name, bool copy) {
+		uint32_t hash = hashOf(name.startPtr, name.length);
+		uint32_t slot = findSlot(name, hash);
+		if(slots[slot] != NO_SYMBOL) {
+			return slots[slot];
+		}
+		const char *kept = copy ? copyToArena(name) : name.startPtr;
+		referredCount += !copy;
+		uint32_t id = (uint32_t)symbols.size();
+		symbols.push_back(Symbol{kept, name.length, hash, copy});
+		slots[slot] = id;
+		// Keep the load factor under one half
+		if(symbols.size() * 2 > slots.size()) {
+			rehash();
+		}
+		return id;
+	}
+
+	/** Returns the ID of the given name or NO_SYMBOL when the name is not in the table */
+	inline uint32_t find(const char *name, unsigned int length) const {
+		return find(name, length, hashOf(name, length));
+	}
+
+	/** The same as find(name, length) but with the hashOf the name already known (like for path literals) */
+	inline uint32_t find(const char *name, unsigned int length, uint32_t hash) const {
+		fio::LenString ls{length, (char*)name};
+		return slots[findSlot(ls, hash)];
+	}
+
+	/** Returns the name of the given symbol (zero terminated only when it was copied into the table) */
+	inline const char* nameOf(uint32_t id) const { return symbols[id].name; }
+
+	/** Returns the length of the name of the given symbol */
+	inline unsigned int lengthOf(uint32_t id) const { return symbols[id].length; }
+
+	/** Returns the number of distinct names */
+	inline size_t size() const { return symbols.size(); }
+
+	/** Returns the number of times the hash table was doubled so far */
+	inline unsigned int rehashCount() const { return __builtin_ctz((uint32_t)slots.size() / INITIAL_SLOTS); }
+
+	/**
+	 * Returns a number that is different for every table (and changes on clear) so cached IDs can be checked
+	 * against it: an ID is valid in the table as long as the serial number is the same.
+	 */
+	inline uint64_t serial() const { return serialNumber; }
+
+	/**
+	 * Adds every name of the other table to this one and returns the new ID of each of its IDs. Names are referred
+	 * or copied the same way as they were in the other table.
+	 */
+	inline std::vector<uint32_t> merge(const SymbolTable &other) {
+		std::vector<uint32_t> remap(other.symbols.size());
+		for(uint32_t i = 0; i < other.symbols.size(); ++i) {
+			const Symbol &s = other.symbols[i];
+			remap[i] = intern(fio::LenString{s.length, (char*)s.name}, s.copied);
+		}
+		return remap;
+	}
+
+	/**
+	 * Forgets every name - the IDs handed out so far become invalid. The memory is kept for reuse: the arenas are
+	 * filled again in the same order so the same names need no allocation after a clear.
+	 */
+	inline void clear() {
+		symbols.clear();
+		std::fill(slots.begin(), slots.end(), NO_SYMBOL);
+		arenaIndex = 0;
+		arenaUsed = 0;
+		referredCount = 0;
+		serialNumber = nextSerial();
+	}
+
+	/** Tells if any name is referred in place (not copied) - those are only valid as long as their memory is */
+	inline bool hasReferredNames() const {
+		return referredCount > 0;
+	}
+
+	/** The FNV-1a hash of the given characters - usable at compile time too */
+	inline constexpr static uint32_t hashOf(const char *p, unsigned int length) {
+		uint32_t hash = 2166136261u;
+		for(unsigned int i = 0; i < length; ++i) {
+			hash ^= (unsigned char)p[i];
+			hash *= 16777619u;
+		}
+		return hash;
+	}
+
+private:
+	static const uint32_t INITIAL_SLOTS = 64;
+	static const uint32_t ARENA_SIZE = 4096;
+
+	struct Symbol {
+		const char *name;
+		unsigned int length;
+		uint32_t hash;
+		/** Tells if the name is in our arenas */
+		bool copied;
+	};
+
+	/** The symbols in the order of their IDs */
+	std::vector<Symbol> symbols;
+	/** The open addressing hash table of the IDs (NO_SYMBOL for empty slots). The size is a power of two. */
+	std::vector<uint32_t> slots;
+	struct Arena {
+		std::unique_ptr<char[]> memory;
+		uint32_t size;
+	};
+
+	/** The copied names live here: the arenas before arenaIndex are full and the current is filled up to arenaUsed */
+	std::vector<Arena> arenas;
+	uint32_t arenaIndex = 0;
+	uint32_t arenaUsed = 0;
+	/** The number of names that are referred in place */
+	uint32_t referredCount = 0;
+	uint64_t serialNumber;
+
+	inline static uint64_t nextSerial() {
+		static std::atomic<uint64_t> counter{0};
+		return ++counter;
+	}
+
+	/** Returns the slot of the name: the one with its ID or the empty slot where it should go */
+	inline uint32_t findSlot(fio::LenString name, uint32_t hash) const {
+		uint32_t mask = (uint32_t)slots.size() - 1;
+		uint32_t slot = hash & mask;
+		while(slots[slot] != NO_SYMBOL) {
+			const Symbol &s = symbols[slots[slot]];
+			if((s.hash == hash) && (s.length == name.length) && !memcmp(s.name, name.startPtr, name.length)) {
+				break;
+			}
+			slot = (slot + 1) & mask;
+		}
+		return slot;
+	}
+
+	/** Doubles the hash table */
+	inline void rehash() {
+		slots.assign(slots.size() * 2, NO_SYMBOL);
+		uint32_t mask = (uint32_t)slots.size() - 1;
+		for(uint32_t id = 0; id < symbols.size(); ++id) {
+			uint32_t slot = symbols[id].hash & mask;
+			while(slots[slot] != NO_SYMBOL) {
+				slot = (slot + 1) & mask;
+			}
+			slots[slot] = id;
+		}
+	}
+
+	/** Copies the name into the arenas with a zero terminator */
+	inline const char* copyToArena(fio::LenString name) {
+		uint32_t needed = name.length + 1;
+		// Go on with the next (kept) arena when the current one is full
+		while((arenaIndex < arenas.size()) && (arenaUsed + needed > arenas[arenaIndex].size)) {
+			++arenaIndex;
+			arenaUsed = 0;
+		}
+		if(arenaIndex == arenas.size()) {
+			// Long names get an arena of their own - a power of two size so similar lengths fit there after a clear
+			uint32_t size = (needed > ARENA_SIZE) ? (1u << (32 - __builtin_clz(needed - 1))) : ARENA_SIZE;
+			arenas.push_back(Arena{std::unique_ptr<char[]>(new char[size]), size});
+		}
+		char *copy = arenas[arenaIndex].memory.get() + arenaUsed;
+		arenaUsed += needed;
+		memcpy(copy, name.startPtr, name.length);
+		copy[name.length] = '\0';
+		return copy;
+	}
+};
+
+} // end of namespace tbuf
+
+#endif // TURBO_BUF_SYMBOLS_H
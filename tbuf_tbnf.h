@@ -0,0 +1,1170 @@
+// tbuf_tbnf.h: Loading turbo-bnf (.tbnf) grammars and validating turbo-buf trees against them.
+
+#ifndef TURBO_BUF_TBNF_H
+#define TURBO_BUF_TBNF_H
+
+#include<algorithm>
+#include<bitset>
+#include<cstdint>
+#include<cstring>
+#include<fstream>
+#include<map>
+#include<memory>
+#include<sstream>
+#include<string>
+#include<unordered_map>
+#include<vector>
+#include"fio.h"
+#include"tbuf.h"
+
+namespace tbuf {
+
+/** The only predefined term of turbo-bnf: any (already unescaped) text character */
+const char TBNF_ESCAPED_UTF8[] = "ESCAPED_UTF8";
+
+/**
+ * A set of turbo-bnf rules (see tbuf.tbnf) compiled into table-driven automata for validating trees.
+ *
+ * A rule is "name::=alternatives" on one line where the alternatives are separated by '|' and each is a sequence of:
+ *   - literal characters and character classes like [a..z0..9_]
+ *   - rule references like <name> - or <prefix_*> for every rule named prefix or prefix_something (ad-hoc polymorphism)
+ *   - node patterns like name{body} where the name is made of the above and the body is a data part and then
+ *     a children part. Patterns with a name starting with '$' are text nodes and their body describes the text.
+ * Every item can have a multiplicity: ? * + *N *N? *N* *N+ (exactly N, N or zero, any multiple of N, positive multiple
+ * of N times). Whole lines starting with '#' are comments and "@include<file>" lines load other grammars.
+ *
+ * Character-level rules (names, hexes and texts) become DFAs with a 256 wide transition table, while the children
+ * of node patterns become position automata (Glushkov automata) of at most 64 positions: one bitset per position
+ * tells what may follow it. Validation runs these in a single preorder pass without backtracking (see TbnfValidator).
+ */
+class TbnfGrammar {
+public:
+	/**
+	 * Adds the rules of the given grammar text. Includes are loaded relative to the baseDir.
+	 * Returns false on syntax errors (see error()) - the rules before the error are kept.
+	 */
+	inline bool load(const char *text, size_t length, const std::string &baseDir = "") {
+		unsigned int lineNumber = 0;
+		size_t pos = 0;
+		while(pos < length) {
+			const char *lineEnd = (const char*)memchr(text + pos, '\n', length - pos);
+			size_t end = (lineEnd != nullptr) ? (size_t)(lineEnd - text) : length;
+			std::string line(text + pos, end - pos);
+			pos = end + 1;
+			++lineNumber;
+			if(!loadLine(line, baseDir)) {
+				std::ostringstream msg;
+				msg << "line " << lineNumber << ": " << errorText;
+				errorText = msg.str();
+				return false;
+			}
+		}
+		return true;
+	}
+
+	/** Adds the rules of the given .tbnf file - returns false when it cannot be read or it has errors */
+	inline bool loadFile(const std::string &path) {
+		std::ifstream file(path, std::ios::binary);
+		if(!file) {
+			errorText = "cannot read " + path;
+			return false;
+		}
+		std::stringstream content;
+		content << file.rdbuf();
+		std::string text = content.str();
+		size_t slash = path.find_last_of('/');
+		std::string baseDir = (slash == std::string::npos) ? "" : path.substr(0, slash + 1);
+		if(!load(text.c_str(), text.length(), baseDir)) {
+			errorText = path + ": " + errorText;
+			return false;
+		}
+		return true;
+	}
+
+	/** Tells if there is a rule with the given name */
+	inline bool hasRule(const std::string &name) const {
+		return rules.find(name) != rules.end();
+	}
+
+	/**
+	 * Compiles the rule as the body of a node (hexes and then children - like "lang::=<body>" in tbuf.tbnf) so that
+	 * nodes can be validated against it. Compiling is done only once per rule. Returns false on errors (see error()).
+	 */
+	inline bool compile(const std::string &rule) {
+		if(bodies.find(rule) != bodies.end()) {
+			return true;
+		}
+		if(!hasRule(rule)) {
+			errorText = "unknown rule <" + rule + ">";
+			return false;
+		}
+		for(auto &r : rules) {
+			if(!checkRefs(r.second)) {
+				errorText = "rule " + r.first + ": " + errorText;
+				return false;
+			}
+		}
+		// The body is a pattern of an implicit node with any name
+		Item ref;
+		ref.kind = Item::REF;
+		ref.ref = rule;
+		Item body;
+		body.kind = Item::NODE;
+		body.body.push_back(Seq{ref});
+		std::vector<uint32_t> variants;
+		expanding.clear();
+		if(!nodeTypesOf(body, true, variants)) {
+			return false;
+		}
+		bodies[rule] = variants;
+		return true;
+	}
+
+	/**
+	 * Tells if the data and the children of the node fit the rule (the name of the node is not checked). Compiles the
+	 * rule when needed. Returns false when it does not fit or on errors - see error() for the details in both cases.
+	 */
+	inline bool validate(Node &node, const std::string &rule);
+
+	/** The description of the last error */
+	inline const std::string& error() const {
+		return errorText;
+	}
+
+private:
+	friend class TbnfValidator;
+	friend class TbnfGenerator;
+
+	/** Multiplicities: exactly one, ?, *, +, *N, *N?, *N*, *N+ */
+	enum class Mult { ONE, OPT, STAR, PLUS, N, N_OPT, N_STAR, N_PLUS };
+
+	struct Item;
+	typedef std::vector<Item> Seq;
+	typedef std::vector<Seq> Alts;
+
+	/** A parsed item of a rule */
+	struct Item {
+		enum Kind { CHARS, REF, NODE } kind = CHARS;
+		Mult mult = Mult::ONE;
+		unsigned int n = 1;
+		/** CHARS: the characters that match */
+		std::bitset<256> chars;
+		/** REF: the referred rule (the prefix for polymorphic references) */
+		std::string ref;
+		bool polymorph = false;
+		/** NODE: the items of the name and the alternatives of the body */
+		Seq name;
+		Alts body;
+	};
+
+	/** The kinds of items a rule consists of (bits) */
+	static const unsigned int KIND_CHAR = 1;
+	static const unsigned int KIND_TREE = 2;
+
+	/** A node of the regular expressions built from the items before they become automata */
+	struct Re {
+		enum Op { EMPTY, ATOM, SEQ, ALT, STAR, PLUS, OPT } op;
+		/** ATOM: the index of the character class or the node type */
+		uint32_t atom;
+		std::vector<uint32_t> kids;
+	};
+
+	/** A DFA over characters: state 0 is the dead state, state 1 is the start */
+	struct CharDfa {
+		std::vector<uint32_t> next;
+		std::vector<uint8_t> accepting;
+
+		inline bool matches(const char *p, unsigned int length) const {
+			uint32_t state = 1;
+			for(unsigned int i = 0; i < length; ++i) {
+				state = next[state * 256 + (unsigned char)p[i]];
+				if(state == 0) {
+					return false;
+				}
+			}
+			return accepting[state];
+		}
+	};
+
+	/** The position automaton of the children of a node type (at most 64 positions) */
+	struct ChildModel {
+		bool nullable;
+		uint64_t first;
+		uint64_t last;
+		std::vector<uint64_t> follow;
+		/** The node type of every position */
+		std::vector<uint32_t> typeOf;
+	};
+
+	/** A possible node: its name, its hexes (or text) and its children */
+	struct NodeType {
+		/** The DFA of the name (-1 for any name) */
+		int32_t name;
+		bool text;
+		/** The DFA of the hexes or the text */
+		uint32_t content;
+		/** The model of the children (for non-text nodes) */
+		uint32_t children;
+	};
+
+	std::map<std::string, Alts> rules;
+	std::string errorText;
+
+	std::vector<CharDfa> dfas;
+	std::vector<ChildModel> models;
+	std::vector<NodeType> types;
+	/** The node types of the compiled node patterns - so recursive patterns are compiled only once */
+	std::unordered_map<const Item*, std::vector<uint32_t>> typesOfPattern;
+	/** The node types of the compiled rules (as bodies) */
+	std::map<std::string, std::vector<uint32_t>> bodies;
+	/** The rules that we are expanding right now (for finding the recursions that need a node in between) */
+	std::vector<std::string> expanding;
+
+	// Rem.: The regular expressions are only needed while compiling
+	std::vector<Re> res;
+	std::vector<std::bitset<256>> classes;
+
+	inline bool fail(const std::string &message) {
+		errorText = message;
+		return false;
+	}
+
+	// Parsing
+
+	inline bool loadLine(const std::string &line, const std::string &baseDir) {
+		size_t at = line.find_first_not_of(" \t\r");
+		if((at == std::string::npos) || (line[at] == '#')) {
+			return true;
+		}
+		if(line.compare(at, 9, "@include<") == 0) {
+			size_t close = line.find('>', at);
+			if(close == std::string::npos) {
+				return fail("missing '>' of the include");
+			}
+			std::string path = line.substr(at + 9, close - at - 9);
+			if(path.empty()) {
+				return fail("empty include");
+			}
+			return loadFile(((path[0] == '/') ? "" : baseDir) + path);
+		}
+		size_t def = line.find("::=", at);
+		if(def == std::string::npos) {
+			return fail("expected name::=rule");
+		}
+		std::string name = line.substr(at, def - at);
+		name.erase(name.find_last_not_of(" \t") + 1);
+		if(name.empty() || (name.find_first_not_of("abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_") != std::string::npos)) {
+			return fail("bad rule name: " + name);
+		}
+		if(hasRule(name)) {
+			return fail("rule " + name + " is defined twice");
+		}
+		std::string body = line.substr(def + 3);
+		body.erase(body.find_last_not_of(" \t\r") + 1);
+		size_t pos = 0;
+		Alts alts;
+		if(!parseAlts(body, pos, '\0', alts)) {
+			return false;
+		}
+		rules[name] = std::move(alts);
+		return true;
+	}
+
+	/** Parses alternatives until the stop character (or the end of the rule) */
+	inline bool parseAlts(const std::string &s, size_t &pos, char stop, Alts &alts) {
+		alts.push_back(Seq());
+		// The items of the current run without whitespace: these become the name of a node pattern on a '{'
+		size_t runStart = 0;
+		while(true) {
+			if(pos >= s.length()) {
+				return (stop == '\0') ? true : fail(std::string("missing '") + stop + "'");
+			}
+			char c = s[pos];
+			Seq &seq = alts.back();
+			if(c == stop) {
+				++pos;
+				return true;
+			}
+			if((c == ' ') || (c == '\t')) {
+				++pos;
+				runStart = seq.size();
+			} else if(c == '|') {
+				++pos;
+				alts.push_back(Seq());
+				runStart = 0;
+			} else if(c == '<') {
+				size_t close = s.find('>', pos);
+				if(close == std::string::npos) {
+					return fail("missing '>'");
+				}
+				Item item;
+				item.kind = Item::REF;
+				std::string ref = s.substr(pos + 1, close - pos - 1);
+				size_t refPos = ref.find_first_not_of("abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_");
+				if((refPos != std::string::npos) && (ref.compare(refPos, std::string::npos, "*") == 0) && (refPos > 0) && (ref[refPos - 1] == '_')) {
+					// <prefix_*>
+					item.polymorph = true;
+					item.ref = ref.substr(0, refPos);
+				} else {
+					// The multiplicity might be inside too: <x*>
+					item.ref = ref.substr(0, refPos);
+					if(refPos != std::string::npos) {
+						size_t multPos = refPos;
+						if(!parseMult(ref, multPos, item) || (multPos != ref.length())) {
+							return fail("bad reference: <" + ref + ">");
+						}
+					}
+				}
+				if(item.ref.empty()) {
+					return fail("empty reference");
+				}
+				pos = close + 1;
+				if(!parseMult(s, pos, item)) {
+					return false;
+				}
+				seq.push_back(std::move(item));
+			} else if(c == '[') {
+				Item item;
+				++pos;
+				while(true) {
+					if(pos >= s.length()) {
+						return fail("missing ']'");
+					}
+					if(s[pos] == ']') {
+						++pos;
+						break;
+					}
+					if((s[pos] == '\\') && (pos + 1 < s.length())) {
+						++pos;
+					}
+					unsigned char from = (unsigned char)s[pos];
+					unsigned char to = from;
+					if((s.compare(pos + 1, 2, "..") == 0) && (pos + 3 < s.length())) {
+						to = (unsigned char)s[pos + 3];
+						pos += 3;
+					}
+					for(unsigned int ch = from; ch <= to; ++ch) {
+						item.chars.set(ch);
+					}
+					++pos;
+				}
+				if(!parseMult(s, pos, item)) {
+					return false;
+				}
+				seq.push_back(std::move(item));
+			} else if(c == '{') {
+				if(runStart >= seq.size()) {
+					return fail("node pattern without a name");
+				}
+				Item item;
+				item.kind = Item::NODE;
+				item.name.assign(std::make_move_iterator(seq.begin() + runStart), std::make_move_iterator(seq.end()));
+				seq.erase(seq.begin() + runStart, seq.end());
+				++pos;
+				if(!parseAlts(s, pos, '}', item.body)) {
+					return false;
+				}
+				if(!parseMult(s, pos, item)) {
+					return false;
+				}
+				// Rem.: Reference the seq again as parsing the body might not keep it, but it is still the last
+				alts.back().push_back(std::move(item));
+				runStart = alts.back().size();
+			} else if((c == '}') || (c == '>') || (c == ']') || (c == '?') || (c == '*') || (c == '+')) {
+				return fail(std::string("unexpected '") + c + "'");
+			} else {
+				// Literal character
+				Item item;
+				item.chars.set((unsigned char)c);
+				++pos;
+				if(!parseMult(s, pos, item)) {
+					return false;
+				}
+				seq.push_back(std::move(item));
+			}
+		}
+	}
+
+	/** Parses the (optional) multiplicity after an item */
+	inline bool parseMult(const std::string &s, size_t &pos, Item &item) {
+		if(pos >= s.length()) {
+			return true;
+		}
+		if(s[pos] == '?') {
+			item.mult = Mult::OPT;
+			++pos;
+		} else if(s[pos] == '+') {
+			item.mult = Mult::PLUS;
+			++pos;
+		} else if(s[pos] == '*') {
+			++pos;
+			if((pos < s.length()) && isdigit((unsigned char)s[pos])) {
+				unsigned long n = 0;
+				while((pos < s.length()) && isdigit((unsigned char)s[pos])) {
+					n = n * 10 + (s[pos] - '0');
+					if(n > MAX_REPEAT) {
+						return fail("too big multiplicity");
+					}
+					++pos;
+				}
+				if(n == 0) {
+					return fail("zero multiplicity");
+				}
+				item.n = (unsigned int)n;
+				item.mult = Mult::N;
+				if(pos < s.length()) {
+					if(s[pos] == '?') { item.mult = Mult::N_OPT; ++pos; }
+					else if(s[pos] == '*') { item.mult = Mult::N_STAR; ++pos; }
+					else if(s[pos] == '+') { item.mult = Mult::N_PLUS; ++pos; }
+				}
+			} else {
+				item.mult = Mult::STAR;
+			}
+		}
+		return true;
+	}
+
+	// Compiling
+
+	static const unsigned int MAX_REPEAT = 1024;
+	static const unsigned int MAX_DFA_STATES = 4096;
+
+	/** Returns the names of the rules an item refers (more for polymorphic references) */
+	inline bool referredRules(const Item &item, std::vector<std::string> &names) {
+		if(!item.polymorph) {
+			if((item.ref != TBNF_ESCAPED_UTF8) && !hasRule(item.ref)) {
+				return fail("unknown rule <" + item.ref + ">");
+			}
+			names.push_back(item.ref);
+			return true;
+		}
+		// <prefix_*> is the prefix without the '_' and everything starting with the prefix
+		std::string base = item.ref.substr(0, item.ref.length() - 1);
+		for(auto &r : rules) {
+			if((r.first == base) || (r.first.compare(0, item.ref.length(), item.ref) == 0)) {
+				names.push_back(r.first);
+			}
+		}
+		if(names.empty()) {
+			return fail("no rules for <" + item.ref + "*>");
+		}
+		return true;
+	}
+
+	/** Checks that every reference of the alternatives refers some rules */
+	inline bool checkRefs(const Alts &alts) {
+		for(const Seq &seq : alts) {
+			for(const Item &item : seq) {
+				std::vector<std::string> names;
+				if(((item.kind == Item::REF) && !referredRules(item, names)) ||
+				   ((item.kind == Item::NODE) && (!checkRefs(Alts{item.name}) || !checkRefs(item.body)))) {
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	/** Returns the KIND_* bits of the rule */
+	inline unsigned int kindOf(const std::string &rule, std::vector<std::string> &visiting) {
+		if(rule == TBNF_ESCAPED_UTF8) {
+			return KIND_CHAR;
+		}
+		if(std::find(visiting.begin(), visiting.end(), rule) != visiting.end()) {
+			return 0;
+		}
+		visiting.push_back(rule);
+		unsigned int kind = 0;
+		for(const Seq &seq : rules[rule]) {
+			for(const Item &item : seq) {
+				kind |= kindOf(item, visiting);
+			}
+		}
+		visiting.pop_back();
+		return kind;
+	}
+
+	inline unsigned int kindOf(const Item &item, std::vector<std::string> &visiting) {
+		if(item.kind == Item::CHARS) {
+			return KIND_CHAR;
+		}
+		if(item.kind == Item::NODE) {
+			return KIND_TREE;
+		}
+		std::vector<std::string> names;
+		if(!referredRules(item, names)) {
+			// Rem.: The error is reported again when the item is compiled
+			return 0;
+		}
+		unsigned int kind = 0;
+		for(const std::string &name : names) {
+			kind |= kindOf(name, visiting);
+		}
+		return kind;
+	}
+
+	inline unsigned int kindOf(const Item &item) {
+		std::vector<std::string> visiting;
+		return kindOf(item, visiting);
+	}
+
+	inline uint32_t newRe(Re::Op op, uint32_t atom = 0) {
+		res.push_back(Re{op, atom, {}});
+		return (uint32_t)res.size() - 1;
+	}
+
+	/** Wraps the expression of one occurrence into the multiplicity of the item */
+	inline uint32_t withMult(uint32_t re, const Item &item) {
+		uint32_t repeated = re;
+		if(item.n > 1) {
+			// The same expression is walked n times by the position numbering so every copy gets its own positions
+			repeated = newRe(Re::SEQ);
+			res[repeated].kids.assign(item.n, re);
+		}
+		switch(item.mult) {
+			case Mult::ONE: case Mult::N: return repeated;
+			case Mult::OPT: case Mult::N_OPT: { uint32_t r = newRe(Re::OPT); res[r].kids.push_back(repeated); return r; }
+			case Mult::STAR: case Mult::N_STAR: { uint32_t r = newRe(Re::STAR); res[r].kids.push_back(repeated); return r; }
+			default: { uint32_t r = newRe(Re::PLUS); res[r].kids.push_back(repeated); return r; }
+		}
+	}
+
+	/** Builds the expression of the alternatives of a rule (in characters or in nodes) */
+	inline bool ruleRe(const std::string &rule, bool tree, uint32_t &re) {
+		if(std::find(expanding.begin(), expanding.end(), rule) != expanding.end()) {
+			return fail("rule <" + rule + "> refers itself without a node in between");
+		}
+		expanding.push_back(rule);
+		bool ok = altsRe(rules[rule], tree, re);
+		expanding.pop_back();
+		return ok;
+	}
+
+	inline bool altsRe(const Alts &alts, bool tree, uint32_t &re) {
+		uint32_t alt = newRe(Re::ALT);
+		for(const Seq &seq : alts) {
+			uint32_t s = newRe(Re::SEQ);
+			for(const Item &item : seq) {
+				uint32_t itemRe;
+				if(!tree ? !charItemRe(item, itemRe) : !treeItemRe(item, itemRe)) {
+					return false;
+				}
+				res[s].kids.push_back(itemRe);
+			}
+			res[alt].kids.push_back(s);
+		}
+		re = alt;
+		return true;
+	}
+
+	/** The expression of an item in characters */
+	inline bool charItemRe(const Item &item, uint32_t &re) {
+		uint32_t one;
+		if(item.kind == Item::CHARS) {
+			classes.push_back(item.chars);
+			one = newRe(Re::ATOM, (uint32_t)classes.size() - 1);
+		} else if(item.kind == Item::NODE) {
+			return fail("node pattern where characters are expected");
+		} else {
+			std::vector<std::string> names;
+			if(!referredRules(item, names)) {
+				return false;
+			}
+			one = newRe(Re::ALT);
+			for(const std::string &name : names) {
+				uint32_t r;
+				if(name == TBNF_ESCAPED_UTF8) {
+					classes.push_back(std::bitset<256>().set());
+					r = newRe(Re::ATOM, (uint32_t)classes.size() - 1);
+				} else if(!ruleRe(name, false, r)) {
+					return false;
+				}
+				res[one].kids.push_back(r);
+			}
+		}
+		re = withMult(one, item);
+		return true;
+	}
+
+	/** The expression of an item in children nodes */
+	inline bool treeItemRe(const Item &item, uint32_t &re) {
+		uint32_t one = newRe(Re::ALT);
+		if(item.kind == Item::CHARS) {
+			return fail("characters after the children");
+		} else if(item.kind == Item::NODE) {
+			std::vector<uint32_t> variants;
+			if(!nodeTypesOf(item, false, variants)) {
+				return false;
+			}
+			for(uint32_t type : variants) {
+				res[one].kids.push_back(newRe(Re::ATOM, type));
+			}
+		} else {
+			std::vector<std::string> names;
+			if(!referredRules(item, names)) {
+				return false;
+			}
+			for(const std::string &name : names) {
+				std::vector<std::string> visiting;
+				if((name == TBNF_ESCAPED_UTF8) || ((kindOf(name, visiting) & KIND_CHAR) != 0)) {
+					return fail("characters after the children: <" + name + ">");
+				}
+				uint32_t r;
+				if(!ruleRe(name, true, r)) {
+					return false;
+				}
+				res[one].kids.push_back(r);
+			}
+		}
+		re = withMult(one, item);
+		return true;
+	}
+
+	/** Position sets while building the automata */
+	typedef std::vector<uint32_t> PosSet;
+
+	static void addAll(PosSet &to, const PosSet &from) {
+		PosSet merged;
+		std::set_union(to.begin(), to.end(), from.begin(), from.end(), std::back_inserter(merged));
+		to.swap(merged);
+	}
+
+	struct Positions {
+		bool nullable;
+		PosSet first;
+		PosSet last;
+	};
+
+	/** The Glushkov construction: numbers the atoms (every walk of a shared expression gets new positions) */
+	inline Positions glushkov(uint32_t re, std::vector<uint32_t> &atoms, std::vector<PosSet> &follow) {
+		const Re r = res[re];
+		switch(r.op) {
+			case Re::EMPTY:
+				return Positions{true, {}, {}};
+			case Re::ATOM: {
+				uint32_t p = (uint32_t)atoms.size();
+				atoms.push_back(r.atom);
+				follow.push_back(PosSet());
+				return Positions{false, {p}, {p}};
+			}
+			case Re::SEQ: {
+				Positions all{true, {}, {}};
+				for(uint32_t kid : r.kids) {
+					Positions k = glushkov(kid, atoms, follow);
+					for(uint32_t p : all.last) {
+						addAll(follow[p], k.first);
+					}
+					if(all.nullable) {
+						addAll(all.first, k.first);
+					}
+					if(!k.nullable) {
+						all.last.clear();
+					}
+					addAll(all.last, k.last);
+					all.nullable = all.nullable && k.nullable;
+				}
+				return all;
+			}
+			case Re::ALT: {
+				Positions any{r.kids.empty(), {}, {}};
+				for(uint32_t kid : r.kids) {
+					Positions k = glushkov(kid, atoms, follow);
+					addAll(any.first, k.first);
+					addAll(any.last, k.last);
+					any.nullable = any.nullable || k.nullable;
+				}
+				return any;
+			}
+			default: {
+				Positions k = glushkov(r.kids[0], atoms, follow);
+				if(r.op != Re::OPT) {
+					for(uint32_t p : k.last) {
+						addAll(follow[p], k.first);
+					}
+				}
+				k.nullable = k.nullable || (r.op != Re::PLUS);
+				return k;
+			}
+		}
+	}
+
+	/** Builds a character DFA from the expression with the subset construction */
+	inline bool charDfa(uint32_t re, uint32_t &dfa) {
+		std::vector<uint32_t> atoms;
+		std::vector<PosSet> follow;
+		Positions g = glushkov(re, atoms, follow);
+		std::vector<bool> isLast(atoms.size(), false);
+		for(uint32_t p : g.last) {
+			isLast[p] = true;
+		}
+		CharDfa d;
+		// The dead state and the start state (that is the only state with no positions - so it is marked)
+		std::map<PosSet, uint32_t> stateOf;
+		std::vector<PosSet> states{PosSet(), PosSet()};
+		d.next.assign(2 * 256, 0);
+		d.accepting = {false, g.nullable};
+		for(uint32_t s = 1; s < states.size(); ++s) {
+			PosSet candidates;
+			if(s == 1) {
+				candidates = g.first;
+			} else {
+				for(uint32_t p : states[s]) {
+					addAll(candidates, follow[p]);
+				}
+			}
+			for(unsigned int c = 0; c < 256; ++c) {
+				PosSet target;
+				for(uint32_t p : candidates) {
+					if(classes[atoms[p]].test(c)) {
+						target.push_back(p);
+					}
+				}
+				if(target.empty()) {
+					continue;
+				}
+				auto it = stateOf.find(target);
+				uint32_t t;
+				if(it != stateOf.end()) {
+					t = it->second;
+				} else {
+					if(states.size() >= MAX_DFA_STATES) {
+						return fail("character rule is too complex");
+					}
+					t = (uint32_t)states.size();
+					stateOf[target] = t;
+					bool accepting = false;
+					for(uint32_t p : target) {
+						accepting = accepting || isLast[p];
+					}
+					states.push_back(target);
+					d.accepting.push_back(accepting);
+					d.next.resize(states.size() * 256, 0);
+				}
+				d.next[s * 256 + c] = t;
+			}
+		}
+		dfas.push_back(std::move(d));
+		dfa = (uint32_t)dfas.size() - 1;
+		return true;
+	}
+
+	/** Builds the child model from the expression */
+	inline bool childModel(uint32_t re, uint32_t &model) {
+		std::vector<uint32_t> atoms;
+		std::vector<PosSet> follow;
+		Positions g = glushkov(re, atoms, follow);
+		if(atoms.size() > 64) {
+			return fail("too many possible children in a node pattern (more than 64 positions)");
+		}
+		auto mask = [] (const PosSet &set) {
+			uint64_t m = 0;
+			for(uint32_t p : set) {
+				m |= 1ULL << p;
+			}
+			return m;
+		};
+		ChildModel m;
+		m.nullable = g.nullable;
+		m.first = mask(g.first);
+		m.last = mask(g.last);
+		for(const PosSet &f : follow) {
+			m.follow.push_back(mask(f));
+		}
+		m.typeOf = atoms;
+		models.push_back(std::move(m));
+		model = (uint32_t)models.size() - 1;
+		return true;
+	}
+
+	/**
+	 * Splits the body items into the possible (data, children) variants. Only references to rules with both data and
+	 * children (like <body> in tbuf.tbnf) need splitting: each of their alternatives gives a variant.
+	 */
+	inline bool bodyVariants(const Seq &items, size_t from, std::vector<const Item*> &data, std::vector<const Item*> &children,
+			std::vector<std::pair<std::vector<const Item*>, std::vector<const Item*>>> &variants) {
+		for(size_t i = from; i < items.size(); ++i) {
+			const Item &item = items[i];
+			unsigned int kind = kindOf(item);
+			if(kind == (KIND_CHAR | KIND_TREE)) {
+				if((item.mult != Mult::ONE) || item.polymorph) {
+					return fail("a rule with both hexes and children can only be referred exactly once: <" + item.ref + ">");
+				}
+				if(std::find(expanding.begin(), expanding.end(), item.ref) != expanding.end()) {
+					return fail("rule <" + item.ref + "> refers itself without a node in between");
+				}
+				expanding.push_back(item.ref);
+				for(const Seq &alt : rules[item.ref]) {
+					// The alternative and then the rest of our items
+					Seq rest(alt);
+					rest.insert(rest.end(), items.begin() + i + 1, items.end());
+					std::vector<const Item*> d(data), c(children);
+					// Rem.: The items of rest are copies so they are kept alive in a list while compiling
+					keptSeqs.push_back(std::unique_ptr<Seq>(new Seq(std::move(rest))));
+					if(!bodyVariants(*keptSeqs.back(), 0, d, c, variants)) {
+						return false;
+					}
+				}
+				expanding.pop_back();
+				return true;
+			} else if(kind == KIND_CHAR) {
+				if(!children.empty()) {
+					return fail("hexes after the children");
+				}
+				data.push_back(&item);
+			} else if(kind == KIND_TREE) {
+				children.push_back(&item);
+			}
+			// Rem.: Items of no kind are empty rules (or errors that are reported later) - they match nothing
+			else if(item.kind == Item::REF) {
+				std::vector<std::string> names;
+				if(!referredRules(item, names)) {
+					return false;
+				}
+			}
+		}
+		variants.emplace_back(data, children);
+		return true;
+	}
+
+	/** The copies of the items that splitting the bodies made */
+	std::vector<std::unique_ptr<Seq>> keptSeqs;
+
+	/** Returns the node types of a node pattern (compiling them the first time) */
+	inline bool nodeTypesOf(const Item &pattern, bool anyName, std::vector<uint32_t> &result) {
+		// Rem.: The implicit pattern of a rule body is not kept so it is not remembered either
+		auto known = typesOfPattern.find(&pattern);
+		if(!anyName && (known != typesOfPattern.end())) {
+			result = known->second;
+			return true;
+		}
+		// The name
+		int32_t nameDfa = -1;
+		bool text = false;
+		if(!anyName) {
+			text = pattern.name[0].kind == Item::CHARS && pattern.name[0].chars.count() == 1 && pattern.name[0].chars.test('$');
+			uint32_t seq = newRe(Re::SEQ);
+			for(const Item &item : pattern.name) {
+				uint32_t itemRe;
+				if(!charItemRe(item, itemRe)) {
+					return false;
+				}
+				res[seq].kids.push_back(itemRe);
+			}
+			uint32_t dfa;
+			if(!charDfa(seq, dfa)) {
+				return false;
+			}
+			nameDfa = (int32_t)dfa;
+		}
+		// Text nodes: the body is the text
+		if(text) {
+			uint32_t re, dfa;
+			if(!altsRe(pattern.body, false, re) || !charDfa(re, dfa)) {
+				return false;
+			}
+			types.push_back(NodeType{nameDfa, true, dfa, 0});
+			result = {(uint32_t)types.size() - 1};
+			if(!anyName) {
+				typesOfPattern[&pattern] = result;
+			}
+			return true;
+		}
+		// Other nodes: a type for every (data, children) variant of the body
+		std::vector<std::pair<std::vector<const Item*>, std::vector<const Item*>>> variants;
+		for(const Seq &alt : pattern.body) {
+			std::vector<const Item*> data, children;
+			if(!bodyVariants(alt, 0, data, children, variants)) {
+				return false;
+			}
+		}
+		uint32_t firstType = (uint32_t)types.size();
+		for(size_t v = 0; v < variants.size(); ++v) {
+			types.push_back(NodeType{nameDfa, false, 0, 0});
+			result.push_back(firstType + (uint32_t)v);
+		}
+		// Rem.: Known before compiling the children so that recursive patterns find themselves
+		if(!anyName) {
+			typesOfPattern[&pattern] = result;
+		}
+		// Recursion is fine through a node: the rules expanded outside of it can be expanded again inside
+		std::vector<std::string> outside;
+		outside.swap(expanding);
+		for(size_t v = 0; v < variants.size(); ++v) {
+			uint32_t dataRe = newRe(Re::SEQ);
+			for(const Item *item : variants[v].first) {
+				uint32_t itemRe;
+				if(!charItemRe(*item, itemRe)) {
+					return false;
+				}
+				res[dataRe].kids.push_back(itemRe);
+			}
+			uint32_t childRe = newRe(Re::SEQ);
+			for(const Item *item : variants[v].second) {
+				uint32_t itemRe;
+				if(!treeItemRe(*item, itemRe)) {
+					return false;
+				}
+				res[childRe].kids.push_back(itemRe);
+			}
+			uint32_t dataDfa, model;
+			if(!charDfa(dataRe, dataDfa) || !childModel(childRe, model)) {
+				return false;
+			}
+			types[firstType + v].content = dataDfa;
+			types[firstType + v].children = model;
+		}
+		expanding.swap(outside);
+		return true;
+	}
+
+	/** Tells if the node (without its children) can be of the given type */
+	inline bool fits(uint32_t type, const NodeCore &nc) const {
+		const NodeType &t = types[type];
+		if(t.text != (nc.nodeKind == NodeKind::TEXT)) {
+			return false;
+		}
+		if((t.name >= 0) && !dfas[t.name].matches(nc.name, nc.nameLength)) {
+			return false;
+		}
+		if(t.text) {
+			return dfas[t.content].matches(nc.text, (nc.text != nullptr) ? nc.textLength : 0);
+		}
+		return dfas[t.content].matches(nc.data.digits.startPtr, nc.data.digits.length);
+	}
+};
+
+/**
+ * Validates a tree against a compiled rule of a TbnfGrammar in one preorder pass. This is a visitor for
+ * Node::dfs_preorder (or anything that calls visitors the same way, like BinaryCodec::walk) so the same validator
+ * checks trees, binary messages or any other source of preorder events. Call finish() after the walk.
+ *
+ * For every open node we keep the node types it might be and the positions of its children automaton it might be in.
+ * All the possibilities are followed at once (like a DFA that is built on the fly) so there is no backtracking.
+ * The stack of open nodes is kept between the validations so validating many messages does not allocate.
+ */
+class TbnfValidator {
+public:
+	/** Create a validator for the rule - that is compiled if it was not yet (check isValid() for errors then) */
+	TbnfValidator(TbnfGrammar &_grammar, const std::string &rule) : grammar(_grammar), compiled(false) {
+		if(grammar.compile(rule)) {
+			rootTypes = grammar.bodies[rule];
+			compiled = true;
+		} else {
+			compileError = grammar.error();
+		}
+		reset();
+	}
+
+	/** Start a new validation */
+	inline void reset() {
+		used = 0;
+		failed = !compiled;
+		finished = false;
+		errorText = compileError;
+	}
+
+	/** Visits the next node in preorder - returns STOP when the tree surely does not fit anymore */
+	inline VisitResult operator()(NodeCore &nc, unsigned int depth, bool leaf) {
+		if(failed) {
+			return VisitResult::STOP;
+		}
+		if(depth == 0) {
+			// The validated node: only its body is checked
+			openFrame(0);
+			for(uint32_t type : rootTypes) {
+				const TbnfGrammar::NodeType &t = grammar.types[type];
+				if(grammar.dfas[t.content].matches(nc.data.digits.startPtr, nc.data.digits.length)) {
+					frames[0].threads.push_back(Thread{type, 0, 0, true, true});
+				}
+			}
+			if(frames[0].threads.empty()) {
+				return reject(nc, "the hexes of the root do not fit");
+			}
+			return VisitResult::CONTINUE;
+		}
+		// Close the nodes that have no more children
+		while(used > depth) {
+			if(!closeFrame()) {
+				return VisitResult::STOP;
+			}
+		}
+		// The possible types of the node come from the possible next positions of every possibility of the parent
+		// Rem.: Opening might grow the frames so the parent is referred only after it
+		openFrame(depth);
+		Frame &parent = frames[depth - 1];
+		Frame &frame = frames[depth];
+		frame.name = nc.name;
+		frame.nameLength = nc.nameLength;
+		for(Thread &th : parent.threads) {
+			if(!th.alive) {
+				continue;
+			}
+			const TbnfGrammar::ChildModel &m = grammar.models[grammar.types[th.type].children];
+			uint64_t next = th.initial ? m.first : followOf(m, th.state);
+			th.candidates = 0;
+			for(uint64_t bits = next; bits != 0; bits &= bits - 1) {
+				unsigned int p = __builtin_ctzll(bits);
+				uint32_t type = m.typeOf[p];
+				if(grammar.fits(type, nc)) {
+					th.candidates |= 1ULL << p;
+					addThread(frame, type);
+				}
+			}
+		}
+		if(frame.threads.empty()) {
+			return reject(nc, "is not allowed here");
+		}
+		return VisitResult::CONTINUE;
+	}
+
+	/** Ends the validation (closes every open node) - returns true when the whole tree fits the rule */
+	inline bool finish() {
+		if(!finished) {
+			finished = true;
+			while(!failed && (used > 1)) {
+				closeFrame();
+			}
+			if(!failed) {
+				if((used == 0) || !accepts(frames[0])) {
+					failed = true;
+					errorText = "the children of the root do not fit";
+				}
+			}
+		}
+		return !failed;
+	}
+
+	/** The reason when the tree did not fit */
+	inline const std::string& error() const {
+		return errorText;
+	}
+
+private:
+	/** One possibility for an open node: its type and the positions of the children automaton it is in */
+	struct Thread {
+		uint32_t type;
+		uint64_t state;
+		/** The positions that the current child can be in */
+		uint64_t candidates;
+		/** True before the first child */
+		bool initial;
+		bool alive;
+	};
+
+	struct Frame {
+		std::vector<Thread> threads;
+		const char *name;
+		unsigned int nameLength;
+	};
+
+	TbnfGrammar &grammar;
+	std::vector<uint32_t> rootTypes;
+	bool compiled;
+	std::string compileError;
+	/** The open nodes: frames[depth] - only the first used ones are valid (the rest is kept for reuse) */
+	std::vector<Frame> frames;
+	size_t used;
+	bool failed;
+	bool finished;
+	std::string errorText;
+
+	inline void openFrame(unsigned int depth) {
+		if(frames.size() <= depth) {
+			frames.resize(depth + 1);
+		}
+		used = depth + 1;
+		frames[depth].threads.clear();
+	}
+
+	inline void addThread(Frame &frame, uint32_t type) {
+		for(const Thread &th : frame.threads) {
+			if(th.type == type) {
+				return;
+			}
+		}
+		frame.threads.push_back(Thread{type, 0, 0, true, true});
+	}
+
+	inline static uint64_t followOf(const TbnfGrammar::ChildModel &m, uint64_t state) {
+		uint64_t next = 0;
+		for(uint64_t bits = state; bits != 0; bits &= bits - 1) {
+			next |= m.follow[__builtin_ctzll(bits)];
+		}
+		return next;
+	}
+
+	/** Tells if the thread can end here: it is in an accepting position of its automaton */
+	inline bool accepts(const Thread &th) const {
+		if(!th.alive) {
+			return false;
+		}
+		const TbnfGrammar::NodeType &t = grammar.types[th.type];
+		if(t.text) {
+			return th.initial;
+		}
+		const TbnfGrammar::ChildModel &m = grammar.models[t.children];
+		return th.initial ? m.nullable : ((th.state & m.last) != 0);
+	}
+
+	inline bool accepts(const Frame &frame) const {
+		for(const Thread &th : frame.threads) {
+			if(accepts(th)) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	/** Closes the last open node: its parent can only be in the positions of the types it turned out to be */
+	inline bool closeFrame() {
+		Frame &child = frames[used - 1];
+		Frame &parent = frames[used - 2];
+		bool anyAlive = false;
+		for(Thread &th : parent.threads) {
+			if(!th.alive) {
+				continue;
+			}
+			const TbnfGrammar::ChildModel &m = grammar.models[grammar.types[th.type].children];
+			uint64_t state = 0;
+			for(uint64_t bits = th.candidates; bits != 0; bits &= bits - 1) {
+				unsigned int p = __builtin_ctzll(bits);
+				for(const Thread &c : child.threads) {
+					if((c.type == m.typeOf[p]) && accepts(c)) {
+						state |= 1ULL << p;
+						break;
+					}
+				}
+			}
+			th.state = state;
+			th.initial = false;
+			th.alive = (state != 0);
+			anyAlive = anyAlive || th.alive;
+		}
+		if(!anyAlive) {
+			failed = true;
+			errorText = std::string(child.name, child.nameLength) + " (at depth " + std::to_string(used - 1) + ") does not fit";
+		}
+		--used;
+		return anyAlive;
+	}
+
+	inline VisitResult reject(const NodeCore &nc, const char *why) {
+		failed = true;
+		errorText = std::string(nc.name, nc.nameLength) + " " + why;
+		return VisitResult::STOP;
+	}
+};
+
+inline bool TbnfGrammar::validate(Node &node, const std::string &rule) {
+	TbnfValidator validator(*this, rule);
+	node.dfs_preorder(validator);
+	if(!validator.finish()) {
+		errorText = validator.error();
+		return false;
+	}
+	return true;
+}
+
+} // end of namespace tbuf
+
+#endif // TURBO_BUF_TBNF_H
@@ -0,0 +1,525 @@
+// tbuf_tbnfgen.h: Generating C++ structs and specialized parsers from tbnf schemas (used by tbnfgen.cpp).
+
+#ifndef TURBO_BUF_TBNFGEN_H
+#define TURBO_BUF_TBNFGEN_H
+
+#include<algorithm>
+#include<map>
+#include<ostream>
+#include<set>
+#include<string>
+#include<vector>
+#include"tbuf_tbnf.h"
+
+namespace tbuf {
+
+/**
+ * Generates a header with one struct per schema rule and parsers that read messages straight into them from any
+ * fio::Input subclass (with tbuf::SchemaReader) - so no Tree, Node or treeStrings is built and the fields are
+ * plain members. Parsing the same shape into the same struct again does not allocate (vectors and strings are reused).
+ *
+ * The start rule describes the body of the message (like lang::=<body> in tbuf.tbnf) and every rule it uses must
+ * be one of these shapes:
+ *   - a node rule: one node pattern with a literal name, like "sensor::=sensor{<hex>*32 <unit> <label>*}"
+ *   - a text rule: one text node pattern with a literal name, like "label::=$_label{<ESCAPED_UTF8>*}"
+ * Bodies are at most one hex item and then the children. A child is a reference to a node rule (a struct field),
+ * a text rule or an inline text pattern (a std::string field) or an inline empty pattern like "enabled{}" (a flag
+ * when it is optional, a count when it repeats and no field at all when it must be there exactly as given).
+ * Multiplicities become optional fields (with a hasX flag), arrays (*N) and vectors (the others). The digits of exact
+ * hexes (*N) are decoded: up to 16 into the smallest unsigned integer that fits, above that into bytes. Other hexes
+ * are kept as their digits in a std::string.
+ *
+ * The parsers follow the children in their order without backtracking. So alternatives, polymorphic references
+ * and items that could take the same name right after each other (like <a>? <a>) are refused. The character
+ * classes of the hexes and the texts are not checked - use TbnfValidator for that.
+ */
+class TbnfGenerator {
+public:
+	TbnfGenerator(TbnfGrammar &_grammar) : grammar(_grammar) {}
+
+	/**
+	 * Writes the header for the start rule into the output. The structs and parsers are put into the given namespace.
+	 * Returns false when some rule cannot be generated (see error()) - nothing is written then.
+	 */
+	inline bool generate(const std::string &startRule, const std::string &ns, std::ostream &out) {
+		structs.clear();
+		order.clear();
+		// Rem.: Compiling checks the references and the recursions of the rules
+		if(!grammar.compile(startRule)) {
+			return fail(grammar.error());
+		}
+		const TbnfGrammar::Alts &alts = grammar.rules[startRule];
+		if(alts.size() != 1) {
+			return fail("the start rule <" + startRule + "> should have one alternative");
+		}
+		if(!addStruct(startRule, "", alts[0])) {
+			return false;
+		}
+		std::vector<std::string> visiting;
+		for(auto &s : structs) {
+			if(!orderStructs(s.first, visiting)) {
+				return false;
+			}
+		}
+		write(startRule, ns, out);
+		return true;
+	}
+
+	inline const std::string& error() const {
+		return errorText;
+	}
+
+private:
+	enum class FieldKind { STRUCT, TEXT, FLAG };
+
+	struct Field {
+		std::string name;
+		FieldKind kind;
+		/** STRUCT: the rule of the struct */
+		std::string rule;
+		/** The literal name of the node in the messages */
+		std::string nodeName;
+		TbnfGrammar::Mult mult;
+		unsigned int n;
+	};
+
+	struct Struct {
+		std::string typeName;
+		/** The name of the node (empty for the body of the message) */
+		std::string nodeName;
+		/** The hexes: none when hasData is false */
+		bool hasData;
+		TbnfGrammar::Mult dataMult;
+		unsigned int dataN;
+		std::vector<Field> fields;
+	};
+
+	TbnfGrammar &grammar;
+	std::string errorText;
+	std::map<std::string, Struct> structs;
+	std::vector<std::string> order;
+
+	inline bool fail(const std::string &message) {
+		errorText = message;
+		return false;
+	}
+
+	/** Returns the literal name of a node pattern or an empty string when it is not a literal */
+	inline static std::string literalName(const TbnfGrammar::Item &pattern) {
+		std::string name;
+		for(const TbnfGrammar::Item &item : pattern.name) {
+			if((item.kind != TbnfGrammar::Item::CHARS) || (item.mult != TbnfGrammar::Mult::ONE) || (item.chars.count() != 1)) {
+				return "";
+			}
+			for(unsigned int c = 0; c < 256; ++c) {
+				if(item.chars.test(c)) {
+					name += (char)c;
+				}
+			}
+		}
+		return name;
+	}
+
+	/** Returns the node pattern of the rule if the rule is only that (or nullptr) */
+	inline const TbnfGrammar::Item* patternOf(const std::string &rule) {
+		const TbnfGrammar::Alts &alts = grammar.rules[rule];
+		if((alts.size() != 1) || (alts[0].size() != 1) || (alts[0][0].kind != TbnfGrammar::Item::NODE) ||
+		   (alts[0][0].mult != TbnfGrammar::Mult::ONE) || literalName(alts[0][0]).empty()) {
+			return nullptr;
+		}
+		return &alts[0][0];
+	}
+
+	/** The C++ type name of a rule: fruit_apple -> FruitApple */
+	inline static std::string typeNameOf(const std::string &rule) {
+		std::string name;
+		bool upper = true;
+		for(char c : rule) {
+			if(c == '_') {
+				upper = true;
+			} else {
+				name += upper ? (char)toupper((unsigned char)c) : c;
+				upper = false;
+			}
+		}
+		if(name.empty() || isdigit((unsigned char)name[0])) {
+			name = "T" + name;
+		}
+		return name;
+	}
+
+	/** A C++ identifier for a field */
+	inline static std::string fieldNameOf(const std::string &name) {
+		static const std::set<std::string> KEYWORDS = {"auto", "bool", "break", "case", "char", "class", "const",
+			"continue", "default", "delete", "do", "double", "else", "enum", "explicit", "extern", "false", "float",
+			"for", "friend", "goto", "if", "inline", "int", "long", "namespace", "new", "operator", "private",
+			"protected", "public", "register", "return", "short", "signed", "sizeof", "static", "struct", "switch",
+			"template", "this", "throw", "true", "try", "typedef", "typename", "union", "unsigned", "using",
+			"virtual", "void", "volatile", "while"};
+		std::string field;
+		for(char c : name) {
+			field += (isalnum((unsigned char)c) || (c == '_')) ? c : '_';
+		}
+		if(field.empty() || isdigit((unsigned char)field[0]) || (KEYWORDS.count(field) > 0)) {
+			field += '_';
+			if(isdigit((unsigned char)field[0])) {
+				field = "_" + field;
+			}
+		}
+		return field;
+	}
+
+	/** Adds the struct of the body of a rule and the structs of the rules it uses */
+	inline bool addStruct(const std::string &rule, const std::string &nodeName, const TbnfGrammar::Seq &body) {
+		Struct s;
+		s.typeName = typeNameOf(rule);
+		for(auto &other : structs) {
+			if(other.second.typeName == s.typeName) {
+				return fail("rules <" + other.first + "> and <" + rule + "> would both be " + s.typeName);
+			}
+		}
+		s.nodeName = nodeName;
+		s.hasData = false;
+		// Rem.: Added before the fields so that recursive rules find it
+		structs[rule] = s;
+		std::vector<Field> fields;
+		for(size_t i = 0; i < body.size(); ++i) {
+			const TbnfGrammar::Item &item = body[i];
+			if(item.polymorph) {
+				return fail("rule <" + rule + ">: polymorphic references are not supported: <" + item.ref + "*>");
+			}
+			if(grammar.kindOf(item) == TbnfGrammar::KIND_CHAR) {
+				if(!fields.empty() || structs[rule].hasData) {
+					return fail("rule <" + rule + ">: only one hex item is supported at the start of the body");
+				}
+				structs[rule].hasData = true;
+				structs[rule].dataMult = item.mult;
+				structs[rule].dataN = item.n;
+				continue;
+			}
+			Field f;
+			f.mult = item.mult;
+			f.n = item.n;
+			if(item.kind == TbnfGrammar::Item::REF) {
+				const TbnfGrammar::Item *pattern = patternOf(item.ref);
+				if(pattern == nullptr) {
+					return fail("rule <" + rule + ">: <" + item.ref + "> should be one node with a literal name");
+				}
+				f.name = fieldNameOf(item.ref);
+				f.nodeName = literalName(*pattern);
+				if(f.nodeName[0] == SYM_STRING_NODE) {
+					f.kind = FieldKind::TEXT;
+				} else {
+					f.kind = FieldKind::STRUCT;
+					f.rule = item.ref;
+					if(pattern->body.size() != 1) {
+						return fail("rule <" + item.ref + ">: alternatives in the body are not supported");
+					}
+					if((structs.find(item.ref) == structs.end()) && !addStruct(item.ref, f.nodeName, pattern->body[0])) {
+						return false;
+					}
+				}
+			} else if(item.kind == TbnfGrammar::Item::NODE) {
+				f.nodeName = literalName(item);
+				if(f.nodeName.empty()) {
+					return fail("rule <" + rule + ">: node patterns should have literal names");
+				}
+				if(f.nodeName[0] == SYM_STRING_NODE) {
+					f.kind = FieldKind::TEXT;
+					std::string bare = f.nodeName.substr(1);
+					if(!bare.empty() && (bare[0] == '_')) {
+						bare = bare.substr(1);
+					}
+					f.name = fieldNameOf(bare.empty() ? "text" : bare);
+				} else {
+					if((item.body.size() != 1) || !item.body[0].empty()) {
+						return fail("rule <" + rule + ">: give the pattern " + f.nodeName + "{...} its own rule");
+					}
+					f.kind = FieldKind::FLAG;
+					f.name = fieldNameOf(f.nodeName);
+				}
+			} else {
+				return fail("rule <" + rule + ">: hexes after the children");
+			}
+			// Unique field names
+			std::string base = f.name;
+			for(unsigned int k = 2; std::any_of(fields.begin(), fields.end(), [&f] (const Field &o) { return o.name == f.name; }); ++k) {
+				f.name = base + "_" + std::to_string(k);
+			}
+			fields.push_back(f);
+		}
+		// The parsers decide on the name of the next child only, so an item that might be left out or repeated
+		// cannot be followed by an item of the same name before something that must be there
+		for(size_t i = 0; i < fields.size(); ++i) {
+			if(!isVariable(fields[i].mult)) {
+				continue;
+			}
+			for(size_t j = i + 1; j < fields.size(); ++j) {
+				if((fields[j].nodeName == fields[i].nodeName) && (fields[j].kind == FieldKind::TEXT) == (fields[i].kind == FieldKind::TEXT)) {
+					return fail("rule <" + rule + ">: the " + fields[i].nodeName + " children are ambiguous");
+				}
+				if(!canBeEmpty(fields[j].mult)) {
+					break;
+				}
+			}
+		}
+		structs[rule].fields = fields;
+		return true;
+	}
+
+	inline static bool isVariable(TbnfGrammar::Mult mult) {
+		return (mult != TbnfGrammar::Mult::ONE) && (mult != TbnfGrammar::Mult::N);
+	}
+
+	inline static bool canBeEmpty(TbnfGrammar::Mult mult) {
+		return (mult == TbnfGrammar::Mult::OPT) || (mult == TbnfGrammar::Mult::STAR) ||
+			(mult == TbnfGrammar::Mult::N_OPT) || (mult == TbnfGrammar::Mult::N_STAR);
+	}
+
+	/** Empty leaves that must be there (once or exactly N times) have no field */
+	inline static bool isFixedFlag(const Field &f) {
+		return (f.kind == FieldKind::FLAG) && !isVariable(f.mult);
+	}
+
+	/** Vectors are the fields of the multiplicities with no fixed count */
+	inline static bool isVector(TbnfGrammar::Mult mult) {
+		return isVariable(mult) && (mult != TbnfGrammar::Mult::OPT);
+	}
+
+	/** Puts the structs in an order where the struct members are defined before they are used (vectors can wait) */
+	inline bool orderStructs(const std::string &rule, std::vector<std::string> &visiting) {
+		if(std::find(order.begin(), order.end(), rule) != order.end()) {
+			return true;
+		}
+		if(std::find(visiting.begin(), visiting.end(), rule) != visiting.end()) {
+			return fail("rule <" + rule + "> contains itself - use a multiplicity like * to make it a vector");
+		}
+		visiting.push_back(rule);
+		for(const Field &f : structs[rule].fields) {
+			if((f.kind == FieldKind::STRUCT) && !isVector(f.mult) && !orderStructs(f.rule, visiting)) {
+				return false;
+			}
+		}
+		visiting.pop_back();
+		order.push_back(rule);
+		return true;
+	}
+
+	/** The condition of a multiplicity on the count n (in C++) */
+	inline static std::string countCheck(TbnfGrammar::Mult mult, unsigned int n, const std::string &count) {
+		std::string N = std::to_string(n);
+		switch(mult) {
+			case TbnfGrammar::Mult::ONE: return count + " == 1";
+			case TbnfGrammar::Mult::OPT: return count + " <= 1";
+			case TbnfGrammar::Mult::STAR: return "true";
+			case TbnfGrammar::Mult::PLUS: return count + " >= 1";
+			case TbnfGrammar::Mult::N: return count + " == " + N;
+			case TbnfGrammar::Mult::N_OPT: return "(" + count + " == 0) || (" + count + " == " + N + ")";
+			case TbnfGrammar::Mult::N_STAR: return "(" + count + " % " + N + ") == 0";
+			default: return "(" + count + " > 0) && ((" + count + " % " + N + ") == 0)";
+		}
+	}
+
+	/** The multiplicity as written in tbnf */
+	inline static std::string multText(TbnfGrammar::Mult mult, unsigned int n) {
+		std::string N = std::to_string(n);
+		switch(mult) {
+			case TbnfGrammar::Mult::ONE: return "";
+			case TbnfGrammar::Mult::OPT: return "?";
+			case TbnfGrammar::Mult::STAR: return "*";
+			case TbnfGrammar::Mult::PLUS: return "+";
+			case TbnfGrammar::Mult::N: return "*" + N;
+			case TbnfGrammar::Mult::N_OPT: return "*" + N + "?";
+			case TbnfGrammar::Mult::N_STAR: return "*" + N + "*";
+			default: return "*" + N + "+";
+		}
+	}
+
+	/** The type of exactly n hex digits */
+	inline static std::string exactDataType(unsigned int n) {
+		return (n <= 2) ? "uint8_t" : (n <= 4) ? "uint16_t" : (n <= 8) ? "uint32_t" : "uint64_t";
+	}
+
+	inline static bool isExact(TbnfGrammar::Mult mult) {
+		return (mult == TbnfGrammar::Mult::ONE) || (mult == TbnfGrammar::Mult::N);
+	}
+
+	inline static std::string quoted(const std::string &s) {
+		std::string q = "\"";
+		for(char c : s) {
+			if((c == '"') || (c == '\\')) q += '\\';
+			q += c;
+		}
+		return q + "\"";
+	}
+
+	inline void write(const std::string &startRule, const std::string &ns, std::ostream &out) {
+		std::string guard = ns + "_GEN_H";
+		std::transform(guard.begin(), guard.end(), guard.begin(), [] (char c) { return isalnum((unsigned char)c) ? (char)toupper((unsigned char)c) : '_'; });
+		out << "// Generated by tbnfgen from the <" << startRule << "> rule - do not edit!\n\n";
+		out << "#ifndef " << guard << "\n#define " << guard << "\n\n";
+		out << "#include<cstdint>\n#include<string>\n#include<vector>\n#include\"tbuf_schema.h\"\n\n";
+		out << "namespace " << ns << " {\n\n";
+		for(const std::string &rule : order) {
+			out << "struct " << structs[rule].typeName << ";\n";
+		}
+		for(const std::string &rule : order) {
+			writeStruct(rule, out);
+		}
+		out << "\n";
+		for(const std::string &rule : order) {
+			out << "template<class InputSubClass>\ninline bool parseBody(tbuf::SchemaReader<InputSubClass> &in, "
+				<< structs[rule].typeName << " &out);\n";
+		}
+		for(const std::string &rule : order) {
+			writeParser(rule, out);
+		}
+		const Struct &start = structs[startRule];
+		out << "\n/** Parses a whole message into the struct - returns false when the message does not fit the schema */\n";
+		out << "template<class InputSubClass>\ninline bool parse(InputSubClass &input, " << start.typeName << " &out) {\n";
+		out << "\ttbuf::SchemaReader<InputSubClass> in(input);\n";
+		out << "\treturn parseBody(in, out);\n}\n\n";
+		out << "} // end of namespace " << ns << "\n\n#endif // " << guard << "\n";
+	}
+
+	inline void writeStruct(const std::string &rule, std::ostream &out) {
+		const Struct &s = structs[rule];
+		out << "\n/** " << (s.nodeName.empty() ? "The body of the message" : "A " + s.nodeName + " node") << " (<" << rule << ">) */\n";
+		out << "struct " << s.typeName << " {\n";
+		if(s.hasData) {
+			std::string mult = multText(s.dataMult, s.dataN);
+			if(isExact(s.dataMult) && (s.dataN <= 16)) {
+				out << "\t/** The value of the hexes (" << s.dataN << " digits) */\n";
+				out << "\t" << exactDataType(s.dataN) << " data;\n";
+			} else if(isExact(s.dataMult)) {
+				out << "\t/** The bytes of the hexes (" << s.dataN << " digits) */\n";
+				out << "\tuint8_t data[" << (s.dataN + 1) / 2 << "];\n";
+			} else {
+				out << "\t/** The hex digits (" << (mult.empty() ? "one" : mult) << ") */\n";
+				out << "\tstd::string data;\n";
+			}
+		}
+		for(const Field &f : s.fields) {
+			if(isFixedFlag(f)) {
+				// Always there after a successful parse - nothing to tell
+				continue;
+			}
+			std::string type = (f.kind == FieldKind::STRUCT) ? structs[f.rule].typeName :
+				(f.kind == FieldKind::TEXT) ? "std::string" : "bool";
+			std::string what = (f.kind == FieldKind::TEXT) ? "The text of " : "";
+			out << "\t/** " << what << f.nodeName << multText(f.mult, f.n) << " */\n";
+			if(f.kind == FieldKind::FLAG) {
+				// Optional flags are there or not - the others are counted
+				if(isVector(f.mult)) {
+					out << "\tunsigned int " << f.name << ";\n";
+				} else {
+					out << "\tbool " << f.name << ";\n";
+				}
+			} else if(f.mult == TbnfGrammar::Mult::N) {
+				out << "\t" << type << " " << f.name << "[" << f.n << "];\n";
+			} else if(isVector(f.mult)) {
+				out << "\tstd::vector<" << type << "> " << f.name << ";\n";
+			} else {
+				out << "\t" << type << " " << f.name << ";\n";
+				if(f.mult == TbnfGrammar::Mult::OPT) {
+					out << "\tbool has" << typeNameOf(f.name) << ";\n";
+				}
+			}
+		}
+		out << "};\n";
+	}
+
+	/** Writes the match of the current child to the field */
+	inline static std::string matchOf(const Field &f) {
+		std::string kind = (f.kind == FieldKind::TEXT) ? "(t == Token::TEXT)" : "((t == Token::NODE) || (t == Token::WORD))";
+		return kind + " && in.nameIs(" + quoted(f.nodeName) + ", " + std::to_string(f.nodeName.length()) + ")";
+	}
+
+	/** Writes the reading of the current child into the target */
+	inline static std::string readOf(const Field &f, const std::string &target) {
+		if(f.kind == FieldKind::STRUCT) {
+			return "in.enter(t);\n\t\tif(!parseBody(in, " + target + ")) return false;";
+		} else if(f.kind == FieldKind::TEXT) {
+			return "if(!in.text(" + target + ")) return false;";
+		}
+		return "if(!in.skipEmpty(t)) return false;";
+	}
+
+	inline void writeParser(const std::string &rule, std::ostream &out) {
+		const Struct &s = structs[rule];
+		out << "\ntemplate<class InputSubClass>\ninline bool parseBody(tbuf::SchemaReader<InputSubClass> &in, " << s.typeName << " &out) {\n";
+		out << "\ttypedef typename tbuf::SchemaReader<InputSubClass>::Token Token;\n";
+		out << "\tfio::LenString digits = in.hexes();\n";
+		if(!s.hasData) {
+			out << "\tif(digits.length != 0) return false;\n";
+		} else {
+			out << "\tif(!(" << countCheck(s.dataMult, s.dataN, "digits.length") << ")) return false;\n";
+			if(isExact(s.dataMult) && (s.dataN <= 16)) {
+				out << "\tout.data = tbuf::SchemaReader<InputSubClass>::template valueOf<" << exactDataType(s.dataN) << ">(digits);\n";
+			} else if(isExact(s.dataMult)) {
+				out << "\ttbuf::SchemaReader<InputSubClass>::bytesOf(digits, out.data, sizeof(out.data));\n";
+			} else {
+				out << "\tout.data.assign(digits.startPtr, digits.length);\n";
+			}
+		}
+		out << "\tToken t = in.next();\n";
+		for(const Field &f : s.fields) {
+			out << "\t// " << f.nodeName << multText(f.mult, f.n) << "\n";
+			std::string match = matchOf(f);
+			if(isFixedFlag(f)) {
+				// Rem.: The empty leaves that must be there are only checked
+				if(f.mult == TbnfGrammar::Mult::N) {
+					out << "\tfor(unsigned int i = 0; i < " << f.n << "; ++i) {\n";
+					out << "\t\tif(!(" << match << ")) return false;\n\t\t" << readOf(f, "") << "\n\t\tt = in.next();\n\t}\n";
+				} else {
+					out << "\tif(!(" << match << ")) return false;\n\t" << readOf(f, "") << "\n\tt = in.next();\n";
+				}
+			} else if(f.kind == FieldKind::FLAG) {
+				if(isVector(f.mult)) {
+					out << "\tout." << f.name << " = 0;\n";
+					out << "\twhile(" << match << ") {\n\t\t" << readOf(f, "") << "\n\t\t++out." << f.name << ";\n\t\tt = in.next();\n\t}\n";
+					if(f.mult != TbnfGrammar::Mult::STAR) {
+						out << "\tif(!(" << countCheck(f.mult, f.n, "out." + f.name) << ")) return false;\n";
+					}
+				} else {
+					out << "\tout." << f.name << " = " << match << ";\n";
+					out << "\tif(out." << f.name << ") {\n\t\t" << readOf(f, "") << "\n\t\tt = in.next();\n\t}\n";
+				}
+			} else if(f.mult == TbnfGrammar::Mult::ONE) {
+				out << "\tif(!(" << match << ")) return false;\n\t{\n\t\t" << readOf(f, "out." + f.name) << "\n\t}\n\tt = in.next();\n";
+			} else if(f.mult == TbnfGrammar::Mult::OPT) {
+				std::string has = "out.has" + typeNameOf(f.name);
+				out << "\t" << has << " = " << match << ";\n";
+				out << "\tif(" << has << ") {\n\t\t" << readOf(f, "out." + f.name) << "\n\t\tt = in.next();\n\t}\n";
+			} else if(f.mult == TbnfGrammar::Mult::N) {
+				out << "\tfor(unsigned int i = 0; i < " << f.n << "; ++i) {\n";
+				out << "\t\tif(!(" << match << ")) return false;\n\t\t" << readOf(f, "out." + f.name + "[i]") << "\n\t\tt = in.next();\n\t}\n";
+			} else {
+				// Rem.: The elements are reused so the same shape of message does not allocate again
+				out << "\t{\n\t\tsize_t n = 0;\n\t\twhile(" << match << ") {\n";
+				out << "\t\t\tif(n == out." << f.name << ".size()) out." << f.name << ".emplace_back();\n";
+				out << "\t\t\t" << readIndented(f, "out." + f.name + "[n]") << "\n\t\t\t++n;\n\t\t\tt = in.next();\n\t\t}\n";
+				out << "\t\tout." << f.name << ".resize(n);\n";
+				if(f.mult != TbnfGrammar::Mult::STAR) {
+					out << "\t\tif(!(" << countCheck(f.mult, f.n, "n") << ")) return false;\n";
+				}
+				out << "\t}\n";
+			}
+		}
+		out << "\treturn t == Token::END;\n}\n";
+	}
+
+	/** The reading of the child one level deeper in the generated code */
+	inline static std::string readIndented(const Field &f, const std::string &target) {
+		std::string read = readOf(f, target);
+		size_t at = read.find("\n\t\t");
+		if(at != std::string::npos) {
+			read.insert(at + 1, "\t");
+		}
+		return read;
+	}
+};
+
+} // end of namespace tbuf
+
+#endif // TURBO_BUF_TBNFGEN_H
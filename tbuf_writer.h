@@ -0,0 +1,213 @@
+// tbuf_writer.h: Fast buffered serialization of turbo-buf trees into any fio::Output sink.
+
+#ifndef TURBO_BUF_WRITER_H
+#define TURBO_BUF_WRITER_H
+
+#include<cstring>
+#include<vector>
+#include"fio.h"
+#include"tbuf.h"
+#include"tbuf_scan.h"
+
+namespace tbuf {
+
+/**
+ * Serializes trees (or subtrees) into the given output sink (a subclass of fio::Output) in the same format as
+ * Node::writeOut does - either pretty printed or dense. Unlike writeOut, this writes the data hexes exactly as
+ * they are (so long hex runs and leading zeros are kept), escapes the '}' and '\' characters of the texts and
+ * separates the words and hex-like names with spaces in dense mode so that the output parses back to the same tree.
+ *
+ * The small tokens (names, braces, indentation) are collected in a big staging buffer while long texts and hexes
+ * are referred in place. These parts are handed over to the sink in batches, so a file descriptor sink needs only
+ * one writev call per batch instead of the many small writes.
+ */
+template<class OutputSubClass>
+class Writer {
+public:
+	/** The default size of the staging buffer */
+	static const unsigned int DEFAULT_BUFFER_SIZE = 64 * 1024;
+
+	/** Create a writer for the given output. The output must outlive the writer. */
+	Writer(OutputSubClass &output, bool prettyPrint = true, unsigned int bufferSize = DEFAULT_BUFFER_SIZE)
+		: out(output), pretty(prettyPrint),
+		  buffer((bufferSize > ZERO_COPY_MIN) ? bufferSize : ZERO_COPY_MIN),
+		  used(0), staged(0), partCount(0) {}
+
+	/**
+	 * Writes the given tree or subtree. Everything is handed over to the output before this returns, but
+	 * the output is not flushed (call flush() on the output for that). Returns false on output errors.
+	 */
+	inline bool write(Node &root) {
+		// The same state as in writeOut: the depth of the last node and its leafness and data-emptiness
+		unsigned int lastDepth = 0;
+		unsigned int lastBits = CLEAR_BITS;
+		root.dfs_preorder([this, &lastDepth, &lastBits] (NodeCore &nc, unsigned int depth, bool leaf) {
+			if((lastBits & LEAF_BIT) == 0) {
+				if(pretty && (depth > 0)) put('\n');
+			}
+			closeNodes(lastDepth, depth, lastBits);
+			if(depth > 0) {
+				// In dense mode a name right after data or a '}' would be read as data when it starts with a hex
+				if(!pretty && (lastBits != (LEAF_BIT | EMPTY_DATA_BIT)) &&
+				   (nc.nameLength > 0) && Hexes::isHexCharacter(nc.name[0])) {
+					put(' ');
+				}
+				indent(depth);
+				put(nc.name, nc.nameLength);
+				// Empty-data leaves are written as the name only
+				if((nc.nodeKind == NodeKind::TEXT) || !nc.data.isEmpty() || !leaf) {
+					put(SYM_OPEN_NODE);
+				}
+			}
+			if(nc.nodeKind != NodeKind::TEXT) {
+				put(nc.data.digits.startPtr, nc.data.digits.length);
+			} else if(nc.text != nullptr) {
+				putEscaped(nc.text, nc.textLength);
+			}
+			lastDepth = depth;
+			lastBits = leaf ? LEAF_BIT : CLEAR_BITS;
+			// Rem.: Text nodes always have their opener written so they need the closer too (even without any text)
+			if((nc.nodeKind != NodeKind::TEXT) &&
+			   (((nc.nodeKind != NodeKind::NORM) && (nc.nodeKind != NodeKind::ROOT)) || (nc.data.isEmpty()))) {
+				lastBits += EMPTY_DATA_BIT;
+			}
+			// In dense mode every empty-data leaf ("word") is closed by a space - even before a '}' or at the end
+			// as otherwise the closing '}' would be the part of the name (writeOut loses these words)
+			if(!pretty && (depth > 0) && (lastBits == (LEAF_BIT | EMPTY_DATA_BIT))) {
+				put(' ');
+			}
+		});
+		// Close the nodes that are still open at the end
+		if(((lastBits & LEAF_BIT) == 0) && pretty && (lastDepth > 0)) {
+			put('\n');
+		}
+		closeNodes(lastDepth, 0, lastBits);
+		drain();
+		return out.isGood();
+	}
+
+private:
+	static const unsigned int CLEAR_BITS = 0;
+	static const unsigned int LEAF_BIT = 1;
+	static const unsigned int EMPTY_DATA_BIT = 2;
+	/** The most parts we hand over to the output at once */
+	static const unsigned int MAX_PARTS = 64;
+	/** Texts and hexes at least this long are referred in place instead of being copied to the staging buffer */
+	static const unsigned int ZERO_COPY_MIN = 512;
+
+	OutputSubClass &out;
+	bool pretty;
+	/** The staging buffer: [staged..used) is not yet among the parts */
+	std::vector<char> buffer;
+	size_t used;
+	size_t staged;
+	fio::LenString parts[MAX_PARTS];
+	unsigned int partCount;
+
+	/**
+	 * Closes the open nodes from lastDepth up to (but not including) depth - just like writeOut does.
+	 * The first closer is on the same line when the last node was a leaf and omitted when it was an empty-data leaf.
+	 */
+	inline void closeNodes(unsigned int &lastDepth, unsigned int depth, unsigned int lastBits) {
+		bool needIndent = ((lastBits & LEAF_BIT) == 0);
+		bool needCloser = ((lastBits & EMPTY_DATA_BIT) == 0);
+		while((lastDepth > 0) && (lastDepth >= depth)) {
+			if(needIndent) {
+				indent(lastDepth);
+			} else { needIndent = true; }
+			if(needCloser) {
+				put(SYM_CLOSE_NODE);
+			} else { needCloser = true; }
+			if(pretty) put('\n');
+			--lastDepth;
+		}
+	}
+
+	/** Writes the tabs of the given depth when pretty printing */
+	inline void indent(unsigned int depth) {
+		static const char TABS[] = "\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t";
+		if(!pretty || (depth == 0)) return;
+		unsigned int tabs = depth - 1;
+		while(tabs > 0) {
+			unsigned int n = (tabs < sizeof(TABS) - 1) ? tabs : (unsigned int)(sizeof(TABS) - 1);
+			put(TABS, n);
+			tabs -= n;
+		}
+	}
+
+	/** Writes the text with '\' before every '}' and '\' */
+	inline void putEscaped(const char *p, unsigned int length) {
+		const ScanKernels &k = Scan::active();
+		while(true) {
+			unsigned int n = k.textSpecial(p, length);
+			put(p, n);
+			if(n >= length) return;
+			put(SYM_ESCAPE);
+			put(p[n]);
+			p += n + 1;
+			length -= n + 1;
+		}
+	}
+
+	inline void put(char c) {
+		if(used == buffer.size()) {
+			drain();
+		}
+		buffer[used++] = c;
+	}
+
+	inline void put(const char *p, size_t length) {
+		if(length == 0) {
+			return;
+		}
+		if(length >= ZERO_COPY_MIN) {
+			// Refer it in place - the tree memory is valid until write() returns
+			stage();
+			addPart(p, length);
+			return;
+		}
+		if(used + length > buffer.size()) {
+			drain();
+		}
+		memcpy(&buffer[used], p, length);
+		used += length;
+	}
+
+	/** Makes the not yet staged part of the buffer a part */
+	inline void stage() {
+		if(used > staged) {
+			size_t from = staged;
+			staged = used;
+			addPart(&buffer[from], used - from);
+		}
+	}
+
+	/** Adds a part - the whole buffer must be staged after it (so a full batch can be written and reused) */
+	inline void addPart(const char *p, size_t length) {
+		parts[partCount++] = fio::LenString{(unsigned int)length, (char*)p};
+		if(partCount == MAX_PARTS) {
+			flushParts();
+			used = 0;
+			staged = 0;
+		}
+	}
+
+	inline void flushParts() {
+		if(partCount > 0) {
+			out.writeParts(parts, partCount);
+			partCount = 0;
+		}
+	}
+
+	/** Hands over everything to the output so the staging buffer can be reused */
+	inline void drain() {
+		stage();
+		flushParts();
+		used = 0;
+		staged = 0;
+	}
+};
+
+} // end of namespace tbuf
+
+#endif // TURBO_BUF_WRITER_H
@@ -1,24 +1,107 @@
 // Small test program for turbo-buf
-// g++ --std=c++14 test.cpp -o test.out
+// g++ --std=c++14 -pthread test.cpp -o test.out
 
 #include<iostream>
+#include<algorithm>
+#include<atomic>
 #include<cstdint>
 #include<cstdio>
+#include<cstdlib>
+#include<cstring>
+#include<new>
 #include<vector>
 #include<string>
+#include<sstream>
 
 // Ensure debug configuration for development
 #define DEBUG_LOG 1	/* There are some detailed logs that happen to show only if this is set */
 #define TBUF_ASSERT 1	/* There are some assertions we better use for development time */
+#define TBUF_STATS 1	/* The counters of the parser and the queries (see tbuf_stats.h) */
+#define TBUF_STATS_TIMERS 1	/* And the phase timers too */
 
 #include"tbuf.h"
+#include"tbuf_parallel.h"
+#include"tbuf_writer.h"
+#include"tbuf_binary.h"
+#include"tbuf_incremental.h"
+#include"tbuf_events.h"
+#include"tbuf_reader.h"
+#include"tbuf_tbnf.h"
+#include"tbuf_tbnfgen.h"
+#include"sensors_gen.h"
 #include"fio.h"
 
 void testTbuf();
+void testMmapInput();
+void testStreamInput();
+void testScanKernels();
+void testStructuralIndex();
+void testIncrementalParser();
+void testEventParser();
+void testReader();
+void testProjection();
+void testTreeReuse();
+void testParallelParse();
+void testLazyTree();
+void testNodePool();
+void testSymbolTable();
+void testChildIndex();
+void testCompiledQuery();
+void testPathLiterals();
+void testStats();
+void testTraversal();
+void testHexDecoding();
+void testHexArrays();
+void testWriter();
+void testBinaryCodec();
+void testTbnf();
+void testGeneratedParser();
+
+/** The number of heap allocations so far - for checking the code paths that should not allocate */
+std::atomic<unsigned long long> allocationCount{0};
+
+void* operator new(size_t size) {
+	++allocationCount;
+	void *p = malloc((size > 0) ? size : 1);
+	if(p == nullptr) throw std::bad_alloc();
+	return p;
+}
+
+void operator delete(void *p) noexcept {
+	free(p);
+}
+
+void operator delete(void *p, size_t size) noexcept {
+	free(p);
+}
 
 int main(){
 	// Various tests
 	testTbuf();
+	testMmapInput();
+	testStreamInput();
+	testScanKernels();
+	testStructuralIndex();
+	testIncrementalParser();
+	testEventParser();
+	testReader();
+	testProjection();
+	testTreeReuse();
+	testParallelParse();
+	testLazyTree();
+	testNodePool();
+	testSymbolTable();
+	testChildIndex();
+	testCompiledQuery();
+	testPathLiterals();
+	testStats();
+	testTraversal();
+	testHexDecoding();
+	testHexArrays();
+	testWriter();
+	testBinaryCodec();
+	testTbnf();
+	testGeneratedParser();
 
 	// Exit
 	return 0;
@@ -140,14 +223,2049 @@ void testTbuf(){
 	fruit.addDuplicate(fruit.root, text1);
 	tbuf::Node& data1 = fruit.addNormalNode(fruit.root, "FFAA0013", "test3");
 	// This would not work instead of the above as auto will be Node and not Node& sadly!!!
-	// This can cause havok and mayhem if one does not know so some test code is added below uncommented.
 	//auto data1 = fruit.addNormalNode(fruit.root, "FFAA0013", "test3");
 	fruit.addDuplicate(data1, text1);
-	//printf("data1.children.size(): %d\n", data1.children.size());
-	//tbuf::Node& lastChild = fruit.root.children[fruit.root.children.size()-1];
-	printf("root.lastChild(%s).children.size(): %d\n", lastChild.core.name, lastChild.children.size());
+	// Rem.: Nodes never move (they are in the node pool) so the references above are still valid here
+	printf("data1.children.size(): %d\n", (int)data1.children.size());
+	tbuf::Node& lastChild = fruit.root.children[fruit.root.children.size()-1];
+	printf("root.lastChild(%s).children.size(): %d\n", lastChild.core.name, (int)lastChild.children.size());
 	printf("Test writeOut - after node additions (pretty-printing):\n");
 	fruit.root.writeOut();
 
 	printf("End of testing\n");
 }
+
+/** Dumps the tree structure into a string so that trees from various parse modes can be compared */
+std::string dumpTree(tbuf::Node &root) {
+	std::string dump;
+	root.dfs_preorder([&dump] (tbuf::NodeCore& nc, unsigned int depth, bool leaf) {
+		dump += std::to_string(depth) + (leaf ? "*" : " ") + std::string(nc.name, nc.nameLength);
+		if(nc.nodeKind == tbuf::NodeKind::TEXT) {
+			dump += "$(" + ((nc.text != nullptr) ? std::string(nc.text, nc.textLength) : std::string()) + ")\n";
+		} else {
+			dump += "(" + ((!nc.data.isEmpty()) ? nc.data.digits.get_str() : std::string()) + ")\n";
+		}
+	});
+	return dump;
+}
+
+void testMmapInput(){
+	printf("Testing fio::MmapInput with zero-copy parsing...\n");
+	// Parse the same file with copying from a FastInput and with zero-copy from the memory mapped file
+	fio::FastInput fin("in.txt");
+	tbuf::Tree copied(fin);
+	fio::MmapInput min("in.txt");
+	tbuf::Tree mapped(min, true);
+	if(dumpTree(copied.root) == dumpTree(mapped.root)) {
+		printf("...zero-copy tree is the same as the copied one\n");
+	} else {
+		printf("FIXME: zero-copy tree differs from the copied one:\n%s\n%s\n", dumpTree(copied.root).c_str(), dumpTree(mapped.root).c_str());
+	}
+
+	// Check if fetch works with the non zero-terminated names too
+	int fetchTestOk = 0;
+	tbuf::TreeQuery::fetch(mapped.root,
+			{"escaped", "$_txt"},
+			[&fetchTestOk] (tbuf::NodeCore &nc) {
+				printf("Found node with text: %.*s\n", nc.textLength, nc.text);
+				++fetchTestOk; // we should have found this...
+			});
+	tbuf::TreeQuery::fetch(mapped.root,
+			std::vector<tbuf::LevelDescender>{
+				tbuf::LevelDescender("fruit", 1, true),
+				tbuf::LevelDescender(tbuf::SYM_STRING_NODE_STR, 0, true),
+			},
+			[&fetchTestOk] (tbuf::NodeCore &nc) {
+				printf("Found node with text: %.*s\n", nc.textLength, nc.text);
+				++fetchTestOk; // we should have found this...
+			});
+	printf("...mmap fetch test ok: %d\n", fetchTestOk);
+
+	printf("Test writeOut - zero-copy tree dense printing:\n");
+	mapped.root.writeOut(stdout, false);
+	printf("\n");
+
+	// Big (sparse) files: over 2 GB these are mapped as a whole and over 4 GB these are refused (no LenString can hold them)
+	char bigName[] = "/tmp/tbuf_big_XXXXXX";
+	int fd = mkstemp(bigName);
+	if((fd >= 0) && (write(fd, "a{01}", 5) == 5) && (ftruncate(fd, (off_t)0x80000010) == 0)) {
+		fio::MmapInput big(bigName);
+		if((big.grabCurr() != 'a') || (big.grabAhead().length != 0x80000010u)) {
+			printf("FIXME: the 2 GB file is not mapped as a whole!\n");
+		} else if(ftruncate(fd, (off_t)0x100000010LL) == 0) {
+			fio::MmapInput huge(bigName);
+			if((huge.grabCurr() == EOF) && (huge.grabAhead().length == 0)) {
+				printf("...mapping big files ok\n");
+			} else {
+				printf("FIXME: the file over 4 GB is not refused!\n");
+			}
+		}
+	}
+	if(fd >= 0) {
+		close(fd);
+		unlink(bigName);
+	}
+}
+
+void testStreamInput(){
+	printf("Testing fio::StreamInput with refills...\n");
+	fio::FastInput fin("in.txt");
+	tbuf::Tree copied(fin);
+	std::string expected = dumpTree(copied.root);
+
+	// A really small initial buffer ensures that we refill and grow a lot while parsing
+	FILE *f = fopen("in.txt", "r");
+	fio::StreamInput sin(f, true, 4);
+	// Rem.: Asking for references should be silently ignored as stream data cannot be referred later
+	tbuf::Tree streamed(sin, true);
+	if(dumpTree(streamed.root) == expected) {
+		printf("...FILE* streamed tree is the same as the copied one\n");
+	} else {
+		printf("FIXME: FILE* streamed tree differs from the copied one:\n%s\n", dumpTree(streamed.root).c_str());
+	}
+
+	// The same with a file descriptor
+	int fd = open("in.txt", O_RDONLY);
+	fio::StreamInput fdin(fd, true, 16);
+	tbuf::Tree fdStreamed(fdin);
+	if(dumpTree(fdStreamed.root) == expected) {
+		printf("...fd streamed tree is the same as the copied one\n");
+	} else {
+		printf("FIXME: fd streamed tree differs from the copied one:\n%s\n", dumpTree(fdStreamed.root).c_str());
+	}
+}
+
+void testScanKernels(){
+	printf("Testing the vectorized scanner kernels against the scalar ones...\n");
+	// Random data from the interesting characters so that every kernel stops at various places
+	const char *alphabet = "0123456789ABCDEFabcxyz_{}$#\\ \t\r\n\xC3";
+	unsigned int alphabetLen = strlen(alphabet);
+	std::vector<char> data(4096);
+	unsigned int seed = 1337;
+	for(char &c : data) {
+		seed = seed * 1103515245 + 12345;
+		c = alphabet[(seed >> 16) % alphabetLen];
+	}
+	tbuf::ScanKernels scalar = tbuf::Scan::kernelsFor(tbuf::ScanLevel::SCALAR);
+	int mismatches = 0;
+	for(int level = (int)tbuf::ScanLevel::SSE2; level <= (int)tbuf::Scan::bestLevel(); ++level) {
+		tbuf::ScanKernels vec = tbuf::Scan::kernelsFor((tbuf::ScanLevel)level);
+		for(unsigned int start = 0; start < 200; ++start) {
+			for(unsigned int len = 0; len < 100; len += 7) {
+				const char *p = &data[start];
+				mismatches += (scalar.hexRun(p, len) != vec.hexRun(p, len));
+				mismatches += (scalar.nameEnd(p, len) != vec.nameEnd(p, len));
+				mismatches += (scalar.structural(p, len) != vec.structural(p, len));
+				mismatches += (scalar.textSpecial(p, len) != vec.textSpecial(p, len));
+				mismatches += (scalar.lineEnd(p, len) != vec.lineEnd(p, len));
+				mismatches += (scalar.whiteSpaceRun(p, len) != vec.whiteSpaceRun(p, len));
+			}
+			tbuf::BlockMasks sm, vm;
+			scalar.blockMasks(&data[start], sm);
+			vec.blockMasks(&data[start], vm);
+			mismatches += (memcmp(&sm, &vm, sizeof(sm)) != 0);
+		}
+	}
+	if(mismatches == 0) {
+		printf("...kernels are matching the scalar ones\n");
+	} else {
+		printf("FIXME: %d kernel results are different from the scalar ones!\n", mismatches);
+	}
+
+	// Parsing must give the same tree on every level - with long hex runs and escaped texts
+	std::string msg = "01234567890ABCDEF0123456789ABCDEF0123 long_name_of_a_node{0123456789ABCDEF0123456789ABCDEF01 "
+			"$_t{An escaped \\} and an escaped escape: \\\\}"
+			"# A comment that is long enough to be scanned by the vectors...\n"
+			"word                                     another_word\n}";
+	std::string expected;
+	for(int level = 0; level <= (int)tbuf::Scan::bestLevel(); ++level) {
+		tbuf::Scan::useLevel((tbuf::ScanLevel)level);
+		std::vector<char> buf(msg.begin(), msg.end());
+		buf.push_back(EOF);
+		fio::FastInput fin(msg.length(), &buf[0], false);
+		tbuf::Tree tree(fin);
+		std::string dump = dumpTree(tree.root);
+		if(level == 0) {
+			expected = dump;
+			printf("%s", dump.c_str());
+		} else if(dump != expected) {
+			printf("FIXME: parsing with scan level %d differs:\n%s", level, dump.c_str());
+		}
+	}
+	tbuf::Scan::useLevel(tbuf::Scan::bestLevel());
+}
+
+/**
+ * Generates a random message out of tbuf-like tokens (also with syntax errors and unusual spacing).
+ * Useful for comparing the various parsers against each other.
+ */
+std::string randomMessage(unsigned int seed, unsigned int tokens) {
+	const char *pieces[] = {
+		"node{", "a{", "long_node_name{", "}", "}", "}", " ", "\n", "\t", "  \r\n",
+		"0123456789ABCDEF", "F", "0A0B0C", "word ", "x ", "${text}", "$_t{", "with \\} escape}",
+		"$_name{a somewhat longer text node that can cross the blocks}", "# comment {$}\n", "{", "$",
+		"0123456789ABCDEF0123456789ABCDEF0123456789ABCDEF0123456789ABCDEF0123", "\\\\", "escaped\\",
+	};
+	const unsigned int pieceCount = sizeof(pieces) / sizeof(pieces[0]);
+	std::string msg;
+	for(unsigned int i = 0; i < tokens; ++i) {
+		seed = seed * 1103515245 + 12345;
+		msg += pieces[(seed >> 16) % pieceCount];
+	}
+	return msg;
+}
+
+void testStructuralIndex(){
+	printf("Testing the two-stage parsing with the structural index...\n");
+	int failures = 0;
+	for(unsigned int seed = 0; seed < 300; ++seed) {
+		std::string msg = randomMessage(seed, seed % 60);
+		// The serial parser gives the expected tree
+		std::vector<char> serialBuf(msg.begin(), msg.end());
+		serialBuf.push_back(EOF);
+		fio::FastInput serialIn(msg.length(), &serialBuf[0], false);
+		tbuf::Tree serial(serialIn);
+		std::string expected = dumpTree(serial.root);
+
+		// Both the copying and the destructive two-stage parse should give the same
+		for(int destructive = 0; destructive < 2; ++destructive) {
+			std::vector<char> buf(msg.begin(), msg.end());
+			buf.push_back(EOF);
+			fio::FastInput fin(msg.length(), &buf[0], false);
+			tbuf::StructuralIndex index(fin);
+			tbuf::Tree indexed(index, destructive == 1);
+			std::string dump = dumpTree(indexed.root);
+			if(dump != expected) {
+				++failures;
+				printf("FIXME: two-stage parse (destructive: %d) differs for:\n%s\n%s\n%s\n", destructive, msg.c_str(), expected.c_str(), dump.c_str());
+			}
+		}
+	}
+	if(failures == 0) {
+		printf("...two-stage parsing gives the same trees as the serial parsing\n");
+	}
+
+	// Streams do not have all their data in the memory: the index is invalid (instead of having only a part)
+	FILE *f = tmpfile();
+	for(int i = 0; i < 20000; ++i) {
+		fputs("item{AB x{CD}}\n", f);
+	}
+	rewind(f);
+	fio::StreamInput sin(f, true, 4096);
+	tbuf::StructuralIndex streamIndex(sin);
+	tbuf::Tree refused(streamIndex);
+	// The stream is not advanced so it can be parsed the usual way
+	tbuf::Tree streamed(sin);
+	if(!streamIndex.isValid() && refused.root.children.empty() && (streamed.root.children.size() == 20000)) {
+		printf("...streams are not indexed\n");
+	} else {
+		printf("FIXME: indexing a stream gave %u nodes!\n", (unsigned int)refused.root.children.size());
+	}
+
+	// Zero-copy from a memory mapped file and subtree skipping
+	fio::MmapInput min("in.txt");
+	tbuf::StructuralIndex index(min);
+	tbuf::Tree mapped(index, true);
+	fio::FastInput fin("in.txt");
+	tbuf::Tree copied(fin);
+	if(dumpTree(mapped.root) == dumpTree(copied.root)) {
+		printf("...zero-copy two-stage tree is the same as the copied one\n");
+	} else {
+		printf("FIXME: zero-copy two-stage tree differs:\n%s\n", dumpTree(mapped.root).c_str());
+	}
+	uint32_t topLevel = 0;
+	for(uint32_t i = 0; i < index.entries.size(); i = index.skip(i)) {
+		if(index.entries[i].kind != tbuf::IndexEntryKind::CLOSE) ++topLevel;
+	}
+	if(topLevel == copied.root.children.size()) {
+		printf("...skipping subtrees visits the %u top level nodes\n", topLevel);
+	} else {
+		printf("FIXME: skipping subtrees visits %u instead of %u top level nodes\n", topLevel, (unsigned int)copied.root.children.size());
+	}
+}
+
+void testParallelParse(){
+	printf("Testing the parallel parsing...\n");
+	int failures = 0;
+	for(unsigned int seed = 0; seed < 300; ++seed) {
+		std::string msg = randomMessage(seed, seed % 150);
+		std::vector<char> serialBuf(msg.begin(), msg.end());
+		serialBuf.push_back(EOF);
+		fio::FastInput serialIn(msg.length(), &serialBuf[0], false);
+		tbuf::Tree serial(serialIn);
+		std::string expected = dumpTree(serial.root);
+
+		for(unsigned int threads = 1; threads <= 8; threads *= 2) {
+			std::vector<char> buf(msg.begin(), msg.end());
+			buf.push_back(EOF);
+			fio::FastInput fin(msg.length(), &buf[0], false);
+			std::unique_ptr<tbuf::Tree> parallel = tbuf::parallelParse(fin, threads);
+			std::string dump = dumpTree(parallel->root);
+			if(dump != expected) {
+				++failures;
+				printf("FIXME: parallel parse with %u threads differs for:\n%s\n%s\n%s\n", threads, msg.c_str(), expected.c_str(), dump.c_str());
+			}
+		}
+	}
+	if(failures == 0) {
+		printf("...parallel parsing gives the same trees as the serial parsing\n");
+	}
+}
+
+void testLazyTree(){
+	printf("Testing lazy trees...\n");
+	int failures = 0;
+	for(unsigned int seed = 0; seed < 300; ++seed) {
+		std::string msg = randomMessage(seed, seed % 80);
+		std::vector<char> serialBuf(msg.begin(), msg.end());
+		serialBuf.push_back(EOF);
+		fio::FastInput serialIn(msg.length(), &serialBuf[0], false);
+		tbuf::Tree serial(serialIn);
+		std::string expected = dumpTree(serial.root);
+
+		// Both the copying and the destructive lazy parse should give the same
+		for(int destructive = 0; destructive < 2; ++destructive) {
+			std::vector<char> buf(msg.begin(), msg.end());
+			buf.push_back(EOF);
+			fio::FastInput fin(msg.length(), &buf[0], false);
+			tbuf::Tree lazy(fin, destructive == 1, true, true);
+			std::string dump = dumpTree(lazy.root);
+			if(dump != expected) {
+				++failures;
+				printf("FIXME: lazy parse (destructive: %d) differs for:\n%s\n%s\n%s\n", destructive, msg.c_str(), expected.c_str(), dump.c_str());
+			}
+		}
+	}
+	if(failures == 0) {
+		printf("...lazy trees are the same as the serially parsed ones\n");
+	}
+
+	// Only the nodes along the fetched path should get parsed
+	fio::MmapInput min("in.txt");
+	tbuf::Tree lazy(min, true, true, true);
+	if(!lazy.root.children.isLazy()) {
+		printf("FIXME: the lazy root children got parsed too early!\n");
+	}
+	int found = 0;
+	tbuf::TreeQuery::fetch(lazy.root, {"escaped", "$_txt"}, [&found] (tbuf::NodeCore &nc) {
+		printf("Found lazy node with text: %.*s\n", nc.textLength, nc.text);
+		++found;
+	});
+	int stillLazy = 0;
+	for(tbuf::Node &child : lazy.root.children) {
+		stillLazy += child.children.isLazy() ? 1 : 0;
+	}
+	if((found == 1) && (stillLazy > 0)) {
+		printf("...fetch parsed only the needed nodes - unparsed top level siblings: %d\n", stillLazy);
+	} else {
+		printf("FIXME: lazy fetch found %d nodes with %d unparsed siblings\n", found, stillLazy);
+	}
+	fio::FastInput fin("in.txt");
+	tbuf::Tree copied(fin);
+	if(dumpTree(lazy.root) != dumpTree(copied.root)) {
+		printf("FIXME: the zero-copy lazy tree differs:\n%s\n", dumpTree(lazy.root).c_str());
+	}
+
+	// Copies of lazy lists parse the children of their node (only once)
+	fio::MmapInput min2("in.txt");
+	tbuf::Tree lazy2(min2, false, true, true);
+	tbuf::ChildList rootKids = lazy2.root.children;
+	size_t copiedCount = rootKids.size();
+	tbuf::Node &first = lazy2.root.children[0];
+	tbuf::ChildList firstKids = first.children;
+	size_t firstCount = first.children.size();
+	if((copiedCount == copied.root.children.size()) && (lazy2.root.children.size() == copiedCount) &&
+			(firstKids.size() == firstCount) && (firstCount == copied.root.children[0].children.size()) &&
+			(dumpTree(lazy2.root) == dumpTree(copied.root))) {
+		printf("...copied lazy lists are parsed into their nodes\n");
+	} else {
+		printf("FIXME: copied lazy lists give %u and %u children!\n", (unsigned int)copiedCount, (unsigned int)firstKids.size());
+	}
+}
+
+void testNodePool(){
+	printf("Testing node addresses in the node pool...\n");
+	fio::FastInput fin("in.txt");
+	tbuf::Tree tree(fin);
+	// Keep references and pointers around while adding a lot of nodes everywhere
+	tbuf::Node &first = tree.root.children[0];
+	tbuf::Node *firstChild = &first.children[0];
+	tbuf::Node &added = tree.addNormalNode(first, "0A", "added");
+	for(int i = 0; i < 10000; ++i) {
+		tree.addNormalNode(tree.root, "FF", "many");
+		tree.addTextNode(added, "text", "t");
+	}
+	int failures = 0;
+	failures += (&first != &tree.root.children[0]);
+	failures += (firstChild != &first.children[0]);
+	failures += (&added != &first.children.back());
+	failures += (added.children.size() != 10000);
+	failures += (tree.root.children.size() != 8 + 10000);
+	// Parents should be right for every node
+	unsigned int checked = 0;
+	std::vector<tbuf::Node*> stack{&tree.root};
+	while(!stack.empty()) {
+		tbuf::Node *node = stack.back();
+		stack.pop_back();
+		for(tbuf::Node &child : node->children) {
+			failures += (child.parent != node);
+			stack.push_back(&child);
+			++checked;
+		}
+	}
+	// Indexing in both directions should find the same nodes as the iteration
+	unsigned int i = 0;
+	for(tbuf::Node &child : tree.root.children) {
+		failures += (&child != &tree.root.children[i]);
+		++i;
+	}
+	while(i-- > 0) {
+		failures += (tree.root.children[i].parent != &tree.root);
+	}
+	if(failures == 0) {
+		printf("...node references and the parents of %u nodes are stable\n", checked);
+	} else {
+		printf("FIXME: %d node references or parents went wrong!\n", failures);
+	}
+}
+
+/** Returns the number of nodes whose name is not the same as the name of their symbol in the tree */
+int wrongNameIds(tbuf::Tree &tree) {
+	int wrong = 0;
+	const tbuf::SymbolTable &symbols = tree.symbolTable();
+	tree.root.dfs_preorder([&wrong, &symbols] (tbuf::NodeCore &nc, unsigned int depth, bool leaf) {
+		if((nc.nameId >= symbols.size()) || (symbols.lengthOf(nc.nameId) != nc.nameLength) ||
+		   memcmp(symbols.nameOf(nc.nameId), nc.name, nc.nameLength)) {
+			++wrong;
+		}
+	});
+	return wrong;
+}
+
+void testSymbolTable(){
+	printf("Testing the interned node names...\n");
+	int failures = 0;
+	// The table itself: growing, finding and clearing
+	tbuf::SymbolTable table;
+	for(int round = 0; round < 2; ++round) {
+		for(int i = 0; i < 1000; ++i) {
+			std::string name = "name" + std::to_string(i);
+			failures += (table.intern(fio::LenString{(unsigned int)name.length(), &name[0]}, true) != (uint32_t)i);
+		}
+		for(int i = 0; i < 1000; ++i) {
+			std::string name = "name" + std::to_string(i);
+			failures += (table.find(name.c_str(), name.length()) != (uint32_t)i);
+			failures += (strcmp(table.nameOf(i), name.c_str()) != 0);
+		}
+		failures += (table.find("name", 4) != tbuf::NO_SYMBOL);
+		table.clear();
+		failures += (table.size() != 0);
+	}
+
+	// Repeated names share one symbol (and in the copying mode one copy too)
+	fio::FastInput fin("in.txt");
+	tbuf::Tree tree(fin);
+	failures += wrongNameIds(tree);
+	tbuf::Node &almafa = tree.root.children[0];
+	failures += (almafa.children[1].core.nameId != almafa.children[4].core.nameId);
+	failures += (almafa.children[1].core.name != almafa.children[4].core.name);
+	failures += (almafa.children[0].core.nameId != almafa.children[1].core.nameId);
+	// "/", almafa, branch, $, körtefa, egy, ketto, harom, hololo, fruit_*, $_var, $_device, escaped, $_txt
+	failures += (tree.symbolTable().size() != 16);
+
+	// A descender resolves its name on every tree (and names added later are found too)
+	tbuf::LevelDescender late("late");
+	failures += (tree.root.descend(late) != nullptr);
+	tbuf::Node &added = tree.addNormalNode(tree.root, "01", "late");
+	failures += (tree.root.descend(late) != &added);
+	fio::FastInput fin2("in.txt");
+	tbuf::Tree other(fin2);
+	tbuf::Node &otherAdded = other.addNormalNode(other.root.children[2], "02", "late");
+	failures += (other.root.descend(late) != nullptr);
+	failures += (other.root.children[2].descend(late) != &otherAdded);
+	failures += wrongNameIds(tree) + wrongNameIds(other);
+
+	// The merged symbols of the parallel parsing
+	for(unsigned int seed = 0; seed < 100; ++seed) {
+		std::string msg = randomMessage(seed, seed % 150);
+		std::vector<char> buf(msg.begin(), msg.end());
+		buf.push_back(EOF);
+		fio::FastInput pin(msg.length(), &buf[0], false);
+		std::unique_ptr<tbuf::Tree> parallel = tbuf::parallelParse(pin, 4);
+		failures += wrongNameIds(*parallel);
+	}
+	if(failures == 0) {
+		printf("...names are interned once and compared by their IDs\n");
+	} else {
+		printf("FIXME: %d interned name checks failed!\n", failures);
+	}
+}
+
+/** Descends the slow way: scanning every child and comparing the names */
+tbuf::Node* descendByScanning(tbuf::Node &node, const tbuf::LevelDescender &ld) {
+	int found = -1;
+	for(tbuf::Node &child : node.children) {
+		std::string name(child.core.name, child.core.nameLength);
+		bool match = ld.adHocPolymorph ? (name.compare(0, ld.targetName.length(), ld.targetName) == 0) : (name == ld.targetName);
+		if(match && (++found == ld.targetIndex)) {
+			return &child;
+		}
+	}
+	return nullptr;
+}
+
+/** Returns the number of lookups below the node where the child index finds something else than the scanning */
+int wrongIndexedLookups(tbuf::Node &node) {
+	const char *names[] = {"a", "ab", "abc", "b", "fruit", "fruit_apple", "fruit_banana", "$", "$_", "$_t", "", "zzz"};
+	int wrong = 0;
+	for(const char *name : names) {
+		for(int k = -1; k < 40; ++k) {
+			for(int prefix = 0; prefix < 2; ++prefix) {
+				tbuf::LevelDescender ld(name, k, prefix == 1);
+				wrong += (node.descend(ld) != descendByScanning(node, ld));
+			}
+		}
+	}
+	return wrong;
+}
+
+void testChildIndex(){
+	printf("Testing the child indices of wide nodes...\n");
+	int failures = 0;
+	// A wide node with repeated, prefixed and text children
+	const char *childNames[] = {"a", "ab", "abc", "b", "fruit_apple", "fruit_banana", "fruit_", "$_t{x}", "${y}"};
+	std::string msg = "wide{";
+	unsigned int seed = 3;
+	for(int i = 0; i < 200; ++i) {
+		seed = seed * 1103515245 + 12345;
+		msg += std::string(childNames[(seed >> 16) % 9]) + " ";
+	}
+	msg += "}";
+	for(int lazy = 0; lazy < 2; ++lazy) {
+		std::vector<char> buf(msg.begin(), msg.end());
+		buf.push_back(EOF);
+		fio::FastInput fin(msg.length(), &buf[0], false);
+		tbuf::Tree tree(fin, lazy == 1, true, lazy == 1);
+		tbuf::Node &wide = tree.root.children[0];
+		failures += wrongIndexedLookups(wide);
+		// The index should stay current when adding
+		for(int i = 0; i < 20; ++i) {
+			tree.addNormalNode(wide, "0A", (i % 2) ? "fruit_cherry" : "ab");
+			tree.addTextNode(wide, "text", "t");
+		}
+		failures += wrongIndexedLookups(wide);
+		failures += (wide.descend(tbuf::LevelDescender("fruit_cherry", 9)) != &wide.children[wide.children.size() - 2]);
+	}
+	// The wide root of the parallel parsing (built from many spliced lists)
+	std::string wideRoot;
+	for(int i = 0; i < 5000; ++i) {
+		wideRoot += childNames[i % 9];
+		wideRoot += "\n";
+	}
+	std::vector<char> buf(wideRoot.begin(), wideRoot.end());
+	buf.push_back(EOF);
+	fio::FastInput pin(wideRoot.length(), &buf[0], false);
+	std::unique_ptr<tbuf::Tree> parallel = tbuf::parallelParse(pin, 4);
+	failures += wrongIndexedLookups(parallel->root);
+	if(failures == 0) {
+		printf("...child indices find the same nodes as scanning the children\n");
+	} else {
+		printf("FIXME: %d lookups went wrong with the child indices!\n", failures);
+	}
+}
+
+void testCompiledQuery(){
+	printf("Testing compiled string queries...\n");
+	int failures = 0;
+	fio::FastInput fin("in.txt");
+	tbuf::Tree tree(fin);
+	fio::FastInput fin2("in.txt");
+	tbuf::Tree other(fin2, true);
+	// Valid queries and what they should find
+	struct { const char *query; const char *expected; } cases[] = {
+		{"egy/ketto/harom", "harom"},
+		{"/egy/ketto@0/harom", "harom"},
+		{"fruit_@2/$_", "$_device"},
+		{"fruit@1_/$_var", "$_var"},
+		{"almafa/branch@4", "branch"},
+		{"almafa/branch@5", nullptr},
+		{"almafa/branch_@0/$", "$"},
+		{"hololo/$", "$"},
+		{"escaped/$_txt", "$_txt"},
+		{"egy/harom", nullptr},
+		{"", "/"},
+	};
+	for(auto &c : cases) {
+		tbuf::CompiledQuery q = tbuf::TreeQuery::compile(c.query);
+		failures += !q.isValid();
+		// The same compiled query on more trees
+		for(tbuf::Tree *t : {&tree, &other}) {
+			tbuf::Node *found = q.find(t->root);
+			if((found == nullptr) != (c.expected == nullptr) ||
+			   ((found != nullptr) && (std::string(found->core.name, found->core.nameLength) != c.expected))) {
+				printf("FIXME: query %s found %s\n", c.query, (found != nullptr) ? found->core.name : "nothing");
+				++failures;
+			}
+		}
+	}
+	// The compiled levels
+	tbuf::CompiledQuery orders = tbuf::TreeQuery::compile("orders/item@3/price_");
+	const std::vector<tbuf::LevelDescender> &levels = orders.getLevels();
+	failures += (levels.size() != 3) || (levels[1].targetName != "item") || (levels[1].targetIndex != 3) ||
+	            (levels[2].targetName != "price") || !levels[2].adHocPolymorph || levels[0].adHocPolymorph;
+	// Syntax errors
+	const char *invalid[] = {"a@", "a@x", "a//b", "a/", "@1", "a@1x", "_", "a@99999999999"};
+	for(const char *query : invalid) {
+		failures += tbuf::TreeQuery::compile(query).isValid();
+	}
+	// Running a compiled query allocates nothing
+	tbuf::CompiledQuery q = tbuf::TreeQuery::compile("fruit_@2/$_");
+	unsigned int textLength = 0;
+	unsigned long long before = allocationCount;
+	for(int i = 0; i < 1000; ++i) {
+		q.fetch((i % 2) ? tree.root : other.root, [&textLength] (tbuf::Node &found) {
+			textLength += found.core.textLength;
+		});
+	}
+	unsigned long long allocations = allocationCount - before;
+	failures += (textLength != 2000) || (allocations != 0);
+	// Prefix levels on wide nodes (through the child index) allocate nothing either - with one and with more names
+	std::string wideMsg = "r{";
+	for(int i = 0; i < 64; ++i) {
+		wideMsg += "k" + std::to_string(i) + "{" + std::to_string(i % 10) + "} ";
+	}
+	wideMsg += "}";
+	std::vector<char> wideBuf(wideMsg.begin(), wideMsg.end());
+	wideBuf.push_back(EOF);
+	fio::FastInput wideIn(wideMsg.length(), &wideBuf[0], false);
+	tbuf::Tree wide(wideIn);
+	tbuf::CompiledQuery manyNames = tbuf::TreeQuery::compile("r/k_@3");
+	tbuf::CompiledQuery oneName = tbuf::TreeQuery::compile("r/k42_");
+	tbuf::Node &r = wide.root.children[0];
+	failures += (manyNames.find(wide.root) != &r.children[3]) || (oneName.find(wide.root) != &r.children[42]);
+	unsigned int wideFound = 0;
+	before = allocationCount;
+	for(int i = 0; i < 1000; ++i) {
+		wideFound += (manyNames.find(wide.root) == &r.children[3]);
+		oneName.fetch(wide.root, [&wideFound] (tbuf::Node &found) {
+			wideFound += (found.core.data.asUint() == 2);
+		});
+	}
+	allocations += allocationCount - before;
+	failures += (wideFound != 2000) || (allocations != 0);
+	// The string form of fetch
+	int found = 0;
+	tbuf::TreeQuery::fetch(tree.root, "egy/ketto/harom", [&found] (tbuf::NodeCore &nc) {
+		found += (nc.data.asUint() == 0xFF);
+	});
+	failures += (found != 1);
+	if(failures == 0) {
+		printf("...compiled queries find the nodes without allocating\n");
+	} else {
+		printf("FIXME: %d compiled query checks failed (allocations: %llu)!\n", failures, allocations);
+	}
+}
+
+// The levels of a path literal are there at compile time already (and invalid paths do not compile)
+constexpr tbuf::PathLiteral<3> ORDERS_PATH{"/orders/item@3/price_"};
+static_assert((ORDERS_PATH.levels[1].length == 4) && (ORDERS_PATH.levels[1].index == 3) && ORDERS_PATH.levels[2].prefix &&
+              (ORDERS_PATH.levels[2].hash == tbuf::SymbolTable::hashOf("price", 5)), "path literal levels");
+static_assert((tbuf::pathLevelCount("egy/ketto@1/harom") == 3) && (tbuf::pathLevelCount("a//b") == 0) &&
+              (tbuf::pathLevelCount("a/") == 0) && (tbuf::pathLevelCount("a@1x") == 0), "path level counts");
+
+void testPathLiterals(){
+	printf("Testing compile time path literals...\n");
+	int failures = 0;
+	fio::FastInput fin("in.txt");
+	tbuf::Tree tree(fin);
+	fio::FastInput fin2("in.txt");
+	tbuf::Tree other(fin2, true);
+	// The same results as the query strings
+	auto sameAs = [&failures] (tbuf::Node &root, const char *query, tbuf::Node *found) {
+		if(tbuf::TreeQuery::compile(query).find(root) != found) {
+			printf("FIXME: path literal %s found %s\n", query, (found != nullptr) ? found->core.name : "nothing");
+			++failures;
+		}
+	};
+	for(tbuf::Tree *t : {&tree, &other}) {
+		tbuf::Node &root = t->root;
+		sameAs(root, "egy/ketto/harom", TBUF_PATH("egy/ketto/harom").find(root));
+		sameAs(root, "/egy/ketto@0/harom", TBUF_PATH("/egy/ketto@0/harom").find(root));
+		sameAs(root, "fruit_@2/$_", TBUF_PATH("fruit_@2/$_").find(root));
+		sameAs(root, "fruit@1_/$_var", TBUF_PATH("fruit@1_/$_var").find(root));
+		sameAs(root, "almafa/branch@4", TBUF_PATH("almafa/branch@4").find(root));
+		sameAs(root, "almafa/branch@5", TBUF_PATH("almafa/branch@5").find(root));
+		sameAs(root, "almafa/branch_@0/$", TBUF_PATH("almafa/branch_@0/$").find(root));
+		sameAs(root, "egy/harom", TBUF_PATH("egy/harom").find(root));
+		sameAs(root, "nosuchname", TBUF_PATH("nosuchname").find(root));
+		failures += (TBUF_PATH("escaped/$_txt").find(root) == nullptr);
+	}
+	// Wide nodes go through the child index
+	std::string msg = "wide{";
+	for(int i = 0; i < 40; ++i) {
+		msg += "item{" + std::to_string(i % 10) + "} itemz{1} ";
+	}
+	msg += "}";
+	std::vector<char> buf(msg.begin(), msg.end());
+	buf.push_back(EOF);
+	fio::FastInput wideIn(msg.length(), &buf[0], false);
+	tbuf::Tree wide(wideIn, true);
+	tbuf::Node *last = TBUF_PATH("wide/item@39").find(wide.root);
+	failures += (last == nullptr) || (last != tbuf::TreeQuery::compile("wide/item@39").find(wide.root)) || (last->core.data.asUint() != 9);
+	failures += (TBUF_PATH("wide/item_@79").find(wide.root) != tbuf::TreeQuery::compile("wide/item_@79").find(wide.root));
+	failures += (TBUF_PATH("wide/item@40").find(wide.root) != nullptr);
+	// Running path literals allocates nothing (the child index is already built above)
+	unsigned int textLength = 0;
+	unsigned int harom = 0;
+	unsigned long long before = allocationCount;
+	for(int i = 0; i < 1000; ++i) {
+		TBUF_PATH("fruit_@2/$_").fetch((i % 2) ? tree.root : other.root, [&textLength] (tbuf::Node &found) {
+			textLength += found.core.textLength;
+		});
+		harom += TBUF_PATH("egy/ketto/harom").find(tree.root)->core.data.asUint();
+		harom += (TBUF_PATH("wide/itemz@39").find(wide.root) != nullptr);
+		// A prefix level with more names on the wide node
+		harom += (TBUF_PATH("wide/item_@3").find(wide.root) == &wide.root.children[0].children[3]);
+	}
+	unsigned long long allocations = allocationCount - before;
+	failures += (textLength != 2000) || (harom != 1000 * 0x101) || (allocations != 0);
+	// The TreeQuery form of fetch
+	int found = 0;
+	tbuf::TreeQuery::fetch(tree.root, TBUF_PATH("egy/ketto/harom"), [&found] (tbuf::NodeCore &nc) {
+		found += (nc.data.asUint() == 0xFF);
+	});
+	failures += (found != 1);
+	if(failures == 0) {
+		printf("...path literals find the same nodes as the queries without allocating\n");
+	} else {
+		printf("FIXME: %d path literal checks failed (allocations: %llu)!\n", failures, allocations);
+	}
+}
+
+void testStats(){
+	printf("Testing the parser and query counters...\n");
+	int failures = 0;
+	std::string msg = "0A # comment\nouter{1F inner{ word $_t{te\\}xt} } deep{x{y{z{}}}} }\nother{1F}\n";
+	std::vector<char> buf(msg.begin(), msg.end());
+	buf.push_back(EOF);
+	fio::FastInput fin(msg.length(), &buf[0], false);
+	tbuf::Tree tree(fin);
+	const tbuf::TreeStats &stats = tree.statistics();
+	failures += (stats.bytesScanned != msg.length());
+	failures += (stats.nodesByKind[(int)tbuf::NodeKind::ROOT] != 1) || (stats.nodesByKind[(int)tbuf::NodeKind::NORM] != 8) ||
+	            (stats.nodesByKind[(int)tbuf::NodeKind::TEXT] != 1);
+	failures += (stats.maxDepth != 5) || (stats.comments != 1) || (stats.commentBytes != 9);
+	failures += (stats.whiteSpaceRuns != 10) || (stats.whiteSpaceBytes != 10);
+	// The root hexes, "1F" twice (the second is a hit) and the text
+	failures += (stats.treeStringInserts != 4) || (stats.treeStringHits != 1);
+	failures += (stats.poolBlocks != 1) || (stats.symbolRehashes != 0) || (stats.queries != 0);
+	// Queries: one compare on the first level, two on the second and one on the last
+	tbuf::Node *x = TBUF_PATH("outer/deep/x").find(tree.root);
+	failures += (x == nullptr) || (stats.queries != 1) || (stats.descends != 3) || (stats.descendComparisons != 4);
+	failures += (stats.phaseTicks[(int)tbuf::StatsPhase::QUERY] == 0);
+	tbuf::TreeQuery::fetch(tree.root, {"other"}, [] (tbuf::NodeCore &nc) {});
+	failures += (stats.queries != 2) || (stats.descends != 4) || (stats.descendComparisons != 6);
+	// The two-stage parsing counts the same nodes
+	std::vector<char> buf2(msg.begin(), msg.end());
+	buf2.push_back(EOF);
+	fio::FastInput fin2(msg.length(), &buf2[0], false);
+	tbuf::StructuralIndex index(fin2);
+	tbuf::Tree indexed(index);
+	const tbuf::TreeStats &indexedStats = indexed.statistics();
+	failures += (indexedStats.bytesScanned != msg.length()) || (indexedStats.maxDepth != 5) ||
+	            !std::equal(stats.nodesByKind, stats.nodesByKind + 4, indexedStats.nodesByKind);
+	// Export
+	std::string exported;
+	stats.forEach([&exported] (const char *name, uint64_t value) {
+		exported += std::string(name) + "=" + std::to_string(value) + " ";
+	});
+	failures += (exported.find("bytes_scanned=" + std::to_string(msg.length()) + " ") == std::string::npos) ||
+	            (exported.find("max_depth=5 ") == std::string::npos) || (exported.find("descend_comparisons=6 ") == std::string::npos);
+	tree.resetStatistics();
+	failures += (stats.bytesScanned != 0) || (stats.queries != 0);
+	if(failures == 0) {
+		printf("...counters are right: %s\n", exported.c_str());
+	} else {
+		printf("FIXME: %d counter checks failed: %s\n", failures, exported.c_str());
+	}
+}
+
+/** Feeds the message to the parser in fragments of random sizes (1 to maxFragment bytes) and counts the messages */
+template<class Handler>
+void feedInFragments(tbuf::IncrementalParser &parser, const std::string &msg, unsigned int seed, unsigned int maxFragment, Handler handler) {
+	size_t at = 0;
+	while(at < msg.length()) {
+		seed = seed * 1103515245 + 12345;
+		size_t length = std::min<size_t>(1 + (seed >> 16) % maxFragment, msg.length() - at);
+		// Copied so that the parser cannot keep referring the fragment
+		std::string fragment = msg.substr(at, length);
+		const char *data = fragment.c_str();
+		while(length > 0) {
+			size_t used = parser.feed(data, length);
+			data += used;
+			length -= used;
+			at += used;
+			if(parser.hasMessage()) {
+				handler(parser.take());
+			}
+		}
+	}
+}
+
+void testIncrementalParser(){
+	printf("Testing the incremental parser with fragmented input...\n");
+	int failures = 0;
+	// Whole inputs: the same trees as parsing them at once
+	for(unsigned int seed = 0; seed < 300; ++seed) {
+		std::string msg = randomMessage(seed, seed % 60);
+		std::vector<char> buf(msg.begin(), msg.end());
+		buf.push_back(EOF);
+		fio::FastInput fin(msg.length(), &buf[0], false);
+		tbuf::Tree whole(fin);
+		tbuf::IncrementalParser parser(false);
+		feedInFragments(parser, msg, seed, 1 + seed % 17, [] (std::unique_ptr<tbuf::Tree> tree) {});
+		parser.finish();
+		std::unique_ptr<tbuf::Tree> parsed = parser.take();
+		if(dumpTree(parsed->root) != dumpTree(whole.root)) {
+			printf("FIXME: incremental parse of seed %u differs:\n%s\n%s\n", seed, dumpTree(whole.root).c_str(), dumpTree(parsed->root).c_str());
+			++failures;
+		}
+	}
+	// A stream of messages: every top-level node is one
+	std::vector<std::string> messages;
+	std::string stream;
+	for(int i = 0; i < 50; ++i) {
+		messages.push_back("frame{" + std::to_string(1000 + i) + " $_t{a \\} b} w{01} word # c}\n }");
+		stream += messages.back() + ((i % 2) ? "\n" : "\n# between\n\t");
+	}
+	for(unsigned int maxFragment : {1u, 3u, 64u, 100000u}) {
+		tbuf::IncrementalParser parser;
+		unsigned int count = 0;
+		feedInFragments(parser, stream, maxFragment, maxFragment, [&] (std::unique_ptr<tbuf::Tree> tree) {
+			std::vector<char> buf(messages[count].begin(), messages[count].end());
+			buf.push_back(EOF);
+			fio::FastInput fin(messages[count].length(), &buf[0], false);
+			tbuf::Tree expected(fin);
+			failures += (dumpTree(tree->root) != dumpTree(expected.root));
+			++count;
+		});
+		failures += !parser.finish() || parser.hasMessage() || (count != messages.size());
+	}
+	// Cut off tokens at the end
+	struct { const char *msg; bool clean; const char *dump; } endings[] = {
+		{"a{01} b{02", false, "0 /()\n1*a(01)\n1*b(02)\n"},
+		{"a{01}", true, "0 /()\n1*a(01)\n"},
+		{"0A x{", false, "0*/(0A)\n"},
+		{"x{0} nam", false, "0 /()\n1*x(0)\n"},
+		{"$_t{te\\", false, "0*/()\n"},
+		{"word ", true, "0 /()\n1*word()\n"},
+	};
+	for(auto &e : endings) {
+		tbuf::IncrementalParser parser(false);
+		failures += (parser.feed(e.msg, strlen(e.msg)) != strlen(e.msg));
+		bool clean = parser.finish();
+		std::string dump = dumpTree(parser.current().root);
+		if((clean != e.clean) || (dump != e.dump)) {
+			printf("FIXME: incremental parse of '%s' ended %s with:\n%s\n", e.msg, clean ? "clean" : "cut off", dump.c_str());
+			++failures;
+		}
+	}
+	// A complete message stops the feeding
+	tbuf::IncrementalParser parser;
+	failures += (parser.feed("a{} b{}", 7) != 3) || !parser.hasMessage() || (parser.feed(" b{}", 4) != 0);
+	if(failures == 0) {
+		printf("...fragmented messages give the same trees as whole ones\n");
+	} else {
+		printf("FIXME: %d incremental parser checks failed!\n", failures);
+	}
+}
+
+/** Writes the events the same way as eventDump(..) writes the tree - nodes starting with skipPrefix are skipped */
+struct DumpingHandler {
+	std::string dump = "0 (";
+	unsigned int depth = 0;
+	/** The ')' of the last line is still missing (the hexes might come) */
+	bool inLine = true;
+	char skipPrefix = 0;
+
+	void endLine() {
+		if(inLine) {
+			dump += ")\n";
+			inLine = false;
+		}
+	}
+	tbuf::VisitResult onOpen(fio::LenString name) {
+		endLine();
+		dump += std::to_string(++depth) + " " + std::string(name.startPtr, name.length) + "(";
+		inLine = true;
+		bool skip = (skipPrefix != 0) && (name.length > 0) && (name.startPtr[0] == skipPrefix);
+		return skip ? tbuf::VisitResult::SKIP_CHILDREN : tbuf::VisitResult::CONTINUE;
+	}
+	void onHexes(fio::LenString digits) {
+		dump += std::string(digits.startPtr, digits.length);
+	}
+	void onText(fio::LenString name, fio::LenString text) {
+		endLine();
+		std::string unescaped(text.length, ' ');
+		unescaped.resize(tbuf::unescapeText(text, &unescaped[0]));
+		dump += std::to_string(depth + 1) + " " + std::string(name.startPtr, name.length) + "$(" + unescaped + ")\n";
+	}
+	void onClose() {
+		endLine();
+		--depth;
+	}
+};
+
+/** Dumps the tree like the DumpingHandler does (skipped nodes are there without their hexes and children) */
+std::string eventDump(tbuf::Node &root, char skipPrefix) {
+	std::string dump;
+	root.dfs_preorder([&dump, skipPrefix] (tbuf::NodeCore& nc, unsigned int depth, bool leaf) {
+		bool skip = (depth > 0) && (skipPrefix != 0) && (nc.nameLength > 0) && (nc.name[0] == skipPrefix);
+		dump += std::to_string(depth) + " " + ((depth > 0) ? std::string(nc.name, nc.nameLength) : std::string());
+		if(nc.nodeKind == tbuf::NodeKind::TEXT) {
+			dump += "$(" + ((nc.text != nullptr) ? std::string(nc.text, nc.textLength) : std::string()) + ")\n";
+		} else {
+			dump += "(" + ((!skip && !nc.data.isEmpty()) ? nc.data.digits.get_str() : std::string()) + ")\n";
+		}
+		return skip ? tbuf::VisitResult::SKIP_CHILDREN : tbuf::VisitResult::CONTINUE;
+	});
+	return dump;
+}
+
+/** Only counts the events - this must not allocate */
+struct CountingHandler {
+	unsigned int opens = 0;
+	unsigned int closes = 0;
+	unsigned int texts = 0;
+	size_t hexDigits = 0;
+
+	void onOpen(fio::LenString name) { ++opens; }
+	void onHexes(fio::LenString digits) { hexDigits += digits.length; }
+	void onText(fio::LenString name, fio::LenString text) { ++texts; }
+	tbuf::VisitResult onClose() { ++closes; return tbuf::VisitResult::CONTINUE; }
+};
+
+void testEventParser(){
+	printf("Testing the event parser against the trees...\n");
+	int failures = 0;
+	for(unsigned int seed = 0; seed < 300; ++seed) {
+		std::string msg = randomMessage(seed, seed % 60);
+		std::vector<char> treeBuf(msg.begin(), msg.end());
+		treeBuf.push_back(EOF);
+		fio::FastInput treeIn(msg.length(), &treeBuf[0], false);
+		tbuf::Tree tree(treeIn);
+		for(char skipPrefix : {'\0', 'a', 'n', 'l'}) {
+			std::string expected = eventDump(tree.root, skipPrefix);
+			// From memory
+			std::vector<char> buf(msg.begin(), msg.end());
+			buf.push_back(EOF);
+			fio::FastInput fin(msg.length(), &buf[0], false);
+			DumpingHandler handler;
+			handler.skipPrefix = skipPrefix;
+			tbuf::parseEvents(fin, handler);
+			handler.endLine();
+			// From a stream with a small buffer (the names and texts must survive the refills)
+			FILE *f = tmpfile();
+			fwrite(msg.data(), 1, msg.length(), f);
+			rewind(f);
+			fio::StreamInput sin(f, true, 4);
+			DumpingHandler streamHandler;
+			streamHandler.skipPrefix = skipPrefix;
+			tbuf::parseEvents(sin, streamHandler);
+			streamHandler.endLine();
+			if((handler.dump != expected) || (streamHandler.dump != expected)) {
+				printf("FIXME: events (skipping '%c') differ for:\n%s\n%s\n%s\n%s\n", skipPrefix, msg.c_str(), expected.c_str(), handler.dump.c_str(), streamHandler.dump.c_str());
+				++failures;
+			}
+		}
+	}
+
+	// Stopping, the result of the parse and the balance of the events
+	const char *msg = "a{01 b{02} $t{x\\}y} c{03 d{ e } } w } z{04}";
+	std::vector<char> buf(msg, msg + strlen(msg) + 1);
+	buf.back() = EOF;
+	{
+		fio::FastInput fin(strlen(msg), &buf[0], false);
+		CountingHandler counter;
+		failures += !tbuf::parseEvents(fin, counter) || (counter.opens != 7) || (counter.closes != 7) || (counter.texts != 1) || (counter.hexDigits != 8);
+	}
+	{
+		struct Stopper {
+			unsigned int opens = 0;
+			tbuf::VisitResult onOpen(fio::LenString name) { return (++opens == 3) ? tbuf::VisitResult::STOP : tbuf::VisitResult::CONTINUE; }
+			void onHexes(fio::LenString digits) {}
+			void onText(fio::LenString name, fio::LenString text) {}
+			void onClose() {}
+		} stopper;
+		fio::FastInput fin(strlen(msg), &buf[0], false);
+		tbuf::EventParser<fio::FastInput, Stopper> parser(fin, stopper);
+		failures += parser.parse() || !parser.isStopped() || (stopper.opens != 3) || (parser.depth() != 1);
+	}
+	{
+		const char *cut = "a{01 b{";
+		std::vector<char> cutBuf(cut, cut + strlen(cut) + 1);
+		cutBuf.back() = EOF;
+		fio::FastInput fin(strlen(cut), &cutBuf[0], false);
+		CountingHandler counter;
+		failures += tbuf::parseEvents(fin, counter) || (counter.opens != 1) || (counter.closes != 0);
+	}
+
+	// No allocations at all while parsing a bigger message
+	std::string big;
+	for(unsigned int seed = 0; seed < 50; ++seed) {
+		big += randomMessage(seed, 60) + "\n}}}}}}}}}}\n";
+	}
+	std::vector<char> bigBuf(big.begin(), big.end());
+	bigBuf.push_back(EOF);
+	fio::FastInput bigIn(big.length(), &bigBuf[0], false);
+	CountingHandler counter;
+	unsigned long long allocations = allocationCount;
+	tbuf::parseEvents(bigIn, counter);
+	allocations = allocationCount - allocations;
+	if((allocations != 0) || (counter.opens == 0)) {
+		printf("FIXME: the event parser allocated %llu times for %u nodes\n", allocations, counter.opens);
+		++failures;
+	}
+
+	if(failures == 0) {
+		printf("...the events describe the same trees (with subtree skipping and without allocations)\n");
+	} else {
+		printf("FIXME: %d event parser checks failed!\n", failures);
+	}
+}
+
+/** Dumps what the reader reads the same way as eventDump(..) - skipping the children of the nodes starting with skipPrefix */
+template<class InputSubClass>
+std::string readerDump(tbuf::Reader<InputSubClass> &reader, char skipPrefix) {
+	std::string dump;
+	while(reader.next()) {
+		fio::LenString name = reader.name();
+		switch(reader.kind()) {
+		case tbuf::ReaderKind::ROOT:
+			dump += "0 (" + (!reader.hexes().isEmpty() ? reader.hexes().digits.get_str() : std::string()) + ")\n";
+			break;
+		case tbuf::ReaderKind::NORM:
+			dump += std::to_string(reader.depth()) + " " + std::string(name.startPtr, name.length) + "(";
+			if((skipPrefix != 0) && (name.length > 0) && (name.startPtr[0] == skipPrefix)) {
+				reader.skipChildren();
+			} else if(!reader.hexes().isEmpty()) {
+				dump += reader.hexes().digits.get_str();
+			}
+			dump += ")\n";
+			break;
+		case tbuf::ReaderKind::TEXT: {
+			std::string unescaped(reader.text().length, ' ');
+			unescaped.resize(tbuf::unescapeText(reader.text(), &unescaped[0]));
+			dump += std::to_string(reader.depth()) + " " + std::string(name.startPtr, name.length) + "$(" + unescaped + ")\n";
+			break;
+		}
+		default:
+			break;
+		}
+	}
+	return dump;
+}
+
+void testReader(){
+	printf("Testing the pull reader against the trees...\n");
+	int failures = 0;
+	for(unsigned int seed = 0; seed < 300; ++seed) {
+		std::string msg = randomMessage(seed, seed % 60);
+		std::vector<char> treeBuf(msg.begin(), msg.end());
+		treeBuf.push_back(EOF);
+		fio::FastInput treeIn(msg.length(), &treeBuf[0], false);
+		tbuf::Tree tree(treeIn);
+		for(char skipPrefix : {'\0', 'a', 'n', 'l'}) {
+			std::string expected = eventDump(tree.root, skipPrefix);
+			std::vector<char> buf(msg.begin(), msg.end());
+			buf.push_back(EOF);
+			fio::FastInput fin(msg.length(), &buf[0], false);
+			tbuf::Reader<fio::FastInput> reader(fin);
+			std::string dump = readerDump(reader, skipPrefix);
+			// From a stream with a small buffer (the names, hexes and texts must survive the refills)
+			FILE *f = tmpfile();
+			fwrite(msg.data(), 1, msg.length(), f);
+			rewind(f);
+			fio::StreamInput sin(f, true, 4);
+			tbuf::Reader<fio::StreamInput> streamReader(sin);
+			std::string streamDump = readerDump(streamReader, skipPrefix);
+			if((dump != expected) || (streamDump != expected)) {
+				printf("FIXME: reader (skipping '%c') differs for:\n%s\n%s\n%s\n%s\n", skipPrefix, msg.c_str(), expected.c_str(), dump.c_str(), streamDump.c_str());
+				++failures;
+			}
+		}
+	}
+
+	// The items with their depths - words and skipped nodes are closed too
+	struct { const char *msg; const char *items; bool cutOff; } cases[] = {
+		{"0A a{01 w $t{x\\}y} b{ c{} } } z ", "R0 N1 N2 C2 T2 N2 N3 C3 C2 C1 N1 C1 ", false},
+		{"a{ # } in a comment\n s{ $t{ } } } x }", "R0 N1 N2 C2 C1 N1 C1 ", false},
+		{"a{01 b{02", "R0 N1 N2 ", true},
+		{"a{ $t{never closed", "R0 N1 ", true},
+	};
+	for(auto &c : cases) {
+		std::vector<char> buf(c.msg, c.msg + strlen(c.msg) + 1);
+		buf.back() = EOF;
+		fio::FastInput fin(strlen(c.msg), &buf[0], false);
+		tbuf::Reader<fio::FastInput> reader(fin);
+		std::string items;
+		while(reader.next()) {
+			items += "?RNTC"[(int)reader.kind()] + std::to_string(reader.depth()) + " ";
+			// Skips "s" (with the braces in its text) when we meet it
+			if((reader.kind() == tbuf::ReaderKind::NORM) && (reader.name().startPtr[0] == 's')) {
+				reader.skipChildren();
+			}
+		}
+		if((items != c.items) || (reader.isCutOff() != c.cutOff) || (reader.kind() != tbuf::ReaderKind::NONE)) {
+			printf("FIXME: reading '%s' gave: %s (cut off: %d)\n", c.msg, items.c_str(), reader.isCutOff());
+			++failures;
+		}
+	}
+
+	// Reading a field out of a message does not allocate
+	const char *msg = "frame{ header{ id{0102} $name{a \\} b} } payload{ big{ 0A } $t{}} } } trailer{FF}";
+	std::vector<char> buf(msg, msg + strlen(msg) + 1);
+	buf.back() = EOF;
+	fio::FastInput fin(strlen(msg), &buf[0], false);
+	unsigned long long allocations = allocationCount;
+	tbuf::Reader<fio::FastInput> reader(fin);
+	unsigned int id = 0;
+	unsigned int trailer = 0;
+	while(reader.next()) {
+		if(reader.kind() != tbuf::ReaderKind::NORM) continue;
+		if(reader.name().length == 7 && memcmp(reader.name().startPtr, "payload", 7) == 0) reader.skipChildren();
+		if(reader.name().length == 2 && memcmp(reader.name().startPtr, "id", 2) == 0) id = reader.hexes().asUint();
+		if(reader.name().length == 7 && memcmp(reader.name().startPtr, "trailer", 7) == 0) trailer = reader.hexes().asUint();
+	}
+	allocations = allocationCount - allocations;
+	if((id != 0x0102) || (trailer != 0xFF) || (allocations != 0)) {
+		printf("FIXME: reader got id %x and trailer %x with %llu allocations\n", id, trailer, allocations);
+		++failures;
+	}
+
+	if(failures == 0) {
+		printf("...the reader reads the same trees (with skipping and without allocations)\n");
+	} else {
+		printf("FIXME: %d reader checks failed!\n", failures);
+	}
+}
+
+/** Returns the query of the node (with the '@' indices among the same named siblings) */
+std::string queryOf(tbuf::Node &node) {
+	std::string query;
+	for(tbuf::Node *n = &node; n->parent != nullptr; n = n->parent) {
+		int index = 0;
+		for(tbuf::Node &sibling : n->parent->children) {
+			if(&sibling == n) break;
+			index += (sibling.core.nameLength == n->core.nameLength) && !memcmp(sibling.core.name, n->core.name, n->core.nameLength);
+		}
+		query = "/" + std::string(n->core.name, n->core.nameLength) + "@" + std::to_string(index) + query;
+	}
+	return query;
+}
+
+/** Counts the nodes of the tree below the given one (the node included) */
+unsigned int countNodes(tbuf::Node &node) {
+	unsigned int count = 0;
+	node.dfs_preorder([&count] (tbuf::NodeCore& nc, unsigned int depth, bool leaf) {
+		++count;
+	});
+	return count;
+}
+
+void testProjection(){
+	printf("Testing the projection parsing...\n");
+	int failures = 0;
+	for(unsigned int seed = 0; seed < 300; ++seed) {
+		std::string msg = randomMessage(seed, seed % 60);
+		std::vector<char> fullBuf(msg.begin(), msg.end());
+		fullBuf.push_back(EOF);
+		fio::FastInput fullIn(msg.length(), &fullBuf[0], false);
+		tbuf::Tree full(fullIn);
+		// Queries to some of the nodes - and some that cannot be found
+		std::vector<tbuf::CompiledQuery> queries;
+		std::vector<tbuf::Node*> stack{&full.root};
+		for(unsigned int n = 0; !stack.empty(); ++n) {
+			tbuf::Node *node = stack.back();
+			stack.pop_back();
+			for(tbuf::Node &child : node->children) {
+				stack.push_back(&child);
+			}
+			std::string name(node->core.name, node->core.nameLength);
+			// Names with the query syntax in them cannot be asked for
+			if((node != &full.root) && (((seed + n) % 5) == 0) && (name.find_first_of("/@_") == std::string::npos)) {
+				queries.push_back(tbuf::CompiledQuery(queryOf(*node).c_str()));
+			}
+		}
+		queries.push_back(tbuf::CompiledQuery("node/missing"));
+		queries.push_back(tbuf::CompiledQuery("long_"));
+		queries.push_back(tbuf::CompiledQuery("a@1/$_t"));
+		for(int mode = 0; mode < 3; ++mode) {
+			// Copying, destructive and streamed
+			std::vector<char> buf(msg.begin(), msg.end());
+			buf.push_back(EOF);
+			fio::FastInput fin(msg.length(), &buf[0], false);
+			FILE *f = tmpfile();
+			fwrite(msg.data(), 1, msg.length(), f);
+			rewind(f);
+			fio::StreamInput sin(f, true, 4);
+			std::unique_ptr<tbuf::Tree> projected((mode < 2) ? new tbuf::Tree(fin, queries, mode == 1) : new tbuf::Tree(sin, queries));
+			for(size_t i = 0; i < queries.size(); ++i) {
+				tbuf::Node *expected = queries[i].find(full.root);
+				tbuf::Node *found = projected->projected(i);
+				if((expected == nullptr) != (found == nullptr) || ((found != nullptr) && (dumpTree(*found) != dumpTree(*expected)))) {
+					printf("FIXME: projection (mode %d) of query %zu differs for:\n%s\n%s\n%s\n", mode, i, msg.c_str(),
+							(expected != nullptr) ? dumpTree(*expected).c_str() : "-", (found != nullptr) ? dumpTree(*found).c_str() : "-");
+					++failures;
+				}
+			}
+			failures += (countNodes(projected->root) > countNodes(full.root)) || (projected->root.core.data.digits.get_str() != full.root.core.data.digits.get_str());
+		}
+	}
+
+	// Only the found nodes and their ancestors are built
+	const char *msg = "0A head{ id{01} skip{ $t{} deep{ x } } } body{ item{01} item{02 $_d{a\\}b} sub{03} } item{04} } tail{FF}";
+	std::vector<char> buf(msg, msg + strlen(msg) + 1);
+	buf.back() = EOF;
+	fio::FastInput fin(strlen(msg), &buf[0], false);
+	tbuf::Tree projected(fin, {tbuf::CompiledQuery("head/id"), tbuf::CompiledQuery("body/item@1"), tbuf::CompiledQuery("body/item@1/sub"), tbuf::CompiledQuery("nothing")});
+	std::string dump = dumpTree(projected.root);
+	const char *expected = "0 /(0A)\n1 head()\n2*id(01)\n1 body()\n2 item(02)\n3*$_d$(a}b)\n3*sub(03)\n";
+	if((dump != expected) || (projected.projected(2) == nullptr) || (projected.projected(2)->core.data.asUint() != 3) || (projected.projected(3) != nullptr)) {
+		printf("FIXME: projected tree is:\n%s\n", dump.c_str());
+		++failures;
+	}
+
+	if(failures == 0) {
+		printf("...the projected trees have the same nodes for the queries\n");
+	} else {
+		printf("FIXME: %d projection checks failed!\n", failures);
+	}
+}
+
+/** Messages of the same shape with different values - bigger ones when wide is set */
+std::string sameShapeMessage(unsigned int i, bool wide) {
+	char hex[16];
+	snprintf(hex, sizeof(hex), "%08X", i * 2654435761u);
+	std::string msg = std::string(hex) + " frame{" + hex + " header{ id{" + hex + "} $_name{user \\} " + std::to_string(i) + "} } values{";
+	for(unsigned int v = 0; v < (wide ? 300u : 100u); ++v) {
+		msg += " v{" + std::string(hex + (v % 8)) + "}";
+	}
+	return msg + " } # " + std::to_string(i) + "\n flag }\n";
+}
+
+void testTreeReuse(){
+	printf("Testing the reuse of trees for more messages...\n");
+	int failures = 0;
+	std::vector<std::string> msgs;
+	for(unsigned int i = 0; i < 40; ++i) {
+		msgs.push_back(sameShapeMessage(i, (i % 10) == 3));
+	}
+	msgs.push_back("");
+	msgs.push_back("other{01 $t{x}} } word ");
+	msgs.push_back(sameShapeMessage(99, false));
+	// Copying, referring and streamed: always the same trees as new ones
+	for(int mode = 0; mode < 3; ++mode) {
+		tbuf::Tree reused;
+		uint64_t serial = reused.symbolTable().serial();
+		for(const std::string &msg : msgs) {
+			std::vector<char> freshBuf(msg.begin(), msg.end());
+			freshBuf.push_back(EOF);
+			fio::FastInput freshIn(msg.length(), &freshBuf[0], false);
+			tbuf::Tree fresh(freshIn);
+			std::vector<char> buf(msg.begin(), msg.end());
+			buf.push_back(EOF);
+			fio::FastInput fin(msg.length(), &buf[0], false);
+			FILE *f = tmpfile();
+			fwrite(msg.data(), 1, msg.length(), f);
+			rewind(f);
+			fio::StreamInput sin(f, true, 16);
+			if(mode < 2) {
+				reused.reparse(fin, mode == 1);
+			} else {
+				reused.reparse(sin);
+			}
+			if(dumpTree(reused.root) != dumpTree(fresh.root)) {
+				printf("FIXME: reparsed tree (mode %d) differs:\n%s\n%s\n", mode, dumpTree(fresh.root).c_str(), dumpTree(reused.root).c_str());
+				++failures;
+			}
+		}
+		// The copied names (and their IDs) are kept, the referred ones are not
+		failures += ((reused.symbolTable().serial() == serial) != (mode != 1));
+		reused.clear();
+		failures += !reused.root.children.empty() || !reused.root.core.data.isEmpty();
+	}
+
+	// No allocations in the steady state - the queries keep working with their cached IDs
+	for(int refer = 0; refer < 2; ++refer) {
+		std::vector<std::vector<char>> bufs;
+		for(const std::string &msg : msgs) {
+			bufs.push_back(std::vector<char>(msg.begin(), msg.end()));
+			bufs.back().push_back(EOF);
+		}
+		tbuf::Tree tree;
+		tbuf::CompiledQuery idQuery("frame/header/id");
+		unsigned long long allocations = 0;
+		for(unsigned int i = 0; i < 40; ++i) {
+			fio::FastInput fin(msgs[i].length(), &bufs[i][0], false);
+			unsigned long long before = allocationCount;
+			tree.reparse(fin, refer == 1);
+			tbuf::Node *id = idQuery.find(tree.root);
+			if(i >= 20) {
+				allocations += allocationCount - before;
+			}
+			failures += (id == nullptr) || (id->core.data.asUint() != i * 2654435761u);
+		}
+		if(allocations != 0) {
+			printf("FIXME: reparsing the same shaped messages (refer: %d) allocated %llu times\n", refer, allocations);
+			++failures;
+		}
+	}
+
+	// Ever changing names do not pile up - the queries find their names again after the names are forgotten
+	tbuf::Tree changing;
+	changing.limitKeptNames(100);
+	tbuf::CompiledQuery keyQuery("msg/key");
+	size_t mostNames = 0;
+	for(unsigned int i = 0; i < 200; ++i) {
+		std::string msg = "msg{ key{" + std::to_string(i % 10) + "} id" + std::to_string(i) + " }";
+		std::vector<char> buf(msg.begin(), msg.end());
+		buf.push_back(EOF);
+		fio::FastInput fin(msg.length(), &buf[0], false);
+		changing.reparse(fin);
+		tbuf::Node *key = keyQuery.find(changing.root);
+		failures += (key == nullptr) || (key->core.data.asUint() != i % 10);
+		mostNames = std::max(mostNames, changing.symbolTable().size());
+	}
+	if(mostNames > 101 + 3) {
+		printf("FIXME: the reused tree kept %u names!\n", (unsigned int)mostNames);
+		++failures;
+	}
+
+	// The incremental parser reuses the given back trees
+	std::string stream;
+	for(unsigned int i = 0; i < 40; ++i) {
+		stream += sameShapeMessage(i, false).substr(9);
+	}
+	tbuf::IncrementalParser parser;
+	unsigned int count = 0;
+	unsigned long long allocations = 0;
+	for(size_t at = 0; at < stream.length(); at += 100) {
+		const char *data = stream.data() + at;
+		size_t length = std::min<size_t>(100, stream.length() - at);
+		unsigned long long before = allocationCount;
+		while(length > 0) {
+			size_t used = parser.feed(data, length);
+			data += used;
+			length -= used;
+			if(parser.hasMessage()) {
+				std::unique_ptr<tbuf::Tree> tree = parser.take();
+				failures += (tree->root.children.size() != 1);
+				++count;
+				parser.recycle(std::move(tree));
+			}
+		}
+		if(count >= 20) {
+			allocations += allocationCount - before;
+		}
+	}
+	if((count != 40) || (allocations != 0)) {
+		printf("FIXME: the incremental parser got %u messages with %llu allocations\n", count, allocations);
+		++failures;
+	}
+
+	if(failures == 0) {
+		printf("...reused trees are the same as new ones (without allocations for the same shaped messages)\n");
+	} else {
+		printf("FIXME: %d tree reuse checks failed!\n", failures);
+	}
+}
+
+/** Reference recursive walk: appends "name:depth:leaf" of every node in preorder or postorder */
+void walkRecursively(tbuf::Node &node, unsigned int depth, bool post, std::string &out) {
+	std::string visit = std::string(node.core.name, node.core.nameLength) + ":" + std::to_string(depth) + ":" + (node.children.empty() ? "1 " : "0 ");
+	if(!post) out += visit;
+	for(tbuf::Node &child : node.children) {
+		walkRecursively(child, depth + 1, post, out);
+	}
+	if(post) out += visit;
+}
+
+void testTraversal(){
+	printf("Testing the iterative tree walks...\n");
+	int failures = 0;
+	auto recorder = [] (std::string &out) {
+		return [&out] (tbuf::NodeCore &nc, unsigned int depth, bool leaf) {
+			out += std::string(nc.name, nc.nameLength) + ":" + std::to_string(depth) + ":" + (leaf ? "1 " : "0 ");
+		};
+	};
+	for(unsigned int seed = 0; seed < 200; ++seed) {
+		std::string msg = randomMessage(seed, seed % 100);
+		std::vector<char> buf(msg.begin(), msg.end());
+		buf.push_back(EOF);
+		fio::FastInput fin(msg.length(), &buf[0], false);
+		tbuf::Tree tree(fin, false, true, (seed % 2) == 1);
+		// Walk the whole tree and also subtrees (which should not leave the subtree)
+		std::vector<tbuf::Node*> starts{&tree.root};
+		if(!tree.root.children.empty()) starts.push_back(&tree.root.children[0]);
+		for(tbuf::Node *start : starts) {
+			for(int post = 0; post < 2; ++post) {
+				std::string expected, walked;
+				walkRecursively(*start, 0, post == 1, expected);
+				bool completed = (post == 1) ? start->dfs_postorder(recorder(walked)) : start->dfs_preorder(recorder(walked));
+				if(!completed || (walked != expected)) {
+					printf("FIXME: the %s walk differs for:\n%s\n%s\n%s\n", post ? "postorder" : "preorder", msg.c_str(), expected.c_str(), walked.c_str());
+					++failures;
+				}
+			}
+		}
+	}
+
+	// Skipping subtrees and stopping early
+	fio::FastInput fin("in.txt");
+	tbuf::Tree tree(fin);
+	unsigned int visited = 0;
+	tree.root.dfs_preorder([&visited] (tbuf::NodeCore &nc, unsigned int depth, bool leaf) {
+		++visited;
+		return (depth == 1) ? tbuf::VisitResult::SKIP_CHILDREN : tbuf::VisitResult::CONTINUE;
+	});
+	failures += (visited != 1 + 8);
+	visited = 0;
+	bool completed = tree.root.dfs_preorder([&visited] (tbuf::NodeCore &nc, unsigned int depth, bool leaf) {
+		++visited;
+		return (nc.nameLength == 5 && !memcmp(nc.name, "harom", 5)) ? tbuf::VisitResult::STOP : tbuf::VisitResult::CONTINUE;
+	});
+	failures += completed || (visited != 12);
+	visited = 0;
+	completed = tree.root.dfs_postorder([&visited] (tbuf::NodeCore &nc, unsigned int depth, bool leaf) {
+		return (++visited == 3) ? tbuf::VisitResult::STOP : tbuf::VisitResult::CONTINUE;
+	});
+	failures += completed || (visited != 3);
+
+	// Very deep trees would overflow the stack with recursion
+	const unsigned int deep = 200000;
+	std::string chain;
+	for(unsigned int i = 0; i < deep; ++i) chain += "a{";
+	for(unsigned int i = 0; i < deep; ++i) chain += "}";
+	std::vector<char> buf(chain.begin(), chain.end());
+	buf.push_back(EOF);
+	fio::FastInput deepIn(chain.length(), &buf[0], false);
+	// Rem.: Built from the index so that the debug log of the parser does not print every node
+	tbuf::StructuralIndex deepIndex(deepIn);
+	tbuf::Tree deepTree(deepIndex, true);
+	unsigned int maxDepth = 0, leaves = 0;
+	deepTree.root.dfs_preorder([&maxDepth] (tbuf::NodeCore &nc, unsigned int depth, bool leaf) {
+		maxDepth = std::max(maxDepth, depth);
+	});
+	deepTree.root.dfs_postorder([&leaves] (tbuf::NodeCore &nc, unsigned int depth, bool leaf) {
+		leaves += leaf ? 1 : 0;
+	});
+	failures += (maxDepth != deep) || (leaves != 1);
+	if(failures == 0) {
+		printf("...walks visit the same nodes as recursion - even %u levels deep\n", deep);
+	} else {
+		printf("FIXME: %d tree walk checks failed!\n", failures);
+	}
+}
+
+void testHexDecoding(){
+	printf("Testing hex decoding...\n");
+	int failures = 0;
+	const char *hexDigits = "0123456789ABCDEF";
+	unsigned int seed = 99;
+	for(unsigned int len = 0; len <= 80; ++len) {
+		for(int round = 0; round < 20; ++round) {
+			// Random hexes - sometimes with many leading zeros
+			std::string hex;
+			unsigned int zeros = (round % 3 == 0) ? len / 2 : 0;
+			for(unsigned int i = 0; i < len; ++i) {
+				seed = seed * 1103515245 + 12345;
+				hex += (i < zeros) ? '0' : hexDigits[(seed >> 16) & 15];
+			}
+			tbuf::Hexes h{fio::LenString{len, &hex[0]}};
+			// The expected value, overflow and bytes the slow way
+			uint64_t expected = 0;
+			bool overflow = false;
+			for(char c : hex) {
+				overflow = overflow || ((expected >> 60) != 0);
+				expected = (expected << 4) | tbuf::Hexes::hexValueOf(c);
+			}
+			std::vector<uint8_t> expectedBytes;
+			std::string even = (len % 2 == 1) ? "0" + hex : hex;
+			for(size_t i = 0; i < even.length(); i += 2) {
+				expectedBytes.push_back((tbuf::Hexes::hexValueOf(even[i]) << 4) | tbuf::Hexes::hexValueOf(even[i + 1]));
+			}
+			uint64_t value;
+			failures += (h.asUint64(value) == overflow);
+			failures += (!overflow && (value != expected));
+			failures += (h.asIntegral() != expected) || (h.asUint() != (unsigned int)expected);
+			std::vector<uint8_t> bytes(h.byteLength() + 1);
+			failures += (h.decodeBytes(&bytes[0], bytes.size()) != expectedBytes.size());
+			failures += !std::equal(expectedBytes.begin(), expectedBytes.end(), bytes.begin());
+			// Too small output
+			if(len > 0) {
+				failures += (h.decodeBytes(&bytes[0], h.byteLength() - 1) != tbuf::Hexes::DECODE_ERROR);
+			}
+			// Every invalid character should be found wherever it is
+			if((round == 0) && (len > 0)) {
+				const char invalid[] = {'a', 'G', '/', ':', '@', ' ', '\0', (char)0xC3};
+				for(unsigned int at = 0; at < len; ++at) {
+					std::string bad = hex;
+					bad[at] = invalid[at % sizeof(invalid)];
+					tbuf::Hexes b{fio::LenString{len, &bad[0]}};
+					failures += b.asUint64(value);
+					failures += (b.decodeBytes(&bytes[0], bytes.size()) != tbuf::Hexes::DECODE_ERROR);
+				}
+			}
+		}
+	}
+	if(failures == 0) {
+		printf("...hexes decode to the same integers and bytes as one nibble at a time\n");
+	} else {
+		printf("FIXME: %d hex decoding checks failed!\n", failures);
+	}
+}
+
+/** Returns the number of failed checks of viewing random hexes as arrays of T with the given element width */
+template<class T>
+int wrongHexArrays(unsigned int digitsPerElem, unsigned int seed) {
+	int failures = 0;
+	const char *hexDigits = "0123456789ABCDEF";
+	for(unsigned int count = 0; count <= 70; ++count) {
+		std::string hex;
+		for(unsigned int i = 0; i < count * digitsPerElem; ++i) {
+			seed = seed * 1103515245 + 12345;
+			hex += hexDigits[(seed >> 16) & 15];
+		}
+		tbuf::Hexes h{fio::LenString{(unsigned int)hex.length(), &hex[0]}};
+		tbuf::HexArray<T> view = h.asArray<T>(digitsPerElem);
+		failures += !view.isValid() || (view.size() != count);
+		std::vector<T> decoded;
+		failures += !view.decodeInto(decoded) || (decoded.size() != count);
+		for(unsigned int i = 0; i < count; ++i) {
+			// The expected element the slow way
+			uint64_t expected = 0;
+			for(unsigned int j = 0; j < digitsPerElem; ++j) {
+				expected = (expected << 4) | tbuf::Hexes::hexValueOf(hex[i * digitsPerElem + j]);
+			}
+			failures += (view[i] != (T)expected) || (decoded[i] != (T)expected);
+		}
+		// Small buffers and invalid characters
+		if(count > 0) {
+			failures += (view.decodeInto(&decoded[0], count - 1) != tbuf::Hexes::DECODE_ERROR);
+			hex[(seed >> 8) % hex.length()] = 'x';
+			failures += (view.decodeInto(&decoded[0], count) != tbuf::Hexes::DECODE_ERROR);
+			failures += view.decodeInto(decoded);
+		}
+	}
+	return failures;
+}
+
+void testHexArrays(){
+	printf("Testing hex array views...\n");
+	int failures = 0;
+	failures += wrongHexArrays<uint8_t>(2, 1) + wrongHexArrays<uint8_t>(1, 2);
+	failures += wrongHexArrays<uint16_t>(4, 3) + wrongHexArrays<uint16_t>(3, 4);
+	failures += wrongHexArrays<uint32_t>(8, 5) + wrongHexArrays<uint32_t>(5, 6);
+	failures += wrongHexArrays<uint64_t>(16, 7) + wrongHexArrays<uint64_t>(12, 8);
+	failures += wrongHexArrays<unsigned long long>(16, 9);
+	// Views that cannot work
+	std::string hex = "0123456789";
+	tbuf::Hexes h{fio::LenString{(unsigned int)hex.length(), &hex[0]}};
+	failures += h.asArray<uint16_t>().isValid() || h.asArray<uint8_t>(3).isValid() || h.asArray<uint8_t>(0).isValid();
+	failures += !h.asArray<uint32_t>(5).isValid() || (h.asArray<uint32_t>(5)[1] != 0x56789);
+	// A sensor frame: 64 samples of 4 hexes
+	std::string msg = std::string("frame{") + std::string(64 * 4, '7') + "}";
+	std::vector<char> buf(msg.begin(), msg.end());
+	buf.push_back(EOF);
+	fio::FastInput fin(msg.length(), &buf[0], false);
+	tbuf::Tree frame(fin);
+	uint16_t samples[64];
+	failures += (frame.root.children[0].core.data.asArray<uint16_t>().decodeInto(samples, 64) != 64) || (samples[63] != 0x7777);
+	if(failures == 0) {
+		printf("...array views decode the same elements as one nibble at a time\n");
+	} else {
+		printf("FIXME: %d hex array checks failed!\n", failures);
+	}
+}
+
+/** Returns what writeOut writes for the tree */
+std::string writeOutToString(tbuf::Node &root, bool prettyPrint) {
+	FILE *f = tmpfile();
+	root.writeOut(f, prettyPrint);
+	std::string written(ftell(f), '\0');
+	rewind(f);
+	if(!written.empty() && (fread(&written[0], 1, written.length(), f) != written.length())) written.clear();
+	fclose(f);
+	return written;
+}
+
+/** Returns the dump of the tree parsed from the message */
+std::string dumpOfParsed(const std::string &msg) {
+	std::vector<char> buf(msg.begin(), msg.end());
+	buf.push_back(EOF);
+	fio::FastInput fin(msg.length(), &buf[0], false);
+	tbuf::Tree tree(fin);
+	return dumpTree(tree.root);
+}
+
+void testWriter(){
+	printf("Testing the buffered writer and the output sinks...\n");
+	int failures = 0;
+	// What we write should parse back to the same tree - with any texts and hexes
+	for(unsigned int seed = 0; seed < 300; ++seed) {
+		std::string msg = randomMessage(seed, seed % 100);
+		std::vector<char> buf(msg.begin(), msg.end());
+		buf.push_back(EOF);
+		fio::FastInput fin(msg.length(), &buf[0], false);
+		tbuf::Tree tree(fin);
+		std::string expected = dumpTree(tree.root);
+		for(int pretty = 0; pretty < 2; ++pretty) {
+			fio::MemoryOutput out;
+			tbuf::Writer<fio::MemoryOutput> writer(out, pretty == 1);
+			writer.write(tree.root);
+			std::string dump = dumpOfParsed(out.str());
+			if(dump != expected) {
+				++failures;
+				printf("FIXME: written tree (pretty: %d) differs for:\n%s\n%s\n%s\n%s\n", pretty, msg.c_str(), out.str().c_str(), expected.c_str(), dump.c_str());
+			}
+		}
+	}
+	// Without escapes and long hexes the pretty printed output is the same as what writeOut gives
+	std::string msg = "almafa{ branch{ ${alma} } branch branch branch } kortefa{AB50}\n"
+			"egy{ketto{harom{FF}}}hololo{${haijojo}} fruit_apple{ $_var{alma}} x{1 y z{2}}";
+	std::vector<char> buf(msg.begin(), msg.end());
+	buf.push_back(EOF);
+	fio::FastInput fin(msg.length(), &buf[0], false);
+	tbuf::Tree fruit(fin);
+	fio::MemoryOutput prettyOut;
+	tbuf::Writer<fio::MemoryOutput>(prettyOut).write(fruit.root);
+	if(prettyOut.str() != writeOutToString(fruit.root, true)) {
+		++failures;
+		printf("FIXME: writer output differs from writeOut:\n%s\n%s\n", prettyOut.str().c_str(), writeOutToString(fruit.root, true).c_str());
+	}
+	// The dense output only differs in the space after the last word of a node (that writeOut omits)
+	fio::MemoryOutput denseOut;
+	tbuf::Writer<fio::MemoryOutput>(denseOut, false).write(fruit.root);
+	std::string dense = writeOutToString(fruit.root, false);
+	dense.replace(dense.find("branch}"), 7, "branch }");
+	if(denseOut.str() != dense) {
+		++failures;
+		printf("FIXME: dense writer output differs from writeOut:\n%s\n%s\n", denseOut.str().c_str(), dense.c_str());
+	}
+	// Many long texts (referred in place) with escapes and long hexes - through a file descriptor and a FILE*
+	std::string big = "big{\n";
+	for(int i = 0; i < 300; ++i) {
+		big += "\tsample{" + std::string(600 + i, 'A' + (i % 6)) + "}\n\t$_text{" + std::string(700, 'x') + "\\} and \\\\}\n";
+	}
+	big += "}\n";
+	std::string expected = dumpOfParsed(big);
+	std::vector<char> bigBuf(big.begin(), big.end());
+	bigBuf.push_back(EOF);
+	fio::FastInput bigIn(big.length(), &bigBuf[0], false);
+	tbuf::Tree bigTree(bigIn);
+	for(int sink = 0; sink < 2; ++sink) {
+		FILE *f = tmpfile();
+		bool good;
+		if(sink == 0) {
+			fio::StreamOutput out(fileno(f));
+			good = tbuf::Writer<fio::StreamOutput>(out, false, 16).write(bigTree.root);
+		} else {
+			fio::StreamOutput out(f);
+			good = tbuf::Writer<fio::StreamOutput>(out, true).write(bigTree.root);
+			out.flush();
+		}
+		fseek(f, 0, SEEK_END);
+		std::string written(ftell(f), '\0');
+		rewind(f);
+		good = good && (fread(&written[0], 1, written.length(), f) == written.length());
+		fclose(f);
+		if(!good || (dumpOfParsed(written) != expected)) {
+			++failures;
+			printf("FIXME: big tree written to the %s differs!\n", (sink == 0) ? "file descriptor" : "FILE*");
+		}
+	}
+	if(failures == 0) {
+		printf("...written trees parse back the same and match writeOut where it is lossless\n");
+	} else {
+		printf("FIXME: %d writer checks failed!\n", failures);
+	}
+}
+
+/** Returns what the writer writes for the tree */
+std::string writtenTree(tbuf::Node &root) {
+	fio::MemoryOutput out;
+	tbuf::Writer<fio::MemoryOutput>(out).write(root);
+	return out.str();
+}
+
+/** Tells if the core fields of the two subtrees are the same (not only what they write out) */
+bool sameCores(tbuf::Node &a, tbuf::Node &b) {
+	tbuf::NodeCore &x = a.core;
+	tbuf::NodeCore &y = b.core;
+	if((x.nodeKind != y.nodeKind) || (x.nameLength != y.nameLength) || (memcmp(x.name, y.name, x.nameLength) != 0) ||
+			(x.data.digits.length != y.data.digits.length) ||
+			((x.data.digits.length > 0) && (memcmp(x.data.digits.startPtr, y.data.digits.startPtr, x.data.digits.length) != 0)) ||
+			((x.text == nullptr) != (y.text == nullptr)) || (x.textLength != y.textLength) ||
+			((x.text != nullptr) && (memcmp(x.text, y.text, x.textLength) != 0)) ||
+			(a.children.size() != b.children.size())) {
+		return false;
+	}
+	for(size_t i = 0; i < a.children.size(); ++i) {
+		if(!sameCores(a.children[i], b.children[i])) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void testBinaryCodec(){
+	printf("Testing the binary encoding...\n");
+	int failures = 0;
+	for(unsigned int seed = 0; seed < 301; ++seed) {
+		// The last one has empty texts for sure
+		std::string msg = (seed < 300) ? randomMessage(seed, seed % 100) : "a{ $e{} b{01 $f{} } } $g{}";
+		std::vector<char> buf(msg.begin(), msg.end());
+		buf.push_back(EOF);
+		fio::FastInput fin(msg.length(), &buf[0], false);
+		tbuf::Tree tree(fin);
+		std::string expected = dumpTree(tree.root);
+		std::string encoded = tbuf::BinaryCodec::encode(tree.root);
+		fio::LenString message{(unsigned int)encoded.length(), &encoded[0]};
+		// Decoded trees - referring the message or copying it
+		for(int refer = 0; refer < 2; ++refer) {
+			std::unique_ptr<tbuf::Tree> decoded = tbuf::BinaryCodec::decode(message, refer == 1);
+			if(!decoded || (dumpTree(decoded->root) != expected) || (writtenTree(decoded->root) != writtenTree(tree.root)) ||
+					!sameCores(decoded->root, tree.root)) {
+				++failures;
+				printf("FIXME: decoded tree (refer: %d) differs for:\n%s\n%s\n", refer, msg.c_str(), decoded ? dumpTree(decoded->root).c_str() : "(null)");
+			}
+		}
+		// Walking the message gives the same as walking the tree
+		std::string walked;
+		bool walkOk = tbuf::BinaryCodec::walk(message, [&walked] (tbuf::NodeCore& nc, unsigned int depth, bool leaf) {
+			walked += std::to_string(depth) + (leaf ? "*" : " ") + std::string(nc.name, nc.nameLength);
+			if(nc.nodeKind == tbuf::NodeKind::TEXT) {
+				walked += "$(" + ((nc.text != nullptr) ? std::string(nc.text, nc.textLength) : std::string()) + ")\n";
+				// Empty texts are nullptr like in the trees
+				walked += ((nc.textLength == 0) != (nc.text == nullptr)) ? "!" : "";
+			} else {
+				walked += "(" + ((!nc.data.isEmpty()) ? nc.data.digits.get_str() : std::string()) + ")\n";
+			}
+		});
+		if(!walkOk || (walked != expected)) {
+			++failures;
+			printf("FIXME: walked message differs for:\n%s\n%s\n", msg.c_str(), walked.c_str());
+		}
+		// Broken messages are refused (and never read out of bounds)
+		for(size_t cut = 0; cut < encoded.length(); ++cut) {
+			std::string truncated = encoded.substr(0, cut);
+			if(tbuf::BinaryCodec::decode(fio::LenString{(unsigned int)cut, &truncated[0]})) {
+				++failures;
+				printf("FIXME: truncated message of %u bytes decoded!\n", (unsigned int)cut);
+			}
+		}
+		std::string flipped = encoded;
+		flipped[seed % flipped.length()] ^= (char)(1 << (seed % 8));
+		tbuf::BinaryCodec::decode(fio::LenString{(unsigned int)flipped.length(), &flipped[0]});
+	}
+	// Malformed messages: a huge digit count (that would overflow the checks), one cut off and one with extra bytes
+	// (the root has two digits first so that the seen digits would wrap around - the zero bytes need the explicit length)
+	const char hugeBytes[] = "TBB1\x01\x01\x08\x00\x01/\x02\x02\x01\x01\x00\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\x01";
+	std::string huge(hugeBytes, sizeof(hugeBytes) - 1);
+	char validBuf[] = "a{0123 b{45}}?";
+	validBuf[13] = EOF;
+	fio::FastInput validIn(13, validBuf, false);
+	tbuf::Tree validTree(validIn);
+	std::string valid = tbuf::BinaryCodec::encode(validTree.root);
+	const std::string malformed[] = {huge, huge + "\x12\x34", valid.substr(0, valid.length() - 1), valid + std::string(1, '\0')};
+	for(const std::string &bad : malformed) {
+		std::string copy = bad;
+		fio::LenString message{(unsigned int)copy.length(), &copy[0]};
+		if(tbuf::BinaryCodec::decode(message) || tbuf::BinaryCodec::decode(message, true) ||
+				tbuf::BinaryCodec::walk(message, [] (tbuf::NodeCore& nc, unsigned int depth, bool leaf) {})) {
+			++failures;
+			printf("FIXME: a malformed message of %u bytes decoded!\n", (unsigned int)copy.length());
+		}
+	}
+
+	// Subtrees can be encoded too
+	fio::FastInput fin("in.txt");
+	tbuf::Tree fruit(fin);
+	std::string encoded = tbuf::BinaryCodec::encode(fruit.root.children[0]);
+	std::unique_ptr<tbuf::Tree> almafa = tbuf::BinaryCodec::decode(fio::LenString{(unsigned int)encoded.length(), &encoded[0]});
+	if(!almafa || (almafa->root.children.size() != 5) || (writtenTree(almafa->root) != writtenTree(fruit.root.children[0]))) {
+		++failures;
+		printf("FIXME: decoded subtree differs!\n");
+	}
+	// Hex-heavy messages with repeated names get about half as big
+	std::string sensors = "sensors{\n";
+	for(int i = 0; i < 100; ++i) {
+		sensors += "\tsample{" + std::string(64, '0' + (i % 10)) + "}\n\tunit{0A}\n";
+	}
+	sensors += "}\n";
+	std::vector<char> buf(sensors.begin(), sensors.end());
+	buf.push_back(EOF);
+	fio::FastInput sensorIn(sensors.length(), &buf[0], false);
+	tbuf::Tree sensorTree(sensorIn);
+	size_t binarySize = tbuf::BinaryCodec::encode(sensorTree.root).length();
+	size_t textSize = writtenTree(sensorTree.root).length();
+	if(2 * binarySize > textSize) {
+		++failures;
+		printf("FIXME: binary message is %u bytes for %u bytes of text!\n", (unsigned int)binarySize, (unsigned int)textSize);
+	}
+	if(failures == 0) {
+		printf("...binary messages decode to the same trees (%u bytes instead of %u for the sensors)\n", (unsigned int)binarySize, (unsigned int)textSize);
+	} else {
+		printf("FIXME: %d binary encoding checks failed!\n", failures);
+	}
+}
+
+/** The example subprotocol of tbuf.tbnf */
+const char *COLOR_GRAMMAR =
+	"@include<tbuf.tbnf>\n"
+	"start::=<cmd>|<data>\n"
+	"cmd::=cmd{<msg><msg>?}\n"
+	"data::=d{<d>+}\n"
+	"# ad-hoc polymorphism here, for color variants:\n"
+	"d::=<msg>|<c_*>\n"
+	"c::=c{<hex>+}\n"
+	"c_4::=c_4{<hex>*3+}\n"
+	"c_8::=c_8{<hex>*6+}\n"
+	"c_9::=c_9{<hex>*8+}\n"
+	"pair::=p{<hex>*2*}\n"
+	"two::=t{<pair>*2 <pair>?}\n";
+
+/** Validates the message against the rule both as a tree and as a binary message */
+bool fitsTbnf(tbuf::TbnfGrammar &grammar, const std::string &msg, const std::string &rule, int &failures) {
+	std::vector<char> buf(msg.begin(), msg.end());
+	buf.push_back(EOF);
+	fio::FastInput fin(msg.length(), &buf[0], false);
+	tbuf::Tree tree(fin);
+	bool fits = grammar.validate(tree.root, rule);
+	std::string encoded = tbuf::BinaryCodec::encode(tree.root);
+	tbuf::TbnfValidator validator(grammar, rule);
+	tbuf::BinaryCodec::walk(fio::LenString{(unsigned int)encoded.length(), &encoded[0]}, validator);
+	if(validator.finish() != fits) {
+		++failures;
+		printf("FIXME: validating the binary form of %s differs!\n", msg.c_str());
+	}
+	return fits;
+}
+
+void testTbnf(){
+	printf("Testing the turbo-bnf grammars...\n");
+	int failures = 0;
+	// The grammar of the protocol itself
+	tbuf::TbnfGrammar tbnf;
+	if(!tbnf.loadFile("tbuf.tbnf") || !tbnf.compile("lang")) {
+		++failures;
+		printf("FIXME: cannot compile tbuf.tbnf: %s\n", tbnf.error().c_str());
+	}
+	const char *fitting[] = { "", "0A05", "a{}b{1}", "almafa{branch{${alma}} branch branch}", "egy{ketto{harom{FF}}}hololo{${haijojo}}",
+		"fruit_apple{$_var{alma}}", "x{0A5 y{} $_txt{Es\\{caped\\}}}" };
+	for(const char *msg : fitting) {
+		if(!fitsTbnf(tbnf, msg, "lang", failures)) {
+			++failures;
+			printf("FIXME: %s should fit tbuf.tbnf: %s\n", msg, tbnf.error().c_str());
+		}
+	}
+	const char *notFitting[] = { "xY{}", "a{b{c{d{Upper{}}}}}", "k\xc3\xb6rtefa{0AB50}", "x{$bad{t}}" };
+	for(const char *msg : notFitting) {
+		if(fitsTbnf(tbnf, msg, "lang", failures)) {
+			++failures;
+			printf("FIXME: %s should not fit tbuf.tbnf\n", msg);
+		}
+	}
+	// A subprotocol with polymorphism and multiplicities
+	tbuf::TbnfGrammar colors;
+	if(!colors.load(COLOR_GRAMMAR, strlen(COLOR_GRAMMAR))) {
+		++failures;
+		printf("FIXME: cannot load the color grammar: %s\n", colors.error().c_str());
+	}
+	const char *goodColors[] = { "cmd{${on}}", "cmd{${set} $_to{red}}", "d{c{0321F}c_4{0F000F}c_8{FF0000}${x}c_9{FF000080}}",
+		"d{c_4{0F0}}" };
+	for(const char *msg : goodColors) {
+		if(!fitsTbnf(colors, msg, "start", failures)) {
+			++failures;
+			printf("FIXME: %s should fit: %s\n", msg, colors.error().c_str());
+		}
+	}
+	const char *badColors[] = { "cmd{}", "cmd{${a}${b}${c}}", "d{}", "d{c_4{0F00}}", "d{c_8{}}", "cmd{${a}}d{c{1}}",
+		"d{c_5{000}}", "cmd{x{}}", "d{c{1}c }" };
+	for(const char *msg : badColors) {
+		if(fitsTbnf(colors, msg, "start", failures)) {
+			++failures;
+			printf("FIXME: %s should not fit\n", msg);
+		}
+	}
+	const char *goodTwos[] = { "t{p p }", "t{p{12}p{3456}p }" };
+	const char *badTwos[] = { "t{p }", "t{p p p p }", "t{p{1}p }", "t{p p q }" };
+	for(const char *msg : goodTwos) {
+		if(!fitsTbnf(colors, msg, "two", failures)) {
+			++failures;
+			printf("FIXME: %s should fit <two>: %s\n", msg, colors.error().c_str());
+		}
+	}
+	for(const char *msg : badTwos) {
+		if(fitsTbnf(colors, msg, "two", failures)) {
+			++failures;
+			printf("FIXME: %s should not fit <two>\n", msg);
+		}
+	}
+	// Errors in the grammars
+	const char *badGrammars[] = { "a::=<b>", "a::=<a>x", "a::=x{<a>", "a::=[a..z", "a::=x{}<hex>\nhex::=[0..9]", "::=x", "a::=*" };
+	for(const char *g : badGrammars) {
+		tbuf::TbnfGrammar bad;
+		if(bad.load(g, strlen(g)) && bad.compile("a")) {
+			++failures;
+			printf("FIXME: grammar %s should not compile\n", g);
+		}
+	}
+	tbuf::TbnfGrammar lines;
+	if(lines.load("# comment\nok::=x{}\nbad::=]\n", 27) || (lines.error().compare(0, 7, "line 3:") != 0)) {
+		++failures;
+		printf("FIXME: wrong grammar error: %s\n", lines.error().c_str());
+	}
+	// Validating again with the same validator does not allocate
+	std::string msg = "d{";
+	for(int i = 0; i < 1000; ++i) msg += "c_8{FF00FF}${color}";
+	msg += "}";
+	std::vector<char> buf(msg.begin(), msg.end());
+	buf.push_back(EOF);
+	fio::FastInput fin(msg.length(), &buf[0], false);
+	tbuf::Tree tree(fin);
+	tbuf::TbnfValidator validator(colors, "start");
+	tree.root.dfs_preorder(validator);
+	bool fits = validator.finish();
+	unsigned long long allocations = allocationCount;
+	validator.reset();
+	tree.root.dfs_preorder(validator);
+	fits = fits && validator.finish();
+	if(!fits || (allocationCount != allocations)) {
+		++failures;
+		printf("FIXME: revalidation failed or allocated: %s\n", validator.error().c_str());
+	}
+	if(failures == 0) {
+		printf("...trees fit the turbo-bnf grammars they should\n");
+	} else {
+		printf("FIXME: %d turbo-bnf checks failed!\n", failures);
+	}
+}
+
+/** A sensor frame that uses every field of sensors.tbnf */
+const char *SENSOR_FRAME =
+	"subtree{0A0B\n"
+	"\tsensor{00112233445566778899AABBCCDDEEFF unit{0A} $_label{Temp \\} one} enabled limit{0010} limit{FFFF} $_note{a} $_note{b}}\n"
+	"\tsensor{FFEEDDCCBBAA99887766554433221100 unit{1} $_label{x} enabled{} # comment\n\t}\n"
+	"\t$_tag{t1} $_tag{t2}\n"
+	"}\n"
+	"subtree{}\n"
+	"crc{DEADBEEF}\n";
+
+/** Parses the message with the generated parser */
+bool parseSensors(const std::string &msg, sensors::Frame &frame) {
+	std::vector<char> buf(msg.begin(), msg.end());
+	buf.push_back(EOF);
+	fio::FastInput fin(msg.length(), &buf[0], false);
+	return sensors::parse(fin, frame);
+}
+
+/** Tells if the frame has the values of SENSOR_FRAME */
+bool isSensorFrame(const sensors::Frame &f) {
+	return (f.subtree.size() == 2) && f.hasChecksum && (f.checksum.data == 0xDEADBEEF) &&
+		(f.subtree[0].data == "0A0B") && (f.subtree[0].sensor.size() == 2) && (f.subtree[0].tag.size() == 2) &&
+		(f.subtree[0].tag[1] == "t2") && f.subtree[1].data.empty() && f.subtree[1].sensor.empty() &&
+		(f.subtree[0].sensor[0].data[0] == 0x00) && (f.subtree[0].sensor[0].data[15] == 0xFF) &&
+		(f.subtree[0].sensor[0].unit.data == "0A") && (f.subtree[0].sensor[0].label == "Temp } one") &&
+		(f.subtree[0].sensor[0].limit.size() == 2) &&
+		(f.subtree[0].sensor[0].limit[1].data == 0xFFFF) && (f.subtree[0].sensor[0].note.size() == 2) &&
+		(f.subtree[0].sensor[1].data[0] == 0xFF) && (f.subtree[0].sensor[1].unit.data == "1") &&
+		(f.subtree[0].sensor[1].label == "x") && f.subtree[0].sensor[1].limit.empty() && f.subtree[0].sensor[1].note.empty();
+}
+
+void testGeneratedParser(){
+	printf("Testing the parsers generated from tbnf schemas...\n");
+	int failures = 0;
+	sensors::Frame frame;
+	if(!parseSensors(SENSOR_FRAME, frame) || !isSensorFrame(frame)) {
+		++failures;
+		printf("FIXME: the generated parser read the frame wrong!\n");
+	}
+	// The same from a stream with a really small buffer
+	FILE *f = tmpfile();
+	fputs(SENSOR_FRAME, f);
+	rewind(f);
+	fio::StreamInput sin(f, true, 4);
+	sensors::Frame streamed;
+	if(!sensors::parse(sin, streamed) || !isSensorFrame(streamed)) {
+		++failures;
+		printf("FIXME: the generated parser read the streamed frame wrong!\n");
+	}
+	// Parsing the same shape again into the same struct does not allocate
+	std::string msg = SENSOR_FRAME;
+	std::vector<char> buf(msg.begin(), msg.end());
+	buf.push_back(EOF);
+	fio::FastInput fin(msg.length(), &buf[0], false);
+	unsigned long long allocations = allocationCount;
+	if(!sensors::parse(fin, frame) || !isSensorFrame(frame) || (allocationCount != allocations)) {
+		++failures;
+		printf("FIXME: parsing again allocated %llu times!\n", allocationCount - allocations);
+	}
+	// Messages that do not fit the schema
+	const char *bad[] = {
+		"subtree{sensor{00112233445566778899AABBCCDDEEFF $_label{x} enabled}}",
+		"subtree{sensor{00112233445566778899AABBCCDDEEFF unit{1} $_label{x} enabled limit{0001}}}",
+		"subtree{sensor{0011 unit{1} $_label{x} enabled}}",
+		"subtree{sensor{00112233445566778899AABBCCDDEEFF unit{1} $_label{x} enabled{1}}}",
+		"subtree{$_tag{a}}",
+		"subtree{0A}",
+		"subtree{other{}}",
+		"crc{DEADBEEF} crc{DEADBEEF}",
+		"subtree{",
+		"subtree{}}",
+		"subtree{sensor{00112233445566778899AABBCCDDEEFF unit{1} $_label{x",
+	};
+	for(const char *msg : bad) {
+		sensors::Frame wrong;
+		if(parseSensors(msg, wrong)) {
+			++failures;
+			printf("FIXME: %s should not fit the sensor schema\n", msg);
+		}
+	}
+	// Only the optional empty leaves get a flag (and the repeated ones a count)
+	const char *flagSchema = "s::=must{} maybe{}? three{}*3 many{}*";
+	tbuf::TbnfGrammar flagGrammar;
+	tbuf::TbnfGenerator flagGenerator(flagGrammar);
+	std::ostringstream flagOut;
+	if(!flagGrammar.load(flagSchema, strlen(flagSchema)) || !flagGenerator.generate("s", "flags", flagOut) ||
+			(flagOut.str().find("bool maybe;") == std::string::npos) || (flagOut.str().find("unsigned int many;") == std::string::npos) ||
+			(flagOut.str().find(" must;") != std::string::npos) || (flagOut.str().find(" three;") != std::string::npos)) {
+		++failures;
+		printf("FIXME: wrong fields for the empty leaves:\n%s\n", flagOut.str().c_str());
+	}
+	// Schemas that cannot be generated
+	const char *badSchemas[] = {
+		"s::=<x>|<y>\nx::=x{}\ny::=y{}",
+		"s::=<c_*>\nc_1::=c_1{}",
+		"s::=<p>? <p>\np::=p{}",
+		"s::=<n>\nn::=n{<n>}",
+		"s::=<x>\nx::=[a..z]+{}",
+		"s::=<x>\nx::=x{<y>}",
+		"s::=x{<hex>}\nhex::=[0..9A..F]",
+	};
+	for(const char *schema : badSchemas) {
+		tbuf::TbnfGrammar grammar;
+		tbuf::TbnfGenerator generator(grammar);
+		std::ostringstream out;
+		if(grammar.load(schema, strlen(schema)) && generator.generate("s", "bad", out)) {
+			++failures;
+			printf("FIXME: schema %s should not generate\n", schema);
+		}
+	}
+	if(failures == 0) {
+		printf("...generated parsers read the messages into their structs without allocating again\n");
+	} else {
+		printf("FIXME: %d generated parser checks failed!\n", failures);
+	}
+}